@@ -37,7 +37,7 @@ do_build() {
   mkdir -p "$BUILD_DIR"
   cd "$BUILD_DIR"
 
-  cmake .. -DCMAKE_BUILD_TYPE=Release
+  cmake .. -DCMAKE_BUILD_TYPE=Release -DMIRTILLO_BUILD_TOOLS=OFF
   cmake --build . -j
 
   echo "Build OK → $BUILD_DIR/$TARGET_BIN"
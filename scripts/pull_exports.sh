@@ -0,0 +1,100 @@
+#!/usr/bin/env bash
+# Mirror the summaries of the mirtillo export store to a desktop directory
+# Usage:
+#   ./scripts/pull_exports.sh SRC DEST
+#
+#   SRC   local share directory (e.g. a mounted copy of
+#         /home/root/.local/share/mirtillo), or "host:" to query the device
+#         over SSH (e.g. root@10.11.99.1:)
+#   DEST  target directory: summary_<uuid>.txt|pdf are written here
+#
+# Only entries changed after the last pulled generation are transferred.
+# Requires `mirtillo --export-all --store` on the device.
+
+set -euo pipefail
+
+if [[ $# -ne 2 ]]; then
+  echo "Usage: $0 SRC DEST" >&2
+  exit 2
+fi
+
+SRC="$1"
+DEST="$2"
+RM_BIN="${RM_BIN:-/home/root/.local/bin/mirtillo}"
+RM_SHARE_DIR="${RM_SHARE_DIR:-/home/root/.local/share/mirtillo}"
+SSH_KEY="${SSH_KEY:-$HOME/.ssh/rm_key}"
+
+STATE_DIR="$DEST/.mirtillo"
+mkdir -p "$STATE_DIR"
+SINCE=0
+[[ -f "$STATE_DIR/generation" ]] && SINCE="$(cat "$STATE_DIR/generation")"
+
+# Two wrappers, as in deploy_to_paperpro.sh: an empty array expanded under
+# set -u aborts on bash < 4.4 (macOS ships 3.2)
+if [[ -f "$SSH_KEY" ]]; then
+  rm_ssh() { ssh -i "$SSH_KEY" "$@"; }
+else
+  rm_ssh() { ssh "$@"; }
+fi
+
+# -----------------------------
+# Source access
+# -----------------------------
+if [[ "$SRC" == *: ]]; then
+  HOST="${SRC%:}"
+  list_changes() { rm_ssh "$HOST" "$RM_BIN --changes-since $SINCE"; }
+  fetch_object() { rm_ssh "$HOST" "cat '$RM_SHARE_DIR/store/objects/$1'" > "$2"; }
+else
+  # Same filter as --changes-since, straight on the manifest
+  list_changes() {
+    local manifest="$SRC/store/manifest.tsv"
+    [[ -f "$manifest" ]] || { echo "Error: no store manifest in $SRC" >&2; return 1; }
+    awk -F'\t' -v since="$SINCE" 'NR == 1 || $5 > since' "$manifest"
+  }
+  fetch_object() { cp "$SRC/store/objects/$1" "$2"; }
+fi
+
+if command -v sha256sum >/dev/null; then
+  sha256_of() { sha256sum "$1" | cut -d' ' -f1; }
+else
+  sha256_of() { shasum -a 256 "$1" | cut -d' ' -f1; }
+fi
+
+# -----------------------------
+# Pull
+# -----------------------------
+CHANGES="$(mktemp)"
+trap 'rm -f "$CHANGES"' EXIT
+list_changes > "$CHANGES"
+
+IFS=$'\t' read -r magic version generation < "$CHANGES" || true
+if [[ "${magic:-}" != "mirtillo-store" || "${version:-}" != "1" ]]; then
+  echo "Error: unexpected store manifest from $SRC" >&2
+  exit 1
+fi
+
+fetched=0
+removed=0
+while IFS=$'\t' read -r uuid artifact hash size gen; do
+  target="$DEST/summary_$uuid.$artifact"
+  if [[ "$hash" == "-" ]]; then
+    rm -f "$target"
+    removed=$((removed + 1))
+    continue
+  fi
+  tmp="$target.tmp"
+  fetch_object "${hash:0:2}/$hash.$artifact" "$tmp"
+  # A newer export may have replaced the object meanwhile: keep the old
+  # generation so the next run retries
+  if [[ "$(sha256_of "$tmp")" != "$hash" ]]; then
+    rm -f "$tmp"
+    echo "Error: checksum mismatch for $uuid.$artifact, retry later" >&2
+    exit 1
+  fi
+  mv "$tmp" "$target"
+  fetched=$((fetched + 1))
+done < <(tail -n +2 "$CHANGES")
+
+echo "$generation" > "$STATE_DIR/generation.tmp"
+mv "$STATE_DIR/generation.tmp" "$STATE_DIR/generation"
+echo "Pulled generation $generation: $fetched file(s) updated, $removed removed."
@@ -0,0 +1,99 @@
+#include "arena.h"
+
+#include <algorithm>
+
+// -------------------------
+//  ScanArena
+// -------------------------
+ScanArena::ScanArena(std::size_t capacity)
+    : m_capacity(capacity)
+    , m_buffer(new std::byte[capacity])
+    , m_mono(m_buffer.get(), capacity, &m_spill)
+{
+}
+
+void ScanArena::reset()
+{
+    m_mono.release(); // torna al buffer iniziale, lo spill viene liberato
+    m_used = 0;
+}
+
+void *ScanArena::do_allocate(std::size_t bytes, std::size_t align)
+{
+    void *p = m_mono.allocate(bytes, align);
+    m_used += bytes;
+    m_highWater = std::max(m_highWater, m_used);
+    return p;
+}
+
+void ScanArena::do_deallocate(void *, std::size_t, std::size_t)
+{
+    // monotonic: si libera solo con reset()
+}
+
+bool ScanArena::do_is_equal(const std::pmr::memory_resource &other) const noexcept
+{
+    return this == &other;
+}
+
+void *ScanArena::Spill::do_allocate(std::size_t n, std::size_t align)
+{
+    bytes += n;
+    return std::pmr::new_delete_resource()->allocate(n, align);
+}
+
+void ScanArena::Spill::do_deallocate(void *p, std::size_t n, std::size_t align)
+{
+    std::pmr::new_delete_resource()->deallocate(p, n, align);
+}
+
+bool ScanArena::Spill::do_is_equal(const std::pmr::memory_resource &other) const noexcept
+{
+    return this == &other;
+}
+
+// -------------------------
+//  ArenaPool
+// -------------------------
+ArenaPool::ArenaPool(int arenas, std::size_t capacity)
+    : m_capacity(capacity)
+{
+    m_arenas.reserve(size_t(std::max(1, arenas)));
+    for (int i = 0; i < std::max(1, arenas); ++i) {
+        m_arenas.push_back(std::make_unique<ScanArena>(capacity));
+        m_free.push_back(m_arenas.back().get());
+    }
+}
+
+ArenaPool::Lease ArenaPool::acquire()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    // parallelFor non supera mai il numero di worker: c'è sempre un'arena
+    Q_ASSERT(!m_free.empty());
+    ScanArena *arena = m_free.back();
+    m_free.pop_back();
+    return Lease(*this, arena);
+}
+
+void ArenaPool::release(ScanArena *arena)
+{
+    arena->reset();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_free.push_back(arena);
+}
+
+std::size_t ArenaPool::highWater() const
+{
+    std::size_t hw = 0;
+    for (const auto &a : m_arenas)
+        hw = std::max(hw, a->highWater());
+    return hw;
+}
+
+std::size_t ArenaPool::spilled() const
+{
+    std::size_t total = 0;
+    for (const auto &a : m_arenas)
+        total += a->spilled();
+    return total;
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <QtGlobal>
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <vector>
+
+// Arena dei temporanei di un documento (scansione con --max-memory).
+// Un buffer fisso, allocato una volta, su cui un monotonic_buffer_resource
+// distribuisce span, vettori e hash del documento corrente; reset() libera
+// tutto in O(1) e il buffer viene riusato dal documento successivo. Oltre
+// la capacità si ripiega sull'heap (spill), contato a parte.
+class ScanArena : public std::pmr::memory_resource
+{
+public:
+    explicit ScanArena(std::size_t capacity);
+    ScanArena(const ScanArena &) = delete;
+    ScanArena &operator=(const ScanArena &) = delete;
+
+    // Fine del documento: tutto torna disponibile (il buffer resta)
+    void reset();
+
+    std::size_t capacity() const { return m_capacity; }
+    // Massimo di byte in uso fra due reset()
+    std::size_t highWater() const { return m_highWater; }
+    // Byte chiesti all'heap perché il buffer era esaurito (totale)
+    std::size_t spilled() const { return m_spill.bytes; }
+
+private:
+    void *do_allocate(std::size_t bytes, std::size_t align) override;
+    void  do_deallocate(void *p, std::size_t bytes, std::size_t align) override;
+    bool  do_is_equal(const std::pmr::memory_resource &other) const noexcept override;
+
+    // Heap oltre il buffer, con il conto dei byte
+    struct Spill : std::pmr::memory_resource {
+        std::size_t bytes = 0;
+        void *do_allocate(std::size_t n, std::size_t align) override;
+        void  do_deallocate(void *p, std::size_t n, std::size_t align) override;
+        bool  do_is_equal(const std::pmr::memory_resource &other) const noexcept override;
+    };
+
+    std::size_t                         m_capacity;
+    std::unique_ptr<std::byte[]>        m_buffer;
+    Spill                               m_spill;
+    std::pmr::monotonic_buffer_resource m_mono;
+    std::size_t                         m_used = 0;
+    std::size_t                         m_highWater = 0;
+};
+
+// Un'arena per worker. Ogni documento ne prende una in prestito (Lease) e
+// la restituisce azzerata: i worker di parallelFor non hanno un indice,
+// così il numero di arene resta quello dei worker qualunque sia il thread.
+class ArenaPool
+{
+public:
+    ArenaPool(int arenas, std::size_t capacity);
+
+    class Lease
+    {
+    public:
+        Lease(ArenaPool &pool, ScanArena *arena) : m_pool(pool), m_arena(arena) {}
+        Lease(const Lease &) = delete;
+        Lease &operator=(const Lease &) = delete;
+        ~Lease() { m_pool.release(m_arena); }
+
+        ScanArena *operator->() const { return m_arena; }
+        ScanArena &operator*() const { return *m_arena; }
+
+    private:
+        ArenaPool &m_pool;
+        ScanArena *m_arena;
+    };
+
+    // Mai più lease contemporanei delle arene (uno per worker)
+    Lease acquire();
+
+    int         arenas() const { return int(m_arenas.size()); }
+    std::size_t capacity() const { return m_capacity; }
+    // Picco su tutte le arene e spill totale (a scansione finita)
+    std::size_t highWater() const;
+    std::size_t spilled() const;
+
+private:
+    void release(ScanArena *arena);
+
+    std::size_t                             m_capacity;
+    std::vector<std::unique_ptr<ScanArena>> m_arenas;
+    std::mutex                              m_mutex;
+    std::vector<ScanArena *>                m_free;
+};
@@ -0,0 +1,282 @@
+#include "batch_export.h"
+#include "export.h"
+#include "export_store.h"
+#include "logging.h"
+#include "parallel.h"
+#include "pdf_summary.h"
+#include "paths.h"
+#include "scan_cache.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QHash>
+#include <QSaveFile>
+#include <QTextStream>
+
+#include <vector>
+
+// Manifest dei summary esportati: magic "MRTE" + versione.
+// Cambiare kSummaryFormat quando cambia il layout di printDocumentSummary:
+// tutte le impronte diventano diverse e i summary vengono riscritti.
+static const quint32 kManifestMagic   = 0x4D525445; // 'MRTE'
+static const quint32 kManifestVersion = 2; // 2: stato del PDF
+static const quint32 kSummaryFormat   = 4; // 2: Highlights, 3: note a mano, 4: estratti EPUB
+
+bool ExportFilter::matches(const DocEntry &e) const
+{
+    if (!kinds.isEmpty() && !kinds.contains(e.kind))
+        return false;
+    if (byFolder && !folders.contains(e.parentUuid))
+        return false;
+    if (taggedOnly && !e.hasTags)
+        return false;
+    return true;
+}
+
+namespace {
+
+struct ManifestEntry {
+    QByteArray fingerprint; // MD5 dei campi che finiscono nel summary
+    FileStamp  file;        // stato del summary subito dopo la scrittura
+    FileStamp  pdf;         // idem per il PDF; size -1 = non scritto con questa impronta
+};
+
+QString manifestPath()
+{
+    return mirtilloShareBase() + "/export_manifest.bin";
+}
+
+QHash<QString, ManifestEntry> loadManifest()
+{
+    QHash<QString, ManifestEntry> m;
+    QFile f(manifestPath());
+    if (!f.open(QIODevice::ReadOnly))
+        return m;
+
+    QDataStream in(&f);
+    in.setVersion(QDataStream::Qt_6_0);
+    quint32 magic = 0, version = 0, count = 0;
+    in >> magic >> version >> count;
+    if (in.status() != QDataStream::Ok || magic != kManifestMagic || version != kManifestVersion)
+        return m;
+
+    for (quint32 i = 0; i < count; ++i) {
+        QString uuid;
+        ManifestEntry e;
+        in >> uuid >> e.fingerprint >> e.file.mtimeNs >> e.file.size >> e.file.inode
+           >> e.pdf.mtimeNs >> e.pdf.size >> e.pdf.inode;
+        if (in.status() != QDataStream::Ok)
+            return QHash<QString, ManifestEntry>(); // troncato: si riesporta tutto
+        m.insert(uuid, e);
+    }
+    return m;
+}
+
+bool saveManifest(const QHash<QString, ManifestEntry> &m)
+{
+    QSaveFile f(manifestPath());
+    if (!f.open(QIODevice::WriteOnly))
+        return false;
+
+    QDataStream out(&f);
+    out.setVersion(QDataStream::Qt_6_0);
+    out << kManifestMagic << kManifestVersion << quint32(m.size());
+    for (auto it = m.cbegin(); it != m.cend(); ++it)
+        out << it.key() << it.value().fingerprint
+            << it.value().file.mtimeNs << it.value().file.size << it.value().file.inode
+            << it.value().pdf.mtimeNs << it.value().pdf.size << it.value().pdf.inode;
+    if (out.status() != QDataStream::Ok) {
+        f.cancelWriting();
+        return false;
+    }
+    return f.commit();
+}
+
+// Impronta di tutto ciò che printDocumentSummary stampa
+QByteArray fingerprint(const DocEntry &e)
+{
+    QByteArray raw;
+    QDataStream s(&raw, QIODevice::WriteOnly);
+    s.setVersion(QDataStream::Qt_6_0);
+    s << kSummaryFormat << e.uuid << e.visibleName << e.kind
+      << qint32(e.pages) << quint32(e.tags.size());
+    for (const TagRef &t : e.tags)
+        s << t.name() << t.pageId.toString() << qint32(t.pageNumber);
+    s << e.highlightsLoaded << e.highlightsTruncated << quint32(e.highlights.size());
+    for (const Highlight &h : e.highlights)
+        s << h.text << qint32(h.pageNumber);
+    s << e.excerptsLoaded << quint32(e.excerpts.size());
+    for (const Excerpt &x : e.excerpts)
+        s << x.text << qint32(x.pageNumber);
+    s << e.inkLoaded << quint32(e.ink.size());
+    for (const PageInk &p : e.ink)
+        s << qint32(p.pageNumber) << p.strokes << quint64(p.points)
+          << p.minX << p.minY << p.maxX << p.maxY << p.mtimeMs;
+    return QCryptographicHash::hash(raw, QCryptographicHash::Md5);
+}
+
+enum class SlotResult : quint8 { UpToDate, Written, Failed };
+
+// Oggetto dello store prodotto da un worker (hash vuoto = niente da registrare)
+struct StoreSlot {
+    QByteArray hash;
+    qint64     size = 0;
+};
+
+struct Slot {
+    SlotResult    result = SlotResult::Failed;
+    ManifestEntry entry;
+    StoreSlot     text, pdf;
+};
+
+} // namespace
+
+ExportStats exportAll(const QList<DocEntry> &pdfs,
+                      const QList<DocEntry> &epubs,
+                      const QList<DocEntry> &notebooks,
+                      const ExportFilter &filter,
+                      const ExportOptions &opts)
+{
+    ExportStats stats;
+
+    std::vector<const DocEntry *> docs;
+    for (const QList<DocEntry> *list : {&pdfs, &epubs, &notebooks})
+        for (const DocEntry &e : *list)
+            if (filter.matches(e))
+                docs.push_back(&e);
+    stats.selected = int(docs.size());
+
+    // Una sola mkpath per tutto il batch
+    if (!QDir().mkpath(mirtilloShareBase())) {
+        stats.failed = stats.selected;
+        return stats;
+    }
+
+    ExportStore store;
+    if (opts.store) {
+        QString error;
+        if (!store.load(error)) {
+            qCWarning(lcExport, "%s", qPrintable(error));
+            stats.failed = stats.selected;
+            return stats;
+        }
+    }
+
+    QHash<QString, ManifestEntry> manifest = loadManifest(); // sola lettura nel pool
+    std::vector<Slot> results(docs.size());
+
+    // Nello store va ogni artefatto scritto ora, e quelli già aggiornati
+    // che lo store non conosce ancora (primo --store dopo export normali) o
+    // che ha come rimossi (documento ricomparso dopo removeMissing)
+    auto toStore = [&](const DocEntry &e, const QString &path, const QString &artifact,
+                       bool written, StoreSlot &out) {
+        if (!opts.store)
+            return true;
+        const StoreEntry *se = written ? nullptr : store.find(e.uuid, artifact);
+        if (se && !se->hash.isEmpty())
+            return true;
+        return ExportStore::addObject(path, artifact, out.hash, out.size);
+    };
+
+    parallelFor(int(docs.size()), opts.jobs, [&](int i) {
+        const DocEntry &e = *docs[size_t(i)];
+        Slot &s = results[size_t(i)];
+        const QString path = summaryPath(e.uuid);
+        const QString pdfPath = summaryPdfPath(e.uuid);
+
+        s.entry.fingerprint = fingerprint(e);
+        const auto it = manifest.constFind(e.uuid);
+        if (it != manifest.cend() && it->fingerprint == s.entry.fingerprint &&
+            it->file == stampFile(path) &&
+            (!opts.pdf || (it->pdf.size >= 0 && it->pdf == stampFile(pdfPath)))) {
+            s.result = SlotResult::UpToDate;
+            s.entry.file = it->file;
+            s.entry.pdf = it->pdf;
+            if (!toStore(e, path, QStringLiteral("txt"), false, s.text) ||
+                (opts.pdf && !toStore(e, pdfPath, QStringLiteral("pdf"), false, s.pdf)))
+                s.result = SlotResult::Failed;
+            return;
+        }
+
+        // Buffer per worker riusati tra un documento e l'altro
+        thread_local QString text;
+        thread_local QByteArray utf8;
+        text.resize(0);
+        {
+            QTextStream ts(&text);
+            printDocumentSummary(e, ts);
+        }
+        utf8.resize(0);
+        utf8.append(text.toUtf8());
+
+        QSaveFile f(path);
+        if (!f.open(QIODevice::WriteOnly | QIODevice::Text) ||
+            f.write(utf8) != utf8.size() || !f.commit()) {
+            s.result = SlotResult::Failed;
+            return;
+        }
+        s.entry.file = stampFile(path);
+
+        // Senza --pdf il PDF eventualmente presente non corrisponde più
+        // all'impronta: resta s.entry.pdf nullo e verrà riscritto
+        if (opts.pdf) {
+            QString error;
+            if (!writeSummaryPdf(e, error)) {
+                s.result = SlotResult::Failed;
+                return;
+            }
+            s.entry.pdf = stampFile(pdfPath);
+        }
+
+        if (!toStore(e, path, QStringLiteral("txt"), true, s.text) ||
+            (opts.pdf && !toStore(e, pdfPath, QStringLiteral("pdf"), true, s.pdf))) {
+            s.result = SlotResult::Failed;
+            return;
+        }
+        s.result = SlotResult::Written;
+    });
+
+    // Merge seriale: statistiche, manifest e store
+    bool changed = false;
+    for (size_t i = 0; i < docs.size(); ++i) {
+        const Slot &s = results[i];
+        switch (s.result) {
+        case SlotResult::UpToDate: ++stats.upToDate; break;
+        case SlotResult::Failed:   ++stats.failed;   continue;
+        case SlotResult::Written:
+            ++stats.written;
+            manifest.insert(docs[i]->uuid, s.entry);
+            changed = true;
+            break;
+        }
+        if (!s.text.hash.isEmpty())
+            store.set(docs[i]->uuid, QStringLiteral("txt"), s.text.hash, s.text.size);
+        if (!s.pdf.hash.isEmpty())
+            store.set(docs[i]->uuid, QStringLiteral("pdf"), s.pdf.hash, s.pdf.size);
+    }
+
+    if (changed && !saveManifest(manifest))
+        qCWarning(lcExport, "cannot write export manifest");
+
+    if (opts.store) {
+        // Rimozioni: solo documenti spariti dalla libreria, non quelli
+        // esclusi dai filtri
+        QSet<QString> alive;
+        for (const QList<DocEntry> *list : {&pdfs, &epubs, &notebooks})
+            for (const DocEntry &e : *list)
+                alive.insert(e.uuid);
+        store.removeMissing(alive);
+
+        stats.storeChanged = store.changed();
+        QString error;
+        if (!store.commit(error)) {
+            qCWarning(lcExport, "%s", qPrintable(error));
+            ++stats.failed;
+        }
+        stats.storeGeneration = store.generation();
+    }
+
+    return stats;
+}
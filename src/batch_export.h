@@ -0,0 +1,47 @@
+#pragma once
+
+#include <QList>
+#include <QSet>
+#include <QString>
+#include "model.h"
+
+// Filtri di --export-all (tutti opzionali, in AND)
+struct ExportFilter {
+    QSet<QString> kinds;          // vuoto = tutti i tipi
+    bool          byFolder = false;
+    QSet<Uuid>    folders;        // sottoalbero di --folder (FolderIndex::subtreeFolders);
+                                  // Uuid nullo = root / My Files
+    bool          taggedOnly = false;
+
+    bool matches(const DocEntry &e) const;
+};
+
+// Opzioni di --export-all
+struct ExportOptions {
+    int  jobs  = 0;     // worker (0 = tutti i core)
+    bool pdf   = false; // anche summary_<uuid>.pdf (writeSummaryPdf)
+    bool store = false; // registra gli artefatti nello store (export_store.h)
+};
+
+struct ExportStats {
+    int selected = 0; // documenti che passano i filtri
+    int written  = 0;
+    int upToDate = 0; // summary già aggiornato: non riscritto
+    int failed   = 0;
+    int     storeChanged    = 0; // voci dello store cambiate (con --store)
+    quint64 storeGeneration = 0;
+};
+
+// Esporta il summary di tutti i documenti selezionati su `opts.jobs` worker.
+// Ogni file è scritto in modo atomico (QSaveFile).
+// Un manifest accanto ai summary (export_manifest.bin) ricorda l'impronta
+// del contenuto di ogni documento e lo stato del file scritto: se entrambi
+// coincidono il documento viene saltato senza nemmeno renderizzarlo.
+// Con `pdf` scrive anche summary_<uuid>.pdf, seguito dallo stesso manifest.
+// Con `store` copia gli artefatti nello store per hash e ne aggiorna il
+// manifest; i documenti spariti dalla libreria diventano rimozioni.
+ExportStats exportAll(const QList<DocEntry> &pdfs,
+                      const QList<DocEntry> &epubs,
+                      const QList<DocEntry> &notebooks,
+                      const ExportFilter &filter,
+                      const ExportOptions &opts);
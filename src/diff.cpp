@@ -0,0 +1,326 @@
+#include "diff.h"
+
+#include "folder_index.h"
+#include "paths.h"
+#include "scanner.h"
+
+#include <QCryptographicHash>
+#include <QFileInfo>
+#include <QSet>
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// Documento di una copia con l'impronta dei suoi tag
+struct SnapDoc {
+    const DocEntry *doc;
+    size_t          fingerprint;
+};
+
+struct TagChange {
+    QString name;
+    int     pageNumber; // -1 = sconosciuta
+    bool    added;
+};
+
+struct DocChange {
+    const DocEntry *a = nullptr; // nullptr = aggiunto in B
+    const DocEntry *b = nullptr; // nullptr = rimosso da A
+    bool renamed  = false;
+    bool moved    = false;
+    bool retagged = false;
+    std::vector<TagChange> tags;
+};
+
+} // namespace
+
+// Una cache per copia, indicizzata dal percorso assoluto della root
+static QString diffCachePath(const QString &root)
+{
+    const QByteArray key = QFileInfo(root).absoluteFilePath().toUtf8();
+    return mirtilloShareBase() + "/diff_cache/" +
+           QString::fromLatin1(QCryptographicHash::hash(key, QCryptographicHash::Md5).toHex()) +
+           ".bin";
+}
+
+// Somma degli hash delle coppie (tag, pagina): i tag sono già senza
+// duplicati (fillDetails), quindi l'ordine in cui compaiono non conta
+static size_t tagFingerprint(const DocEntry &e)
+{
+    size_t h = qHash(e.pages);
+    for (const TagRef &t : e.tags)
+        h += qHashMulti(0, t.nameId, t.pageId);
+    return h;
+}
+
+static std::vector<SnapDoc> sortedByUuid(const LibraryScan &lib)
+{
+    std::vector<SnapDoc> docs;
+    docs.reserve(size_t(lib.pdfs.size() + lib.epubs.size() + lib.notebooks.size() +
+                        lib.folders.size()));
+    for (const QList<DocEntry> *list : {&lib.pdfs, &lib.epubs, &lib.notebooks, &lib.folders})
+        for (const DocEntry &e : *list)
+            docs.push_back(SnapDoc{&e, tagFingerprint(e)});
+    std::sort(docs.begin(), docs.end(), [](const SnapDoc &x, const SnapDoc &y) {
+        return x.doc->uuid < y.doc->uuid;
+    });
+    return docs;
+}
+
+// Coppie (tag, pageId) presenti in una sola delle due versioni
+static void diffTags(const DocEntry &a, const DocEntry &b, std::vector<TagChange> &out)
+{
+    QSet<std::pair<quint32, Uuid>> inA, inB;
+    inA.reserve(a.tags.size());
+    inB.reserve(b.tags.size());
+    for (const TagRef &t : a.tags)
+        inA.insert(std::make_pair(t.nameId, t.pageId));
+    for (const TagRef &t : b.tags) {
+        inB.insert(std::make_pair(t.nameId, t.pageId));
+        if (!inA.contains(std::make_pair(t.nameId, t.pageId)))
+            out.push_back(TagChange{t.name(), t.pageNumber, true});
+    }
+    for (const TagRef &t : a.tags)
+        if (!inB.contains(std::make_pair(t.nameId, t.pageId)))
+            out.push_back(TagChange{t.name(), t.pageNumber, false});
+
+    std::sort(out.begin(), out.end(), [](const TagChange &x, const TagChange &y) {
+        if (x.name != y.name)
+            return x.name < y.name;
+        if (x.pageNumber != y.pageNumber)
+            return x.pageNumber < y.pageNumber;
+        return x.added < y.added;
+    });
+}
+
+// Cartella di un documento nella sua copia; "?" se non raggiungibile
+static QString folderOf(const FolderIndex &index, const DocEntry &e)
+{
+    const int node = index.find(e.parentUuid);
+    return node >= 0 ? index.path(node) : QStringLiteral("?");
+}
+
+static void appendPage(OutputSink &sink, int pageNumber)
+{
+    if (pageNumber >= 0)
+        sink.appendNumber(pageNumber + 1);
+    else
+        sink.append("?");
+}
+
+static void writeText(OutputSink &sink, const DocChange &c,
+                      const FolderIndex &fa, const FolderIndex &fb)
+{
+    const DocEntry &cur = c.b ? *c.b : *c.a;
+    sink.append(!c.a ? "+ " : !c.b ? "- " : "~ ");
+    sink.appendUtf8(cur.kind);
+    sink.append("  \"");
+    sink.appendUtf8(cur.visibleName);
+    sink.append("\"  ");
+    sink.appendUtf8(c.b ? folderOf(fb, cur) : folderOf(fa, cur));
+    sink.append("  (");
+    sink.appendUtf8(cur.uuid);
+    sink.append(")\n");
+    if (!c.a || !c.b)
+        return;
+
+    if (c.renamed) {
+        sink.append("    renamed: \"");
+        sink.appendUtf8(c.a->visibleName);
+        sink.append("\" -> \"");
+        sink.appendUtf8(c.b->visibleName);
+        sink.append("\"\n");
+    }
+    if (c.moved) {
+        sink.append("    moved: ");
+        sink.appendUtf8(folderOf(fa, *c.a));
+        sink.append(" -> ");
+        sink.appendUtf8(folderOf(fb, *c.b));
+        sink.append("\n");
+    }
+    if (c.a->pages != c.b->pages) {
+        sink.append("    pages: ");
+        sink.appendNumber(c.a->pages);
+        sink.append(" -> ");
+        sink.appendNumber(c.b->pages);
+        sink.append("\n");
+    }
+    for (const TagChange &t : c.tags) {
+        sink.append(t.added ? "    + tag \"" : "    - tag \"");
+        sink.appendUtf8(t.name);
+        sink.append("\" (page ");
+        appendPage(sink, t.pageNumber);
+        sink.append(")\n");
+    }
+}
+
+static void writeJsonTags(OutputSink &sink, const char *key, const DocChange &c, bool added)
+{
+    sink.append(key);
+    sink.append("[");
+    bool first = true;
+    for (const TagChange &t : c.tags) {
+        if (t.added != added)
+            continue;
+        sink.append(first ? "{\"tag\":" : ",{\"tag\":");
+        first = false;
+        sink.appendJsonString(t.name);
+        sink.append(",\"page\":");
+        if (t.pageNumber >= 0)
+            sink.appendNumber(t.pageNumber + 1);
+        else
+            sink.append("null");
+        sink.append("}");
+    }
+    sink.append("]");
+}
+
+static void writeJson(OutputSink &sink, const DocChange &c,
+                      const FolderIndex &fa, const FolderIndex &fb)
+{
+    const DocEntry &cur = c.b ? *c.b : *c.a;
+    sink.append("{\"change\":");
+    sink.append(!c.a ? "\"added\"" : !c.b ? "\"removed\"" : "\"changed\"");
+    sink.append(",\"uuid\":");
+    sink.appendJsonString(cur.uuid);
+    sink.append(",\"kind\":");
+    sink.appendJsonString(cur.kind);
+    sink.append(",\"name\":");
+    sink.appendJsonString(cur.visibleName);
+    sink.append(",\"folder\":");
+    sink.appendJsonString(c.b ? folderOf(fb, cur) : folderOf(fa, cur));
+    sink.append(",\"pages\":");
+    sink.appendNumber(cur.pages);
+    if (c.a && c.b) {
+        if (c.renamed) {
+            sink.append(",\"oldName\":");
+            sink.appendJsonString(c.a->visibleName);
+        }
+        if (c.moved) {
+            sink.append(",\"oldFolder\":");
+            sink.appendJsonString(folderOf(fa, *c.a));
+        }
+        if (c.a->pages != c.b->pages) {
+            sink.append(",\"oldPages\":");
+            sink.appendNumber(c.a->pages);
+        }
+        writeJsonTags(sink, ",\"tagsAdded\":", c, true);
+        writeJsonTags(sink, ",\"tagsRemoved\":", c, false);
+    }
+    sink.append("}");
+}
+
+bool diffLibraries(const QString &rootA, const QString &rootB, const ScanOptions &scan,
+                   OutputFormat format, OutputSink &sink,
+                   DiffStats &stats, QString &error)
+{
+    if (format == OutputFormat::Csv) {
+        error = "--diff supports --format text, json or jsonl";
+        return false;
+    }
+
+    std::vector<LibraryScan> libs(2);
+    libs[0].opts.root = rootA;
+    libs[1].opts.root = rootB;
+    for (LibraryScan &lib : libs) {
+        if (!scan.cachePath.isEmpty())
+            lib.opts.cachePath = diffCachePath(lib.opts.root);
+        lib.opts.jobs = scan.jobs;
+        lib.opts.maxMemory = scan.maxMemory; // scanLibraries lo divide fra le root
+    }
+    scanLibraries(libs);
+    for (const LibraryScan &lib : libs) {
+        if (!lib.ok) {
+            error = "directory not found: " + lib.opts.root;
+            return false;
+        }
+    }
+
+    FolderIndex fa, fb;
+    fa.build(libs[0].folders, libs[0].pdfs, libs[0].epubs, libs[0].notebooks);
+    fb.build(libs[1].folders, libs[1].pdfs, libs[1].epubs, libs[1].notebooks);
+
+    // Merge join sugli UUID ordinati: O(n log n) per l'ordinamento, poi
+    // lineare; il confronto tag per tag solo se le impronte differiscono
+    const std::vector<SnapDoc> da = sortedByUuid(libs[0]);
+    const std::vector<SnapDoc> db = sortedByUuid(libs[1]);
+    std::vector<DocChange> changes;
+    size_t i = 0, j = 0;
+    while (i < da.size() || j < db.size()) {
+        DocChange c;
+        if (j == db.size() || (i < da.size() && da[i].doc->uuid < db[j].doc->uuid)) {
+            c.a = da[i++].doc;
+            ++stats.removed;
+        } else if (i == da.size() || db[j].doc->uuid < da[i].doc->uuid) {
+            c.b = db[j++].doc;
+            ++stats.added;
+        } else {
+            const SnapDoc &x = da[i++];
+            const SnapDoc &y = db[j++];
+            c.a = x.doc;
+            c.b = y.doc;
+            c.renamed = x.doc->visibleName != y.doc->visibleName;
+            c.moved   = x.doc->parentUuid != y.doc->parentUuid;
+            if (x.fingerprint != y.fingerprint) {
+                diffTags(*x.doc, *y.doc, c.tags);
+                c.retagged = !c.tags.empty() || x.doc->pages != y.doc->pages;
+            }
+            if (!c.renamed && !c.moved && !c.retagged) {
+                ++stats.unchanged;
+                continue;
+            }
+            stats.renamed  += c.renamed;
+            stats.moved    += c.moved;
+            stats.retagged += c.retagged;
+        }
+        changes.push_back(std::move(c));
+    }
+
+    if (format == OutputFormat::Text) {
+        sink.append("Diff ");
+        sink.appendUtf8(rootA);
+        sink.append(" -> ");
+        sink.appendUtf8(rootB);
+        sink.append(": ");
+        sink.appendNumber(stats.added);
+        sink.append(" added, ");
+        sink.appendNumber(stats.removed);
+        sink.append(" removed, ");
+        sink.appendNumber(stats.renamed);
+        sink.append(" renamed, ");
+        sink.appendNumber(stats.moved);
+        sink.append(" moved, ");
+        sink.appendNumber(stats.retagged);
+        sink.append(" with tag/page changes, ");
+        sink.appendNumber(stats.unchanged);
+        sink.append(" unchanged.\n");
+        // Aggiunti, rimossi, poi modificati; ognuno in ordine di UUID
+        for (int pass = 0; pass < 3; ++pass) {
+            for (const DocChange &c : changes) {
+                const int group = !c.a ? 0 : !c.b ? 1 : 2;
+                if (group == pass)
+                    writeText(sink, c, fa, fb);
+            }
+        }
+    } else {
+        const bool array = format == OutputFormat::Json;
+        if (array)
+            sink.append("[");
+        bool first = true;
+        for (const DocChange &c : changes) {
+            if (array)
+                sink.append(first ? "\n  " : ",\n  ");
+            first = false;
+            writeJson(sink, c, fa, fb);
+            if (!array)
+                sink.append("\n");
+        }
+        if (array)
+            sink.append(first ? "]\n" : "\n]\n");
+    }
+    sink.flush();
+    return true;
+}
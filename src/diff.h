@@ -0,0 +1,36 @@
+#pragma once
+
+#include <QString>
+
+#include "output.h"
+#include "scanner.h"
+
+// Confronto fra due copie della libreria xochitl (--diff <rootA> <rootB>):
+// backup rsync, altri dispositivi, stati di sync diversi.
+//
+// - Le due root vengono scansionate in parallelo (scanLibraries), ognuna
+//   con la sua cache incrementale in share/diff_cache/: rifare il diff
+//   delle stesse copie non rilegge i .content invariati. Con --no-cache
+//   (cachePath vuoto) le cache di diff non si leggono né si scrivono.
+// - I documenti (cartelle comprese) sono ordinati per UUID e confrontati
+//   con un merge join: aggiunti, rimossi, rinominati, spostati.
+// - Per ogni documento un'impronta dei tag (somma degli hash delle coppie
+//   tag/pagina, indipendente dall'ordine) e del numero di pagine: solo i
+//   documenti con impronte diverse vengono confrontati tag per tag.
+struct DiffStats {
+    int added     = 0;
+    int removed   = 0;
+    int renamed   = 0;
+    int moved     = 0;
+    int retagged  = 0; // tag o numero di pagine cambiati
+    int unchanged = 0;
+};
+
+// Scrive le differenze da rootA a rootB su sink nel formato scelto (text,
+// json, jsonl). Da `scan` valgono jobs, maxMemory (per l'intero diff) e la
+// cache (cachePath vuoto = nessuna; altrimenti quella di diff di ogni root);
+// root e lazy sono ignorati. false + error se una root non esiste o il
+// formato è csv
+bool diffLibraries(const QString &rootA, const QString &rootB, const ScanOptions &scan,
+                   OutputFormat format, OutputSink &sink,
+                   DiffStats &stats, QString &error);
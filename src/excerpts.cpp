@@ -0,0 +1,574 @@
+#include "excerpts.h"
+#include "logging.h"
+#include "parallel.h"
+#include "paths.h"
+#include "profile.h"
+#include "scan_cache.h"
+#include "zip_reader.h"
+
+#include <QDataStream>
+#include <QDir>
+#include <QFileInfo>
+#include <QHash>
+#include <QSaveFile>
+#include <QUrl>
+#include <QXmlStreamReader>
+
+#include <algorithm>
+#include <cctype>
+#include <utility>
+#include <vector>
+
+// Header del layout: magic "MEPL" + versione (come scan_cache.bin)
+static const quint32 kLayoutMagic   = 0x4D45504C; // 'MEPL'
+static const quint32 kLayoutVersion = 1;
+
+// Lunghezza di un estratto (byte UTF-8, prima del taglio a parola)
+static const qsizetype kExcerptBytes = 280;
+// Margine oltre l'estratto per chiudere l'ultima parola
+static const qsizetype kExcerptSlack = 48;
+// Pagine con estratto per documento
+static const int kMaxExcerpts = 256;
+// container.xml e OPF sono piccoli: oltre questi tetti l'EPUB è sospetto
+static const qsizetype kMaxContainerBytes = 64 * 1024;
+static const qsizetype kMaxOpfBytes       = 4 * 1024 * 1024;
+
+// -------------------------
+//  MarkupStripper
+// -------------------------
+static bool isSpace(char c)
+{
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\f';
+}
+
+// Elementi di blocco: il loro confine separa le parole
+static bool isBlockTag(const QByteArray &name)
+{
+    static const char *const kBlocks[] = {
+        "p", "div", "br", "h1", "h2", "h3", "h4", "h5", "h6", "li", "ul", "ol",
+        "tr", "td", "th", "section", "blockquote", "hr", "dt", "dd", "pre",
+        "article", "aside", "figure", "figcaption", "table", "title",
+    };
+    for (const char *b : kBlocks)
+        if (name == b)
+            return true;
+    return false;
+}
+
+static void appendUtf8(QByteArray &out, uint cp)
+{
+    if (cp == 0 || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF))
+        cp = 0xFFFD;
+    if (cp < 0x80) {
+        out.append(char(cp));
+    } else if (cp < 0x800) {
+        out.append(char(0xC0 | (cp >> 6)));
+        out.append(char(0x80 | (cp & 0x3F)));
+    } else if (cp < 0x10000) {
+        out.append(char(0xE0 | (cp >> 12)));
+        out.append(char(0x80 | ((cp >> 6) & 0x3F)));
+        out.append(char(0x80 | (cp & 0x3F)));
+    } else {
+        out.append(char(0xF0 | (cp >> 18)));
+        out.append(char(0x80 | ((cp >> 12) & 0x3F)));
+        out.append(char(0x80 | ((cp >> 6) & 0x3F)));
+        out.append(char(0x80 | (cp & 0x3F)));
+    }
+}
+
+void MarkupStripper::feed(const char *data, qsizetype size)
+{
+    qsizetype i = 0;
+    while (i < size && !m_stop) {
+        const char c = data[i];
+        switch (m_state) {
+        case State::Text:
+            if (c == '<') {
+                m_state = State::Tag;
+                m_tag.resize(0);
+            } else if (c == '&') {
+                m_state = State::Entity;
+                m_entity.resize(0);
+            } else if (m_skip == 0) {
+                if (isSpace(c))
+                    emitSpace();
+                else
+                    emitChar(c);
+            }
+            break;
+        case State::Tag:
+            if (c == '>') {
+                endTag();
+                m_state = State::Text;
+            } else if (c == '<') {
+                m_tag.resize(0); // '<' nel testo (script non in CDATA)
+            } else if (m_tag.size() < 16) {
+                m_tag.append(c);
+                if (m_tag == "!--") {
+                    m_state = State::Comment;
+                    m_dashes = 0;
+                }
+            }
+            break;
+        case State::Comment:
+            if (c == '>' && m_dashes >= 2)
+                m_state = State::Text;
+            else
+                m_dashes = (c == '-') ? m_dashes + 1 : 0;
+            break;
+        case State::Entity:
+            if (c == ';') {
+                endEntity();
+                m_state = State::Text;
+            } else if (m_entity.size() < 10 && (std::isalnum(uchar(c)) || c == '#')) {
+                m_entity.append(c);
+            } else {
+                // '&' isolato: vale come testo, e c va riletto
+                m_state = State::Text;
+                if (m_skip == 0) {
+                    emitChar('&');
+                    for (char e : std::as_const(m_entity))
+                        emitChar(e);
+                }
+                continue;
+            }
+            break;
+        }
+        ++i;
+    }
+}
+
+void MarkupStripper::finish()
+{
+    flush();
+}
+
+void MarkupStripper::emitChar(char c)
+{
+    m_out.append(c);
+    m_space = false;
+    ++m_emitted;
+    if (m_out.size() >= 4096)
+        flush();
+}
+
+void MarkupStripper::emitSpace()
+{
+    if (m_space)
+        return;
+    m_out.append(' ');
+    m_space = true;
+    ++m_emitted;
+}
+
+void MarkupStripper::endTag()
+{
+    if (m_tag.isEmpty() || m_tag.startsWith('!') || m_tag.startsWith('?'))
+        return; // <!DOCTYPE>, <?xml?>
+
+    const bool closing = m_tag.startsWith('/');
+    const bool selfClosing = m_tag.endsWith('/');
+    qsizetype b = closing ? 1 : 0, e = b;
+    while (e < m_tag.size() && !isSpace(m_tag[e]) && m_tag[e] != '/')
+        ++e;
+    QByteArray name = m_tag.mid(b, e - b).toLower();
+    // Prefisso XML (<html:p>)
+    const qsizetype colon = name.indexOf(':');
+    if (colon >= 0)
+        name.remove(0, colon + 1);
+
+    if (name == "head" || name == "script" || name == "style") {
+        if (closing)
+            m_skip = qMax(0, m_skip - 1);
+        else if (!selfClosing)
+            ++m_skip;
+        return;
+    }
+    if (m_skip == 0 && isBlockTag(name))
+        emitSpace();
+}
+
+void MarkupStripper::endEntity()
+{
+    if (m_skip > 0)
+        return;
+
+    QByteArray out;
+    if (m_entity.startsWith('#')) {
+        bool ok = false;
+        const uint cp = (m_entity.size() > 1 && (m_entity[1] == 'x' || m_entity[1] == 'X'))
+            ? m_entity.mid(2).toUInt(&ok, 16)
+            : m_entity.mid(1).toUInt(&ok, 10);
+        if (ok)
+            appendUtf8(out, cp);
+    } else if (m_entity == "amp") {
+        out = "&";
+    } else if (m_entity == "lt") {
+        out = "<";
+    } else if (m_entity == "gt") {
+        out = ">";
+    } else if (m_entity == "quot") {
+        out = "\"";
+    } else if (m_entity == "apos") {
+        out = "'";
+    } else if (m_entity == "nbsp") {
+        emitSpace();
+        return;
+    }
+    // Entità sconosciute (DTD dell'EPUB 2): saltate
+    for (char c : std::as_const(out))
+        emitChar(c);
+}
+
+void MarkupStripper::flush()
+{
+    if (m_out.isEmpty() || m_stop)
+        return;
+    if (!text(m_emitted - m_out.size(), m_out.constData(), m_out.size()))
+        m_stop = true;
+    m_out.resize(0);
+}
+
+namespace {
+
+// Conta soltanto: serve la lunghezza in testo del capitolo
+class TextCounter : public MarkupStripper
+{
+protected:
+    bool text(qint64, const char *, qsizetype) override { return true; }
+};
+
+// Raccoglie le finestre di testo che iniziano agli offset richiesti
+class ExcerptCollector : public MarkupStripper
+{
+public:
+    struct Request {
+        qint64     offset = 0; // nel testo del capitolo
+        int        page = 0;
+        QByteArray raw;
+    };
+
+    explicit ExcerptCollector(std::vector<Request> &requests)
+        : m_requests(requests)
+    {
+    }
+
+protected:
+    bool text(qint64 offset, const char *data, qsizetype size) override
+    {
+        const qint64 end = offset + size;
+        const qsizetype want = kExcerptBytes + 2 * kExcerptSlack;
+        // Le richieste sono ordinate: quelle complete stanno in testa
+        for (size_t i = m_done; i < m_requests.size(); ++i) {
+            Request &r = m_requests[i];
+            const qint64 from = qMax(offset, r.offset + r.raw.size());
+            if (from >= end)
+                break; // richieste successive: più avanti nel testo
+            const qint64 to = qMin(end, r.offset + want);
+            if (to > from)
+                r.raw.append(data + (from - offset), qsizetype(to - from));
+        }
+        while (m_done < m_requests.size() && m_requests[m_done].raw.size() >= want)
+            ++m_done;
+        return m_done < m_requests.size();
+    }
+
+private:
+    std::vector<Request> &m_requests;
+    size_t m_done = 0;
+};
+
+} // namespace
+
+// -------------------------
+//  Layout (container.xml + OPF)
+// -------------------------
+static QString layoutPath(const QString &uuid)
+{
+    return mirtilloShareBase() + "/epub_layout/" + uuid + ".bin";
+}
+
+static bool loadLayout(const QString &uuid, const FileStamp &stamp, EpubLayout &layout)
+{
+    QFile f(layoutPath(uuid));
+    if (!f.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream in(&f);
+    in.setVersion(QDataStream::Qt_6_0);
+    quint32 magic = 0, version = 0, count = 0;
+    FileStamp st;
+    in >> magic >> version;
+    if (in.status() != QDataStream::Ok || magic != kLayoutMagic || version != kLayoutVersion)
+        return false;
+    in >> st.mtimeNs >> st.size >> st.inode >> count;
+    if (in.status() != QDataStream::Ok || !(st == stamp))
+        return false; // .epub cambiato: layout da rifare
+
+    layout = EpubLayout();
+    for (quint32 i = 0; i < count; ++i) {
+        EpubLayout::Chapter ch;
+        in >> ch.entry >> ch.textBytes;
+        if (in.status() != QDataStream::Ok || ch.textBytes < 0)
+            return false;
+        layout.chapters.append(ch);
+        layout.totalBytes += ch.textBytes;
+    }
+    return in.atEnd();
+}
+
+static bool saveLayout(const QString &uuid, const FileStamp &stamp, const EpubLayout &layout)
+{
+    const QString path = layoutPath(uuid);
+    if (!QDir().mkpath(QFileInfo(path).absolutePath()))
+        return false;
+
+    QSaveFile f(path);
+    if (!f.open(QIODevice::WriteOnly))
+        return false;
+    QDataStream out(&f);
+    out.setVersion(QDataStream::Qt_6_0);
+    out << kLayoutMagic << kLayoutVersion
+        << stamp.mtimeNs << stamp.size << stamp.inode
+        << quint32(layout.chapters.size());
+    for (const EpubLayout::Chapter &ch : layout.chapters)
+        out << ch.entry << ch.textBytes;
+    return out.status() == QDataStream::Ok && f.commit();
+}
+
+// Ordine della spine: META-INF/container.xml → OPF → manifest + spine
+static bool readSpine(const ZipReader &zip, QList<QByteArray> &spine)
+{
+    QByteArray data;
+    const ZipEntry *container = zip.find("META-INF/container.xml");
+    if (!container || !zip.readAll(*container, kMaxContainerBytes, data))
+        return false;
+
+    QString opfPath;
+    {
+        QXmlStreamReader xml(data);
+        while (!xml.atEnd() && opfPath.isEmpty()) {
+            if (xml.readNext() == QXmlStreamReader::StartElement && xml.name() == u"rootfile")
+                opfPath = xml.attributes().value("full-path").toString();
+        }
+    }
+    const ZipEntry *opf = opfPath.isEmpty() ? nullptr : zip.find(opfPath.toUtf8());
+    if (!opf || !zip.readAll(*opf, kMaxOpfBytes, data))
+        return false;
+
+    // Gli href del manifest sono relativi alla directory dell'OPF
+    const qsizetype slash = opfPath.lastIndexOf('/');
+    const QString opfDir = slash >= 0 ? opfPath.left(slash + 1) : QString();
+
+    QHash<QString, QString> items; // id → voce ZIP (solo XHTML/HTML)
+    QStringList order;
+    QXmlStreamReader xml(data);
+    while (!xml.atEnd()) {
+        if (xml.readNext() != QXmlStreamReader::StartElement)
+            continue;
+        const QXmlStreamAttributes attrs = xml.attributes();
+        if (xml.name() == u"item") {
+            const QStringView type = attrs.value("media-type");
+            if (type != u"application/xhtml+xml" && type != u"text/html")
+                continue;
+            QString href = QUrl::fromPercentEncoding(attrs.value("href").toUtf8());
+            const qsizetype hash = href.indexOf('#');
+            if (hash >= 0)
+                href.truncate(hash);
+            items.insert(attrs.value("id").toString(), QDir::cleanPath(opfDir + href));
+        } else if (xml.name() == u"itemref") {
+            if (attrs.value("linear") != u"no") // note, copertine alternative
+                order.append(attrs.value("idref").toString());
+        }
+    }
+    if (xml.hasError())
+        return false;
+
+    spine.clear();
+    for (const QString &id : std::as_const(order)) {
+        const auto it = items.constFind(id);
+        if (it != items.cend())
+            spine.append(it->toUtf8());
+    }
+    return !spine.isEmpty();
+}
+
+// Lunghezze in testo di tutti i capitoli: inflate completo del libro
+static bool computeLayout(const ZipReader &zip, EpubLayout &layout)
+{
+    QList<QByteArray> spine;
+    if (!readSpine(zip, spine))
+        return false;
+
+    layout = EpubLayout();
+    for (const QByteArray &name : std::as_const(spine)) {
+        const ZipEntry *entry = zip.find(name);
+        if (!entry)
+            continue; // voce dichiarata ma assente: la spine va avanti
+        TextCounter counter;
+        if (!zip.read(*entry, [&](const char *p, qsizetype n) {
+                counter.feed(p, n);
+                return true;
+            }))
+            return false;
+        counter.finish();
+        profileAddBytes(ProfileBytes::Excerpts, entry->compressedSize);
+
+        layout.chapters.append({name, counter.emitted()});
+        layout.totalBytes += counter.emitted();
+    }
+    return true;
+}
+
+// Finestra grezza → estratto: parole intere, "…" dove il testo continua
+static QString makeExcerpt(const QByteArray &raw, bool chapterStart)
+{
+    qsizetype b = 0;
+    if (!chapterStart) {
+        // si parte dalla prima parola intera (e mai a metà di un carattere UTF-8)
+        const qsizetype sp = raw.indexOf(' ');
+        if (sp >= 0 && sp < kExcerptSlack)
+            b = sp + 1;
+        while (b < raw.size() && (uchar(raw[b]) & 0xC0) == 0x80)
+            ++b;
+    }
+    qsizetype e = qMin(raw.size(), b + kExcerptBytes);
+    const bool cut = e < raw.size();
+    if (cut) {
+        const qsizetype sp = raw.lastIndexOf(' ', e);
+        if (sp > b + kExcerptBytes / 2)
+            e = sp;
+        else
+            while (e > b && (uchar(raw[e]) & 0xC0) == 0x80)
+                --e;
+    }
+
+    QString text = QString::fromUtf8(raw.constData() + b, e - b).trimmed();
+    if (text.isEmpty())
+        return text;
+    if (!chapterStart)
+        text.prepend(QChar(0x2026));
+    if (cut)
+        text.append(QChar(0x2026));
+    return text;
+}
+
+// -------------------------
+//  API
+// -------------------------
+bool loadDocumentExcerpts(DocEntry &e)
+{
+    e.excerpts.clear();
+    e.excerptsLoaded = true;
+    if (e.kind != "epub" || e.pages <= 0)
+        return true;
+
+    // Pagine taggate distinte, in ordine
+    std::vector<int> pages;
+    for (const TagRef &t : e.tags)
+        if (t.pageNumber >= 0 && t.pageNumber < e.pages)
+            pages.push_back(t.pageNumber);
+    std::sort(pages.begin(), pages.end());
+    pages.erase(std::unique(pages.begin(), pages.end()), pages.end());
+    if (pages.size() > size_t(kMaxExcerpts))
+        pages.resize(size_t(kMaxExcerpts));
+    if (pages.empty())
+        return true;
+
+    ProfileScope prof(ProfilePhase::Excerpts);
+
+    const QString path = xochitlBase() + "/" + e.uuid + ".epub";
+    ZipReader zip;
+    if (!zip.open(path))
+        return false;
+
+    EpubLayout layout;
+    const FileStamp stamp = stampFile(path);
+    if (!loadLayout(e.uuid, stamp, layout)) {
+        if (!computeLayout(zip, layout))
+            return false;
+        if (!saveLayout(e.uuid, stamp, layout))
+            qCDebug(lcScan, "cannot write EPUB layout for %s", qPrintable(e.uuid));
+    }
+    if (layout.totalBytes <= 0)
+        return true;
+
+    // Inizio di ogni capitolo nel testo del libro
+    std::vector<qint64> starts;
+    starts.reserve(size_t(layout.chapters.size()));
+    qint64 pos = 0;
+    for (const EpubLayout::Chapter &ch : std::as_const(layout.chapters)) {
+        starts.push_back(pos);
+        pos += ch.textBytes;
+    }
+
+    // Pagina N di P → byte N/P del testo → (capitolo, offset); le pagine
+    // sono ordinate, quindi lo sono anche le richieste di ogni capitolo
+    QHash<int, std::vector<ExcerptCollector::Request>> byChapter;
+    std::vector<int> chapterOrder;
+    for (int page : pages) {
+        const qint64 global = qint64(double(page) / e.pages * double(layout.totalBytes));
+        const int ch = int(std::upper_bound(starts.begin(), starts.end(), global) - starts.begin()) - 1;
+        if (ch < 0 || layout.chapters[ch].textBytes == 0)
+            continue;
+        auto &reqs = byChapter[ch];
+        if (reqs.empty())
+            chapterOrder.push_back(ch);
+        ExcerptCollector::Request r;
+        r.offset = global - starts[size_t(ch)];
+        r.page = page;
+        reqs.push_back(r);
+    }
+
+    bool allOk = true;
+    for (int ch : chapterOrder) {
+        const EpubLayout::Chapter &chapter = layout.chapters[ch];
+        const ZipEntry *entry = zip.find(chapter.entry);
+        std::vector<ExcerptCollector::Request> &reqs = byChapter[ch];
+        if (!entry) {
+            allOk = false;
+            continue;
+        }
+
+        ExcerptCollector collector(reqs);
+        // Ci si ferma dopo l'ultimo estratto: il resto non viene inflato
+        if (!zip.read(*entry, [&](const char *p, qsizetype n) {
+                collector.feed(p, n);
+                return !collector.stopped();
+            }))
+            allOk = false;
+        collector.finish();
+        profileAddBytes(ProfileBytes::Excerpts, entry->compressedSize);
+
+        for (const ExcerptCollector::Request &r : reqs) {
+            Excerpt x;
+            x.pageNumber = r.page;
+            x.text = makeExcerpt(r.raw, r.offset == 0);
+            if (!x.text.isEmpty())
+                e.excerpts.append(x);
+        }
+    }
+
+    std::sort(e.excerpts.begin(), e.excerpts.end(),
+              [](const Excerpt &a, const Excerpt &b) { return a.pageNumber < b.pageNumber; });
+    return allOk;
+}
+
+int loadExcerpts(QList<DocEntry> &epubs, int jobs)
+{
+    // Come loadHighlights: puntatori presi nel thread principale
+    std::vector<DocEntry *> docs;
+    for (DocEntry &e : epubs)
+        docs.push_back(&e);
+
+    parallelFor(int(docs.size()), jobs, [&](int i) {
+        DocEntry &e = *docs[size_t(i)];
+        if (!loadDocumentExcerpts(e))
+            qCWarning(lcScan, "unreadable EPUB %s.epub", qPrintable(e.uuid));
+    });
+
+    int total = 0;
+    for (const DocEntry *e : docs)
+        total += int(e->excerpts.size());
+    return total;
+}
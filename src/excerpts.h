@@ -0,0 +1,83 @@
+#pragma once
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+
+#include "model.h"
+
+// Estratti di testo delle pagine taggate degli EPUB (<uuid>.epub).
+//
+// xochitl impagina l'EPUB da sé e non salva dove cade ogni pagina: la
+// pagina N di P viene collocata in proporzione sul testo del libro, cioè
+// al byte N/P del testo di tutta la spine, e da lì si prende un estratto
+// di qualche riga.
+//
+// - Lo ZIP viene aperto una volta (ZipReader: central directory, voci
+//   inflate in streaming); container.xml e OPF danno l'ordine della spine.
+// - Il markup è tolto in streaming (MarkupStripper): niente DOM, niente
+//   <head>/<script>/<style>, spazi compattati, entità decodificate.
+// - La lunghezza in testo di ogni capitolo richiede di inflare tutto il
+//   libro una volta: viene salvata in share/epub_layout/<uuid>.bin insieme
+//   all'impronta del .epub. Gli export successivi inflano solo i capitoli
+//   che contengono pagine taggate, e solo fino all'ultimo estratto.
+// - Le posizioni delle pagine non vengono salvate: dipendono dal numero di
+//   pagine, che cambia quando xochitl reimpagina (font, margini), e si
+//   ricavano dalle lunghezze dei capitoli in O(pagine).
+
+// Toglie il markup da XHTML a blocchi arbitrari e passa il testo (UTF-8,
+// spazi compattati) a text() insieme alla sua posizione nel capitolo.
+class MarkupStripper
+{
+public:
+    virtual ~MarkupStripper() = default;
+
+    void feed(const char *data, qsizetype size);
+    // Fine della voce: consegna il testo ancora in buffer
+    void finish();
+
+    // Byte di testo emessi finora
+    qint64 emitted() const { return m_emitted; }
+    // text() ha chiesto di fermarsi
+    bool stopped() const { return m_stop; }
+
+protected:
+    // Blocco di testo che inizia al byte `offset`; false = basta così
+    virtual bool text(qint64 offset, const char *data, qsizetype size) = 0;
+
+private:
+    enum class State : quint8 { Text, Tag, Comment, Entity };
+
+    void emitChar(char c);
+    void emitSpace();
+    void endTag();
+    void endEntity();
+    void flush();
+
+    State      m_state = State::Text;
+    QByteArray m_tag;       // primi caratteri del tag corrente
+    QByteArray m_entity;
+    QByteArray m_out;       // testo in attesa di text()
+    int        m_skip = 0;  // profondità dentro <head>, <script>, <style>
+    int        m_dashes = 0;
+    bool       m_space = true; // ultimo byte emesso è uno spazio (o inizio)
+    bool       m_stop = false;
+    qint64     m_emitted = 0;
+};
+
+// Layout persistito di un EPUB: voci della spine e loro lunghezza in testo
+struct EpubLayout {
+    struct Chapter {
+        QByteArray entry;     // nome della voce nello ZIP
+        qint64     textBytes = 0;
+    };
+    QList<Chapter> chapters;
+    qint64 totalBytes = 0;
+};
+
+// Carica gli estratti delle pagine taggate di un EPUB (le altre entry
+// restano senza estratti). false se il .epub non è leggibile.
+bool loadDocumentExcerpts(DocEntry &e);
+
+// Estratti di tutti gli EPUB su `jobs` worker. Restituisce quanti
+int loadExcerpts(QList<DocEntry> &epubs, int jobs);
@@ -1,14 +1,13 @@
 #include "export.h"
+#include "paths.h"
+#include "pdf_summary.h"
 
+#include <QDateTime>
 #include <QDir>
 #include <QFile>
 #include <QIODevice>
 #include <QMap>
 
-// Percorso base per i file di mirtillo sul Paper Pro
-static const QString kShareBase =
-    QStringLiteral("/home/root/.local/share/mirtillo");
-
 // -------------------------
 //  Summary a video
 // -------------------------
@@ -27,16 +26,13 @@ void printDocumentSummary(const DocEntry &doc, QTextStream &out)
     out << "Tag count : " << doc.tags.size() << "\n";
     out << "Tags by name:\n";
 
-    if (doc.tags.isEmpty()) {
+    if (doc.tags.isEmpty())
         out << "  (none)\n";
-        out << "==========================================================\n";
-        return;
-    }
 
     // Raggruppa per nome tag (QMap = ordinato per chiave)
     QMap<QString, QList<const TagRef*>> byName;
     for (const TagRef &t : doc.tags) {
-        byName[t.name].append(&t);
+        byName[t.name()].append(&t);
     }
 
     for (auto it = byName.cbegin(); it != byName.cend(); ++it) {
@@ -50,41 +46,149 @@ void printDocumentSummary(const DocEntry &doc, QTextStream &out)
                               ? QString::number(tr->pageNumber + 1)
                               : QStringLiteral("?");
             out << "      • Page " << pageStr
-                << " (" << tr->pageId << ")\n";
+                << " (" << tr->pageId.toString() << ")\n";
+        }
+    }
+
+    // Highlight: solo se caricati (loadDocumentHighlights) e presenti
+    if (doc.highlightsLoaded && !doc.highlights.isEmpty()) {
+        out << "Highlights: " << doc.highlights.size();
+        if (doc.highlightsTruncated)
+            out << " (truncated)";
+        out << "\n";
+        for (const Highlight &h : doc.highlights) {
+            QString pageStr = (h.pageNumber >= 0)
+                              ? QString::number(h.pageNumber + 1)
+                              : QStringLiteral("?");
+            out << "  - Page " << pageStr << ": \"" << h.text << "\"\n";
+        }
+    }
+
+    // Estratti delle pagine taggate degli EPUB (loadDocumentExcerpts)
+    if (doc.excerptsLoaded && !doc.excerpts.isEmpty()) {
+        out << "Excerpts: " << doc.excerpts.size() << "\n";
+        for (const Excerpt &x : doc.excerpts)
+            out << "  - Page " << (x.pageNumber + 1) << ": \"" << x.text << "\"\n";
+    }
+
+    // Note a mano: pagine con almeno un tratto (loadDocumentInk)
+    if (doc.inkLoaded && !doc.ink.isEmpty()) {
+        out << "Handwritten notes: " << doc.ink.size() << " page(s)\n";
+        for (const PageInk &p : doc.ink) {
+            QString pageStr = (p.pageNumber >= 0)
+                              ? QString::number(p.pageNumber + 1)
+                              : QStringLiteral("?");
+            out << "  - Notes present on page " << pageStr
+                << " (" << p.strokes << " strokes, " << p.points << " points, area "
+                << qRound(p.minX) << "," << qRound(p.minY) << " – "
+                << qRound(p.maxX) << "," << qRound(p.maxY) << ", modified "
+                << QDateTime::fromMSecsSinceEpoch(p.mtimeMs).toString("yyyy-MM-dd HH:mm")
+                << ")\n";
         }
     }
 
     out << "==========================================================\n";
 }
 
+// -------------------------
+//  Query sull'indice dei tag
+// -------------------------
+void printTagHits(const QList<TagHit> &hits, QTextStream &out)
+{
+    if (hits.isEmpty()) {
+        out << "No pages found for the requested tag.\n";
+        return;
+    }
+
+    // Gli hit arrivano già ordinati per tag, documento, pagina
+    QString curTag, curDoc;
+    for (const TagHit &h : hits) {
+        if (h.tag != curTag) {
+            out << "=== Tag \"" << h.tag << "\" ===\n";
+            curTag = h.tag;
+            curDoc.clear();
+        }
+        if (h.docUuid != curDoc) {
+            out << "  - " << h.docTitle << " [" << h.docKind << "] ("
+                << h.docUuid << ")\n";
+            curDoc = h.docUuid;
+        }
+
+        QString pageStr = (h.pageNumber >= 0)
+                          ? QString::number(h.pageNumber + 1)
+                          : QStringLiteral("?");
+        out << "      • Page " << pageStr << " (" << h.pageId << ")\n";
+    }
+}
+
+// -------------------------
+//  Albero delle cartelle
+// -------------------------
+void printFolderTree(const FolderIndex &index, int node, QTextStream &out)
+{
+    const int base = index.depth(node);
+    for (int n : index.subtreeNodes(node)) {
+        const FolderStats &st = index.subtree(n);
+        out << QString(2 * (index.depth(n) - base), QLatin1Char(' ')) << index.path(n)
+            << "  " << st.documents() << " document(s) ("
+            << st.pdfs << " pdf, " << st.epubs << " epub, " << st.notebooks << " notebook), "
+            << st.folders << " subfolder(s), "
+            << st.taggedPages << " tagged page(s), "
+            << st.tags.size() << " distinct tag(s)\n";
+    }
+}
+
 // -------------------------
 //  Export su file
 // -------------------------
-void exportDocument(const DocEntry &doc, QTextStream &out)
+QString summaryPath(const QString &uuid)
 {
-    QDir dir(kShareBase);
+    return QDir(mirtilloShareBase()).filePath(QStringLiteral("summary_%1.txt").arg(uuid));
+}
+
+bool writeSummaryFile(const DocEntry &doc, QString &error)
+{
+    QDir dir(mirtilloShareBase());
     if (!dir.exists()) {
         if (!dir.mkpath(".")) {
-            out << "Error: cannot create directory: " << kShareBase << "\n";
-            return;
+            error = "cannot create directory: " + mirtilloShareBase();
+            return false;
         }
     }
 
-    const QString fileName =
-        QStringLiteral("summary_%1.txt").arg(doc.uuid);
-
-    const QString fullPath = dir.filePath(fileName);
+    const QString fullPath = summaryPath(doc.uuid);
 
     QFile f(fullPath);
     if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
-        out << "Error: cannot write summary file: " << fullPath << "\n";
-        return;
+        error = "cannot write summary file: " + fullPath;
+        return false;
     }
 
     QTextStream s(&f);
     // riusa esattamente lo stesso layout del summary a video
     printDocumentSummary(doc, s);
     s.flush();
+    return true;
+}
 
-    out << "Summary exported to: " << fullPath << "\n";
-}
\ No newline at end of file
+void exportDocument(const DocEntry &doc, QTextStream &out)
+{
+    QString error;
+    if (!writeSummaryFile(doc, error)) {
+        out << "Error: " << error << "\n";
+        return;
+    }
+
+    out << "Summary exported to: " << summaryPath(doc.uuid) << "\n";
+}
+
+void exportDocumentPdf(const DocEntry &doc, QTextStream &out)
+{
+    QString error;
+    if (!writeSummaryPdf(doc, error)) {
+        out << "Error: " << error << "\n";
+        return;
+    }
+
+    out << "PDF summary exported to: " << summaryPdfPath(doc.uuid) << "\n";
+}
@@ -1,10 +1,28 @@
 #pragma once
 
+#include "folder_index.h"
 #include "model.h"
+#include "tag_index.h"
 #include <QTextStream>
 
 // Stampa il summary a video
 void printDocumentSummary(const DocEntry &doc, QTextStream &out);
 
 // Esporta il summary in un file di testo sul Paper Pro
-void exportDocument(const DocEntry &doc, QTextStream &out);
\ No newline at end of file
+void exportDocument(const DocEntry &doc, QTextStream &out);
+
+// Esporta il summary in PDF (summary_<uuid>.pdf, vedi pdf_summary.h)
+void exportDocumentPdf(const DocEntry &doc, QTextStream &out);
+
+// Percorso del summary esportato di un documento (summary_<uuid>.txt)
+QString summaryPath(const QString &uuid);
+
+// Scrive il summary senza messaggi a video (usato anche da --watch)
+bool writeSummaryFile(const DocEntry &doc, QString &error);
+
+// Stampa il risultato di una query sull'indice dei tag (--tag / --tag-prefix)
+void printTagHits(const QList<TagHit> &hits, QTextStream &out);
+
+// Stampa l'albero delle cartelle da `node` in giù, con gli aggregati di
+// ogni sottoalbero (--folders)
+void printFolderTree(const FolderIndex &index, int node, QTextStream &out);
@@ -0,0 +1,221 @@
+#include "export_store.h"
+#include "paths.h"
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+
+#include <algorithm>
+
+static const char kStoreMagic[] = "mirtillo-store";
+static const int  kStoreVersion = 1;
+
+QString ExportStore::basePath()
+{
+    return mirtilloShareBase() + "/store";
+}
+
+QString ExportStore::manifestPath()
+{
+    return basePath() + "/manifest.tsv";
+}
+
+QString ExportStore::objectPath(const QByteArray &hash, const QString &artifact)
+{
+    return basePath() + "/objects/" + QString::fromLatin1(hash.left(2)) + "/" +
+           QString::fromLatin1(hash) + "." + artifact;
+}
+
+bool ExportStore::load(QString &error)
+{
+    m_entries.clear();
+    m_generation = 0;
+    m_changed = 0;
+    m_replaced.clear();
+
+    QFile f(manifestPath());
+    if (!f.exists())
+        return true;
+    if (!f.open(QIODevice::ReadOnly)) {
+        error = "cannot read " + manifestPath();
+        return false;
+    }
+
+    const QList<QByteArray> head = f.readLine().trimmed().split('\t');
+    bool ok = head.size() == 3 && head.at(0) == kStoreMagic && head.at(1).toInt() == kStoreVersion;
+    if (ok)
+        m_generation = head.at(2).toULongLong(&ok);
+    if (!ok) {
+        error = "invalid store manifest: " + manifestPath();
+        return false;
+    }
+
+    while (!f.atEnd()) {
+        const QByteArray line = f.readLine().trimmed();
+        if (line.isEmpty())
+            continue;
+        const QList<QByteArray> c = line.split('\t');
+        StoreEntry e;
+        bool sizeOk = false, genOk = false;
+        if (c.size() == 5) {
+            e.uuid       = QString::fromLatin1(c.at(0));
+            e.artifact   = QString::fromLatin1(c.at(1));
+            e.hash       = c.at(2) == "-" ? QByteArray() : c.at(2);
+            e.size       = c.at(3).toLongLong(&sizeOk);
+            e.generation = c.at(4).toULongLong(&genOk);
+        }
+        if (!sizeOk || !genOk) {
+            error = "invalid store manifest: " + manifestPath();
+            m_entries.clear();
+            return false;
+        }
+        m_entries.insert(key(e.uuid, e.artifact), e);
+    }
+    return true;
+}
+
+const StoreEntry *ExportStore::find(const QString &uuid, const QString &artifact) const
+{
+    const auto it = m_entries.constFind(key(uuid, artifact));
+    return it == m_entries.cend() ? nullptr : &*it;
+}
+
+bool ExportStore::addObject(const QString &path, const QString &artifact,
+                            QByteArray &hash, qint64 &size)
+{
+    QFile f(path);
+    if (!f.open(QIODevice::ReadOnly))
+        return false;
+    size = f.size();
+
+    QCryptographicHash h(QCryptographicHash::Sha256);
+    if (const uchar *map = size > 0 ? f.map(0, size) : nullptr) {
+        h.addData(QByteArray::fromRawData(reinterpret_cast<const char *>(map), size));
+        f.unmap(const_cast<uchar *>(map));
+    } else if (!h.addData(&f)) {
+        return false;
+    }
+    hash = h.result().toHex();
+
+    const QString object = objectPath(hash, artifact);
+    if (QFileInfo::exists(object))
+        return true; // stesso contenuto già nello store
+
+    // Copia su un nome temporaneo e rename: un oggetto è sempre completo.
+    // Una copia e non un hard link, così nessuno scrittore del summary può
+    // alterare un oggetto già pubblicato.
+    if (!QDir().mkpath(QFileInfo(object).path()))
+        return false;
+    // nome temporaneo per sorgente: due documenti con lo stesso contenuto
+    // possono arrivare qui insieme da due worker
+    const QString tmp = object + "." + QString::number(qHash(path), 16) + ".tmp";
+    QFile::remove(tmp);
+    if (!QFile::copy(path, tmp))
+        return false;
+    if (!QFile::rename(tmp, object)) {
+        QFile::remove(tmp);
+        return QFileInfo::exists(object); // scritto da un altro worker
+    }
+    return true;
+}
+
+StoreEntry &ExportStore::touch(const QString &uuid, const QString &artifact)
+{
+    StoreEntry &e = m_entries[key(uuid, artifact)];
+    if (!e.hash.isEmpty())
+        m_replaced.insert(e.hash);
+    e.uuid = uuid;
+    e.artifact = artifact;
+    e.generation = m_generation + 1;
+    ++m_changed;
+    return e;
+}
+
+void ExportStore::set(const QString &uuid, const QString &artifact,
+                      const QByteArray &hash, qint64 size)
+{
+    const StoreEntry *old = find(uuid, artifact);
+    if (old && old->hash == hash)
+        return;
+    StoreEntry &e = touch(uuid, artifact);
+    e.hash = hash;
+    e.size = size;
+}
+
+void ExportStore::removeMissing(const QSet<QString> &alive)
+{
+    QList<QPair<QString, QString>> gone;
+    for (const StoreEntry &e : std::as_const(m_entries))
+        if (!e.hash.isEmpty() && !alive.contains(e.uuid))
+            gone.append(qMakePair(e.uuid, e.artifact));
+    for (const auto &g : std::as_const(gone)) {
+        StoreEntry &e = touch(g.first, g.second);
+        e.hash.clear();
+        e.size = 0;
+    }
+}
+
+QByteArray ExportStore::formatEntry(const StoreEntry &e)
+{
+    return e.uuid.toLatin1() + '\t' + e.artifact.toLatin1() + '\t' +
+           (e.hash.isEmpty() ? QByteArray("-") : e.hash) + '\t' +
+           QByteArray::number(e.size) + '\t' + QByteArray::number(e.generation) + '\n';
+}
+
+QList<StoreEntry> ExportStore::changesSince(quint64 since) const
+{
+    QList<StoreEntry> out;
+    for (const StoreEntry &e : m_entries)
+        if (e.generation > since)
+            out.append(e);
+    std::sort(out.begin(), out.end(), [](const StoreEntry &a, const StoreEntry &b) {
+        if (a.generation != b.generation)
+            return a.generation < b.generation;
+        return key(a.uuid, a.artifact) < key(b.uuid, b.artifact);
+    });
+    return out;
+}
+
+bool ExportStore::commit(QString &error)
+{
+    if (m_changed == 0)
+        return true;
+    if (!QDir().mkpath(basePath())) {
+        error = "cannot create directory: " + basePath();
+        return false;
+    }
+
+    ++m_generation;
+    QSaveFile f(manifestPath());
+    if (!f.open(QIODevice::WriteOnly)) {
+        error = "cannot write " + manifestPath();
+        return false;
+    }
+    f.write(QByteArray(kStoreMagic) + '\t' + QByteArray::number(kStoreVersion) + '\t' +
+            QByteArray::number(m_generation) + '\n');
+    for (const StoreEntry &e : changesSince(0))
+        f.write(formatEntry(e));
+    if (!f.commit()) {
+        error = "cannot write " + manifestPath();
+        --m_generation;
+        return false;
+    }
+
+    // Dopo il commit: un puller che legge il manifest precedente trova
+    // ancora gli oggetti fino a questo punto
+    QSet<QByteArray> live;
+    for (const StoreEntry &e : std::as_const(m_entries))
+        if (!e.hash.isEmpty())
+            live.insert(e.hash);
+    for (const QByteArray &h : std::as_const(m_replaced)) {
+        if (live.contains(h))
+            continue;
+        QFile::remove(objectPath(h, QStringLiteral("txt")));
+        QFile::remove(objectPath(h, QStringLiteral("pdf")));
+    }
+    m_replaced.clear();
+    m_changed = 0;
+    return true;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QSet>
+#include <QString>
+
+// Store degli export indirizzato per contenuto (share/store/), per la
+// sincronizzazione verso il desktop (scripts/pull_exports.sh):
+//
+//   store/objects/<h2>/<sha256>.<txt|pdf>   un file per contenuto distinto
+//   store/manifest.tsv                      chi punta a cosa
+//
+// Il manifest è testo separato da TAB, riscritto in modo atomico a ogni
+// --export-all --store che cambia qualcosa:
+//
+//   mirtillo-store  1  <generazione>
+//   <uuid>  <txt|pdf>  <sha256 | ->  <byte>  <generazione della modifica>
+//
+// La generazione cresce di uno per esecuzione con modifiche; ogni voce
+// ricorda quella in cui è cambiata, così "--changes-since N" elenca solo le
+// voci con generazione > N. "-" è una rimozione (documento sparito dalla
+// libreria): la voce resta come tombstone perché il puller la veda.
+// Gli oggetti non più referenziati vengono cancellati dopo il commit.
+
+struct StoreEntry {
+    QString    uuid;
+    QString    artifact;       // "txt" | "pdf"
+    QByteArray hash;           // SHA-256 esadecimale; vuoto = rimosso
+    qint64     size = 0;
+    quint64    generation = 0; // generazione dell'ultima modifica
+};
+
+class ExportStore
+{
+public:
+    static QString basePath();
+    static QString manifestPath();
+    static QString objectPath(const QByteArray &hash, const QString &artifact);
+
+    // Legge il manifest; un manifest assente è uno store vuoto.
+    // false + error se il file esiste ma non è valido
+    bool load(QString &error);
+
+    quint64 generation() const { return m_generation; }
+    const StoreEntry *find(const QString &uuid, const QString &artifact) const;
+
+    // Copia `path` in objects/ sotto il suo hash (se non c'è già).
+    // Thread-safe: usato dai worker di exportAll prima del merge
+    static bool addObject(const QString &path, const QString &artifact,
+                          QByteArray &hash, qint64 &size);
+
+    // Aggiorna una voce: la generazione cambia solo se cambia l'hash
+    void set(const QString &uuid, const QString &artifact,
+             const QByteArray &hash, qint64 size);
+    // Tombstone per le voci i cui documenti non sono in `alive`
+    void removeMissing(const QSet<QString> &alive);
+
+    // Manifest atomico (QSaveFile) e pulizia degli oggetti orfani;
+    // senza modifiche non scrive nulla
+    bool commit(QString &error);
+
+    // Numero di voci cambiate in questa esecuzione
+    int changed() const { return m_changed; }
+
+    // Voci con generazione > since, nell'ordine del manifest
+    QList<StoreEntry> changesSince(quint64 since) const;
+
+    // Riga del manifest / di --changes-since
+    static QByteArray formatEntry(const StoreEntry &e);
+
+private:
+    static QString key(const QString &uuid, const QString &artifact)
+    {
+        return uuid + QLatin1Char('.') + artifact;
+    }
+    StoreEntry &touch(const QString &uuid, const QString &artifact);
+
+    QHash<QString, StoreEntry> m_entries;  // chiave uuid.artifact
+    quint64                    m_generation = 0;
+    int                        m_changed = 0;
+    QSet<QByteArray>           m_replaced; // hash sostituiti: forse orfani
+};
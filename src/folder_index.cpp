@@ -0,0 +1,163 @@
+#include "folder_index.h"
+#include "scanner.h"
+
+#include <algorithm>
+#include <iterator>
+
+void FolderIndex::build(const QList<DocEntry> &folders,
+                        const QList<DocEntry> &pdfs,
+                        const QList<DocEntry> &epubs,
+                        const QList<DocEntry> &notebooks)
+{
+    m_nodes.clear();
+    m_byUuid.clear();
+    m_byPath.clear();
+    m_ambiguous.clear();
+
+    // 1) Cartelle raggruppate per parent (nullo = root)
+    QHash<Uuid, std::vector<const DocEntry *>> byParent;
+    for (const DocEntry &f : folders)
+        byParent[f.parentUuid].push_back(&f);
+
+    // 2) Visita in ampiezza dalla root: ogni percorso estende quello del
+    //    padre, già calcolato. Ciò che non è raggiungibile resta fuori.
+    m_nodes.reserve(size_t(folders.size()) + 1);
+    m_nodes.emplace_back();
+    m_nodes[0].path = QStringLiteral("/");
+    m_byUuid.insert(Uuid(), kRoot);
+    m_byPath.insert(m_nodes[0].path, kRoot);
+
+    for (size_t n = 0; n < m_nodes.size(); ++n) {
+        const auto it = byParent.find(m_nodes[n].uuid);
+        if (it == byParent.end())
+            continue;
+        std::vector<const DocEntry *> &kids = it.value();
+        std::sort(kids.begin(), kids.end(),
+                  [](const DocEntry *a, const DocEntry *b) { return docLessByName(*a, *b); });
+
+        for (const DocEntry *f : kids) {
+            const Uuid id = Uuid::fromString(f->uuid);
+            if (m_byUuid.contains(id))
+                continue; // già visitata
+
+            Node child;
+            child.uuid   = id;
+            child.path   = (n == size_t(kRoot) ? QString() : m_nodes[n].path) + "/" + f->visibleName;
+            child.parent = int(n);
+            child.depth  = m_nodes[n].depth + 1;
+
+            const int idx = int(m_nodes.size());
+            m_nodes[n].children.push_back(idx);
+            m_byUuid.insert(id, idx);
+            if (m_byPath.contains(child.path))
+                m_ambiguous.insert(child.path);
+            else
+                m_byPath.insert(child.path, idx);
+            m_nodes.push_back(std::move(child));
+        }
+        byParent.erase(it);
+    }
+
+    // 3) Documenti nella propria cartella + aggregati diretti
+    QSet<Uuid> pages;
+    for (const QList<DocEntry> *list : {&pdfs, &epubs, &notebooks}) {
+        for (const DocEntry &e : *list) {
+            const int n = find(e.parentUuid);
+            if (n < 0)
+                continue;
+
+            Node &node = m_nodes[size_t(n)];
+            node.docs.push_back(&e);
+            if (e.kind == "pdf")       ++node.own.pdfs;
+            else if (e.kind == "epub") ++node.own.epubs;
+            else                       ++node.own.notebooks;
+
+            pages.clear();
+            for (const TagRef &t : e.tags) {
+                pages.insert(t.pageId);
+                node.own.tags.push_back(t.nameId);
+            }
+            node.own.taggedPages += int(pages.size());
+        }
+    }
+
+    for (Node &node : m_nodes) {
+        std::sort(node.own.tags.begin(), node.own.tags.end());
+        node.own.tags.erase(std::unique(node.own.tags.begin(), node.own.tags.end()),
+                            node.own.tags.end());
+        node.own.folders = int(node.children.size());
+        node.subtree = node.own;
+    }
+
+    // 4) Aggregati di sottoalbero: i figli hanno indici maggiori del padre,
+    //    quindi una passata all'indietro li visita prima di lui
+    std::vector<quint32> merged;
+    for (size_t n = m_nodes.size(); n-- > 1; ) {
+        const FolderStats &c = m_nodes[n].subtree;
+        FolderStats &p = m_nodes[size_t(m_nodes[n].parent)].subtree;
+        p.pdfs        += c.pdfs;
+        p.epubs       += c.epubs;
+        p.notebooks   += c.notebooks;
+        p.folders     += c.folders;
+        p.taggedPages += c.taggedPages;
+
+        merged.clear();
+        std::set_union(p.tags.begin(), p.tags.end(), c.tags.begin(), c.tags.end(),
+                       std::back_inserter(merged));
+        p.tags.swap(merged);
+    }
+}
+
+int FolderIndex::find(const Uuid &folder) const
+{
+    return m_byUuid.value(folder, -1);
+}
+
+int FolderIndex::resolve(const QString &arg, QString &error) const
+{
+    QString a = arg.trimmed();
+    if (a == "root" || a == "/")
+        return kRoot;
+
+    if (a.startsWith(QLatin1Char('/'))) {
+        while (a.size() > 1 && a.endsWith(QLatin1Char('/')))
+            a.chop(1);
+        if (m_ambiguous.contains(a)) {
+            error = "folder path is ambiguous (use the folder UUID): " + a;
+            return -1;
+        }
+        const int n = m_byPath.value(a, -1);
+        if (n < 0)
+            error = "folder not found: " + a;
+        return n;
+    }
+
+    // Solo ricerca: in --serve le richieste non devono internare stringhe
+    Uuid folder;
+    const int n = Uuid::lookup(a, folder) ? find(folder) : -1;
+    if (n < 0)
+        error = "folder not found: " + a;
+    return n;
+}
+
+std::vector<int> FolderIndex::subtreeNodes(int node) const
+{
+    std::vector<int> out;
+    std::vector<int> stack{node};
+    while (!stack.empty()) {
+        const int n = stack.back();
+        stack.pop_back();
+        out.push_back(n);
+        const std::vector<int> &kids = m_nodes[size_t(n)].children;
+        stack.insert(stack.end(), kids.rbegin(), kids.rend());
+    }
+    return out;
+}
+
+QSet<Uuid> FolderIndex::subtreeFolders(int node) const
+{
+    QSet<Uuid> out;
+    for (int n : subtreeNodes(node))
+        out.insert(m_nodes[size_t(n)].uuid);
+    return out;
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <QHash>
+#include <QList>
+#include <QSet>
+#include <QString>
+
+#include <vector>
+
+#include "model.h"
+
+// Aggregati di una cartella (solo i documenti diretti, oppure l'intero
+// sottoalbero)
+struct FolderStats {
+    int pdfs = 0, epubs = 0, notebooks = 0;
+    int folders     = 0; // sottocartelle
+    int taggedPages = 0; // pagine con almeno un tag
+    std::vector<quint32> tags; // tag distinti (nameId in tagNames()), ordinati
+
+    int documents() const { return pdfs + epubs + notebooks; }
+};
+
+// Albero delle cartelle (CollectionType) della libreria, costruito una volta
+// dopo la scansione. Il nodo 0 è la root (My Files).
+//
+// - I percorsi ("/Lavoro/Progetti") sono calcolati una sola volta, in
+//   ampiezza: ogni cartella estende il percorso del padre, nessuna risalita
+//   della catena dei parent per documento.
+// - Gli aggregati di sottoalbero sono precalcolati dal basso verso l'alto:
+//   leggerli costa O(1); elencare documenti e cartelle di un sottoalbero
+//   costa O(sottoalbero), non O(libreria).
+// - Cartelle con parent sconosciuto (es. cestinato) o in un ciclo non sono
+//   raggiungibili dalla root: loro e i loro documenti restano fuori.
+//
+// I puntatori ai documenti restano validi finché le liste passate a build()
+// non vengono modificate.
+class FolderIndex
+{
+public:
+    static const int kRoot = 0;
+
+    void build(const QList<DocEntry> &folders,
+               const QList<DocEntry> &pdfs,
+               const QList<DocEntry> &epubs,
+               const QList<DocEntry> &notebooks);
+
+    // Numero di nodi raggiungibili (root inclusa)
+    int size() const { return int(m_nodes.size()); }
+
+    // Nodo della cartella; -1 se sconosciuta o non raggiungibile
+    int find(const Uuid &folder) const;
+
+    // "root", "/", UUID di cartella o percorso "/A/B".
+    // -1 con `error` se non trovata o se il percorso è ambiguo
+    // (cartelle sorelle con lo stesso nome: usare l'UUID). Non interna
+    // l'argomento: un UUID mai visto è semplicemente "non trovata".
+    int resolve(const QString &arg, QString &error) const;
+
+    const QString &path(int node) const { return m_nodes[size_t(node)].path; }
+    const Uuid    &uuid(int node) const { return m_nodes[size_t(node)].uuid; }
+    int            depth(int node) const { return m_nodes[size_t(node)].depth; }
+    const std::vector<int> &children(int node) const { return m_nodes[size_t(node)].children; }
+
+    const FolderStats &own(int node) const     { return m_nodes[size_t(node)].own; }
+    const FolderStats &subtree(int node) const { return m_nodes[size_t(node)].subtree; }
+
+    // Nodi del sottoalbero in pre-ordine (figli ordinati per nome)
+    std::vector<int> subtreeNodes(int node) const;
+
+    // UUID delle cartelle del sottoalbero (Uuid nullo per la root):
+    // il filtro di --folder (ExportFilter::folders)
+    QSet<Uuid> subtreeFolders(int node) const;
+
+    // Documenti del sottoalbero, cartella per cartella in pre-ordine
+    template <typename F>
+    void forEachDocument(int node, F &&fn) const
+    {
+        for (int n : subtreeNodes(node))
+            for (const DocEntry *e : m_nodes[size_t(n)].docs)
+                fn(*e);
+    }
+
+private:
+    struct Node {
+        Uuid             uuid;
+        QString          path;
+        int              parent = -1;
+        int              depth  = 0;
+        std::vector<int> children;
+        std::vector<const DocEntry *> docs; // documenti diretti
+        FolderStats      own, subtree;
+    };
+
+    std::vector<Node>    m_nodes;
+    QHash<Uuid, int>     m_byUuid;
+    QHash<QString, int>  m_byPath;
+    QSet<QString>        m_ambiguous; // percorsi di più cartelle
+};
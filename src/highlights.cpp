@@ -0,0 +1,223 @@
+#include "highlights.h"
+#include "json_stream.h"
+#include "json_utils.h"
+#include "logging.h"
+#include "parallel.h"
+#include "paths.h"
+#include "profile.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+
+#include <algorithm>
+#include <vector>
+
+// Tetto di memoria per documento (testo UTF-16 + record)
+static const qsizetype kMaxHighlightBytes = 512 * 1024;
+// Un singolo highlight non può prendersi tutto il tetto
+static const qsizetype kMaxHighlightChars = 8 * 1024;
+
+// Fine dello span grezzo di un testo JSON che si decodifica in al più
+// maxChars unità UTF-16, senza spezzare escape o sequenze UTF-8: il testo
+// oltre il tetto non va né pagato nel budget né decodificato
+static const char *clampRawText(const char *b, const char *e, bool escaped, qsizetype maxChars)
+{
+    qsizetype chars = 0;
+    const char *p = b;
+    while (p < e) {
+        const uchar ch = uchar(*p);
+        qsizetype len = 1, units = 1;
+        if (escaped && ch == '\\')
+            len = (e - p > 1 && p[1] == 'u') ? 6 : 2;
+        else if (ch >= 0xF0) {
+            len = 4;
+            units = 2; // fuori dal BMP: coppia di surrogati
+        } else if (ch >= 0xE0)
+            len = 3;
+        else if (ch >= 0xC0)
+            len = 2;
+        if (chars + units > maxChars || len > e - p)
+            break;
+        p += len;
+        chars += units;
+    }
+    return p;
+}
+
+bool parseHighlightsPage(const char *data, qsizetype size,
+                         const Uuid &pageId, int pageNumber,
+                         qsizetype &budget, bool &full,
+                         QList<Highlight> &out)
+{
+    JsonCursor c(data, size);
+    c.skipBom();
+    if (c.peekType() != '{')
+        return false;
+
+    // Un elemento: il testo resta uno span nel buffer finché il record non
+    // è completo, poi viene decodificato solo se c'è spazio nel budget
+    auto readItem = [&]() {
+        if (c.peekType() != '{')
+            return c.skipValue();
+
+        Highlight h;
+        h.pageId = pageId;
+        h.pageNumber = pageNumber;
+        const char *tb = nullptr, *te = nullptr;
+        bool escaped = false;
+        const bool ok = c.forEachMember([&](const JsonCursor::Key &k) {
+            if (k.is("text"))   return c.readStringRaw(tb, te, escaped);
+            if (k.is("color"))  return c.readInt(0, h.color);
+            if (k.is("start"))  return c.readInt(-1, h.start);
+            if (k.is("length")) return c.readInt(0, h.length);
+            return c.skipValue();
+        });
+        if (!ok)
+            return false;
+        if (!tb)
+            return true; // senza testo non c'è nulla da riportare
+
+        // Spazi iniziali fuori dal conto (trimmed() li toglierebbe comunque),
+        // poi solo la parte che entra in kMaxHighlightChars
+        while (tb < te && (*tb == ' ' || *tb == '\t' || *tb == '\n' || *tb == '\r'))
+            ++tb;
+        te = clampRawText(tb, te, escaped, kMaxHighlightChars);
+
+        const qsizetype cost = qsizetype(sizeof(Highlight)) + (te - tb) * qsizetype(sizeof(QChar));
+        if (cost > budget) {
+            full = true;
+            return false; // interrompe la lettura: il resto non entra
+        }
+        h.text = JsonCursor::decode(tb, te, escaped).trimmed();
+        if (h.text.isEmpty())
+            return true;
+        budget -= qsizetype(sizeof(Highlight)) + h.text.size() * qsizetype(sizeof(QChar));
+        out.append(h);
+        return true;
+    };
+
+    // "highlights" è un array di livelli, ciascuno un array di elementi;
+    // si accetta anche la forma piatta
+    const bool ok = c.forEachMember([&](const JsonCursor::Key &k) {
+        if (!k.is("highlights"))
+            return c.skipValue();
+        if (c.peekType() != '[')
+            return c.skipValue();
+        return c.forEachElement([&]() {
+            if (c.peekType() == '[')
+                return c.forEachElement(readItem);
+            return readItem();
+        });
+    });
+
+    if (full)
+        return true;
+    return ok && c.atEnd();
+}
+
+QSet<QString> highlightDirs()
+{
+    QSet<QString> dirs;
+    const QStringList names = QDir(xochitlBase()).entryList(QStringList() << "*.highlights",
+                                                            QDir::Dirs | QDir::NoDotAndDotDot);
+    for (const QString &n : names)
+        dirs.insert(n.chopped(int(sizeof(".highlights") - 1)));
+    return dirs;
+}
+
+bool loadDocumentHighlights(DocEntry &e, const QSet<QString> *dirs)
+{
+    e.highlights.clear();
+    e.highlightsTruncated = false;
+    e.highlightsLoaded = true;
+
+    const QString dirPath = xochitlBase() + "/" + e.uuid + ".highlights";
+    if (dirs ? !dirs->contains(e.uuid) : !QFileInfo(dirPath).isDir())
+        return true;
+
+    ProfileScope prof(ProfilePhase::Highlights);
+
+    const QStringList files = QDir(dirPath).entryList(QStringList() << "*.json",
+                                                       QDir::Files, QDir::Name);
+    if (files.isEmpty())
+        return true;
+
+    // Numeri di pagina dalla stessa page map dei tag
+    ContentInfo content;
+    QHash<QString,int> pageMap;
+    if (loadContentInfo(xochitlBase() + "/" + e.uuid + ".content", content, CF_PageMap))
+        pageMap = buildPageMap(content);
+
+    bool allOk = true;
+    qsizetype budget = kMaxHighlightBytes;
+    bool full = false;
+    for (const QString &name : files) {
+        const QString pageIdStr = name.chopped(5); // ".json"
+        const Uuid pageId = Uuid::fromString(pageIdStr);
+        const int pageNumber = pageMap.value(pageIdStr, -1);
+
+        QFile f(dirPath + "/" + name);
+        if (!f.open(QIODevice::ReadOnly)) {
+            allOk = false;
+            continue;
+        }
+        const qint64 size = f.size();
+        if (size <= 0) {
+            allOk = false;
+            continue;
+        }
+        profileAddBytes(ProfileBytes::Highlights, size);
+
+        bool ok;
+        if (const uchar *map = f.map(0, size)) {
+            ok = parseHighlightsPage(reinterpret_cast<const char *>(map), size,
+                                     pageId, pageNumber, budget, full, e.highlights);
+            f.unmap(const_cast<uchar *>(map));
+        } else {
+            const QByteArray data = f.readAll();
+            ok = parseHighlightsPage(data.constData(), data.size(),
+                                     pageId, pageNumber, budget, full, e.highlights);
+        }
+        allOk = allOk && ok;
+        if (full)
+            break;
+    }
+
+    e.highlightsTruncated = full;
+    std::stable_sort(e.highlights.begin(), e.highlights.end(),
+                     [](const Highlight &a, const Highlight &b) {
+                         // pagine sconosciute in fondo
+                         const uint pa = uint(a.pageNumber), pb = uint(b.pageNumber);
+                         if (pa != pb)
+                             return pa < pb;
+                         return a.start < b.start;
+                     });
+    return allOk;
+}
+
+int loadHighlights(QList<DocEntry> &pdfs,
+                   QList<DocEntry> &epubs,
+                   QList<DocEntry> &notebooks,
+                   int jobs)
+{
+    const QSet<QString> dirs = highlightDirs();
+
+    // Puntatori presi qui, nel thread principale: i worker non toccano le
+    // QList (niente detach concorrenti), solo la propria entry
+    std::vector<DocEntry *> docs;
+    for (QList<DocEntry> *list : {&pdfs, &epubs, &notebooks})
+        for (DocEntry &e : *list)
+            docs.push_back(&e);
+
+    parallelFor(int(docs.size()), jobs, [&](int i) {
+        DocEntry &e = *docs[size_t(i)];
+        if (!loadDocumentHighlights(e, &dirs))
+            qCWarning(lcScan, "unreadable highlights in %s.highlights", qPrintable(e.uuid));
+    });
+
+    int total = 0;
+    for (const DocEntry *e : docs)
+        total += int(e->highlights.size());
+    return total;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <QList>
+#include <QSet>
+#include <QString>
+
+#include "model.h"
+
+// Estrattore degli highlight: <uuid>.highlights/<pageId>.json
+//
+//   {"highlights": [[{"text": "...", "color": 3, "start": 120, "length": 42,
+//                     "rects": [...]}, ...], ...]}
+//
+// Ogni file è mappato e letto in streaming con JsonCursor: si tengono solo
+// text, color, start e length (rects & co. vengono saltati senza allocare).
+// Le pagine sono numerate con buildPageMap del .content, come i tag.
+//
+// Memoria limitata per documento: superato il tetto (testo + record) gli
+// highlight restanti non vengono letti e la entry è marcata come troncata,
+// così un EPUB annotatissimo non può esaurire la RAM del device.
+// Gli highlight non sono nella scansione né nella scan cache: si caricano
+// quando servono (summary, export).
+
+// Estrae gli highlight di una pagina da un buffer JSON e li accoda a `out`.
+// `budget` sono i byte ancora disponibili per il documento (decrementati);
+// `full` diventa true se il tetto è stato raggiunto. false = JSON non valido.
+bool parseHighlightsPage(const char *data, qsizetype size,
+                         const Uuid &pageId, int pageNumber,
+                         qsizetype &budget, bool &full,
+                         QList<Highlight> &out);
+
+// Carica gli highlight di una entry. `dirs` (UUID con una directory
+// .highlights, dal listing della libreria) evita una stat() per documento.
+// Restituisce false se almeno un file non era leggibile o valido.
+bool loadDocumentHighlights(DocEntry &e, const QSet<QString> *dirs = nullptr);
+
+// UUID che hanno una directory <uuid>.highlights (un solo listing)
+QSet<QString> highlightDirs();
+
+// Carica gli highlight di tutte le entry su `jobs` worker (0 = tutti i core).
+// Restituisce il numero di highlight letti.
+int loadHighlights(QList<DocEntry> &pdfs,
+                   QList<DocEntry> &epubs,
+                   QList<DocEntry> &notebooks,
+                   int jobs);
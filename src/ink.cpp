@@ -0,0 +1,367 @@
+#include "ink.h"
+#include "json_stream.h"
+#include "json_utils.h"
+#include "logging.h"
+#include "parallel.h"
+#include "paths.h"
+#include "profile.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QtEndian>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#include <sys/stat.h>
+
+namespace {
+
+const char kRmHeader[]        = "reMarkable .lines file, version=6";
+const qsizetype kRmHeaderSize = 43; // intestazione completata da spazi
+
+const quint8 kBlockSceneLine = 0x05;
+
+// Tipi dei tag (4 bit bassi)
+enum : quint8 {
+    kTagByte1   = 0x1,
+    kTagByte4   = 0x4,
+    kTagByte8   = 0x8,
+    kTagLength4 = 0xC,
+    kTagId      = 0xF
+};
+
+// Strumenti che non lasciano inchiostro visibile
+const quint32 kToolEraser     = 6;
+const quint32 kToolEraserArea = 8;
+
+// Dimensione di un punto per versione del blocco
+const qsizetype kPointSizeV1 = 24; // x, y, speed, direction, width, pressure: float
+const qsizetype kPointSize   = 14; // x, y: float; speed, width: u16; direction, pressure: u8
+
+// Cursore su [p, end) di un blocco: niente copie, solo puntatori nel file
+struct Reader {
+    const uchar *p;
+    const uchar *end;
+
+    qsizetype left() const { return end - p; }
+
+    bool u32(quint32 &v)
+    {
+        if (left() < 4)
+            return false;
+        v = qFromLittleEndian<quint32>(p);
+        p += 4;
+        return true;
+    }
+
+    bool varuint(quint32 &v)
+    {
+        v = 0;
+        for (int shift = 0; shift < 35; shift += 7) {
+            if (p == end)
+                return false;
+            const uchar b = *p++;
+            v |= quint32(b & 0x7F) << shift;
+            if (!(b & 0x80))
+                return true;
+        }
+        return false;
+    }
+
+    bool tag(quint32 &index, quint8 &type)
+    {
+        quint32 x;
+        if (!varuint(x))
+            return false;
+        index = x >> 4;
+        type  = quint8(x & 0xF);
+        return true;
+    }
+
+    // Salta il valore di un tag; per Length4 anche il sotto-blocco
+    bool skip(quint8 type)
+    {
+        qsizetype n;
+        switch (type) {
+        case kTagByte1: n = 1; break;
+        case kTagByte4: n = 4; break;
+        case kTagByte8: n = 8; break;
+        case kTagId: {
+            if (left() < 1)
+                return false;
+            ++p; // parte 1 del CrdtId
+            quint32 part2;
+            return varuint(part2);
+        }
+        case kTagLength4: {
+            quint32 len;
+            if (!u32(len))
+                return false;
+            n = qsizetype(len);
+            break;
+        }
+        default:
+            return false;
+        }
+        if (left() < n)
+            return false;
+        p += n;
+        return true;
+    }
+};
+
+inline float readFloat(const uchar *p)
+{
+    const quint32 bits = qFromLittleEndian<quint32>(p);
+    float f;
+    std::memcpy(&f, &bits, sizeof f);
+    return f;
+}
+
+// Bounding box di n punti a passo `stride`. Quattro accumulatori per lato
+// spezzano la catena di dipendenze dei min/max, così il ciclo non aspetta
+// il confronto precedente e il compilatore può usare registri vettoriali.
+// I NaN non spostano il box (std::min/max tengono il primo argomento).
+void boundPoints(const uchar *p, qsizetype n, qsizetype stride, PageInk &ink)
+{
+    float mnx[4], mny[4], mxx[4], mxy[4];
+    for (int k = 0; k < 4; ++k) {
+        mnx[k] = ink.minX;
+        mny[k] = ink.minY;
+        mxx[k] = ink.maxX;
+        mxy[k] = ink.maxY;
+    }
+
+    qsizetype i = 0;
+    for (; i + 4 <= n; i += 4) {
+        for (int k = 0; k < 4; ++k) {
+            const uchar *q = p + (i + k) * stride;
+            const float x = readFloat(q);
+            const float y = readFloat(q + 4);
+            mnx[k] = std::min(mnx[k], x);
+            mny[k] = std::min(mny[k], y);
+            mxx[k] = std::max(mxx[k], x);
+            mxy[k] = std::max(mxy[k], y);
+        }
+    }
+    for (; i < n; ++i) {
+        const uchar *q = p + i * stride;
+        const float x = readFloat(q);
+        const float y = readFloat(q + 4);
+        mnx[0] = std::min(mnx[0], x);
+        mny[0] = std::min(mny[0], y);
+        mxx[0] = std::max(mxx[0], x);
+        mxy[0] = std::max(mxy[0], y);
+    }
+
+    for (int k = 0; k < 4; ++k) {
+        ink.minX = std::min(ink.minX, mnx[k]);
+        ink.minY = std::min(ink.minY, mny[k]);
+        ink.maxX = std::max(ink.maxX, mxx[k]);
+        ink.maxY = std::max(ink.maxY, mxy[k]);
+    }
+}
+
+// Valore di un tratto (dopo il byte del tipo di elemento)
+bool parseLine(Reader r, quint8 version, PageInk &ink)
+{
+    quint32 tool = 0;
+    const uchar *points = nullptr;
+    quint32 pointBytes = 0;
+
+    while (r.left() > 0) {
+        quint32 index;
+        quint8 type;
+        if (!r.tag(index, type))
+            return false;
+        if (index == 1 && type == kTagByte4) {
+            if (!r.u32(tool))
+                return false;
+        } else if (index == 5 && type == kTagLength4) {
+            if (!r.u32(pointBytes) || r.left() < qsizetype(pointBytes))
+                return false;
+            points = r.p;
+            r.p += pointBytes;
+        } else if (!r.skip(type)) {
+            return false;
+        }
+    }
+
+    if (!points || tool == kToolEraser || tool == kToolEraserArea)
+        return true;
+
+    const qsizetype stride = version >= 2 ? kPointSize : kPointSizeV1;
+    const qsizetype n = qsizetype(pointBytes) / stride;
+    if (n == 0)
+        return true;
+    boundPoints(points, n, stride, ink);
+    ++ink.strokes;
+    ink.points += quint64(n);
+    return true;
+}
+
+// Payload di un blocco SceneLineItem: parent, item, left, right,
+// deleted_length e, se l'elemento non è cancellato, il valore (tag 6)
+bool parseLineBlock(Reader r, quint8 version, PageInk &ink)
+{
+    while (r.left() > 0) {
+        quint32 index;
+        quint8 type;
+        if (!r.tag(index, type))
+            return false;
+        if (index == 6 && type == kTagLength4) {
+            quint32 len;
+            if (!r.u32(len) || len < 1 || r.left() < qsizetype(len))
+                return false;
+            // Il primo byte è il tipo di elemento, ridondante col tipo di blocco
+            if (!parseLine(Reader{r.p + 1, r.p + len}, version, ink))
+                return false;
+            r.p += len;
+        } else if (!r.skip(type)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+bool parseRmPage(const char *data, qsizetype size, PageInk &out)
+{
+    out.strokes = 0;
+    out.points  = 0;
+    out.minX = out.minY = std::numeric_limits<float>::max();
+    out.maxX = out.maxY = std::numeric_limits<float>::lowest();
+
+    bool ok = size >= kRmHeaderSize &&
+              std::memcmp(data, kRmHeader, sizeof(kRmHeader) - 1) == 0;
+
+    Reader r{reinterpret_cast<const uchar *>(data) + kRmHeaderSize,
+             reinterpret_cast<const uchar *>(data) + size};
+    while (ok && r.left() > 0) {
+        quint32 len;
+        if (r.left() < 8 || !r.u32(len)) {
+            ok = false;
+            break;
+        }
+        const quint8 version = r.p[2];
+        const quint8 type    = r.p[3];
+        r.p += 4;
+        if (r.left() < qsizetype(len)) {
+            ok = false;
+            break;
+        }
+        if (type == kBlockSceneLine)
+            ok = parseLineBlock(Reader{r.p, r.p + len}, version, out);
+        r.p += len;
+    }
+
+    if (out.points == 0)
+        out.minX = out.minY = out.maxX = out.maxY = 0;
+    return ok;
+}
+
+QSet<QString> inkDirs()
+{
+    // Le directory delle pagine sono i soli <uuid> senza estensione
+    // (le altre sono .highlights, .thumbnails, .textconversion, ...)
+    QSet<QString> dirs;
+    const QStringList names = QDir(xochitlBase()).entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+    for (const QString &n : names)
+        if (!n.contains(QLatin1Char('.')))
+            dirs.insert(n);
+    return dirs;
+}
+
+bool loadDocumentInk(DocEntry &e, const QSet<QString> *dirs)
+{
+    e.ink.clear();
+    e.inkLoaded = true;
+
+    const QString dirPath = xochitlBase() + "/" + e.uuid;
+    if (dirs ? !dirs->contains(e.uuid) : !QFileInfo(dirPath).isDir())
+        return true;
+
+    ProfileScope prof(ProfilePhase::Ink);
+
+    const QStringList files = QDir(dirPath).entryList(QStringList() << "*.rm",
+                                                       QDir::Files, QDir::Name);
+    if (files.isEmpty())
+        return true;
+
+    ContentInfo content;
+    QHash<QString,int> pageMap;
+    if (loadContentInfo(xochitlBase() + "/" + e.uuid + ".content", content, CF_PageMap))
+        pageMap = buildPageMap(content);
+
+    bool allOk = true;
+    for (const QString &name : files) {
+        QFile f(dirPath + "/" + name);
+        if (!f.open(QIODevice::ReadOnly)) {
+            allOk = false;
+            continue;
+        }
+        // fstat sul descrittore: dimensione e mtime senza ripassare dal path
+        struct stat st;
+        if (::fstat(f.handle(), &st) != 0 || st.st_size <= 0) {
+            allOk = false;
+            continue;
+        }
+        const qint64 size = qint64(st.st_size);
+        profileAddBytes(ProfileBytes::Ink, size);
+
+        PageInk page;
+        bool ok;
+        if (const uchar *map = f.map(0, size)) {
+            ok = parseRmPage(reinterpret_cast<const char *>(map), size, page);
+            f.unmap(const_cast<uchar *>(map));
+        } else {
+            const QByteArray data = f.readAll();
+            ok = parseRmPage(data.constData(), data.size(), page);
+        }
+        allOk = allOk && ok;
+        if (page.strokes == 0)
+            continue;
+
+        const QString pageIdStr = name.chopped(3); // ".rm"
+        page.pageId     = Uuid::fromString(pageIdStr);
+        page.pageNumber = pageMap.value(pageIdStr, -1);
+        page.mtimeMs    = qint64(st.st_mtim.tv_sec) * 1000 + st.st_mtim.tv_nsec / 1000000;
+        e.ink.append(page);
+    }
+
+    std::sort(e.ink.begin(), e.ink.end(), [](const PageInk &a, const PageInk &b) {
+        // pagine sconosciute in fondo
+        return uint(a.pageNumber) < uint(b.pageNumber);
+    });
+    return allOk;
+}
+
+int loadInk(QList<DocEntry> &pdfs,
+            QList<DocEntry> &epubs,
+            QList<DocEntry> &notebooks,
+            int jobs)
+{
+    const QSet<QString> dirs = inkDirs();
+
+    // Come loadHighlights: puntatori presi nel thread principale
+    std::vector<DocEntry *> docs;
+    for (QList<DocEntry> *list : {&pdfs, &epubs, &notebooks})
+        for (DocEntry &e : *list)
+            docs.push_back(&e);
+
+    parallelFor(int(docs.size()), jobs, [&](int i) {
+        DocEntry &e = *docs[size_t(i)];
+        if (!loadDocumentInk(e, &dirs))
+            qCWarning(lcScan, "unreadable page files in %s/", qPrintable(e.uuid));
+    });
+
+    int total = 0;
+    for (const DocEntry *e : docs)
+        total += int(e->ink.size());
+    return total;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <QList>
+#include <QSet>
+#include <QString>
+
+#include "model.h"
+
+// Statistiche dell'inchiostro: <uuid>/<pageId>.rm, formato "lines" v6.
+//
+//   "reMarkable .lines file, version=6" + spazi fino a 43 byte, poi blocchi:
+//   u32 lunghezza | u8 0 | u8 versione minima | u8 versione | u8 tipo | payload
+//
+// I payload sono sequenze di tag (varuint indice<<4 | tipo) seguiti dal
+// valore: ID (u8 + varuint), Byte1/4/8, Length4 (u32 + sotto-blocco).
+// Interessano solo i blocchi SceneLineItem (0x05): il valore del tratto
+// contiene lo strumento (tag 1) e i punti (tag 5, 14 byte l'uno dalla
+// versione 2, 24 nella 1: x e y float in testa). Tutto il resto viene
+// saltato con la lunghezza dichiarata, senza copiare nulla dal file mappato.
+//
+// Come gli highlight, l'inchiostro non fa parte della scansione: si carica
+// quando serve un summary.
+
+// Statistiche di una pagina da un buffer .rm (pageId/pageNumber/mtime
+// restano al chiamante). false = non è un v6 o un blocco è malformato;
+// i tratti letti fino a quel punto restano in `out`.
+bool parseRmPage(const char *data, qsizetype size, PageInk &out);
+
+// Carica l'inchiostro di una entry (solo pagine con almeno un tratto).
+// `dirs` (UUID con una directory <uuid>/) evita una stat() per documento.
+// Restituisce false se almeno un .rm non era leggibile o valido.
+bool loadDocumentInk(DocEntry &e, const QSet<QString> *dirs = nullptr);
+
+// UUID che hanno una directory delle pagine <uuid>/ (un solo listing)
+QSet<QString> inkDirs();
+
+// Carica l'inchiostro di tutte le entry su `jobs` worker (0 = tutti i core).
+// Restituisce il numero di pagine con tratti.
+int loadInk(QList<DocEntry> &pdfs,
+            QList<DocEntry> &epubs,
+            QList<DocEntry> &notebooks,
+            int jobs);
@@ -0,0 +1,701 @@
+#include "json_stream.h"
+#include "profile.h"
+
+#include <QByteArray>
+#include <QFile>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+// Stesso limite di annidamento del parser di QJsonDocument
+static const int kMaxDepth = 1024;
+
+// -------------------------
+//  JsonCursor
+// -------------------------
+JsonCursor::JsonCursor(const char *data, qsizetype size)
+    : m_p(data), m_end(data + size)
+{
+}
+
+bool JsonCursor::Key::is(const char *literal) const
+{
+    const size_t n = std::strlen(literal);
+    if (!escaped)
+        return size_t(end - begin) == n && std::memcmp(begin, literal, n) == 0;
+    // chiave con escape (raro): confronto sulla forma decodificata
+    return JsonCursor::decode(begin, end, true) == QLatin1String(literal, qsizetype(n));
+}
+
+void JsonCursor::ws()
+{
+    while (m_p < m_end && (*m_p == ' ' || *m_p == '\t' || *m_p == '\n' || *m_p == '\r'))
+        ++m_p;
+}
+
+bool JsonCursor::eat(char c)
+{
+    ws();
+    if (m_p < m_end && *m_p == c) {
+        ++m_p;
+        return true;
+    }
+    return false;
+}
+
+bool JsonCursor::enter()
+{
+    return ++m_depth <= kMaxDepth;
+}
+
+void JsonCursor::skipBom()
+{
+    if (m_end - m_p >= 3 && std::memcmp(m_p, "\xEF\xBB\xBF", 3) == 0)
+        m_p += 3;
+    ws();
+}
+
+bool JsonCursor::atEnd()
+{
+    ws();
+    return m_p == m_end;
+}
+
+char JsonCursor::peekType()
+{
+    ws();
+    if (m_p >= m_end)
+        return 0;
+    const char c = *m_p;
+    return (c == '{' || c == '[' || c == '"') ? c : 0;
+}
+
+// Valida una sequenza UTF-8 multibyte (rifiuta overlong, surrogati, > U+10FFFF)
+static bool skipUtf8(const char *&p, const char *end)
+{
+    const unsigned char c = static_cast<unsigned char>(*p);
+    int len;
+    char32_t cp;
+    if (c >= 0xC2 && c <= 0xDF)      { len = 2; cp = c & 0x1F; }
+    else if (c >= 0xE0 && c <= 0xEF) { len = 3; cp = c & 0x0F; }
+    else if (c >= 0xF0 && c <= 0xF4) { len = 4; cp = c & 0x07; }
+    else return false;
+
+    if (end - p < len)
+        return false;
+    for (int i = 1; i < len; ++i) {
+        const unsigned char cc = static_cast<unsigned char>(p[i]);
+        if ((cc & 0xC0) != 0x80)
+            return false;
+        cp = (cp << 6) | (cc & 0x3F);
+    }
+    if ((len == 3 && cp < 0x800) || (len == 4 && (cp < 0x10000 || cp > 0x10FFFF)) ||
+        (cp >= 0xD800 && cp <= 0xDFFF))
+        return false;
+
+    p += len;
+    return true;
+}
+
+static int hexValue(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+bool JsonCursor::scanString(const char *&begin, const char *&end, bool &escaped)
+{
+    if (m_p >= m_end || *m_p != '"')
+        return fail();
+    ++m_p;
+    begin = m_p;
+    escaped = false;
+
+    while (m_p < m_end) {
+        const char c = *m_p;
+        if (c == '"') {
+            end = m_p++;
+            return true;
+        }
+        if (c == '\\') {
+            escaped = true;
+            if (m_end - m_p < 2)
+                return fail();
+            const char e = m_p[1];
+            if (e == 'u') {
+                if (m_end - m_p < 6)
+                    return fail();
+                for (int i = 2; i < 6; ++i)
+                    if (hexValue(m_p[i]) < 0)
+                        return fail();
+                m_p += 6;
+            } else if (std::strchr("\"\\/bfnrt", e) && e != '\0') {
+                m_p += 2;
+            } else {
+                return fail();
+            }
+        } else if (static_cast<unsigned char>(c) < 0x80) {
+            ++m_p;
+        } else if (!skipUtf8(m_p, m_end)) {
+            return fail();
+        }
+    }
+    return fail(); // stringa non terminata
+}
+
+bool JsonCursor::scanNumber(const char *&begin, const char *&end)
+{
+    auto digits = [&]() {
+        const char *s = m_p;
+        while (m_p < m_end && *m_p >= '0' && *m_p <= '9')
+            ++m_p;
+        return m_p > s;
+    };
+
+    begin = m_p;
+    if (m_p < m_end && *m_p == '-')
+        ++m_p;
+    if (m_p < m_end && *m_p == '0')
+        ++m_p;
+    else if (!digits())
+        return fail();
+
+    if (m_p < m_end && *m_p == '.') {
+        ++m_p;
+        if (!digits())
+            return fail();
+    }
+    if (m_p < m_end && (*m_p == 'e' || *m_p == 'E')) {
+        ++m_p;
+        if (m_p < m_end && (*m_p == '+' || *m_p == '-'))
+            ++m_p;
+        if (!digits())
+            return fail();
+    }
+    end = m_p;
+    return true;
+}
+
+bool JsonCursor::scanLiteral(const char *lit, int len)
+{
+    if (m_end - m_p < len || std::memcmp(m_p, lit, size_t(len)) != 0)
+        return fail();
+    m_p += len;
+    return true;
+}
+
+bool JsonCursor::skipValue()
+{
+    ws();
+    if (m_p >= m_end)
+        return fail();
+
+    const char *b, *e;
+    bool esc;
+    switch (*m_p) {
+    case '{':
+        return forEachMember([this](const Key &) { return skipValue(); });
+    case '[':
+        return forEachElement([this]() { return skipValue(); });
+    case '"':
+        return scanString(b, e, esc);
+    case 't':
+        return scanLiteral("true", 4);
+    case 'f':
+        return scanLiteral("false", 5);
+    case 'n':
+        return scanLiteral("null", 4);
+    default:
+        return scanNumber(b, e);
+    }
+}
+
+bool JsonCursor::readStringRaw(const char *&begin, const char *&end, bool &escaped)
+{
+    ws();
+    if (m_p < m_end && *m_p == '"')
+        return scanString(begin, end, escaped);
+
+    begin = end = nullptr;
+    escaped = false;
+    return skipValue();
+}
+
+bool JsonCursor::readBool(bool def, bool &out)
+{
+    ws();
+    if (m_p < m_end && *m_p == 't') {
+        out = true;
+        return scanLiteral("true", 4);
+    }
+    if (m_p < m_end && *m_p == 'f') {
+        out = false;
+        return scanLiteral("false", 5);
+    }
+    out = def;
+    return skipValue();
+}
+
+bool JsonCursor::readString(QString &out)
+{
+    const char *b, *e;
+    bool esc;
+    if (!readStringRaw(b, e, esc))
+        return false;
+    out = b ? decode(b, e, esc) : QString();
+    return true;
+}
+
+// Converte il testo di un numero in double (strtod vuole uno zero finale)
+static double toDouble(const char *b, const char *e)
+{
+    char buf[64];
+    const size_t n = size_t(e - b);
+    if (n >= sizeof(buf))
+        return std::strtod(QByteArray(b, qsizetype(n)).constData(), nullptr);
+    std::memcpy(buf, b, n);
+    buf[n] = '\0';
+    return std::strtod(buf, nullptr);
+}
+
+bool JsonCursor::readDouble(double def, double &out)
+{
+    ws();
+    if (m_p < m_end && (*m_p == '-' || (*m_p >= '0' && *m_p <= '9'))) {
+        const char *b, *e;
+        if (!scanNumber(b, e))
+            return false;
+        out = toDouble(b, e);
+        return true;
+    }
+    out = def;
+    return skipValue();
+}
+
+bool JsonCursor::readInt(int def, int &out)
+{
+    ws();
+    if (!(m_p < m_end && (*m_p == '-' || (*m_p >= '0' && *m_p <= '9')))) {
+        out = def;
+        return skipValue();
+    }
+
+    const char *b, *e;
+    if (!scanNumber(b, e))
+        return false;
+
+    // Percorso veloce: intero decimale corto
+    const char *p = b;
+    const bool neg = (*p == '-');
+    if (neg)
+        ++p;
+    if (e - p <= 10 && std::find_if(p, e, [](char c) { return c < '0' || c > '9'; }) == e) {
+        qint64 v = 0;
+        for (; p < e; ++p)
+            v = v * 10 + (*p - '0');
+        if (neg)
+            v = -v;
+        out = (v >= INT_MIN && v <= INT_MAX) ? int(v) : def;
+        return true;
+    }
+
+    // Come QJsonValue::toInt: un double vale solo se intero e nel range di int
+    const double d = toDouble(b, e);
+    if (std::isfinite(d) && d >= double(INT_MIN) && d <= double(INT_MAX) && std::floor(d) == d)
+        out = int(d);
+    else
+        out = def;
+    return true;
+}
+
+QString JsonCursor::decode(const char *begin, const char *end, bool escaped)
+{
+    if (!escaped)
+        return QString::fromUtf8(begin, end - begin);
+
+    QString s;
+    s.reserve(end - begin);
+    const char *run = begin;
+    const char *p = begin;
+    while (p < end) {
+        if (*p != '\\') {
+            ++p;
+            continue;
+        }
+        s += QString::fromUtf8(run, p - run);
+        const char e = p[1];
+        switch (e) {
+        case 'b': s += QChar(u'\b'); break;
+        case 'f': s += QChar(u'\f'); break;
+        case 'n': s += QChar(u'\n'); break;
+        case 'r': s += QChar(u'\r'); break;
+        case 't': s += QChar(u'\t'); break;
+        case 'u': {
+            const char16_t cu = char16_t((hexValue(p[2]) << 12) | (hexValue(p[3]) << 8) |
+                                         (hexValue(p[4]) << 4) | hexValue(p[5]));
+            s += QChar(cu); // le coppie di surrogati si ricompongono da sole
+            p += 4;
+            break;
+        }
+        default:  s += QChar(char16_t(e)); break; // \" \\ \/
+        }
+        p += 2;
+        run = p;
+    }
+    s += QString::fromUtf8(run, end - run);
+    return s;
+}
+
+// -------------------------
+//  Estrattore del .content
+// -------------------------
+
+// Le due varianti dell'estrattore (ContentInfo con QString, ContentSpans
+// con span nell'arena) condividono il parser: cambiano solo la lettura
+// delle stringhe e i contenitori, tramite gli overload qui sotto.
+
+// Stringa trimmed come QString (readString + trimmed())
+static bool readText(JsonCursor &c, const ContentInfo &, QString &out)
+{
+    if (!c.readString(out))
+        return false;
+    out = out.trimmed();
+    return true;
+}
+
+// Copia `bytes` nell'arena e restituisce lo span
+static std::string_view arenaCopy(const QByteArray &bytes, std::pmr::memory_resource *mr)
+{
+    if (bytes.isEmpty())
+        return {};
+    char *p = static_cast<char *>(mr->allocate(size_t(bytes.size()), 1));
+    std::memcpy(p, bytes.constData(), size_t(bytes.size()));
+    return std::string_view(p, size_t(bytes.size()));
+}
+
+// Span di una stringa JSON: nel buffer se non ha escape, altrimenti
+// decodificato nell'arena. Con trim = true toglie gli spazi come
+// QString::trimmed (quelli Unicode passano dalla decodifica)
+static bool readSpan(JsonCursor &c, std::pmr::memory_resource *mr, bool trim,
+                     std::string_view &out)
+{
+    const char *b, *e;
+    bool esc;
+    if (!c.readStringRaw(b, e, esc))
+        return false;
+    out = {};
+    if (!b)
+        return true;
+
+    if (!esc) {
+        if (trim) {
+            // nelle stringhe JSON gli spazi ASCII non escape sono solo ' '
+            while (b < e && *b == ' ')
+                ++b;
+            while (e > b && e[-1] == ' ')
+                --e;
+        }
+        if (!trim || b == e || (uchar(*b) < 0x80 && uchar(e[-1]) < 0x80)) {
+            out = std::string_view(b, size_t(e - b));
+            return true;
+        }
+    }
+    QString s = JsonCursor::decode(b, e, esc);
+    if (trim)
+        s = s.trimmed();
+    out = arenaCopy(s.toUtf8(), mr);
+    return true;
+}
+
+static bool readText(JsonCursor &c, const ContentSpans &info, std::string_view &out)
+{
+    return readSpan(c, info.resource(), true, out);
+}
+
+static bool isBlank(const QString &s) { return s.isEmpty(); }
+static bool isBlank(std::string_view s) { return s.empty(); }
+
+static void addTag(QList<ContentTag> &tags, QString &name, QString &pageId)
+{
+    tags.append(ContentTag{name, pageId});
+}
+
+static void addTag(std::pmr::vector<ContentSpans::Tag> &tags,
+                   std::string_view name, std::string_view pageId)
+{
+    tags.push_back({name, pageId});
+}
+
+static void addPage(QList<QPair<QString,int>> &pages, QString &id, int page)
+{
+    pages.append(qMakePair(id, page));
+}
+
+static void addPage(std::pmr::vector<ContentSpans::Page> &pages, std::string_view id, int page)
+{
+    pages.push_back({id, page});
+}
+
+static void resetInfo(ContentInfo &out)
+{
+    out = ContentInfo();
+}
+
+static void resetInfo(ContentSpans &out)
+{
+    out.extraFileType = out.rootFileType = {};
+    out.extraTags.clear();
+    out.rootTags.clear();
+    out.cPages.clear();
+    out.rootPages.clear();
+    out.extraTagsSize = out.rootTagsSize = 0;
+    out.pageCount = 0;
+}
+
+// pageTags[]: conta tutti gli elementi, tiene solo quelli con name/pageId validi
+template <typename Info, typename Tags>
+static bool readTags(JsonCursor &c, const Info &info, Tags &tags, qsizetype &size)
+{
+    tags.clear();
+    size = 0;
+    if (c.peekType() != '[')
+        return c.skipValue();
+
+    return c.forEachElement([&]() {
+        ++size;
+        if (c.peekType() != '{')
+            return c.skipValue();
+
+        decltype(Info::extraFileType) name, pageId;
+        const bool ok = c.forEachMember([&](const JsonCursor::Key &k) {
+            if (k.is("name"))   return readText(c, info, name);
+            if (k.is("pageId")) return readText(c, info, pageId);
+            return c.skipValue();
+        });
+        if (ok && !isBlank(name) && !isBlank(pageId))
+            addTag(tags, name, pageId);
+        return ok;
+    });
+}
+
+// pages[]: tiene le coppie (id, redir.value) con id non vuoto e pagina >= 0
+template <typename Info, typename Pages>
+static bool readPages(JsonCursor &c, const Info &info, Pages &pages)
+{
+    pages.clear();
+    if (c.peekType() != '[')
+        return c.skipValue();
+
+    return c.forEachElement([&]() {
+        if (c.peekType() != '{')
+            return c.skipValue();
+
+        decltype(Info::extraFileType) pid;
+        int pageNo = -1;
+        const bool ok = c.forEachMember([&](const JsonCursor::Key &k) {
+            if (k.is("id"))
+                return readText(c, info, pid);
+            if (k.is("redir")) {
+                pageNo = -1;
+                if (c.peekType() != '{')
+                    return c.skipValue();
+                return c.forEachMember([&](const JsonCursor::Key &rk) {
+                    if (rk.is("value"))
+                        return c.readInt(-1, pageNo);
+                    return c.skipValue();
+                });
+            }
+            return c.skipValue();
+        });
+        if (ok && !isBlank(pid) && pageNo >= 0)
+            addPage(pages, pid, pageNo);
+        return ok;
+    });
+}
+
+template <typename Info>
+static bool parseContent(const char *data, qsizetype size, Info &out, unsigned fields)
+{
+    resetInfo(out);
+
+    JsonCursor c(data, size);
+    c.skipBom();
+    if (c.peekType() != '{')
+        return false;
+
+    // Chiavi duplicate: vince l'ultima (come QJsonObject), per questo ogni
+    // lettura azzera il campo prima di riempirlo.
+    // Con CF_Probe si interrompe la lettura (fn → false) appena si conosce
+    // extraMetaData.fileType: "stopped" distingue l'uscita voluta dall'errore.
+    bool stopped = false;
+    const bool ok = c.forEachMember([&](const JsonCursor::Key &k) {
+        if ((fields & CF_FileType) && k.is("fileType"))
+            return readText(c, out, out.rootFileType);
+        if ((fields & CF_PageTags) && k.is("pageTags"))
+            return readTags(c, out, out.rootTags, out.rootTagsSize);
+        if ((fields & CF_PageMap) && k.is("pages"))
+            return readPages(c, out, out.rootPages);
+        if ((fields & CF_PageCount) && k.is("pageCount"))
+            return c.readInt(0, out.pageCount);
+
+        if ((fields & (CF_FileType | CF_PageTags)) && k.is("extraMetaData")) {
+            out.extraFileType = {};
+            out.extraTags.clear();
+            out.extraTagsSize = 0;
+            if (c.peekType() != '{')
+                return c.skipValue();
+            return c.forEachMember([&](const JsonCursor::Key &ek) {
+                if ((fields & CF_FileType) && ek.is("fileType")) {
+                    if (!readText(c, out, out.extraFileType))
+                        return false;
+                    if ((fields & CF_Probe) && !isBlank(out.extraFileType))
+                        stopped = true;
+                    return !stopped;
+                }
+                if ((fields & CF_PageTags) && ek.is("pageTags"))
+                    return readTags(c, out, out.extraTags, out.extraTagsSize);
+                return c.skipValue();
+            });
+        }
+
+        if ((fields & CF_PageMap) && k.is("cPages")) {
+            out.cPages.clear();
+            if (c.peekType() != '{')
+                return c.skipValue();
+            return c.forEachMember([&](const JsonCursor::Key &ck) {
+                if (ck.is("pages"))
+                    return readPages(c, out, out.cPages);
+                return c.skipValue();
+            });
+        }
+
+        return c.skipValue();
+    });
+
+    if (stopped)
+        return true;
+
+    if (!ok || !c.atEnd()) {
+        resetInfo(out);
+        return false;
+    }
+    return true;
+}
+
+bool parseContentInfo(const char *data, qsizetype size,
+                      ContentInfo &out, unsigned fields)
+{
+    return parseContent(data, size, out, fields);
+}
+
+bool parseContentSpans(const char *data, qsizetype size,
+                       ContentSpans &out, unsigned fields)
+{
+    return parseContent(data, size, out, fields);
+}
+
+bool parseMetadataSpans(const char *data, qsizetype size,
+                        MetadataSpans &out, std::pmr::memory_resource *mr)
+{
+    out = MetadataSpans();
+
+    JsonCursor c(data, size);
+    c.skipBom();
+    if (c.peekType() != '{')
+        return false;
+
+    // Come nel DOM: chiavi duplicate → vince l'ultima
+    const bool ok = c.forEachMember([&](const JsonCursor::Key &k) {
+        if (k.is("deleted"))
+            return c.readBool(false, out.deleted);
+        if (k.is("parent")) {
+            out.parentIsString = c.peekType() == '"';
+            return readSpan(c, mr, false, out.parent);
+        }
+        if (k.is("visibleName")) {
+            out.hasVisibleName = c.peekType() == '"';
+            return c.readString(out.visibleName);
+        }
+        if (k.is("type"))
+            return readSpan(c, mr, false, out.type);
+        return c.skipValue();
+    });
+
+    if (!ok || !c.atEnd()) {
+        out = MetadataSpans();
+        return false;
+    }
+    return true;
+}
+
+// -------------------------
+//  MappedFile
+// -------------------------
+MappedFile::~MappedFile()
+{
+    if (m_map)
+        ::munmap(m_map, size_t(m_size));
+}
+
+bool MappedFile::open(const QString &path)
+{
+    const int fd = ::open(QFile::encodeName(path).constData(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || st.st_size <= 0) {
+        ::close(fd);
+        return false; // file vuoto: JSON non valido
+    }
+    m_size = qsizetype(st.st_size);
+
+    void *map = ::mmap(nullptr, size_t(m_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (map != MAP_FAILED) {
+        m_map  = map;
+        m_data = static_cast<const char *>(map);
+        return true;
+    }
+
+    // mmap non supportato: copia in memoria
+    QFile f(path);
+    if (!f.open(QIODevice::ReadOnly))
+        return false;
+    m_copy = f.readAll();
+    m_data = m_copy.constData();
+    m_size = m_copy.size();
+    return m_size > 0;
+}
+
+bool loadContentInfo(const QString &path, ContentInfo &out, unsigned fields)
+{
+    QFile f(path);
+    if (!f.open(QIODevice::ReadOnly))
+        return false;
+
+    const qint64 size = f.size();
+    if (size <= 0)
+        return false; // file vuoto: JSON non valido
+    profileAddBytes(ProfileBytes::Content, size);
+
+    // mmap in sola lettura; se il FS non lo supporta si ripiega su readAll
+    if (const uchar *map = f.map(0, size)) {
+        const bool ok = parseContentInfo(reinterpret_cast<const char *>(map), size, out, fields);
+        f.unmap(const_cast<uchar *>(map));
+        return ok;
+    }
+
+    const QByteArray data = f.readAll();
+    return parseContentInfo(data.constData(), data.size(), out, fields);
+}
@@ -0,0 +1,250 @@
+#pragma once
+
+#include <QByteArray>
+#include <QList>
+#include <QPair>
+#include <QString>
+
+#include <memory_resource>
+#include <string_view>
+#include <vector>
+
+// Lettore JSON "pull" su un buffer in memoria (tipicamente mmap).
+// Nessun DOM: il chiamante scorre oggetti/array e legge solo i valori
+// che gli servono; tutto il resto è validato e saltato senza allocare.
+// La grammatica accettata segue QJsonDocument::fromJson (BOM iniziale,
+// UTF-8 valido nelle stringhe, annidamento massimo 1024).
+class JsonCursor
+{
+public:
+    // Chiave di un membro: span grezzo (senza virgolette) nel buffer
+    struct Key {
+        const char *begin = nullptr;
+        const char *end   = nullptr;
+        bool escaped      = false; // contiene sequenze \x: va decodificata
+
+        bool is(const char *literal) const;
+    };
+
+    JsonCursor(const char *data, qsizetype size);
+
+    bool ok() const { return m_ok; }
+
+    // Salta spazi e l'eventuale BOM UTF-8 iniziale
+    void skipBom();
+    // true se dopo gli spazi non resta nulla
+    bool atEnd();
+
+    // Tipo del prossimo valore (dopo gli spazi): '{' '[' '"' o 0 per scalari
+    char peekType();
+
+    // Scorre i membri dell'oggetto corrente: fn(const Key&) deve consumare
+    // il valore (leggendolo o con skipValue) e restituire false per abortire.
+    template <typename Fn> bool forEachMember(Fn &&fn);
+    // Scorre gli elementi dell'array corrente: fn() consuma l'elemento
+    template <typename Fn> bool forEachElement(Fn &&fn);
+
+    // Valida e salta un valore qualsiasi
+    bool skipValue();
+
+    // Legge una stringa; se il valore non è stringa lo salta e out = ""
+    // (come QJsonValue::toString())
+    bool readString(QString &out);
+    // Span grezzo di una stringa (escaped = true se va decodificata);
+    // se il valore non è stringa lo salta e restituisce uno span vuoto
+    bool readStringRaw(const char *&begin, const char *&end, bool &escaped);
+    // Legge un intero con la semantica di QJsonValue::toInt(def)
+    bool readInt(int def, int &out);
+    // Legge un booleano con la semantica di QJsonValue::toBool(def)
+    bool readBool(bool def, bool &out);
+    // Legge un numero qualsiasi come double (def se non numerico)
+    bool readDouble(double def, double &out);
+
+    // Decodifica uno span di stringa JSON (escape \uXXXX inclusi)
+    static QString decode(const char *begin, const char *end, bool escaped);
+
+private:
+    void ws();
+    bool eat(char c);
+    bool fail() { m_ok = false; return false; }
+    bool enter();
+    bool scanString(const char *&begin, const char *&end, bool &escaped);
+    bool scanNumber(const char *&begin, const char *&end);
+    bool scanLiteral(const char *lit, int len);
+
+    const char *m_p;
+    const char *m_end;
+    int  m_depth = 0;
+    bool m_ok    = true;
+};
+
+template <typename Fn>
+bool JsonCursor::forEachMember(Fn &&fn)
+{
+    if (!eat('{') || !enter())
+        return fail();
+    if (eat('}')) {
+        --m_depth;
+        return true;
+    }
+    do {
+        ws();
+        Key k;
+        if (!scanString(k.begin, k.end, k.escaped) || !eat(':'))
+            return fail();
+        if (!fn(k) || !m_ok)
+            return fail();
+    } while (eat(','));
+    if (!eat('}'))
+        return fail();
+    --m_depth;
+    return true;
+}
+
+template <typename Fn>
+bool JsonCursor::forEachElement(Fn &&fn)
+{
+    if (!eat('[') || !enter())
+        return fail();
+    if (eat(']')) {
+        --m_depth;
+        return true;
+    }
+    do {
+        if (!fn() || !m_ok)
+            return fail();
+    } while (eat(','));
+    if (!eat(']'))
+        return fail();
+    --m_depth;
+    return true;
+}
+
+// Campi del .content da estrarre (bitmask): tutto il resto viene saltato
+enum ContentField : unsigned {
+    CF_FileType  = 1u << 0, // extraMetaData.fileType, fileType
+    CF_PageTags  = 1u << 1, // extraMetaData.pageTags[], pageTags[]
+    CF_PageMap   = 1u << 2, // cPages.pages[].id/redir.value, pages[]
+    CF_PageCount = 1u << 3, // pageCount
+    CF_All       = CF_FileType | CF_PageTags | CF_PageMap | CF_PageCount,
+    // Si ferma appena extraMetaData.fileType è noto e non vuoto: il resto del
+    // file non viene letto né validato (sonda della scansione lazy)
+    CF_Probe     = 1u << 4
+};
+
+// Un elemento di pageTags: name/pageId già trimmed e non vuoti
+struct ContentTag {
+    QString name;
+    QString pageId;
+};
+
+// Sottoinsieme del .content estratto senza costruire il DOM.
+// I campi "extra*" e "root*" restano separati: le priorità (fallback)
+// sono applicate da readFileType/readPageTags/buildPageMap in json_utils.
+struct ContentInfo {
+    QString extraFileType;            // extraMetaData.fileType (trimmed)
+    QString rootFileType;             // fileType (trimmed)
+
+    QList<ContentTag> extraTags;      // extraMetaData.pageTags validi
+    qsizetype extraTagsSize = 0;      // elementi dell'array (anche non validi)
+    QList<ContentTag> rootTags;       // pageTags validi
+    qsizetype rootTagsSize  = 0;
+
+    QList<QPair<QString,int>> cPages;    // cPages.pages[]: (id, redir.value) validi
+    QList<QPair<QString,int>> rootPages; // pages[]: idem
+
+    int pageCount = 0;                // pageCount (toInt(0))
+};
+
+// Estrae i campi richiesti da un buffer JSON in un solo passaggio.
+// I valori non richiesti vengono validati e saltati senza allocare.
+// Restituisce false se il JSON non è valido o la radice non è un oggetto
+// (stessa semantica di loadJsonObject + QJsonDocument::isObject).
+bool parseContentInfo(const char *data, qsizetype size,
+                      ContentInfo &out, unsigned fields = CF_All);
+
+// Come parseContentInfo, ma lavora sul file mappato in memoria
+bool loadContentInfo(const QString &path,
+                     ContentInfo &out, unsigned fields = CF_All);
+
+// File in sola lettura mappato per la durata dell'oggetto (se il FS non
+// supporta mmap viene letto in memoria). Gli span di ContentSpans e
+// MetadataSpans puntano qui dentro.
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    ~MappedFile();
+
+    // false = assente, vuoto o illeggibile
+    bool open(const QString &path);
+
+    const char *data() const { return m_data; }
+    qsizetype   size() const { return m_size; }
+
+private:
+    void       *m_map = nullptr;
+    const char *m_data = nullptr;
+    qsizetype   m_size = 0;
+    QByteArray  m_copy;
+};
+
+// Variante di ContentInfo per la scansione con --max-memory: stesse regole
+// e stessi campi, ma le stringhe sono span UTF-8 (già trimmed) nel file
+// mappato e le liste stanno nell'arena del documento (vedi arena.h). Solo
+// le stringhe con escape, o con spazi Unicode da togliere, vengono
+// decodificate e copiate nell'arena. Tutto resta valido finché il file è
+// mappato e l'arena non viene azzerata.
+struct ContentSpans {
+    struct Tag {
+        std::string_view name;
+        std::string_view pageId;
+    };
+    struct Page {
+        std::string_view id;
+        int page = -1;
+    };
+
+    explicit ContentSpans(std::pmr::memory_resource *mr)
+        : extraTags(mr), rootTags(mr), cPages(mr), rootPages(mr)
+    {
+    }
+
+    std::pmr::memory_resource *resource() const { return extraTags.get_allocator().resource(); }
+
+    std::string_view extraFileType;
+    std::string_view rootFileType;
+
+    std::pmr::vector<Tag> extraTags;
+    qsizetype extraTagsSize = 0;
+    std::pmr::vector<Tag> rootTags;
+    qsizetype rootTagsSize  = 0;
+
+    std::pmr::vector<Page> cPages;
+    std::pmr::vector<Page> rootPages;
+
+    int pageCount = 0;
+};
+
+// Come parseContentInfo, sugli span
+bool parseContentSpans(const char *data, qsizetype size,
+                       ContentSpans &out, unsigned fields = CF_All);
+
+// Campi del .metadata usati dalla scansione, estratti senza DOM con la
+// semantica di QJsonValue: deleted vale solo se è true, parent può essere
+// stringa (non trimmed) o altro, visibleName solo se è una stringa.
+struct MetadataSpans {
+    bool             deleted = false;
+    bool             parentIsString = false;
+    std::string_view parent;
+    bool             hasVisibleName = false;
+    QString          visibleName;
+    std::string_view type;
+};
+
+// false se il JSON non è valido o la radice non è un oggetto (come
+// loadJsonObject). Le stringhe con escape vanno nell'arena `mr`.
+bool parseMetadataSpans(const char *data, qsizetype size,
+                        MetadataSpans &out, std::pmr::memory_resource *mr);
@@ -1,7 +1,9 @@
 #include "json_utils.h"
+#include "profile.h"
 
 #include <QFile>
 #include <QJsonDocument>
+#include <QStringList>
 
 bool loadJsonObject(const QString& path, QJsonObject& out)
 {
@@ -9,7 +11,10 @@ bool loadJsonObject(const QString& path, QJsonObject& out)
     if (!f.open(QIODevice::ReadOnly))
         return false;
 
-    const auto doc = QJsonDocument::fromJson(f.readAll());
+    const QByteArray data = f.readAll();
+    profileAddBytes(ProfileBytes::Metadata, data.size());
+
+    const auto doc = QJsonDocument::fromJson(data);
     if (!doc.isObject())
         return false;
 
@@ -70,4 +75,129 @@ QHash<QString,int> buildPageMap(const QJsonObject& content)
     }
 
     return map;
+}
+
+// -------------------------
+//  Variante su ContentInfo
+// -------------------------
+QString readFileType(const ContentInfo& content)
+{
+    if (!content.extraFileType.isEmpty())
+        return content.extraFileType;
+    return content.rootFileType; // può essere vuoto: verrà gestito a valle
+}
+
+QList<ContentTag> readPageTags(const ContentInfo& content)
+{
+    // come toArray().isEmpty(): conta anche gli elementi non validi
+    if (content.extraTagsSize > 0)
+        return content.extraTags;
+    return content.rootTags;
+}
+
+QHash<QString,int> buildPageMap(const ContentInfo& content)
+{
+    QHash<QString,int> map;
+
+    // 1) cPages.pages
+    for (const auto& p : content.cPages)
+        map.insert(p.first, p.second);
+
+    // 2) fallback: root-level "pages"
+    if (map.isEmpty()) {
+        for (const auto& p : content.rootPages)
+            map.insert(p.first, p.second);
+    }
+
+    return map;
+}
+
+// -------------------------
+//  Verifica differenziale
+// -------------------------
+bool verifyContentExtractor(const QString& path, QString& diff)
+{
+    diff.clear();
+
+    QJsonObject dom;
+    ContentInfo info;
+    const bool domOk    = loadJsonObject(path, dom);
+    const bool streamOk = loadContentInfo(path, info);
+
+    if (domOk != streamOk) {
+        diff = QStringLiteral("parse result: QJson=%1 stream=%2")
+                   .arg(domOk ? "ok" : "fail", streamOk ? "ok" : "fail");
+        return false;
+    }
+    if (!domOk)
+        return true; // entrambi rifiutano il file
+
+    QStringList problems;
+
+    const QString t1 = readFileType(dom), t2 = readFileType(info);
+    if (t1 != t2)
+        problems << QStringLiteral("fileType: \"%1\" vs \"%2\"").arg(t1, t2);
+
+    // pageTags: stessa lista (in ordine) dopo trim e scarto dei vuoti
+    QList<ContentTag> domTags;
+    for (const auto& v : readPageTags(dom)) {
+        const QJsonObject t = v.toObject();
+        ContentTag ct{t.value("name").toString().trimmed(),
+                      t.value("pageId").toString().trimmed()};
+        if (!ct.name.isEmpty() && !ct.pageId.isEmpty())
+            domTags.append(ct);
+    }
+    const QList<ContentTag> streamTags = readPageTags(info);
+    bool sameTags = domTags.size() == streamTags.size();
+    for (qsizetype i = 0; sameTags && i < domTags.size(); ++i) {
+        sameTags = domTags[i].name == streamTags[i].name &&
+                   domTags[i].pageId == streamTags[i].pageId;
+    }
+    if (!sameTags)
+        problems << QStringLiteral("pageTags: %1 vs %2 entries")
+                        .arg(domTags.size()).arg(streamTags.size());
+
+    const QHash<QString,int> m1 = buildPageMap(dom), m2 = buildPageMap(info);
+    if (m1 != m2)
+        problems << QStringLiteral("page map: %1 vs %2 entries")
+                        .arg(m1.size()).arg(m2.size());
+
+    const int c1 = dom.value("pageCount").toInt(0);
+    if (c1 != info.pageCount)
+        problems << QStringLiteral("pageCount: %1 vs %2").arg(c1).arg(info.pageCount);
+
+    // Variante a span di --max-memory: deve coincidere con ContentInfo
+    MappedFile file;
+    std::pmr::monotonic_buffer_resource arena;
+    ContentSpans spans(&arena);
+    if (!file.open(path) || !parseContentSpans(file.data(), file.size(), spans)) {
+        problems << QStringLiteral("span extractor: parse failed");
+    } else {
+        auto text = [](std::string_view s) { return QString::fromUtf8(s.data(), qsizetype(s.size())); };
+        const QString t3 = text(spans.extraFileType.empty() ? spans.rootFileType : spans.extraFileType);
+        if (t3 != t2)
+            problems << QStringLiteral("span fileType: \"%1\" vs \"%2\"").arg(t2, t3);
+
+        const auto &tags = spans.extraTagsSize > 0 ? spans.extraTags : spans.rootTags;
+        bool same = qsizetype(tags.size()) == streamTags.size();
+        for (qsizetype i = 0; same && i < streamTags.size(); ++i)
+            same = text(tags[size_t(i)].name) == streamTags[i].name &&
+                   text(tags[size_t(i)].pageId) == streamTags[i].pageId;
+        if (!same)
+            problems << QStringLiteral("span pageTags: %1 vs %2 entries")
+                            .arg(streamTags.size()).arg(qsizetype(tags.size()));
+
+        QHash<QString,int> m3;
+        for (const auto &p : spans.cPages.empty() ? spans.rootPages : spans.cPages)
+            m3.insert(text(p.id), p.page);
+        if (m3 != m2)
+            problems << QStringLiteral("span page map: %1 vs %2 entries")
+                            .arg(m2.size()).arg(m3.size());
+        if (spans.pageCount != info.pageCount)
+            problems << QStringLiteral("span pageCount: %1 vs %2")
+                            .arg(info.pageCount).arg(spans.pageCount);
+    }
+
+    diff = problems.join(QStringLiteral("; "));
+    return problems.isEmpty();
 }
\ No newline at end of file
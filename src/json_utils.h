@@ -4,6 +4,7 @@
 #include <QJsonArray>
 #include <QHash>
 #include <QString>
+#include "json_stream.h"
 
 // Carica un file JSON come QJsonObject
 bool loadJsonObject(const QString& path, QJsonObject& out);
@@ -15,4 +16,13 @@ QString readFileType(const QJsonObject& content);
 QJsonArray readPageTags(const QJsonObject& content);
 
 // Costruisce una mappa pageId → pageNumber da cPages.pages[].redir.value (con fallback root.pages)
-QHash<QString,int> buildPageMap(const QJsonObject& content);
\ No newline at end of file
+QHash<QString,int> buildPageMap(const QJsonObject& content);
+
+// Stesse regole di fallback, sui campi estratti in streaming (json_stream.h)
+QString readFileType(const ContentInfo& content);
+QList<ContentTag> readPageTags(const ContentInfo& content);
+QHash<QString,int> buildPageMap(const ContentInfo& content);
+
+// Confronto differenziale estrattore in streaming ↔ DOM QJsonDocument
+// sullo stesso .content. Restituisce false e descrive le differenze in `diff`.
+bool verifyContentExtractor(const QString& path, QString& diff);
\ No newline at end of file
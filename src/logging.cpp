@@ -1,27 +1,476 @@
 #include "logging.h"
+#include "paths.h"
 
-#include <QLoggingCategory>
 #include <QByteArray>
+#include <QFile>
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <mutex>
+#include <thread>
+
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+
+Q_LOGGING_CATEGORY(lcScan,   "mirtillo.scan")
+Q_LOGGING_CATEGORY(lcExport, "mirtillo.export")
+Q_LOGGING_CATEGORY(lcWatch,  "mirtillo.watch")
+
+// Ring: 256 slot da 512 byte (128 KiB). Un messaggio più lungo viene troncato
+static const int    kSlots       = 256;
+static const int    kTextBytes   = 480;
+// Rotazione: mirtillo.log → mirtillo.log.1 → … → mirtillo.log.3
+static const qint64 kMaxLogBytes = 1024 * 1024;
+static const int    kKeepLogs    = 3;
 
-// Silenzia i warning specifici sul locale ANSI_X3.4-1968 / UTF-8 mancanti
-void mirtilloMessageHandler(QtMsgType type,
-                            const QMessageLogContext &context,
-                            const QString &msg)
+namespace {
+
+struct Slot {
+    std::atomic<quint64> seq{0}; // == posizione: libero; == posizione+1: pronto
+    QtMsgType   type = QtDebugMsg;
+    const char *category = nullptr; // nome statico della QLoggingCategory
+    qint64      timeMs = 0;
+    int         length = 0;
+    char        text[kTextBytes];
+};
+
+// Coda limitata multi-produttore / singolo consumatore (schema di Vyukov):
+// ogni slot ha un numero di sequenza, i produttori si contendono solo
+// m_head con una CAS
+class LogRing
 {
-    Q_UNUSED(context);
+public:
+    LogRing()
+    {
+        for (int i = 0; i < kSlots; ++i)
+            m_slots[i].seq.store(quint64(i), std::memory_order_relaxed);
+    }
+
+    Slot *acquire()
+    {
+        quint64 pos = m_head.load(std::memory_order_relaxed);
+        for (;;) {
+            Slot &s = m_slots[pos % kSlots];
+            const qint64 diff = qint64(s.seq.load(std::memory_order_acquire)) - qint64(pos);
+            if (diff == 0) {
+                if (m_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    return &s;
+            } else if (diff < 0) {
+                return nullptr; // pieno
+            } else {
+                pos = m_head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Il produttore ha riempito lo slot; seq ne ricava la posizione
+    static void publish(Slot *s)
+    {
+        s->seq.store(s->seq.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // Solo il thread di flush
+    Slot *front()
+    {
+        Slot &s = m_slots[m_tail % kSlots];
+        return s.seq.load(std::memory_order_acquire) == m_tail + 1 ? &s : nullptr;
+    }
+    void pop()
+    {
+        m_slots[m_tail % kSlots].seq.store(m_tail + kSlots, std::memory_order_release);
+        ++m_tail;
+        m_popped.store(m_tail, std::memory_order_release);
+    }
+
+    quint64 head() const { return m_head.load(std::memory_order_acquire); }
+    quint64 popped() const { return m_popped.load(std::memory_order_acquire); }
+
+private:
+    Slot                 m_slots[kSlots];
+    alignas(64) std::atomic<quint64> m_head{0};
+    alignas(64) quint64  m_tail = 0;
+    std::atomic<quint64> m_popped{0};
+};
+
+struct LogState {
+    LogRing ring;
+    std::atomic<quint64> dropped{0};
+    std::atomic<bool>    sleeping{false};
+    std::atomic<bool>    running{false};
+    bool                 stop = false;
+
+    std::mutex              mutex;  // flusher: attesa, file e stop; mai i produttori
+    std::condition_variable wake;
+    std::condition_variable drained;
+    std::thread             flusher;
+
+    QFile  file;
+    qint64 fileSize = 0;
+    bool   fileEnabled = false;
+};
+
+// Mai distrutto: i messaggi possono arrivare anche durante la distruzione
+// degli oggetti statici
+LogState *g_log = nullptr;
+
+QtMsgType                        g_level = QtWarningMsg;
+QLoggingCategory::CategoryFilter g_qtFilter = nullptr;
+
+} // namespace
+
+// QtMsgType non è ordinato per gravità (QtInfoMsg vale 4)
+static int severity(QtMsgType t)
+{
+    switch (t) {
+    case QtDebugMsg:    return 0;
+    case QtInfoMsg:     return 1;
+    case QtWarningMsg:  return 2;
+    case QtCriticalMsg: return 3;
+    case QtFatalMsg:    return 4;
+    }
+    return 2;
+}
 
-    if (type == QtWarningMsg) {
-        if (msg.contains("ANSI_X3.4-1968", Qt::CaseInsensitive) ||
-            msg.contains("Qt depends on a UTF-8 locale", Qt::CaseInsensitive)) {
-            // Ignora completamente questo warning
+static char levelLetter(QtMsgType t)
+{
+    switch (t) {
+    case QtDebugMsg:    return 'D';
+    case QtInfoMsg:     return 'I';
+    case QtWarningMsg:  return 'W';
+    case QtCriticalMsg: return 'C';
+    case QtFatalMsg:    return 'F';
+    }
+    return '?';
+}
+
+static bool isMirtilloCategory(const char *name)
+{
+    return name && std::strncmp(name, "mirtillo.", 9) == 0;
+}
+
+// Invocato da Qt una volta per categoria (alla creazione e a ogni
+// installFilter), non per messaggio: i livelli restano flag sulla categoria
+static void categoryFilter(QLoggingCategory *category)
+{
+    if (g_qtFilter)
+        g_qtFilter(category); // regole di Qt (QT_LOGGING_RULES, ...)
+
+    const char *name = category->categoryName();
+    if (isMirtilloCategory(name)) {
+        const int min = severity(g_level);
+        category->setEnabled(QtDebugMsg,    min <= severity(QtDebugMsg));
+        category->setEnabled(QtInfoMsg,     min <= severity(QtInfoMsg));
+        category->setEnabled(QtWarningMsg,  min <= severity(QtWarningMsg));
+        category->setEnabled(QtCriticalMsg, true);
+    } else if (std::strcmp(name, "qt.core.locale") == 0) {
+        // Il locale è forzato a C.UTF-8 in main(): il warning non serve
+        category->setEnabled(QtWarningMsg, false);
+    }
+}
+
+// Il warning di QCoreApplication sul locale ANSI_X3.4-1968 esce nella
+// categoria "default": resta il confronto sul testo, ma solo lì
+static bool isLocaleWarning(QtMsgType type, const char *category, const QString &msg)
+{
+    if (type != QtWarningMsg || isMirtilloCategory(category))
+        return false;
+    return msg.contains(QLatin1String("ANSI_X3.4-1968"), Qt::CaseInsensitive) ||
+           msg.contains(QLatin1String("Qt depends on a UTF-8 locale"), Qt::CaseInsensitive);
+}
+
+// UTF-16 → UTF-8 direttamente nello slot, troncando a `cap` byte senza
+// spezzare un carattere
+static int encodeUtf8(const QString &s, char *out, int cap)
+{
+    int n = 0;
+    const QChar *p = s.constData(), *end = p + s.size();
+    while (p < end) {
+        char32_t c = p->unicode();
+        ++p;
+        if (QChar::isHighSurrogate(c) && p < end && p->isLowSurrogate()) {
+            c = QChar::surrogateToUcs4(char16_t(c), p->unicode());
+            ++p;
+        }
+        const int len = c < 0x80 ? 1 : c < 0x800 ? 2 : c < 0x10000 ? 3 : 4;
+        if (n + len > cap)
+            break;
+        switch (len) {
+        case 1:
+            out[n++] = char(c);
+            break;
+        case 2:
+            out[n++] = char(0xC0 | (c >> 6));
+            out[n++] = char(0x80 | (c & 0x3F));
+            break;
+        case 3:
+            out[n++] = char(0xE0 | (c >> 12));
+            out[n++] = char(0x80 | ((c >> 6) & 0x3F));
+            out[n++] = char(0x80 | (c & 0x3F));
+            break;
+        default:
+            out[n++] = char(0xF0 | (c >> 18));
+            out[n++] = char(0x80 | ((c >> 12) & 0x3F));
+            out[n++] = char(0x80 | ((c >> 6) & 0x3F));
+            out[n++] = char(0x80 | (c & 0x3F));
+            break;
+        }
+    }
+    return n;
+}
+
+static qint64 nowMs()
+{
+    struct timespec ts;
+    ::clock_gettime(CLOCK_REALTIME, &ts);
+    return qint64(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void writeAll(int fd, const char *data, qsizetype size)
+{
+    while (size > 0) {
+        const ssize_t n = ::write(fd, data, size_t(size));
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
             return;
+        data += n;
+        size -= n;
+    }
+}
+
+// Riga per stderr: come prima del logger asincrono, con "mirtillo: "
+// davanti ai messaggi delle categorie mirtillo.*
+static void appendConsoleLine(QByteArray &out, const Slot &s)
+{
+    if (isMirtilloCategory(s.category))
+        out.append("mirtillo: ");
+    out.append(s.text, s.length);
+    out.append('\n');
+}
+
+// Riga del file: "2026-01-31 18:04:05.123 W mirtillo.scan: testo"
+static void appendFileLine(QByteArray &out, const Slot &s)
+{
+    const time_t secs = time_t(s.timeMs / 1000);
+    struct tm tm;
+    ::localtime_r(&secs, &tm);
+    char stamp[40];
+    const int n = std::snprintf(stamp, sizeof stamp, "%04d-%02d-%02d %02d:%02d:%02d.%03d %c ",
+                                tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday,
+                                tm.tm_hour, tm.tm_min, tm.tm_sec, int(s.timeMs % 1000),
+                                levelLetter(s.type));
+    out.append(stamp, n);
+    out.append(s.category ? s.category : "default");
+    out.append(": ");
+    out.append(s.text, s.length);
+    out.append('\n');
+}
+
+static QString logFilePath()
+{
+    return mirtilloShareBase() + "/mirtillo.log";
+}
+
+// Con il mutex preso. mirtillo.log.N più vecchio scartato, gli altri scalano
+static void rotateLogFile(LogState &st)
+{
+    st.file.close();
+    const QString base = logFilePath();
+    QFile::remove(base + "." + QString::number(kKeepLogs));
+    for (int i = kKeepLogs - 1; i >= 1; --i)
+        QFile::rename(base + "." + QString::number(i), base + "." + QString::number(i + 1));
+    QFile::rename(base, base + ".1");
+    st.fileSize = 0;
+    if (!st.file.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Unbuffered))
+        st.fileEnabled = false;
+}
+
+static void writeFileBatch(LogState &st, const QByteArray &batch)
+{
+    if (!st.fileEnabled || batch.isEmpty())
+        return;
+    if (st.fileSize > 0 && st.fileSize + batch.size() > kMaxLogBytes)
+        rotateLogFile(st);
+    if (st.fileEnabled && st.file.write(batch) == batch.size())
+        st.fileSize += batch.size();
+}
+
+static void flusherLoop(LogState &st)
+{
+    // Il thread parte prima che main() blocchi SIGINT/SIGTERM per il
+    // signalfd di --serve/--watch: senza questa maschera il kernel potrebbe
+    // consegnarli qui, con l'azione di default (uscita senza chiusura
+    // ordinata). I segnali sincroni (errori di questo thread) restano attivi.
+    sigset_t mask;
+    sigfillset(&mask);
+    for (int sig : {SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGTRAP, SIGABRT})
+        sigdelset(&mask, sig);
+    ::pthread_sigmask(SIG_BLOCK, &mask, nullptr);
+
+    QByteArray console, file;
+    console.reserve(16 * 1024);
+    file.reserve(16 * 1024);
+
+    std::unique_lock<std::mutex> lock(st.mutex);
+    for (;;) {
+        // Un blocco alla volta: una write() per sink invece di una per messaggio
+        console.resize(0);
+        file.resize(0);
+        while (Slot *s = st.ring.front()) {
+            appendConsoleLine(console, *s);
+            if (st.fileEnabled)
+                appendFileLine(file, *s);
+            st.ring.pop();
+            if (console.size() >= 16 * 1024)
+                break;
         }
+        if (const quint64 lost = st.dropped.exchange(0)) {
+            Slot note;
+            note.type = QtWarningMsg;
+            note.category = "mirtillo.log";
+            note.timeMs = nowMs();
+            note.length = std::snprintf(note.text, sizeof note.text,
+                                        "%llu log message(s) dropped (buffer full)",
+                                        (unsigned long long)lost);
+            appendConsoleLine(console, note);
+            if (st.fileEnabled)
+                appendFileLine(file, note);
+        }
+
+        if (!console.isEmpty()) {
+            lock.unlock();
+            writeAll(STDERR_FILENO, console.constData(), console.size());
+            lock.lock();
+            writeFileBatch(st, file);
+            st.drained.notify_all();
+            continue;
+        }
+
+        st.drained.notify_all();
+        if (st.stop)
+            return;
+        // I produttori svegliano solo se `sleeping`: senza lock la sveglia
+        // può perdersi, l'attesa a tempo la recupera
+        st.sleeping.store(true, std::memory_order_seq_cst);
+        if (!st.ring.front() && !st.stop)
+            st.wake.wait_for(lock, std::chrono::milliseconds(200));
+        st.sleeping.store(false, std::memory_order_relaxed);
+    }
+}
+
+static void stopLogging()
+{
+    LogState *st = g_log;
+    if (!st || !st->running.load())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(st->mutex);
+        st->stop = true;
+    }
+    st->wake.notify_one();
+    st->flusher.join();
+    st->running.store(false);
+}
+
+static void messageHandler(QtMsgType type, const QMessageLogContext &context, const QString &msg)
+{
+    if (isLocaleWarning(type, context.category, msg))
+        return;
+
+    LogState *st = g_log;
+    const bool running = st && st->running.load(std::memory_order_acquire);
+    if (!running || type == QtFatalMsg) {
+        // Prima di abort(): scrive ciò che è in coda, poi questo messaggio
+        if (running && std::this_thread::get_id() != st->flusher.get_id())
+            flushLogging();
+        // Senza thread di flush (o prima di abort()): scrittura sincrona
+        Slot s;
+        s.category = context.category;
+        s.length = encodeUtf8(msg, s.text, kTextBytes);
+        QByteArray line;
+        appendConsoleLine(line, s);
+        writeAll(STDERR_FILENO, line.constData(), line.size());
+        return;
+    }
+
+    Slot *s = st->ring.acquire();
+    if (!s) {
+        st->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    s->type = type;
+    s->category = context.category;
+    s->timeMs = nowMs();
+    s->length = encodeUtf8(msg, s->text, kTextBytes);
+    LogRing::publish(s);
+
+    if (st->sleeping.load(std::memory_order_seq_cst))
+        st->wake.notify_one();
+}
+
+void installLogging()
+{
+    if (g_log)
+        return;
+    g_log = new LogState;
+    g_qtFilter = QLoggingCategory::installFilter(categoryFilter);
+    qInstallMessageHandler(messageHandler);
+
+    g_log->running.store(true, std::memory_order_release);
+    g_log->flusher = std::thread(flusherLoop, std::ref(*g_log));
+    std::atexit(stopLogging);
+}
+
+void configureLogging(const LogOptions &opts)
+{
+    g_level = opts.level;
+    QLoggingCategory::installFilter(categoryFilter); // rivaluta le categorie esistenti
+
+    LogState *st = g_log;
+    if (!st || !opts.file)
+        return;
+    std::lock_guard<std::mutex> lock(st->mutex);
+    if (st->fileEnabled)
+        return;
+    st->file.setFileName(logFilePath());
+    if (st->file.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Unbuffered)) {
+        st->fileEnabled = true;
+        st->fileSize = st->file.size();
     }
+}
+
+void flushLogging()
+{
+    LogState *st = g_log;
+    if (!st || !st->running.load())
+        return;
+    const quint64 target = st->ring.head();
+    std::unique_lock<std::mutex> lock(st->mutex);
+    st->wake.notify_one();
+    st->drained.wait_for(lock, std::chrono::seconds(2),
+                         [&] { return st->ring.popped() >= target; });
+}
 
-    // Tutto il resto: stampa normale su stderr
-    QByteArray local = msg.toLocal8Bit();
-    std::fprintf(stderr, "%s\n", local.constData());
+bool parseLogLevel(const QString &s, QtMsgType &level)
+{
+    if (s == "debug")
+        level = QtDebugMsg;
+    else if (s == "info")
+        level = QtInfoMsg;
+    else if (s == "warning")
+        level = QtWarningMsg;
+    else if (s == "critical")
+        level = QtCriticalMsg;
+    else
+        return false;
+    return true;
 }
 
 // Piccolo header con gatto ASCII + versione
@@ -31,4 +480,4 @@ QString mirtilloHeader(const QString &version)
     QString line2 = "( o.o )   Paper Pro CLI tool";
     QString line3 = " > ^ <    meta/tag extractor";
     return line1 + "\n" + line2 + "\n" + line3;
-}
\ No newline at end of file
+}
@@ -1,12 +1,37 @@
 #pragma once
 
 #include <QtGlobal>
+#include <QLoggingCategory>
 #include <QString>
 
-// Message handler personalizzato: silenzia solo i warning di qt.core.locale
-void mirtilloMessageHandler(QtMsgType type,
-                            const QMessageLogContext &context,
-                            const QString &msg);
+// Categorie di mirtillo: qCDebug/qCInfo/qCWarning(lcScan, ...).
+// Un livello disabilitato costa un test sul flag della categoria: la
+// macro non valuta gli argomenti e non costruisce il messaggio.
+Q_DECLARE_LOGGING_CATEGORY(lcScan)    // mirtillo.scan: libreria, highlight, inchiostro
+Q_DECLARE_LOGGING_CATEGORY(lcExport)  // mirtillo.export: summary, manifest, indici
+Q_DECLARE_LOGGING_CATEGORY(lcWatch)   // mirtillo.watch: --watch / --serve
+
+struct LogOptions {
+    QtMsgType level = QtWarningMsg; // soglia delle categorie mirtillo.*
+    bool      file  = false;        // anche su share/mirtillo.log (a rotazione)
+};
+
+// Message handler asincrono: il thread che logga copia il messaggio in un
+// ring buffer lock-free (senza allocazioni) e un thread di flush scrive a
+// blocchi su stderr e sul file di log. A buffer pieno i messaggi vengono
+// scartati e contati, mai attesi. Da chiamare per prima cosa in main():
+// installa anche il filtro delle categorie e lo svuotamento all'uscita.
+void installLogging();
+
+// Applica le opzioni della riga di comando (--debug, --log-level, --log-file).
+// Il filtro delle categorie viene ricalcolato una volta qui, non per messaggio
+void configureLogging(const LogOptions &opts);
+
+// Attende che il thread di flush abbia scritto tutto (chiamata anche all'uscita)
+void flushLogging();
+
+// Legge "debug" / "info" / "warning" / "critical"; false se sconosciuto
+bool parseLogLevel(const QString &s, QtMsgType &level);
 
 // Header ASCII con "logo" e versione
-QString mirtilloHeader(const QString &version);
\ No newline at end of file
+QString mirtilloHeader(const QString &version);
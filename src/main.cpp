@@ -9,19 +9,91 @@
 #include <QByteArray>
 #include <QFile>
 #include <QIODevice>
+#include <QStringList>
+#include <QHash>
 
 #include <clocale>       // setlocale
 #include <algorithm>     // std::sort
+#include <memory>        // std::unique_ptr
+#include <sys/resource.h> // getrusage
+#include <unistd.h>       // STDOUT_FILENO
 
 #include "logging.h"
 #include "model.h"
+#include "paths.h"
+#include "profile.h"
 #include "scanner.h"
 #include "export.h"
+#include "folder_index.h"
+#include "highlights.h"
+#include "ink.h"
+#include "batch_export.h"
+#include "diff.h"
+#include "excerpts.h"
+#include "export_store.h"
+#include "output.h"
+#include "tag_index.h"
+#include "tag_stats.h"
+#include "title_search.h"
+#include "server.h"
+#include "watcher.h"
+
+// Lista del menu in 2 colonne ("  1) Titolo"), renderizzata una volta sola
+static QString renderTwoColumns(const QList<DocEntry>& L)
+{
+    const int n = L.size();
+    const int colw = 48; // larghezza colonna
+    QString text;
+    QTextStream ts(&text);
+    for (int i = 0; i < n; ) {
+        QString left = QString("%1) %2")
+                           .arg(i+1, 3, 10, QChar(' '))
+                           .arg(L[i].visibleName.left(colw-7));
+        QString right;
+        if (i+1 < n) {
+            right = QString("%1) %2")
+                        .arg(i+2, 3, 10, QChar(' '))
+                        .arg(L[i+1].visibleName.left(colw-7));
+        }
+        ts << left.leftJustified(colw) << "  " << right << "\n";
+        i += 2;
+    }
+    ts.flush();
+    return text;
+}
+
+// Picco di memoria residente del processo (per --debug)
+static long peakRssKiB()
+{
+    struct rusage ru;
+    return ::getrusage(RUSAGE_SELF, &ru) == 0 ? ru.ru_maxrss : -1;
+}
+
+// --max-memory: all'uscita (distruttore) picco di RSS e uso delle arene
+// su stderr, così stdout resta pulito anche con --format
+struct MemoryReport {
+    const ScanStats *stats = nullptr;
+    qint64 budget = 0;
+
+    ~MemoryReport()
+    {
+        if (!stats)
+            return;
+        const long rss = peakRssKiB();
+        QTextStream err(stderr);
+        err << "Memory: peak RSS " << rss << " KiB of " << (budget >> 10) << " KiB budget"
+            << " | arenas " << stats->arenas << " x " << (stats->arenaCapacity >> 10) << " KiB"
+            << ", high-water " << (stats->arenaHighWater >> 10) << " KiB"
+            << ", spilled " << (stats->arenaSpilled >> 10) << " KiB"
+            << " | oversized .content " << stats->oversized
+            << (rss > (budget >> 10) ? " (over budget)" : "") << "\n";
+    }
+};
 
 int main(int argc, char *argv[])
 {
-    // 0) Installa il message handler per silenziare qt.core.locale
-    qInstallMessageHandler(mirtilloMessageHandler);
+    // 0) Logger asincrono; il filtro delle categorie silenzia qt.core.locale
+    installLogging();
 
     // 1) Prova comunque a forzare UTF-8 (innocuo su Paper Pro)
     setlocale(LC_ALL, "C.UTF-8");
@@ -33,8 +105,29 @@ int main(int argc, char *argv[])
     QCoreApplication app(argc, argv);
     QTextStream out(stdout), in(stdin);
 
-    // Gestione opzioni --version / --about / --debug
+    // Gestione opzioni --version / --about / --debug / --log-level / --log-file / --no-cache / --jobs / --lazy / --max-memory / --watch / --profile
+    // / --export-all (+ filtri --kind / --folder / --has-tags, --pdf, --store) / --changes-since / --diff / --folders / --tag-stats / --format / --serve / --client
     bool debug = false;
+    LogOptions logOpts;
+    bool foldersMode = false;
+    bool tagStatsMode = false;
+    QString folderArg;     // --folder, risolto dopo la scansione (FolderIndex)
+    bool watch = false;
+    bool serve = false;
+    QString socketPath = defaultSocketPath();
+    int  profile = 0; // 0 = off, 1 = tabella, 2 = JSON
+    bool exportAllMode = false;
+    ExportOptions exportOpts;
+    bool changesSince = false;
+    QStringList diffRoots; // --diff <rootA> <rootB>
+    quint64 sinceGeneration = 0;
+    ExportFilter exportFilter;
+    OutputFormat format = OutputFormat::Text;
+    QString tagQuery;      // --tag / --tag-prefix
+    bool tagPrefix = false;
+    ScanOptions scanOpts;
+    scanOpts.cachePath = mirtilloShareBase() + "/scan_cache.bin";
+    scanOpts.jobs = 0; // default: tutti i core del Paper Pro
 
     for (int i = 1; i < argc; ++i) {
         const QString arg = QString::fromUtf8(argv[i]).trimmed();
@@ -54,7 +147,7 @@ int main(int argc, char *argv[])
                 path = qEnvironmentVariable("MIRTILLO_ABOUT_PATH");
             } else {
                 // Path runtime sul dispositivo
-                path = QStringLiteral("/home/root/.local/share/mirtillo/ABOUT.txt");
+                path = mirtilloShareBase() + "/ABOUT.txt";
             }
 
             QFile f(path);
@@ -67,36 +160,483 @@ int main(int argc, char *argv[])
             return 0;
         }
 
+        if (arg == "--tag" || arg == "--tag-prefix") {
+            // Query non interattiva direttamente sull'indice mmap: niente scansione
+            if (i + 1 >= argc) {
+                out << "Error: " << arg << " requires a tag name\n";
+                return 1;
+            }
+            tagQuery = QString::fromUtf8(argv[++i]).trimmed();
+            tagPrefix = (arg == "--tag-prefix");
+        }
+
+        if (arg == "--format") {
+            // Output leggibile da programmi: json | jsonl | csv (text = default)
+            const QString v = (i + 1 < argc) ? QString::fromUtf8(argv[++i]) : QString();
+            if (!parseOutputFormat(v, format)) {
+                out << "Error: --format expects text, json, jsonl or csv\n";
+                return 1;
+            }
+        }
+
         if (arg == "--debug") {
             debug = true;
+            logOpts.level = QtDebugMsg;
+        }
+
+        if (arg == "--log-level") {
+            const QString v = (i + 1 < argc) ? QString::fromUtf8(argv[++i]) : QString();
+            if (!parseLogLevel(v, logOpts.level)) {
+                out << "Error: --log-level expects debug, info, warning or critical\n";
+                return 1;
+            }
+        }
+
+        if (arg == "--log-file") {
+            // Copia dei messaggi in share/mirtillo.log (a rotazione)
+            logOpts.file = true;
+        }
+
+        if (arg == "--no-cache") {
+            // Forza la rilettura completa di tutti i .metadata/.content
+            scanOpts.cachePath.clear();
+        }
+
+        if (arg == "--jobs") {
+            // Numero di worker per la scansione (1 = seriale, 0 = auto)
+            bool ok = false;
+            const int n = (i + 1 < argc) ? QString::fromUtf8(argv[++i]).toInt(&ok) : -1;
+            if (!ok || n < 0) {
+                out << "Error: --jobs requires a number >= 0\n";
+                return 1;
+            }
+            scanOpts.jobs = n;
+        }
+
+        if (arg == "--lazy") {
+            // Avvio rapido: tag e pagine letti solo per i documenti aperti
+            scanOpts.lazy = true;
+        }
+
+        if (arg == "--max-memory") {
+            // Tetto in MB per la scansione: temporanei in arene riusate
+            bool ok = false;
+            const int mb = (i + 1 < argc) ? QString::fromUtf8(argv[++i]).toInt(&ok) : -1;
+            if (!ok || mb <= 0) {
+                out << "Error: --max-memory requires a size in MB > 0\n";
+                return 1;
+            }
+            scanOpts.maxMemory = qint64(mb) * 1024 * 1024;
+        }
+
+        if (arg == "--profile" || arg == "--profile=json") {
+            // Scansione misurata: stampa i tempi per fase ed esce
+            profile = (arg == "--profile") ? 1 : 2;
+            profileEnable();
+        }
+
+        if (arg == "--export-all") {
+            // Export non interattivo dei summary di tutta la libreria
+            exportAllMode = true;
+        }
+
+        if (arg == "--kind") {
+            // Uno o più tipi separati da virgola: pdf,epub,notebook
+            const QString v = (i + 1 < argc) ? QString::fromUtf8(argv[++i]).trimmed() : QString();
+            for (const QString& k : v.split(',', Qt::SkipEmptyParts)) {
+                const QString kind = k.trimmed().toLower();
+                if (kind != "pdf" && kind != "epub" && kind != "notebook") {
+                    out << "Error: --kind expects pdf, epub or notebook\n";
+                    return 1;
+                }
+                exportFilter.kinds.insert(kind);
+            }
+            if (exportFilter.kinds.isEmpty()) {
+                out << "Error: --kind expects pdf, epub or notebook\n";
+                return 1;
+            }
+        }
+
+        if (arg == "--folder") {
+            // UUID della cartella, percorso "/A/B" oppure "root" per My Files;
+            // comprende le sottocartelle
+            if (i + 1 >= argc) {
+                out << "Error: --folder requires a folder UUID, a path or \"root\"\n";
+                return 1;
+            }
+            folderArg = QString::fromUtf8(argv[++i]).trimmed();
+        }
+
+        if (arg == "--folders") {
+            // Albero delle cartelle con gli aggregati di ogni sottoalbero
+            foldersMode = true;
+        }
+
+        if (arg == "--has-tags") {
+            exportFilter.taggedOnly = true;
+        }
+
+        if (arg == "--pdf") {
+            // --export-all scrive anche summary_<uuid>.pdf
+            exportOpts.pdf = true;
+        }
+
+        if (arg == "--store") {
+            // --export-all registra gli artefatti nello store per hash
+            exportOpts.store = true;
+        }
+
+        if (arg == "--changes-since") {
+            // Voci dello store cambiate dopo una generazione: niente scansione
+            bool ok = false;
+            sinceGeneration = (i + 1 < argc) ? QString::fromUtf8(argv[++i]).toULongLong(&ok) : 0;
+            if (!ok) {
+                out << "Error: --changes-since requires a generation number\n";
+                return 1;
+            }
+            changesSince = true;
+        }
+
+        if (arg == "--diff") {
+            // Confronto di due copie della libreria: niente scansione di xochitl
+            if (i + 2 >= argc) {
+                out << "Error: --diff requires two library directories\n";
+                return 1;
+            }
+            diffRoots << QString::fromUtf8(argv[i + 1]) << QString::fromUtf8(argv[i + 2]);
+            i += 2;
         }
+
+        if (arg == "--tag-stats") {
+            // Frequenze, densità e co-occorrenza dei tag (stessi filtri di --export-all)
+            tagStatsMode = true;
+        }
+
+        if (arg == "--watch") {
+            // Resta residente e aggiorna indice e summary a ogni modifica
+            watch = true;
+        }
+
+        if (arg == "--serve") {
+            // Resta residente e risponde alle query di --client
+            serve = true;
+        }
+
+        if (arg == "--socket") {
+            if (i + 1 >= argc) {
+                out << "Error: --socket requires a path\n";
+                return 1;
+            }
+            socketPath = QString::fromUtf8(argv[++i]);
+        }
+
+        if (arg == "--client") {
+            // Tutto ciò che segue è la query da inoltrare al server: niente scansione
+            QStringList query;
+            for (++i; i < argc; ++i)
+                query << QString::fromUtf8(argv[i]);
+            out.flush();
+            return runClient(socketPath, query);
+        }
+    }
+
+    configureLogging(logOpts);
+
+    if (!diffRoots.isEmpty()) {
+        out.flush();
+        OutputSink sink(STDOUT_FILENO);
+        DiffStats ds;
+        QString error;
+        if (!diffLibraries(diffRoots.at(0), diffRoots.at(1), scanOpts, format, sink, ds, error)) {
+            out << "Error: " << error << "\n";
+            return 1;
+        }
+        return sink.ok() ? 0 : 1;
     }
 
+    if (changesSince) {
+        // Prima riga: intestazione del manifest con la generazione attuale,
+        // poi le voci cambiate nel formato del manifest (export_store.h)
+        ExportStore store;
+        QString error;
+        if (!store.load(error)) {
+            out << "Error: " << error << "\n";
+            return 1;
+        }
+        out << "mirtillo-store\t1\t" << store.generation() << "\n";
+        for (const StoreEntry &e : store.changesSince(sinceGeneration))
+            out << ExportStore::formatEntry(e);
+        return 0;
+    }
+
+    if (!tagQuery.isEmpty()) {
+        // Query non interattiva direttamente sull'indice mmap: niente scansione
+        TagIndex index;
+        const QString indexPath = mirtilloShareBase() + "/tag_index.bin";
+        if (!index.open(indexPath)) {
+            out << "Tag index not found or invalid: " << indexPath << "\n"
+                << "Run mirtillo once without options to build it.\n";
+            return 1;
+        }
+
+        const QList<TagHit> hits = index.find(tagQuery, tagPrefix);
+        if (format == OutputFormat::Text) {
+            printTagHits(hits, out);
+            return 0;
+        }
+
+        OutputSink sink(STDOUT_FILENO);
+        RecordWriter w(sink, format, RecordWriter::Kind::TagHits);
+        w.begin();
+        for (const TagHit& h : hits)
+            w.tagHit(h);
+        w.end();
+        return sink.ok() ? 0 : 1;
+    }
+
+    // In --watch, --serve, --export-all, --folders, --tag-stats e --format
+    // servono entry complete (tag, pagine)
+    if (watch || serve || exportAllMode || foldersMode || tagStatsMode ||
+        format != OutputFormat::Text)
+        scanOpts.lazy = false;
+
     // 2) Scansione documenti
-    QList<DocEntry> pdfs, epubs, notebooks;
+    QList<DocEntry> pdfs, epubs, notebooks, folders;
     ScanStats stats;
 
-    if (!scanDocuments(pdfs, epubs, notebooks, stats)) {
+    if (!scanDocuments(pdfs, epubs, notebooks, stats, scanOpts, &folders)) {
         out << "Directory not found: "
-            << "/home/root/.local/share/remarkable/xochitl"
+            << xochitlBase()
             << "\n";
         return 1;
     }
+    MemoryReport memoryReport;
+    if (scanOpts.maxMemory > 0) {
+        memoryReport.stats  = &stats;
+        memoryReport.budget = scanOpts.maxMemory;
+    }
 
     // Ordinamento alfabetico per visibleName
-    auto byName = [](const DocEntry& a, const DocEntry& b) {
-        return QString::localeAwareCompare(a.visibleName, b.visibleName) < 0;
+    {
+        ProfileScope prof(ProfilePhase::Sort);
+        std::sort(pdfs.begin(),      pdfs.end(),      docLessByName);
+        std::sort(epubs.begin(),     epubs.end(),     docLessByName);
+        std::sort(notebooks.begin(), notebooks.end(), docLessByName);
+        std::sort(folders.begin(),   folders.end(),   docLessByName);
+    }
+
+    // Albero delle cartelle: percorsi e aggregati per --folder / --folders
+    FolderIndex folderIndex;
+    {
+        ProfileScope prof(ProfilePhase::FolderIndex);
+        folderIndex.build(folders, pdfs, epubs, notebooks);
+    }
+
+    int folderNode = FolderIndex::kRoot;
+    if (!folderArg.isEmpty()) {
+        QString error;
+        folderNode = folderIndex.resolve(folderArg, error);
+        if (folderNode < 0) {
+            out << "Error: " << error << "\n";
+            return 1;
+        }
+        exportFilter.byFolder = true;
+        exportFilter.folders = folderIndex.subtreeFolders(folderNode);
+    }
+
+    // Indice globale dei tag accanto ai summary (usato da --tag / --tag-prefix).
+    // Con --lazy i tag non sono stati letti: si tiene l'indice precedente.
+    if (stats.deferred == 0) {
+        ProfileScope prof(ProfilePhase::TagIndex);
+        if (!writeTagIndex(mirtilloShareBase() + "/tag_index.bin", pdfs, epubs, notebooks))
+            qCWarning(lcExport, "cannot write tag index");
+    }
+
+    if (profile) {
+        // Come --export-all: misura anche highlight, inchiostro ed estratti
+        loadHighlights(pdfs, epubs, notebooks, scanOpts.jobs);
+        loadInk(pdfs, epubs, notebooks, scanOpts.jobs);
+        loadExcerpts(epubs, scanOpts.jobs);
+        profileReport(out, profile == 2);
+        return 0;
+    }
+
+    if (exportAllMode) {
+        // Highlight, inchiostro ed estratti non fanno parte della scansione:
+        // servono al summary
+        loadHighlights(pdfs, epubs, notebooks, scanOpts.jobs);
+        loadInk(pdfs, epubs, notebooks, scanOpts.jobs);
+        loadExcerpts(epubs, scanOpts.jobs);
+        exportOpts.jobs = scanOpts.jobs;
+        const ExportStats es = exportAll(pdfs, epubs, notebooks, exportFilter, exportOpts);
+        out << "Exported " << es.written << " summary file(s) to " << mirtilloShareBase()
+            << " (" << es.upToDate << " up to date, " << es.failed << " failed, "
+            << es.selected << " selected).\n";
+        if (exportOpts.store)
+            out << "Store generation " << es.storeGeneration << " (" << es.storeChanged
+                << " change(s)).\n";
+        return es.failed == 0 ? 0 : 1;
+    }
+
+    if (tagStatsMode) {
+        if (format != OutputFormat::Text && format != OutputFormat::Json) {
+            out << "Error: --tag-stats supports --format text or json\n";
+            return 1;
+        }
+        std::vector<const DocEntry*> docs;
+        auto add = [&](const DocEntry& e) {
+            if (exportFilter.matches(e))
+                docs.push_back(&e);
+        };
+        if (exportFilter.byFolder) {
+            folderIndex.forEachDocument(folderNode, add);
+        } else {
+            for (const QList<DocEntry>* list : {&pdfs, &epubs, &notebooks})
+                for (const DocEntry& e : *list)
+                    add(e);
+        }
+
+        TagStats tagStats;
+        tagStats.build(docs, scanOpts.jobs);
+        if (format == OutputFormat::Text) {
+            printTagStats(tagStats, 20, out);
+            return 0;
+        }
+        OutputSink sink(STDOUT_FILENO);
+        writeTagStatsJson(tagStats, sink);
+        return sink.ok() ? 0 : 1;
+    }
+
+    if (foldersMode) {
+        if (format == OutputFormat::Text) {
+            printFolderTree(folderIndex, folderNode, out);
+            return 0;
+        }
+        OutputSink sink(STDOUT_FILENO);
+        RecordWriter w(sink, format, RecordWriter::Kind::Folders);
+        w.begin();
+        for (int n : folderIndex.subtreeNodes(folderNode))
+            w.folder(folderIndex, n);
+        w.end();
+        return sink.ok() ? 0 : 1;
+    }
+
+    if (format != OutputFormat::Text) {
+        // Indice della libreria (stessi filtri di --export-all) in streaming
+        OutputSink sink(STDOUT_FILENO);
+        RecordWriter w(sink, format, RecordWriter::Kind::Documents);
+        auto write = [&](const DocEntry& e) {
+            if (exportFilter.matches(e))
+                w.document(e);
+        };
+        w.begin();
+        if (exportFilter.byFolder) {
+            // Solo il sottoalbero: O(sottoalbero), cartella per cartella
+            folderIndex.forEachDocument(folderNode, write);
+        } else {
+            for (const QList<DocEntry>* list : {&pdfs, &epubs, &notebooks})
+                for (const DocEntry& e : *list)
+                    write(e);
+        }
+        w.end();
+        return sink.ok() ? 0 : 1;
+    }
+
+    if (watch || serve) {
+        // Combinabili: con --serve --watch il server risponde con le liste
+        // aggiornate dal watcher
+        std::unique_ptr<LibraryWatcher> watcher;
+        if (watch) {
+            watcher = std::make_unique<LibraryWatcher>(pdfs, epubs, notebooks, folders,
+                                                       scanOpts, out);
+            if (!watcher->start()) {
+                out << "Error: cannot watch " << xochitlBase() << "\n";
+                return 1;
+            }
+            out << "Watching " << xochitlBase() << " ("
+                << (pdfs.size() + epubs.size() + notebooks.size())
+                << " document(s)).\n";
+        }
+
+        std::unique_ptr<QueryServer> server;
+        if (serve) {
+            server = std::make_unique<QueryServer>(pdfs, epubs, notebooks, folders);
+            QString error;
+            if (!server->listen(socketPath, error)) {
+                out << "Error: " << error << "\n";
+                return 1;
+            }
+            out << "Serving " << (pdfs.size() + epubs.size() + notebooks.size())
+                << " document(s) on " << socketPath << ".\n";
+        }
+
+        if (watcher && server) {
+            QueryServer* s = server.get();
+            watcher->setChangeHandler([s]() { s->invalidate(); });
+        }
+
+        // Ctrl+C chiude il loop: i distruttori rimuovono il socket
+        quitOnTerminationSignals();
+        out << "Press Ctrl+C to stop.\n";
+        out.flush();
+        return app.exec();
+    }
+
+    // Dettagli caricati on-demand (solo --lazy), con limite di memoria
+    DetailsCache details;
+
+    // Nel menu le liste non cambiano: ognuna è renderizzata una volta sola
+    QHash<const QList<DocEntry>*, QString> rendered;
+
+    // Ricerca per titolo (/testo), indicizzata al primo uso
+    TitleSearch search;
+    const int kSearchResults = 20;
+
+    // Risultati di /testo (filtrati per tipo se `kind` non è vuoto) finché
+    // l'utente non sceglie un numero; nullptr = torna al menu
+    auto searchLoop = [&](QString query, const QString& kind) -> const DocEntry* {
+        if (!search.isBuilt())
+            search.build({&pdfs, &epubs, &notebooks});
+
+        while (true) {
+            const QList<TitleHit> hits = search.find(query, kSearchResults, kind);
+            if (hits.isEmpty()) {
+                out << "\nNo titles match \"" << query.trimmed() << "\".\n";
+            } else {
+                out << "\nBest matches for \"" << query.trimmed() << "\":\n\n";
+                for (int i = 0; i < hits.size(); ++i)
+                    out << QString("%1) ").arg(i+1, 3, 10, QChar(' '))
+                        << hits[i].doc->visibleName << "  [" << hits[i].doc->kind << "]\n";
+            }
+
+            if (!hits.isEmpty())
+                out << "\nSelect a number (1-" << hits.size() << "), ";
+            else
+                out << "\nType ";
+            out << "/text to search again, or 0 to go back to main menu: ";
+            out.flush();
+
+            const QString answer = in.readLine().trimmed();
+            if (answer.startsWith('/')) {
+                query = answer.mid(1);
+                continue;
+            }
+            bool ok = false;
+            const int sel = answer.toInt(&ok);
+            if (!ok || sel < 0 || sel > hits.size()) {
+                out << "Invalid selection.\n";
+                return nullptr;
+            }
+            return sel == 0 ? nullptr : hits[sel-1].doc;
+        }
     };
-    std::sort(pdfs.begin(),      pdfs.end(),      byName);
-    std::sort(epubs.begin(),     epubs.end(),     byName);
-    std::sort(notebooks.begin(), notebooks.end(), byName);
 
     // -----------------------------
     // Loop principale del menu
     // -----------------------------
     while (true) {
         // 1) Chiedi il tipo di documento
-        out << "\nDocument type to list? [p] PDF  [e] EPUB  [n] notebook  [q] quit: ";
+        out << "\nDocument type to list? [p] PDF  [e] EPUB  [n] notebook  [/text] search  [q] quit: ";
         out.flush();
 
         QString choice = in.readLine().trimmed().toLower();
@@ -108,74 +648,83 @@ int main(int argc, char *argv[])
             break;
         }
 
-        const QList<DocEntry>* list = nullptr;
-        QString kindLabel;
+        const DocEntry* chosen = nullptr;
 
-        if (choice == "p") {
-            list = &pdfs;
-            kindLabel = "PDF";
-        } else if (choice == "e") {
-            list = &epubs;
-            kindLabel = "EPUB";
-        } else if (choice == "n") {
-            list = &notebooks;
-            kindLabel = "notebook";
+        if (choice.startsWith('/')) {
+            // Ricerca su tutti i tipi
+            chosen = searchLoop(choice.mid(1), QString());
+            if (!chosen)
+                continue;
         } else {
-            out << "Unknown choice. Please use p/e/n/q.\n";
-            continue;
-        }
-
-        if (list->isEmpty()) {
-            out << "No " << kindLabel << " documents found.\n";
-            continue;
-        }
-
-        // 2) Stampa la lista in 2 colonne
-        auto printList = [&](const QList<DocEntry>& L) {
-            const int n = L.size();
-            const int colw = 48; // larghezza colonna
-            for (int i = 0; i < n; ) {
-                QString left = QString("%1) %2")
-                                   .arg(i+1, 3, 10, QChar(' '))
-                                   .arg(L[i].visibleName.left(colw-7));
-                QString right;
-                if (i+1 < n) {
-                    right = QString("%1) %2")
-                                .arg(i+2, 3, 10, QChar(' '))
-                                .arg(L[i+1].visibleName.left(colw-7));
-                }
-                out << left.leftJustified(colw) << "  " << right << "\n";
-                i += 2;
+            const QList<DocEntry>* list = nullptr;
+            QString kindLabel, kind;
+
+            if (choice == "p") {
+                list = &pdfs;
+                kindLabel = "PDF";
+                kind = "pdf";
+            } else if (choice == "e") {
+                list = &epubs;
+                kindLabel = "EPUB";
+                kind = "epub";
+            } else if (choice == "n") {
+                list = &notebooks;
+                kindLabel = "notebook";
+                kind = "notebook";
+            } else {
+                out << "Unknown choice. Please use p/e/n, /text or q.\n";
+                continue;
+            }
+
+            if (list->isEmpty()) {
+                out << "No " << kindLabel << " documents found.\n";
+                continue;
             }
-        };
 
-        out << "\nFound " << list->size() << " " << kindLabel << " document(s):\n\n";
-        printList(*list);
+            // 2) Stampa la lista in 2 colonne (dalla cache)
+            auto it = rendered.constFind(list);
+            if (it == rendered.cend())
+                it = rendered.insert(list, renderTwoColumns(*list));
 
-        // 3) Chiedi quale documento aprire
-        out << "\nSelect a number (1-" << list->size()
-            << ") or 0 to go back to main menu: ";
-        out.flush();
+            out << "\nFound " << list->size() << " " << kindLabel << " document(s):\n\n";
+            out << *it;
 
-        bool ok = false;
-        int sel = in.readLine().trimmed().toInt(&ok);
-        if (!ok || sel < 0 || sel > list->size()) {
-            out << "Invalid selection.\n";
-            continue;
-        }
-        if (sel == 0) {
-            // Torna al menu principale
-            continue;
+            // 3) Chiedi quale documento aprire (oppure /testo: ricerca in questo tipo)
+            out << "\nSelect a number (1-" << list->size()
+                << "), /text to search, or 0 to go back to main menu: ";
+            out.flush();
+
+            const QString answer = in.readLine().trimmed();
+            if (answer.startsWith('/')) {
+                chosen = searchLoop(answer.mid(1), kind);
+                if (!chosen)
+                    continue;
+            } else {
+                bool ok = false;
+                int sel = answer.toInt(&ok);
+                if (!ok || sel < 0 || sel > list->size()) {
+                    out << "Invalid selection.\n";
+                    continue;
+                }
+                if (sel == 0) {
+                    // Torna al menu principale
+                    continue;
+                }
+                chosen = &list->at(sel-1);
+            }
         }
 
-        const DocEntry& pick = list->at(sel-1);
+        DocEntry pick = details.resolve(*chosen);
+        loadDocumentHighlights(pick);
+        loadDocumentInk(pick);
+        loadDocumentExcerpts(pick);
 
         // 4) Mostra i dettagli del documento
         printDocumentSummary(pick, out);
 
         // 5) Chiedi cosa fare dopo: export / torna al menu / quit
         while (true) {
-            out << "\n[e] export  [m] main menu  [q] quit: ";
+            out << "\n[e] export  [p] export PDF  [m] main menu  [q] quit: ";
             out.flush();
             QString action = in.readLine().trimmed().toLower();
 
@@ -183,6 +732,9 @@ int main(int argc, char *argv[])
                 exportDocument(pick, out);
                 // dopo l'export torniamo al menu principale
                 break;
+            } else if (action == "p") {
+                exportDocumentPdf(pick, out);
+                break;
             } else if (action == "m" || action.isEmpty()) {
                 // torna al menu principale
                 break;
@@ -193,11 +745,16 @@ int main(int argc, char *argv[])
                         << " | missing .content: " << stats.contentMissing
                         << " | forced fileType: " << stats.forcedType
                         << " | deleted: " << stats.deleted
-                        << " | trash: " << stats.trash << "\n";
+                        << " | trash: " << stats.trash
+                        << " | cached: " << stats.cached
+                        << " | deferred: " << stats.deferred
+                        << " | folders: " << stats.folders
+                        << " | tag names: " << tagNames().size()
+                        << " | peak RSS: " << peakRssKiB() << " KiB\n";
                 }
                 return 0;
             } else {
-                out << "Unknown choice. Use e/m/q.\n";
+                out << "Unknown choice. Use e/p/m/q.\n";
             }
         }
     }
@@ -207,7 +764,12 @@ int main(int argc, char *argv[])
             << " | missing .content: " << stats.contentMissing
             << " | forced fileType: " << stats.forcedType
             << " | deleted: " << stats.deleted
-            << " | trash: " << stats.trash << "\n";
+            << " | trash: " << stats.trash
+            << " | cached: " << stats.cached
+            << " | deferred: " << stats.deferred
+            << " | folders: " << stats.folders
+            << " | tag names: " << tagNames().size()
+            << " | peak RSS: " << peakRssKiB() << " KiB\n";
     }
 
     return 0;
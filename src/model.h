@@ -3,23 +3,65 @@
 #include <QString>
 #include <QList>
 
-// Rappresenta un singolo tag su una pagina specifica
+#include "string_table.h"
+#include "uuid.h"
+
+// Rappresenta un singolo tag su una pagina specifica.
+// Layout compatto (24 byte, nessuna allocazione): il nome è un indice in
+// tagNames() e la pagina un UUID binario; le stringhe si ricostruiscono
+// solo per stampa/export (name(), pageId.toString()).
 struct TagRef {
-    QString name;        // Nome del tag (es. "Ippolito, Confut.")
-    QString pageId;      // UUID della pagina
+    quint32 nameId = 0;      // Nome del tag (es. "Ippolito, Confut.") in tagNames()
     int     pageNumber = -1; // Numero pagina (0-based); -1 se non disponibile
+    Uuid    pageId;          // UUID della pagina
+
+    QString name() const { return tagNames().at(nameId); }
+};
+
+// Un passaggio evidenziato (<uuid>.highlights/<pageId>.json)
+struct Highlight {
+    Uuid    pageId;
+    int     pageNumber = -1; // 0-based (buildPageMap); -1 se non disponibile
+    int     color  = 0;      // codice colore di xochitl
+    int     start  = -1;     // offset del testo nella pagina
+    int     length = 0;
+    QString text;
+};
+
+// Inchiostro di una pagina (<uuid>/<pageId>.rm, formato v6)
+struct PageInk {
+    Uuid    pageId;
+    int     pageNumber = -1; // 0-based (buildPageMap); -1 se non disponibile
+    quint32 strokes = 0;     // tratti visibili (gomme escluse)
+    quint64 points  = 0;
+    float   minX = 0, minY = 0, maxX = 0, maxY = 0; // bounding box (coordinate .rm)
+    qint64  mtimeMs = 0;     // ultima modifica del .rm
+};
+
+// Estratto di testo di una pagina taggata di un EPUB (vedi excerpts.h)
+struct Excerpt {
+    int     pageNumber = -1; // 0-based
+    QString text;
 };
 
 // Rappresenta un documento (PDF / EPUB / notebook) nella libreria reMarkable
 struct DocEntry {
     QString uuid;         // UUID del documento (basename dei file)
     QString visibleName;  // Titolo mostrato nell'interfaccia
-    QString parentUuid;   // "" = root / My Files; altrimenti UUID cartella
+    Uuid    parentUuid;   // nullo = root / My Files; altrimenti UUID cartella
     bool    hasParent = false;
-    QString kind;         // "pdf" | "epub" | "notebook"
+    QString kind;         // "pdf" | "epub" | "notebook" ("folder" solo nella lista cartelle)
     QList<TagRef> tags;   // Elenco dei tag per-pagina
     int     pages = 0;    // Placeholder per futuro conteggio pagine
     bool    hasTags = false;
+    bool    detailsLoaded = true; // false = tag/pagine non ancora letti (scansione lazy)
+    QList<Highlight> highlights;  // ordinati per pagina e offset (vedi highlights.h)
+    bool    highlightsLoaded = false;    // non fanno parte della scansione
+    bool    highlightsTruncated = false; // superato il tetto di memoria per documento
+    QList<PageInk> ink;           // solo pagine con tratti, ordinate (vedi ink.h)
+    bool    inkLoaded = false;    // come gli highlight: fuori dalla scansione
+    QList<Excerpt> excerpts;      // solo EPUB, pagine taggate in ordine
+    bool    excerptsLoaded = false;
 };
 
 // Statistiche di scansione (utili in modalità --debug)
@@ -29,4 +71,30 @@ struct ScanStats {
     int forcedType      = 0; // Quanti fileType determinati via fallback
     int trash           = 0; // Quanti elementi in "trash"
     int deleted         = 0; // Quanti marcati "deleted"
+    int cached          = 0; // Quanti documenti presi dalla cache incrementale
+    int deferred        = 0; // Quanti .content rimandati (scansione lazy)
+    int folders         = 0; // Quante cartelle (CollectionType)
+
+    // Solo con --max-memory (ScanOptions::maxMemory)
+    int    oversized      = 0; // .content oltre l'arena, letti da soli a fine scansione
+    int    arenas         = 0; // un'arena per worker
+    qint64 arenaCapacity  = 0; // byte per arena
+    qint64 arenaHighWater = 0; // massimo in uso in un'arena per un documento
+    qint64 arenaSpilled   = 0; // byte finiti sull'heap ad arena piena
+};
+
+// Esito della scansione di un singolo UUID
+enum class DocOutcome : quint8 {
+    Unreadable     = 0, // .metadata mancante o non valido
+    Deleted        = 1, // marcato "deleted"
+    Trash          = 2, // parent == "trash"
+    ContentMissing = 3, // .content mancante o non valido
+    Ok             = 4  // entry valida (smistata per kind)
+};
+
+// Risultato della scansione di un UUID: entry + contributo a ScanStats
+struct DocScan {
+    DocOutcome outcome    = DocOutcome::Unreadable;
+    bool       forcedType = false; // fileType dedotto via fallback sul FS
+    DocEntry   entry;              // valida solo se outcome == Ok
 };
\ No newline at end of file
@@ -0,0 +1,358 @@
+#include "output.h"
+
+#include <cerrno>
+
+#include <unistd.h>
+
+bool parseOutputFormat(const QString &name, OutputFormat &out)
+{
+    const QString n = name.trimmed().toLower();
+    if (n == "text")       out = OutputFormat::Text;
+    else if (n == "json")  out = OutputFormat::Json;
+    else if (n == "jsonl") out = OutputFormat::JsonLines;
+    else if (n == "csv")   out = OutputFormat::Csv;
+    else return false;
+    return true;
+}
+
+// -------------------------
+//  OutputSink
+// -------------------------
+OutputSink::OutputSink(int fd, qsizetype blockSize)
+    : m_fd(fd)
+    , m_blockSize(blockSize)
+{
+    m_buf.reserve(blockSize + 4096);
+}
+
+OutputSink::OutputSink(QByteArray &target, qsizetype blockSize)
+    : m_fd(-1)
+    , m_target(&target)
+    , m_blockSize(blockSize)
+{
+    m_buf.reserve(blockSize + 4096);
+}
+
+OutputSink::~OutputSink()
+{
+    flush();
+}
+
+bool OutputSink::flush()
+{
+    if (m_target) {
+        m_target->append(m_buf);
+        m_buf.resize(0);
+        return true;
+    }
+
+    const char *p = m_buf.constData();
+    qsizetype left = m_buf.size();
+    while (m_ok && left > 0) {
+        const ssize_t n = ::write(m_fd, p, size_t(left));
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            m_ok = false; // EPIPE & co.: il resto dell'output va perso
+            break;
+        }
+        p += n;
+        left -= n;
+    }
+    m_buf.resize(0); // mantiene la capacità
+    return m_ok;
+}
+
+void OutputSink::appendUtf8(QStringView s)
+{
+    const qsizetype n = s.size();
+    for (qsizetype i = 0; i < n; ++i) {
+        uint c = s.at(i).unicode();
+        if (c < 0x80) {
+            m_buf.append(char(c));
+            continue;
+        }
+        if (QChar::isHighSurrogate(c) && i + 1 < n && s.at(i + 1).isLowSurrogate()) {
+            c = QChar::surrogateToUcs4(char16_t(c), s.at(++i).unicode());
+        } else if (QChar::isSurrogate(c)) {
+            c = 0xFFFD; // surrogato spaiato: come QString::toUtf8()
+        }
+
+        if (c < 0x800) {
+            m_buf.append(char(0xC0 | (c >> 6)));
+        } else if (c < 0x10000) {
+            m_buf.append(char(0xE0 | (c >> 12)));
+            m_buf.append(char(0x80 | ((c >> 6) & 0x3F)));
+        } else {
+            m_buf.append(char(0xF0 | (c >> 18)));
+            m_buf.append(char(0x80 | ((c >> 12) & 0x3F)));
+            m_buf.append(char(0x80 | ((c >> 6) & 0x3F)));
+        }
+        m_buf.append(char(0x80 | (c & 0x3F)));
+    }
+    maybeFlush();
+}
+
+void OutputSink::appendJsonString(QStringView s)
+{
+    static const char hex[] = "0123456789abcdef";
+
+    m_buf.append('"');
+    qsizetype run = 0; // inizio del tratto senza escape
+    for (qsizetype i = 0; i < s.size(); ++i) {
+        const char16_t c = s.at(i).unicode();
+        if (c >= 0x20 && c != '"' && c != '\\')
+            continue;
+
+        appendUtf8(s.mid(run, i - run));
+        run = i + 1;
+        switch (c) {
+        case '"':  m_buf.append("\\\"", 2); break;
+        case '\\': m_buf.append("\\\\", 2); break;
+        case '\n': m_buf.append("\\n", 2);  break;
+        case '\r': m_buf.append("\\r", 2);  break;
+        case '\t': m_buf.append("\\t", 2);  break;
+        default: {
+            const char esc[6] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xF]};
+            m_buf.append(esc, 6);
+        }
+        }
+    }
+    appendUtf8(s.mid(run));
+    m_buf.append('"');
+    maybeFlush();
+}
+
+void OutputSink::appendCsvField(QStringView s)
+{
+    bool quote = false;
+    for (QChar c : s) {
+        if (c == QLatin1Char(',') || c == QLatin1Char('"') ||
+            c == QLatin1Char('\n') || c == QLatin1Char('\r')) {
+            quote = true;
+            break;
+        }
+    }
+    if (!quote) {
+        appendUtf8(s);
+        return;
+    }
+
+    m_buf.append('"');
+    qsizetype run = 0;
+    for (qsizetype i = 0; i < s.size(); ++i) {
+        if (s.at(i) != QLatin1Char('"'))
+            continue;
+        appendUtf8(s.mid(run, i + 1 - run)); // include la virgoletta...
+        m_buf.append('"');                    // ...e la raddoppia
+        run = i + 1;
+    }
+    appendUtf8(s.mid(run));
+    m_buf.append('"');
+    maybeFlush();
+}
+
+void OutputSink::appendNumber(qint64 n)
+{
+    char tmp[24];
+    char *p = tmp + sizeof(tmp);
+    const bool neg = n < 0;
+    quint64 v = neg ? quint64(0) - quint64(n) : quint64(n);
+    do {
+        *--p = char('0' + v % 10);
+        v /= 10;
+    } while (v);
+    if (neg)
+        *--p = '-';
+    append(p, tmp + sizeof(tmp) - p);
+}
+
+// -------------------------
+//  RecordWriter
+// -------------------------
+RecordWriter::RecordWriter(OutputSink &sink, OutputFormat format, Kind kind)
+    : m_sink(sink)
+    , m_format(format)
+    , m_kind(kind)
+{
+}
+
+void RecordWriter::begin()
+{
+    m_first = true;
+    if (m_format == OutputFormat::Json) {
+        m_sink.append("[");
+    } else if (m_format == OutputFormat::Csv) {
+        m_sink.append(m_kind == Kind::Documents
+                          ? "uuid,name,kind,parent,pages,tag,page,page_id\n"
+                          : m_kind == Kind::TagHits
+                          ? "tag,uuid,name,kind,page,page_id\n"
+                          : "uuid,path,documents,pdf,epub,notebook,folders,tagged_pages,tags\n");
+    }
+}
+
+void RecordWriter::end()
+{
+    if (m_format == OutputFormat::Json)
+        m_sink.append(m_first ? "]\n" : "\n]\n");
+    m_sink.flush();
+}
+
+void RecordWriter::separator()
+{
+    if (m_format == OutputFormat::Json)
+        m_sink.append(m_first ? "\n  " : ",\n  ");
+    m_first = false;
+}
+
+// Pagina 1-based come nel summary a video; null se sconosciuta
+void RecordWriter::jsonPage(int pageNumber)
+{
+    if (pageNumber >= 0)
+        m_sink.appendNumber(pageNumber + 1);
+    else
+        m_sink.append("null");
+}
+
+void RecordWriter::document(const DocEntry &doc)
+{
+    const QString parent = doc.parentUuid.toString();
+
+    if (m_format == OutputFormat::Csv) {
+        // Una riga per tag; i documenti senza tag hanno una riga sola
+        auto row = [&](const TagRef *t) {
+            m_sink.appendCsvField(doc.uuid);
+            m_sink.append(',');
+            m_sink.appendCsvField(doc.visibleName);
+            m_sink.append(',');
+            m_sink.appendCsvField(doc.kind);
+            m_sink.append(',');
+            m_sink.appendCsvField(parent);
+            m_sink.append(',');
+            m_sink.appendNumber(doc.pages);
+            m_sink.append(',');
+            if (t) {
+                m_sink.appendCsvField(t->name());
+                m_sink.append(',');
+                if (t->pageNumber >= 0)
+                    m_sink.appendNumber(t->pageNumber + 1);
+                m_sink.append(',');
+                m_sink.appendCsvField(t->pageId.toString());
+            } else {
+                m_sink.append(",,");
+            }
+            m_sink.append('\n');
+        };
+        if (doc.tags.isEmpty())
+            row(nullptr);
+        for (const TagRef &t : doc.tags)
+            row(&t);
+        return;
+    }
+
+    separator();
+    m_sink.append("{\"uuid\":");
+    m_sink.appendJsonString(doc.uuid);
+    m_sink.append(",\"name\":");
+    m_sink.appendJsonString(doc.visibleName);
+    m_sink.append(",\"kind\":");
+    m_sink.appendJsonString(doc.kind);
+    m_sink.append(",\"parent\":");
+    if (doc.hasParent)
+        m_sink.appendJsonString(parent);
+    else
+        m_sink.append("null");
+    m_sink.append(",\"pages\":");
+    m_sink.appendNumber(doc.pages);
+    m_sink.append(",\"tags\":[");
+    for (qsizetype i = 0; i < doc.tags.size(); ++i) {
+        const TagRef &t = doc.tags.at(i);
+        m_sink.append(i ? ",{\"name\":" : "{\"name\":");
+        m_sink.appendJsonString(t.name());
+        m_sink.append(",\"page\":");
+        jsonPage(t.pageNumber);
+        m_sink.append(",\"pageId\":");
+        m_sink.appendJsonString(t.pageId.toString());
+        m_sink.append('}');
+    }
+    m_sink.append("]}");
+    if (m_format == OutputFormat::JsonLines)
+        m_sink.append('\n');
+}
+
+void RecordWriter::tagHit(const TagHit &hit)
+{
+    if (m_format == OutputFormat::Csv) {
+        m_sink.appendCsvField(hit.tag);
+        m_sink.append(',');
+        m_sink.appendCsvField(hit.docUuid);
+        m_sink.append(',');
+        m_sink.appendCsvField(hit.docTitle);
+        m_sink.append(',');
+        m_sink.appendCsvField(hit.docKind);
+        m_sink.append(',');
+        if (hit.pageNumber >= 0)
+            m_sink.appendNumber(hit.pageNumber + 1);
+        m_sink.append(',');
+        m_sink.appendCsvField(hit.pageId);
+        m_sink.append('\n');
+        return;
+    }
+
+    separator();
+    m_sink.append("{\"tag\":");
+    m_sink.appendJsonString(hit.tag);
+    m_sink.append(",\"uuid\":");
+    m_sink.appendJsonString(hit.docUuid);
+    m_sink.append(",\"name\":");
+    m_sink.appendJsonString(hit.docTitle);
+    m_sink.append(",\"kind\":");
+    m_sink.appendJsonString(hit.docKind);
+    m_sink.append(",\"page\":");
+    jsonPage(hit.pageNumber);
+    m_sink.append(",\"pageId\":");
+    m_sink.appendJsonString(hit.pageId);
+    m_sink.append('}');
+    if (m_format == OutputFormat::JsonLines)
+        m_sink.append('\n');
+}
+
+void RecordWriter::folder(const FolderIndex &index, int node)
+{
+    const FolderStats &st = index.subtree(node);
+    const bool isRoot = (node == FolderIndex::kRoot);
+    const qint64 counts[] = {st.documents(), st.pdfs, st.epubs, st.notebooks, st.folders,
+                             st.taggedPages, qint64(st.tags.size())};
+
+    if (m_format == OutputFormat::Csv) {
+        if (!isRoot)
+            m_sink.appendCsvField(index.uuid(node).toString());
+        m_sink.append(',');
+        m_sink.appendCsvField(index.path(node));
+        for (qint64 c : counts) {
+            m_sink.append(',');
+            m_sink.appendNumber(c);
+        }
+        m_sink.append('\n');
+        return;
+    }
+
+    static const char *const keys[] = {",\"documents\":", ",\"pdf\":", ",\"epub\":",
+                                       ",\"notebook\":", ",\"folders\":",
+                                       ",\"taggedPages\":", ",\"tags\":"};
+    separator();
+    m_sink.append("{\"uuid\":");
+    if (isRoot)
+        m_sink.append("null");
+    else
+        m_sink.appendJsonString(index.uuid(node).toString());
+    m_sink.append(",\"path\":");
+    m_sink.appendJsonString(index.path(node));
+    for (int i = 0; i < 7; ++i) {
+        m_sink.append(keys[i]);
+        m_sink.appendNumber(counts[i]);
+    }
+    m_sink.append('}');
+    if (m_format == OutputFormat::JsonLines)
+        m_sink.append('\n');
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+#include <QStringView>
+
+#include "folder_index.h"
+#include "model.h"
+#include "tag_index.h"
+
+// Formati di output non interattivi (--format)
+enum class OutputFormat {
+    Text,      // layout leggibile (default, menu interattivo)
+    Json,      // un array JSON di record
+    JsonLines, // un oggetto JSON per riga
+    Csv        // una riga per (documento, tag), con intestazione
+};
+
+// "text" | "json" | "jsonl" | "csv"
+bool parseOutputFormat(const QString &name, OutputFormat &out);
+
+// Scrittura bufferizzata su file descriptor: i dati vengono accumulati e
+// scritti a blocchi grandi; la memoria usata non dipende dalla quantità
+// di output.
+class OutputSink
+{
+public:
+    explicit OutputSink(int fd, qsizetype blockSize = 64 * 1024);
+    // Variante in memoria: i blocchi vengono accodati a `target` (risposte
+    // di --serve, che ne antepongono la lunghezza)
+    explicit OutputSink(QByteArray &target, qsizetype blockSize = 64 * 1024);
+    ~OutputSink();
+
+    OutputSink(const OutputSink &) = delete;
+    OutputSink &operator=(const OutputSink &) = delete;
+
+    void append(char c) { m_buf.append(c); maybeFlush(); }
+    void append(const char *s, qsizetype n) { m_buf.append(s, n); maybeFlush(); }
+    void append(const char *s) { m_buf.append(s); maybeFlush(); }
+
+    // Stringa UTF-16 → UTF-8 direttamente nel buffer (niente temporanei)
+    void appendUtf8(QStringView s);
+    // Stringa JSON tra virgolette, con escape
+    void appendJsonString(QStringView s);
+    // Campo CSV (RFC 4180: virgolettato solo se serve)
+    void appendCsvField(QStringView s);
+    void appendNumber(qint64 n);
+
+    bool flush();
+    // false se una write() è fallita (es. pipe chiusa)
+    bool ok() const { return m_ok; }
+
+private:
+    void maybeFlush()
+    {
+        if (m_buf.size() >= m_blockSize)
+            flush();
+    }
+
+    int         m_fd;
+    QByteArray *m_target = nullptr;
+    qsizetype   m_blockSize;
+    QByteArray  m_buf;
+    bool        m_ok = true;
+};
+
+// Emette record (documenti o hit dell'indice dei tag) uno alla volta nel
+// formato scelto, senza costruire un DOM o l'intero output in memoria.
+class RecordWriter
+{
+public:
+    enum class Kind { Documents, TagHits, Folders };
+
+    RecordWriter(OutputSink &sink, OutputFormat format, Kind kind);
+
+    void begin(); // "[" per JSON, intestazione per CSV
+    void document(const DocEntry &doc);
+    void tagHit(const TagHit &hit);
+    // Cartella con gli aggregati del suo sottoalbero
+    void folder(const FolderIndex &index, int node);
+    void end();   // "]" per JSON + flush
+
+private:
+    void separator();
+    void jsonPage(int pageNumber);
+
+    OutputSink  &m_sink;
+    OutputFormat m_format;
+    Kind         m_kind;
+    bool         m_first = true;
+};
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <QThread>
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// Numero effettivo di worker: 0 = tutti i core, mai più degli elementi
+inline int effectiveJobs(int jobs, int items)
+{
+    if (jobs <= 0)
+        jobs = QThread::idealThreadCount();
+    return std::max(1, std::min(jobs, items));
+}
+
+// Esegue fn(i) per ogni i in [0, n) su `jobs` thread (0 = auto).
+// I worker prelevano blocchi di indici da un contatore atomico, così un
+// documento lento non blocca una partizione statica. fn deve scrivere
+// solo nel proprio slot i: l'ordine dei risultati resta quello di input.
+template <typename Fn>
+void parallelFor(int n, int jobs, Fn &&fn)
+{
+    if (n <= 0)
+        return;
+
+    const int workers = effectiveJobs(jobs, n);
+    if (workers == 1) {
+        for (int i = 0; i < n; ++i)
+            fn(i);
+        return;
+    }
+
+    const int chunk = std::clamp(n / (workers * 16), 1, 64);
+    std::atomic<int> next{0};
+
+    auto run = [&]() {
+        for (;;) {
+            const int begin = next.fetch_add(chunk, std::memory_order_relaxed);
+            if (begin >= n)
+                return;
+            const int end = std::min(n, begin + chunk);
+            for (int i = begin; i < end; ++i)
+                fn(i);
+        }
+    };
+
+    std::vector<std::thread> pool;
+    pool.reserve(workers - 1);
+    for (int w = 1; w < workers; ++w)
+        pool.emplace_back(run);
+    run(); // anche il thread chiamante lavora
+    for (std::thread &t : pool)
+        t.join();
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <QString>
+#include <QtGlobal>
+
+// I percorsi sono letti una volta sola (al primo uso) e possono essere
+// sostituiti da variabili d'ambiente: utile in VM e per i benchmark
+// (tools/mirtillo_bench) che lavorano su librerie sintetiche.
+//
+// setXochitlBase() / setMirtilloShareBase() li cambiano a runtime (più
+// librerie nello stesso processo, mirtillo_bench --check): vanno chiamate
+// quando nessun worker è attivo, perché le letture non sono protette.
+
+namespace paths_detail {
+
+inline QString &xochitlRoot()
+{
+    static QString base = qEnvironmentVariableIsSet("MIRTILLO_XOCHITL_DIR")
+        ? qEnvironmentVariable("MIRTILLO_XOCHITL_DIR")
+        : QStringLiteral("/home/root/.local/share/remarkable/xochitl");
+    return base;
+}
+
+inline QString &shareRoot()
+{
+    static QString base = qEnvironmentVariableIsSet("MIRTILLO_SHARE_DIR")
+        ? qEnvironmentVariable("MIRTILLO_SHARE_DIR")
+        : QStringLiteral("/home/root/.local/share/mirtillo");
+    return base;
+}
+
+} // namespace paths_detail
+
+// Directory base dei documenti reMarkable (override: MIRTILLO_XOCHITL_DIR)
+inline QString xochitlBase()
+{
+    return paths_detail::xochitlRoot();
+}
+
+// Directory dei file di mirtillo sul Paper Pro (ABOUT, summary, indici)
+// (override: MIRTILLO_SHARE_DIR)
+inline QString mirtilloShareBase()
+{
+    return paths_detail::shareRoot();
+}
+
+inline void setXochitlBase(const QString &dir)
+{
+    paths_detail::xochitlRoot() = dir;
+}
+
+inline void setMirtilloShareBase(const QString &dir)
+{
+    paths_detail::shareRoot() = dir;
+}
@@ -0,0 +1,454 @@
+#include "pdf_summary.h"
+#include "pdf_writer.h"
+#include "paths.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QSet>
+#include <QStringList>
+#include <QtEndian>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include <unistd.h>
+
+namespace {
+
+// A4 in punti, margini e interlinea del testo (Helvetica 10 pt)
+const int kPageWidth  = 595;
+const int kPageHeight = 842;
+const int kMargin     = 50;
+const int kLeading    = 14;
+// Caratteri per riga a 10 pt: la larghezza media di Helvetica è ~0,5 em
+const int kWrapChars  = 90;
+
+// Griglia delle miniature
+const int kThumbColumns = 3;
+const int kThumbRows    = 3;
+const int kCaption      = 16;
+// Tetto dei pixel inflati per le miniature con alpha (le altre non si inflano)
+const qsizetype kMaxInflated = 16 * 1024 * 1024;
+
+QByteArray num(double v)
+{
+    return QByteArray::number(v, 'f', 2);
+}
+
+QByteArray ref(int obj)
+{
+    return QByteArray::number(obj) + " 0 R";
+}
+
+QString pageLabel(int pageNumber)
+{
+    return pageNumber >= 0 ? QString::number(pageNumber + 1) : QStringLiteral("?");
+}
+
+// Scrive una pagina: contenuto + oggetto pagina, annotato in `kids`
+void writePage(PdfWriter &w, int parent, const QByteArray &resources,
+               const QByteArray &content, std::vector<int> &kids)
+{
+    const int contentObj = w.reserve();
+    w.addStream(contentObj, QByteArray(), content);
+
+    const int pageObj = w.reserve();
+    w.beginObject(pageObj);
+    w.write("<< /Type /Page /Parent " + ref(parent) +
+            " /MediaBox [0 0 " + QByteArray::number(kPageWidth) + " " +
+            QByteArray::number(kPageHeight) + "] /Resources << " + resources +
+            " >> /Contents " + ref(contentObj) + " >>");
+    w.endObject();
+    kids.push_back(pageObj);
+}
+
+// -------------------------
+//  Pagine di testo
+// -------------------------
+class TextPages
+{
+public:
+    TextPages(PdfWriter &w, int parent, const QByteArray &fonts, std::vector<int> &kids)
+        : m_w(w), m_parent(parent), m_fonts(fonts), m_kids(kids) {}
+
+    void line(const QString &s, bool bold = false, int size = 10, int indent = 0)
+    {
+        const int height = qMax(kLeading, size + 4);
+        if (m_y - height < kMargin)
+            endPage();
+        m_y -= height;
+        m_content += "BT /" + QByteArray(bold ? "F2 " : "F1 ") + QByteArray::number(size) +
+                     " Tf " + QByteArray::number(kMargin + indent) + " " +
+                     QByteArray::number(m_y) + " Td " + PdfWriter::text(s) + " Tj ET\n";
+    }
+
+    // A capo sugli spazi; le parole più lunghe della riga vengono spezzate
+    void wrapped(const QString &s, int indent = 0)
+    {
+        const int width = qMax(20, kWrapChars - indent / 5);
+        QString rest = s;
+        while (rest.size() > width) {
+            int cut = int(rest.lastIndexOf(QLatin1Char(' '), width));
+            if (cut <= 0)
+                cut = width;
+            line(rest.left(cut), false, 10, indent);
+            rest = rest.mid(cut).trimmed();
+        }
+        if (!rest.isEmpty())
+            line(rest, false, 10, indent);
+    }
+
+    void gap(int pts) { m_y -= pts; }
+
+    void endPage()
+    {
+        if (!m_content.isEmpty())
+            writePage(m_w, m_parent, m_fonts, m_content, m_kids);
+        m_content.clear();
+        m_y = kPageHeight - kMargin;
+    }
+
+private:
+    PdfWriter        &m_w;
+    int               m_parent;
+    QByteArray        m_fonts;
+    std::vector<int> &m_kids;
+    QByteArray        m_content;
+    int               m_y = kPageHeight - kMargin;
+};
+
+// -------------------------
+//  Miniature PNG
+// -------------------------
+struct PngImage {
+    quint32    width  = 0;
+    quint32    height = 0;
+    int        depth  = 0;
+    int        colorType = 0;
+    bool       interlaced = false;
+    QByteArray palette;                         // PLTE (tipo 3)
+    std::vector<PdfWriter::FileRange> idat;     // dati dei chunk IDAT nel file
+};
+
+// Legge solo le intestazioni dei chunk (pread): i dati restano nel file
+bool readPng(int fd, PngImage &img)
+{
+    static const uchar kSignature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    uchar head[33]; // firma + IHDR completo
+    if (::pread(fd, head, sizeof head, 0) != qint64(sizeof head) ||
+        std::memcmp(head, kSignature, 8) != 0 ||
+        qFromBigEndian<quint32>(head + 8) != 13 || std::memcmp(head + 12, "IHDR", 4) != 0)
+        return false;
+
+    img.width      = qFromBigEndian<quint32>(head + 16);
+    img.height     = qFromBigEndian<quint32>(head + 20);
+    img.depth      = head[24];
+    img.colorType  = head[25];
+    img.interlaced = head[28] != 0;
+    if (head[26] != 0 || head[27] != 0) // compressione / filtri sconosciuti
+        return false;
+
+    qint64 pos = sizeof head;
+    for (;;) {
+        uchar chunk[8];
+        if (::pread(fd, chunk, sizeof chunk, pos) != qint64(sizeof chunk))
+            return false;
+        const quint32 length = qFromBigEndian<quint32>(chunk);
+        const qint64 data = pos + 8;
+        if (std::memcmp(chunk + 4, "IDAT", 4) == 0) {
+            img.idat.push_back(PdfWriter::FileRange{data, qint64(length)});
+        } else if (std::memcmp(chunk + 4, "PLTE", 4) == 0) {
+            if (length > 768 || length % 3 != 0)
+                return false;
+            img.palette.resize(qsizetype(length));
+            if (::pread(fd, img.palette.data(), length, data) != qint64(length))
+                return false;
+        } else if (std::memcmp(chunk + 4, "IEND", 4) == 0) {
+            break;
+        }
+        pos = data + qint64(length) + 4; // CRC
+    }
+    return img.width > 0 && img.height > 0 && !img.idat.empty();
+}
+
+// Canali di colore (senza alpha) per tipo PNG; 0 = combinazione non gestita
+int colorChannels(const PngImage &img)
+{
+    const int d = img.depth;
+    switch (img.colorType) {
+    case 0: return (d == 1 || d == 2 || d == 4 || d == 8 || d == 16) ? 1 : 0;
+    case 2: return (d == 8 || d == 16) ? 3 : 0;
+    case 3: return (d == 1 || d == 2 || d == 4 || d == 8) && !img.palette.isEmpty() ? 1 : 0;
+    case 4: return (d == 8 || d == 16) ? 1 : 0;
+    case 6: return (d == 8 || d == 16) ? 3 : 0;
+    default: return 0;
+    }
+}
+
+QByteArray imageDict(const PngImage &img, int colors, const QByteArray &colorSpace)
+{
+    const QByteArray w = QByteArray::number(img.width);
+    const QByteArray bpc = QByteArray::number(img.depth);
+    return "/Type /XObject /Subtype /Image /Width " + w +
+           " /Height " + QByteArray::number(img.height) +
+           " /ColorSpace " + colorSpace + " /BitsPerComponent " + bpc +
+           " /Filter /FlateDecode /DecodeParms << /Predictor 15 /Colors " +
+           QByteArray::number(colors) + " /BitsPerComponent " + bpc +
+           " /Columns " + w + " >>";
+}
+
+// zlib senza l'intestazione di 4 byte di qCompress
+QByteArray deflate(const QByteArray &data)
+{
+    return qCompress(data).mid(4);
+}
+
+// Scrive la miniatura come XObject; 0 se il file non è utilizzabile
+int embedPng(PdfWriter &w, const QString &path, PngImage &img)
+{
+    QFile f(path);
+    if (!f.open(QIODevice::ReadOnly))
+        return 0;
+    const int fd = f.handle();
+    if (!readPng(fd, img) || img.interlaced)
+        return 0;
+    const int colors = colorChannels(img);
+    if (colors == 0)
+        return 0;
+
+    QByteArray colorSpace = colors == 3 ? "/DeviceRGB" : "/DeviceGray";
+    if (img.colorType == 3) {
+        colorSpace = "[/Indexed /DeviceRGB " +
+                     QByteArray::number(img.palette.size() / 3 - 1) + " <" +
+                     img.palette.toHex() + ">]";
+    }
+
+    const int obj = w.reserve();
+    if (img.colorType != 4 && img.colorType != 6) {
+        // Caso normale: gli IDAT vanno nel PDF così come sono
+        w.addFileStream(obj, imageDict(img, colors, colorSpace), fd, img.idat);
+        return obj;
+    }
+
+    // Con alpha: si inflano le righe ancora filtrate e si separano i canali.
+    // Ogni filtro PNG combina un byte solo con lo stesso byte del pixel a
+    // sinistra / della riga sopra, cioè con lo stesso canale: le due metà
+    // restano righe filtrate valide, da ricomprimere senza decodificarle.
+    QByteArray compressed;
+    for (const PdfWriter::FileRange &r : img.idat) {
+        const qsizetype at = compressed.size();
+        compressed.resize(at + qsizetype(r.length));
+        if (::pread(fd, compressed.data() + at, size_t(r.length), r.offset) != r.length)
+            return 0;
+    }
+    const int sample = img.depth / 8;
+    const qsizetype colorBytes = qsizetype(colors) * sample;
+    const qsizetype pixelBytes = colorBytes + sample;
+    const qsizetype rowBytes = 1 + qsizetype(img.width) * pixelBytes;
+    const qsizetype expected = rowBytes * qsizetype(img.height);
+    if (expected > kMaxInflated)
+        return 0;
+
+    char size[4];
+    qToBigEndian<quint32>(quint32(expected), size);
+    const QByteArray raw = qUncompress(QByteArray(size, 4) + compressed);
+    if (raw.size() != expected)
+        return 0;
+
+    QByteArray color, alpha;
+    color.reserve(qsizetype(img.height) * (1 + qsizetype(img.width) * colorBytes));
+    alpha.reserve(qsizetype(img.height) * (1 + qsizetype(img.width) * sample));
+    for (quint32 y = 0; y < img.height; ++y) {
+        const char *row = raw.constData() + qsizetype(y) * rowBytes;
+        color.append(row[0]); // tipo di filtro della riga
+        alpha.append(row[0]);
+        for (quint32 x = 0; x < img.width; ++x) {
+            const char *px = row + 1 + qsizetype(x) * pixelBytes;
+            color.append(px, colorBytes);
+            alpha.append(px + colorBytes, sample);
+        }
+    }
+
+    const int mask = w.reserve();
+    w.addStream(mask, imageDict(img, 1, "/DeviceGray"), deflate(alpha));
+    w.addStream(obj, imageDict(img, colors, colorSpace) + " /SMask " + ref(mask), deflate(color));
+    return obj;
+}
+
+} // namespace
+
+QString summaryPdfPath(const QString &uuid)
+{
+    return QDir(mirtilloShareBase()).filePath(QStringLiteral("summary_%1.pdf").arg(uuid));
+}
+
+bool writeSummaryPdf(const DocEntry &doc, QString &error)
+{
+    QDir dir(mirtilloShareBase());
+    if (!dir.exists() && !dir.mkpath(".")) {
+        error = "cannot create directory: " + mirtilloShareBase();
+        return false;
+    }
+
+    PdfWriter w(summaryPdfPath(doc.uuid));
+    if (!w.open(error))
+        return false;
+
+    const int catalog = w.reserve();
+    const int pages   = w.reserve();
+    const int regular = w.reserve();
+    const int bold    = w.reserve();
+    for (const auto &font : {qMakePair(regular, QByteArray("Helvetica")),
+                             qMakePair(bold, QByteArray("Helvetica-Bold"))}) {
+        w.beginObject(font.first);
+        w.write("<< /Type /Font /Subtype /Type1 /BaseFont /" + font.second +
+                " /Encoding /WinAnsiEncoding >>");
+        w.endObject();
+    }
+    const QByteArray fonts = "/Font << /F1 " + ref(regular) + " /F2 " + ref(bold) + " >>";
+
+    std::vector<int> kids;
+    TextPages text(w, pages, fonts, kids);
+
+    // 1) Intestazione, come il summary di testo
+    text.line(doc.visibleName, true, 16);
+    text.gap(6);
+    text.line("UUID: " + doc.uuid);
+    text.line("Type: " + doc.kind);
+    text.line("Pages: " + (doc.pages > 0 ? QString::number(doc.pages) : QStringLiteral("(unknown)")));
+    text.line("Tag count: " + QString::number(doc.tags.size()));
+
+    // 2) Tag per nome (nome, poi pagina) con l'elenco delle pagine a capo
+    std::vector<const TagRef *> byName;
+    byName.reserve(size_t(doc.tags.size()));
+    for (const TagRef &t : doc.tags)
+        byName.push_back(&t);
+    std::stable_sort(byName.begin(), byName.end(), [](const TagRef *a, const TagRef *b) {
+        if (a->nameId != b->nameId) {
+            const int c = QString::compare(a->name(), b->name());
+            if (c != 0)
+                return c < 0;
+        }
+        return uint(a->pageNumber) < uint(b->pageNumber);
+    });
+
+    text.gap(8);
+    text.line("Tags by name", true, 12);
+    if (byName.empty())
+        text.line("(none)", false, 10, 12);
+    for (size_t i = 0; i < byName.size();) {
+        const quint32 id = byName[i]->nameId;
+        QStringList pagesOf;
+        for (; i < byName.size() && byName[i]->nameId == id; ++i)
+            pagesOf << pageLabel(byName[i]->pageNumber);
+        text.line(QLatin1Char('"') + tagNames().at(id) + QLatin1Char('"'), true, 10, 12);
+        text.wrapped((pagesOf.size() == 1 ? "Page " : "Pages ") + pagesOf.join(", "), 24);
+    }
+
+    // 3) Highlight, estratti e note a mano, se caricati
+    if (doc.highlightsLoaded && !doc.highlights.isEmpty()) {
+        text.gap(8);
+        text.line("Highlights (" + QString::number(doc.highlights.size()) +
+                  (doc.highlightsTruncated ? ", truncated)" : ")"), true, 12);
+        for (const Highlight &h : doc.highlights)
+            text.wrapped("Page " + pageLabel(h.pageNumber) + ": “" + h.text + "”", 12);
+    }
+    if (doc.excerptsLoaded && !doc.excerpts.isEmpty()) {
+        text.gap(8);
+        text.line("Excerpts (" + QString::number(doc.excerpts.size()) + ")", true, 12);
+        for (const Excerpt &x : doc.excerpts)
+            text.wrapped("Page " + pageLabel(x.pageNumber) + ": “" + x.text + "”", 12);
+    }
+    if (doc.inkLoaded && !doc.ink.isEmpty()) {
+        text.gap(8);
+        text.line("Handwritten notes", true, 12);
+        for (const PageInk &p : doc.ink)
+            text.line("Notes present on page " + pageLabel(p.pageNumber) + " (" +
+                      QString::number(p.strokes) + " strokes, modified " +
+                      QDateTime::fromMSecsSinceEpoch(p.mtimeMs).toString("yyyy-MM-dd HH:mm") + ")",
+                      false, 10, 12);
+    }
+    text.endPage();
+
+    // 4) Miniature delle pagine taggate (una volta per pagina, in ordine)
+    const QString thumbDir = xochitlBase() + "/" + doc.uuid + ".thumbnails";
+    const QStringList pngs = QDir(thumbDir).entryList(QStringList() << "*.png", QDir::Files);
+    if (!pngs.isEmpty() && !doc.tags.isEmpty()) {
+        const QSet<QString> available(pngs.cbegin(), pngs.cend());
+
+        std::vector<const TagRef *> byPage(byName);
+        std::stable_sort(byPage.begin(), byPage.end(), [](const TagRef *a, const TagRef *b) {
+            return uint(a->pageNumber) < uint(b->pageNumber);
+        });
+
+        const double cellW = double(kPageWidth - 2 * kMargin) / kThumbColumns;
+        const double cellH = double(kPageHeight - 2 * kMargin - 30) / kThumbRows;
+        QByteArray content, xobjects;
+        int slot = 0;
+        auto flushGrid = [&]() {
+            if (slot == 0)
+                return;
+            const QByteArray heading = "BT /F2 12 Tf " + QByteArray::number(kMargin) + " " +
+                                       QByteArray::number(kPageHeight - kMargin - 12) + " Td " +
+                                       PdfWriter::text("Thumbnails") + " Tj ET\n";
+            writePage(w, pages, fonts + " /XObject << " + xobjects + ">>", heading + content, kids);
+            content.clear();
+            xobjects.clear();
+            slot = 0;
+        };
+
+        Uuid last;
+        for (const TagRef *t : byPage) {
+            if (t->pageId == last)
+                continue;
+            last = t->pageId;
+            const QString file = t->pageId.toString() + ".png";
+            if (!available.contains(file))
+                continue;
+
+            PngImage img;
+            const int obj = embedPng(w, thumbDir + "/" + file, img);
+            if (!obj)
+                continue;
+
+            const int col = slot % kThumbColumns, row = slot / kThumbColumns;
+            const double scale = qMin((cellW - 10) / img.width, (cellH - kCaption - 10) / img.height);
+            const double dw = img.width * scale, dh = img.height * scale;
+            const double x = kMargin + col * cellW + (cellW - dw) / 2;
+            const double top = kPageHeight - kMargin - 30 - row * cellH;
+            const double y = top - 5 - dh;
+            const QByteArray name = "/Im" + QByteArray::number(slot);
+            xobjects += name + " " + ref(obj) + " ";
+            content += "q " + num(dw) + " 0 0 " + num(dh) + " " + num(x) + " " + num(y) +
+                       " cm " + name + " Do Q\n";
+            content += "BT /F1 9 Tf " + num(kMargin + col * cellW + 5) + " " +
+                       num(y - kCaption + 4) + " Td " +
+                       PdfWriter::text("Page " + pageLabel(t->pageNumber)) + " Tj ET\n";
+
+            if (++slot == kThumbColumns * kThumbRows)
+                flushGrid();
+        }
+        flushGrid();
+    }
+
+    // 5) Albero delle pagine, catalogo, info
+    w.beginObject(pages);
+    w.write("<< /Type /Pages /Count " + QByteArray::number(qsizetype(kids.size())) + " /Kids [");
+    for (int k : kids)
+        w.write(ref(k) + " ");
+    w.write("] >>");
+    w.endObject();
+
+    w.beginObject(catalog);
+    w.write("<< /Type /Catalog /Pages " + ref(pages) + " >>");
+    w.endObject();
+
+    const int info = w.reserve();
+    w.beginObject(info);
+    w.write("<< /Title " + PdfWriter::text(doc.visibleName) + " /Producer (mirtillo) >>");
+    w.endObject();
+
+    return w.finish(catalog, info, error);
+}
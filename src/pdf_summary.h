@@ -0,0 +1,25 @@
+#pragma once
+
+#include <QString>
+
+#include "model.h"
+
+// Summary in PDF (summary_<uuid>.pdf): stesse sezioni del summary di testo
+// (tag per nome con le pagine, highlight, note a mano) più le miniature
+// delle pagine taggate, 3×3 per pagina.
+//
+// Le miniature <uuid>.thumbnails/<pageId>.png non vengono decodificate: i
+// chunk IDAT sono già uno stream zlib con i filtri PNG per riga, che il PDF
+// legge con /FlateDecode e /Predictor 15. I loro byte passano dal file PNG
+// al PDF con sendfile. Solo i PNG con canale alpha vanno inflati per
+// separare l'alpha in una /SMask (i filtri PNG lavorano per canale, quindi
+// niente decodifica dei pixel); gli interlacciati vengono saltati.
+//
+// Il file è scritto oggetto per oggetto (PdfWriter): in memoria resta solo
+// la pagina corrente.
+
+// Percorso del summary PDF di un documento
+QString summaryPdfPath(const QString &uuid);
+
+// Scrive summary_<uuid>.pdf in modo atomico. false + error in caso di errore
+bool writeSummaryPdf(const DocEntry &doc, QString &error);
@@ -0,0 +1,195 @@
+#include "pdf_writer.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#include <sys/sendfile.h>
+#include <unistd.h>
+
+// Il buffer si svuota quando supera questa soglia
+static const qsizetype kBufferSize = 64 * 1024;
+
+PdfWriter::PdfWriter(const QString &path)
+    : m_file(path)
+{
+    m_offsets.push_back(0); // l'oggetto 0 è la testa della free list
+}
+
+bool PdfWriter::open(QString &error)
+{
+    // Senza buffer di QFileDevice: il buffer è m_buf, e sendfile scrive
+    // direttamente sul descrittore dopo flush()
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Unbuffered)) {
+        error = "cannot write " + m_file.fileName();
+        m_ok = false;
+        return false;
+    }
+    m_buf.reserve(kBufferSize + 4096);
+    // Il commento binario segnala ai programmi di trasferimento che il file non è testo
+    write("%PDF-1.4\n%\xE2\xE3\xCF\xD3\n");
+    return true;
+}
+
+int PdfWriter::reserve()
+{
+    m_offsets.push_back(0);
+    return int(m_offsets.size() - 1);
+}
+
+void PdfWriter::write(const QByteArray &data)
+{
+    m_buf.append(data);
+    m_pos += data.size();
+    if (m_buf.size() >= kBufferSize)
+        flush();
+}
+
+void PdfWriter::write(const char *data)
+{
+    write(QByteArray::fromRawData(data, qsizetype(std::strlen(data))));
+}
+
+void PdfWriter::flush()
+{
+    if (m_buf.isEmpty())
+        return;
+    if (m_ok && m_file.write(m_buf) != m_buf.size())
+        m_ok = false;
+    m_buf.resize(0);
+}
+
+void PdfWriter::beginObject(int num)
+{
+    m_offsets[size_t(num)] = m_pos;
+    write(QByteArray::number(num) + " 0 obj\n");
+}
+
+void PdfWriter::endObject()
+{
+    write("\nendobj\n");
+}
+
+void PdfWriter::addStream(int num, const QByteArray &dict, const QByteArray &data)
+{
+    beginObject(num);
+    write("<< " + dict + " /Length " + QByteArray::number(data.size()) + " >>\nstream\n");
+    write(data);
+    write("\nendstream");
+    endObject();
+}
+
+void PdfWriter::addFileStream(int num, const QByteArray &dict, int fd,
+                              const std::vector<FileRange> &ranges)
+{
+    qint64 length = 0;
+    for (const FileRange &r : ranges)
+        length += r.length;
+
+    beginObject(num);
+    write("<< " + dict + " /Length " + QByteArray::number(length) + " >>\nstream\n");
+    flush(); // i byte del file vanno dopo quelli in buffer
+    for (const FileRange &r : ranges)
+        copyRange(fd, r.offset, r.length);
+    m_pos += length;
+    write("\nendstream");
+    endObject();
+}
+
+void PdfWriter::copyRange(int fd, qint64 offset, qint64 length)
+{
+    const int out = m_file.handle();
+    off_t pos = off_t(offset);
+    qint64 left = length;
+
+    while (m_ok && m_sendfile && left > 0) {
+        const ssize_t n = ::sendfile(out, fd, &pos, size_t(left));
+        if (n > 0) {
+            left -= n;
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n < 0 && (errno == EINVAL || errno == ENOSYS) && left == length) {
+            m_sendfile = false; // FS senza supporto: si ripiega su pread
+        } else {
+            m_ok = false; // errore o file accorciato nel frattempo
+        }
+    }
+
+    char chunk[16 * 1024];
+    while (m_ok && left > 0) {
+        const ssize_t n = ::pread(fd, chunk, size_t(qMin<qint64>(left, sizeof chunk)), pos);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0 || m_file.write(chunk, n) != n) {
+            m_ok = false;
+            break;
+        }
+        pos += n;
+        left -= n;
+    }
+}
+
+bool PdfWriter::finish(int catalog, int info, QString &error)
+{
+    const qint64 xref = m_pos;
+    write("xref\n0 " + QByteArray::number(qsizetype(m_offsets.size())) + "\n");
+    write("0000000000 65535 f \n");
+    char entry[21];
+    for (size_t i = 1; i < m_offsets.size(); ++i) {
+        // Oggetti riservati e mai scritti: voce libera, il file resta valido
+        if (m_offsets[i] > 0)
+            std::snprintf(entry, sizeof entry, "%010lld 00000 n \n", (long long)m_offsets[i]);
+        else
+            std::snprintf(entry, sizeof entry, "0000000000 00001 f \n");
+        write(QByteArray(entry, 20));
+    }
+
+    QByteArray trailer = "trailer\n<< /Size " + QByteArray::number(qsizetype(m_offsets.size())) +
+                         " /Root " + QByteArray::number(catalog) + " 0 R";
+    if (info > 0)
+        trailer += " /Info " + QByteArray::number(info) + " 0 R";
+    trailer += " >>\nstartxref\n" + QByteArray::number(xref) + "\n%%EOF\n";
+    write(trailer);
+    flush();
+
+    if (!m_ok || !m_file.commit()) {
+        m_file.cancelWriting();
+        error = "cannot write " + m_file.fileName();
+        m_ok = false;
+        return false;
+    }
+    return true;
+}
+
+QByteArray PdfWriter::text(const QString &s)
+{
+    QByteArray out;
+    out.reserve(s.size() + 2);
+    out.append('(');
+    for (QChar qc : s) {
+        const char16_t c = qc.unicode();
+        char b;
+        if ((c >= 0x20 && c < 0x7F) || (c >= 0xA0 && c <= 0xFF)) {
+            b = char(c);
+        } else {
+            // WinAnsiEncoding 0x80-0x9F: solo i segni che usiamo davvero
+            switch (c) {
+            case 0x20AC: b = char(0x80); break; // €
+            case 0x2026: b = char(0x85); break; // …
+            case 0x2018: b = char(0x91); break;
+            case 0x2019: b = char(0x92); break;
+            case 0x201C: b = char(0x93); break;
+            case 0x201D: b = char(0x94); break;
+            case 0x2022: b = char(0x95); break; // •
+            case 0x2013: b = char(0x96); break; // –
+            case 0x2014: b = char(0x97); break; // —
+            default:     b = '?';        break;
+            }
+        }
+        if (b == '(' || b == ')' || b == '\\')
+            out.append('\\');
+        out.append(b);
+    }
+    out.append(')');
+    return out;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <QByteArray>
+#include <QSaveFile>
+#include <QString>
+
+#include <vector>
+
+// Scrittore PDF 1.4 in streaming: ogni oggetto va su disco appena
+// completato, la tabella xref (un offset per oggetto) si scrive in fondo.
+// La memoria non dipende dalla dimensione del documento: un buffer di
+// uscita fisso più 8 byte per oggetto.
+//
+// I numeri di oggetto si allocano con reserve(), anche prima di scrivere
+// l'oggetto (riferimenti in avanti, es. /Parent delle pagine). Il file è
+// scritto in modo atomico (QSaveFile): finish() lo sostituisce solo se
+// tutto è andato a buon fine.
+class PdfWriter
+{
+public:
+    // Porzione di un file da copiare in uno stream (offset, lunghezza)
+    struct FileRange {
+        qint64 offset = 0;
+        qint64 length = 0;
+    };
+
+    explicit PdfWriter(const QString &path);
+
+    bool open(QString &error);
+    bool ok() const { return m_ok; }
+
+    int reserve();
+
+    // Oggetto generico: begin, contenuto con write(), end
+    void beginObject(int num);
+    void endObject();
+    void write(const QByteArray &data);
+    void write(const char *data);
+
+    // Stream con i dati in memoria; `dict` senza /Length né << >>
+    void addStream(int num, const QByteArray &dict, const QByteArray &data);
+
+    // Stream i cui byte vengono da porzioni del file `fd`: copiati
+    // nel kernel (sendfile) senza passare dallo spazio utente
+    void addFileStream(int num, const QByteArray &dict, int fd,
+                       const std::vector<FileRange> &ranges);
+
+    // xref + trailer (/Root catalog, /Info opzionale) e commit
+    bool finish(int catalog, int info, QString &error);
+
+    // Stringa letterale PDF: (testo) in WinAnsi, con escape;
+    // i caratteri non rappresentabili diventano '?'
+    static QByteArray text(const QString &s);
+
+private:
+    void flush();
+    void copyRange(int fd, qint64 offset, qint64 length);
+
+    QSaveFile           m_file;
+    QByteArray          m_buf;
+    qint64              m_pos = 0;   // byte già scritti + buffer
+    std::vector<qint64> m_offsets;   // per numero di oggetto (0 = libero)
+    bool                m_ok = true;
+    bool                m_sendfile = true; // false dopo EINVAL/ENOSYS
+};
@@ -0,0 +1,62 @@
+#include "prefetch.h"
+
+#include <QFile>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+Prefetcher::Prefetcher(const QString &dir, const QStringList &uuids,
+                       const QStringList &suffixes, int window)
+    : m_dir(dir)
+    , m_uuids(uuids)
+    , m_suffixes(suffixes)
+    , m_window(window > 0 ? window : 1)
+{
+    if (!m_uuids.isEmpty())
+        m_thread = std::thread([this]() { run(); });
+}
+
+Prefetcher::~Prefetcher()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_stop = true;
+    }
+    m_wake.notify_one();
+    if (m_thread.joinable())
+        m_thread.join();
+}
+
+void Prefetcher::completed()
+{
+    // Sveglia il thread solo quando si libera mezza finestra: niente
+    // notify per ogni documento
+    const int done = m_completed.fetch_add(1, std::memory_order_relaxed) + 1;
+    if (done % qMax(1, m_window / 2) == 0)
+        m_wake.notify_one();
+}
+
+void Prefetcher::run()
+{
+    const int n = int(m_uuids.size());
+    for (int next = 0; next < n; ++next) {
+        {
+            // completed() notifica senza lock: il timeout copre una sveglia persa
+            std::unique_lock<std::mutex> lock(m_lock);
+            while (!m_stop && next >= m_completed.load(std::memory_order_relaxed) + m_window)
+                m_wake.wait_for(lock, std::chrono::milliseconds(5));
+            if (m_stop)
+                return;
+        }
+
+        const QString base = m_dir + "/" + m_uuids.at(next);
+        for (const QString &suffix : m_suffixes) {
+            const int fd = ::open(QFile::encodeName(base + suffix).constData(),
+                                  O_RDONLY | O_CLOEXEC);
+            if (fd < 0)
+                continue; // file mancante: lo segnalerà il worker
+            ::posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+            ::close(fd);
+        }
+    }
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <QStringList>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// Prefetch dei file da leggere durante la scansione.
+// Un thread dedicato scorre la lista in anticipo rispetto ai worker e chiede
+// al kernel di caricarli in page cache (posix_fadvise WILLNEED, che avvia
+// il readahead in modo asincrono). Quando un worker apre o mappa il file
+// i dati sono già in RAM, o almeno in arrivo: l'I/O dei file successivi si
+// sovrappone al parsing di quelli precedenti e la coda del dispositivo
+// resta piena anche con pochi worker.
+class Prefetcher
+{
+public:
+    // Elemento i = dir/uuids[i] + ognuno dei suffissi (es. ".metadata").
+    // Gli elementi vengono sollecitati fino a `window` oltre quelli già
+    // completati dai worker; il thread parte subito.
+    Prefetcher(const QString &dir, const QStringList &uuids,
+               const QStringList &suffixes, int window);
+    ~Prefetcher();
+
+    Prefetcher(const Prefetcher &) = delete;
+    Prefetcher &operator=(const Prefetcher &) = delete;
+
+    // Un worker ha finito un elemento: la finestra avanza di uno
+    void completed();
+
+private:
+    void run();
+
+    const QString     m_dir;
+    const QStringList m_uuids;
+    const QStringList m_suffixes;
+    const int         m_window;
+    std::atomic<int>  m_completed{0};
+    bool              m_stop = false; // protetto da m_lock
+    std::mutex              m_lock;
+    std::condition_variable m_wake;
+    std::thread             m_thread;
+};
@@ -0,0 +1,205 @@
+#include "profile.h"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+namespace detail {
+std::atomic<bool> g_profileEnabled{false};
+}
+
+// Istogramma dei tempi per documento: bucket a potenze di 2 in µs,
+// l'ultimo raccoglie tutto ciò che supera 2^(kBuckets-2) µs (~65 ms)
+static const int kBuckets = 18;
+// Quanti documenti lenti tenere
+static const int kSlowest = 10;
+
+static const char *const kPhaseNames[int(ProfilePhase::Count)] = {
+    "scan_total", "list_dir", "cache_load", "stat", "metadata_json",
+    "content_json", "page_map", "tag_dedup", "merge", "cache_save",
+    "sort", "tag_index", "folder_index", "highlights", "ink",
+    "excerpts",
+};
+
+static const char *const kBytesNames[int(ProfileBytes::Count)] = {
+    "metadata", "content", "highlights", "ink", "excerpts",
+};
+
+namespace {
+
+struct Counters {
+    std::atomic<qint64> phaseNs[int(ProfilePhase::Count)] = {};
+    std::atomic<qint64> phaseCalls[int(ProfilePhase::Count)] = {};
+    std::atomic<qint64> bytes[int(ProfileBytes::Count)] = {};
+    std::atomic<qint64> files[int(ProfileBytes::Count)] = {};
+    std::atomic<qint64> histogram[kBuckets] = {};
+
+    // (ns, uuid) dei documenti più lenti: min-heap di kSlowest elementi
+    QMutex slowLock;
+    std::vector<std::pair<qint64, QString>> slowest;
+};
+
+Counters &counters()
+{
+    static Counters c;
+    return c;
+}
+
+int bucketFor(qint64 ns)
+{
+    qint64 us = ns / 1000;
+    int b = 0;
+    while (us > 0 && b < kBuckets - 1) {
+        us >>= 1;
+        ++b;
+    }
+    return b;
+}
+
+} // namespace
+
+void profileEnable()
+{
+    counters(); // costruita qui, prima dei worker
+    detail::g_profileEnabled.store(true, std::memory_order_relaxed);
+}
+
+void profileAdd(ProfilePhase phase, qint64 ns)
+{
+    Counters &c = counters();
+    c.phaseNs[int(phase)].fetch_add(ns, std::memory_order_relaxed);
+    c.phaseCalls[int(phase)].fetch_add(1, std::memory_order_relaxed);
+}
+
+void profileAddBytes(ProfileBytes kind, qint64 bytes)
+{
+    if (!profileEnabled())
+        return;
+    Counters &c = counters();
+    c.bytes[int(kind)].fetch_add(bytes, std::memory_order_relaxed);
+    c.files[int(kind)].fetch_add(1, std::memory_order_relaxed);
+}
+
+void profileDocument(const QString &uuid, qint64 ns)
+{
+    Counters &c = counters();
+    c.histogram[bucketFor(ns)].fetch_add(1, std::memory_order_relaxed);
+
+    auto greater = [](const std::pair<qint64, QString> &a,
+                      const std::pair<qint64, QString> &b) { return a.first > b.first; };
+
+    QMutexLocker lock(&c.slowLock);
+    if (int(c.slowest.size()) < kSlowest) {
+        c.slowest.emplace_back(ns, uuid);
+        std::push_heap(c.slowest.begin(), c.slowest.end(), greater);
+    } else if (ns > c.slowest.front().first) {
+        std::pop_heap(c.slowest.begin(), c.slowest.end(), greater);
+        c.slowest.back() = std::make_pair(ns, uuid);
+        std::push_heap(c.slowest.begin(), c.slowest.end(), greater);
+    }
+}
+
+// Limite superiore (µs) del bucket b; -1 = illimitato
+static qint64 bucketLimitUs(int b)
+{
+    return b == kBuckets - 1 ? -1 : (qint64(1) << b);
+}
+
+void profileReport(QTextStream &out, bool json)
+{
+    Counters &c = counters();
+
+    std::vector<std::pair<qint64, QString>> slowest;
+    {
+        QMutexLocker lock(&c.slowLock);
+        slowest = c.slowest;
+    }
+    std::sort(slowest.begin(), slowest.end(),
+              [](const auto &a, const auto &b) { return a.first > b.first; });
+
+    if (json) {
+        QJsonArray phases;
+        for (int i = 0; i < int(ProfilePhase::Count); ++i) {
+            QJsonObject p;
+            p["phase"]    = kPhaseNames[i];
+            p["calls"]    = double(c.phaseCalls[i].load());
+            p["total_ms"] = double(c.phaseNs[i].load()) / 1e6;
+            phases.append(p);
+        }
+
+        QJsonObject bytes;
+        for (int i = 0; i < int(ProfileBytes::Count); ++i)
+            bytes[kBytesNames[i]] = QJsonObject{{"files", double(c.files[i].load())},
+                                                {"bytes", double(c.bytes[i].load())}};
+
+        QJsonArray histogram;
+        for (int b = 0; b < kBuckets; ++b) {
+            QJsonObject h;
+            h["le_us"] = double(bucketLimitUs(b));
+            h["count"] = double(c.histogram[b].load());
+            histogram.append(h);
+        }
+
+        QJsonArray slow;
+        for (const auto &s : slowest)
+            slow.append(QJsonObject{{"uuid", s.second}, {"ms", double(s.first) / 1e6}});
+
+        QJsonObject root;
+        root["phases"]          = phases;
+        root["bytes_read"]      = bytes;
+        root["document_us_histogram"] = histogram;
+        root["slowest"]         = slow;
+        out << QJsonDocument(root).toJson(QJsonDocument::Indented);
+        out.flush();
+        return;
+    }
+
+    out << "=== Profile ==============================================\n";
+    out << QString("%1 %2 %3 %4\n")
+               .arg(QLatin1String("phase"), -16)
+               .arg(QLatin1String("calls"), 9)
+               .arg(QLatin1String("total ms"), 12)
+               .arg(QLatin1String("avg us"), 12);
+    for (int i = 0; i < int(ProfilePhase::Count); ++i) {
+        const qint64 calls = c.phaseCalls[i].load();
+        const qint64 ns    = c.phaseNs[i].load();
+        out << QString("%1 %2 %3 %4\n")
+                   .arg(QLatin1String(kPhaseNames[i]), -16)
+                   .arg(calls, 9)
+                   .arg(double(ns) / 1e6, 12, 'f', 2)
+                   .arg(calls ? double(ns) / 1e3 / double(calls) : 0.0, 12, 'f', 1);
+    }
+    out << "(worker phases are summed over all threads)\n\n";
+
+    out << "Bytes read:\n";
+    for (int i = 0; i < int(ProfileBytes::Count); ++i)
+        out << "  " << QString(QLatin1String(kBytesNames[i])).leftJustified(10)
+            << c.files[i].load() << " file(s), "
+            << (c.bytes[i].load() / 1024) << " KiB\n";
+
+    out << "\nParsed documents by scan time:\n";
+    for (int b = 0; b < kBuckets; ++b) {
+        const qint64 n = c.histogram[b].load();
+        if (n == 0)
+            continue;
+        const qint64 limit = bucketLimitUs(b);
+        const QString label = limit < 0
+            ? QString("> %1 us").arg(qint64(1) << (kBuckets - 2))
+            : QString("<= %1 us").arg(limit);
+        out << "  " << label.leftJustified(14) << n << "\n";
+    }
+
+    out << "\nSlowest documents:\n";
+    if (slowest.empty())
+        out << "  (none parsed: all from cache)\n";
+    for (const auto &s : slowest)
+        out << "  " << QString::number(double(s.first) / 1e6, 'f', 2).rightJustified(9)
+            << " ms  " << s.second << "\n";
+    out << "==========================================================\n";
+    out.flush();
+}
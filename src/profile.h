@@ -0,0 +1,102 @@
+#pragma once
+
+#include <QString>
+#include <QTextStream>
+
+#include <atomic>
+#include <chrono>
+
+// Profilazione della scansione (--profile). Disattivata per default: ogni
+// punto di misura costa solo la lettura di un flag; i contatori sono
+// atomici perché la scansione gira su più worker.
+
+// Fasi misurate. I tempi delle fasi eseguite dai worker sono sommati su
+// tutti i thread (tempo di lavoro, non tempo reale)
+enum class ProfilePhase : int {
+    ScanTotal,     // scanDocuments completo (tempo reale)
+    ListDir,       // entryList dei *.metadata
+    CacheLoad,     // lettura scan_cache.bin
+    Stat,          // stat() di .metadata/.content (impronte della cache)
+    MetadataJson,  // lettura + parsing .metadata
+    ContentJson,   // lettura + parsing .content (mmap, streaming)
+    PageMap,       // buildPageMap
+    TagDedup,      // costruzione TagRef + deduplica
+    Merge,         // merge seriale dei risultati
+    CacheSave,     // scrittura scan_cache.bin
+    Sort,          // ordinamento delle liste
+    TagIndex,      // scrittura tag_index.bin
+    FolderIndex,   // albero delle cartelle + aggregati
+    Highlights,    // lettura + parsing <uuid>.highlights/*.json
+    Ink,           // lettura + parsing <uuid>/*.rm
+    Excerpts,      // layout + estratti di <uuid>.epub
+    Count
+};
+
+// Byte letti dal disco per tipo di file
+enum class ProfileBytes : int {
+    Metadata,   // loadJsonObject (in scansione solo i .metadata)
+    Content,    // loadContentInfo
+    Highlights, // <uuid>.highlights/*.json
+    Ink,        // <uuid>/*.rm
+    Excerpts,   // voci di <uuid>.epub (compresse)
+    Count
+};
+
+namespace detail {
+extern std::atomic<bool> g_profileEnabled;
+}
+
+inline bool profileEnabled()
+{
+    return detail::g_profileEnabled.load(std::memory_order_relaxed);
+}
+
+void profileEnable();
+
+// Orologio monotono in ns (per misure che non stanno in un solo blocco)
+inline qint64 profileNow()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void profileAdd(ProfilePhase phase, qint64 ns);
+void profileAddBytes(ProfileBytes kind, qint64 bytes);
+// Tempo totale di scansione di un documento riletto da disco
+// (istogramma + i più lenti)
+void profileDocument(const QString &uuid, qint64 ns);
+
+// Stampa il report: tabella leggibile o JSON (json = true)
+void profileReport(QTextStream &out, bool json);
+
+// Timer RAII: misura il blocco solo se la profilazione è attiva
+class ProfileScope
+{
+public:
+    explicit ProfileScope(ProfilePhase phase)
+        : m_phase(phase), m_active(profileEnabled())
+    {
+        if (m_active)
+            m_start = std::chrono::steady_clock::now();
+    }
+
+    ~ProfileScope()
+    {
+        if (m_active)
+            profileAdd(m_phase, elapsedNs());
+    }
+
+    ProfileScope(const ProfileScope &) = delete;
+    ProfileScope &operator=(const ProfileScope &) = delete;
+
+    qint64 elapsedNs() const
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now() - m_start).count();
+    }
+
+private:
+    ProfilePhase m_phase;
+    bool         m_active;
+    std::chrono::steady_clock::time_point m_start;
+};
@@ -0,0 +1,237 @@
+#include "scan_cache.h"
+
+#include <QByteArray>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QSet>
+
+#include <sys/stat.h>
+
+// Header dell'indice: magic "MRTC" + versione del formato.
+// Cambiare kCacheVersion a ogni modifica del layout: i file vecchi
+// vengono scartati e ricostruiti.
+static const quint32 kCacheMagic   = 0x4D525443; // 'MRTC'
+static const quint32 kCacheVersion = 2; // 2: cartelle con kind "folder"
+
+FileStamp stampFile(const QString &path)
+{
+    FileStamp s;
+    struct stat st;
+    if (::stat(QFile::encodeName(path).constData(), &st) != 0)
+        return s; // size = -1 → assente
+
+    s.mtimeNs = qint64(st.st_mtim.tv_sec) * 1000000000LL + st.st_mtim.tv_nsec;
+    s.size    = qint64(st.st_size);
+    s.inode   = quint64(st.st_ino);
+    return s;
+}
+
+// -------------------------
+//  Serializzazione
+// -------------------------
+static void writeStamp(QDataStream &s, const FileStamp &st)
+{
+    s << st.mtimeNs << st.size << st.inode;
+}
+
+static void readStamp(QDataStream &s, FileStamp &st)
+{
+    s >> st.mtimeNs >> st.size >> st.inode;
+}
+
+static void writeEntry(QDataStream &s, const QString &uuid, const ScanCache::Entry &e)
+{
+    s << uuid;
+    writeStamp(s, e.meta);
+    writeStamp(s, e.content);
+    s << quint8(e.scan.outcome) << e.scan.forcedType;
+
+    if (e.scan.outcome != DocOutcome::Ok)
+        return;
+
+    const DocEntry &d = e.scan.entry;
+    // Su disco le stringhe: gli indici di tagNames() valgono solo nel processo
+    s << d.visibleName << d.parentUuid.toString() << d.hasParent << d.kind
+      << qint32(d.pages) << d.hasTags << quint32(d.tags.size());
+    for (const TagRef &t : d.tags)
+        s << t.name() << t.pageId.toString() << qint32(t.pageNumber);
+}
+
+static bool readEntry(QDataStream &s, QString &uuid, ScanCache::Entry &e)
+{
+    quint8 outcome = 0;
+    s >> uuid;
+    readStamp(s, e.meta);
+    readStamp(s, e.content);
+    s >> outcome >> e.scan.forcedType;
+
+    if (s.status() != QDataStream::Ok || outcome > quint8(DocOutcome::Ok))
+        return false;
+    e.scan.outcome = DocOutcome(outcome);
+
+    if (e.scan.outcome != DocOutcome::Ok)
+        return true;
+
+    DocEntry &d = e.scan.entry;
+    QString parent;
+    qint32 pages = 0;
+    quint32 tagCount = 0;
+    s >> d.visibleName >> parent >> d.hasParent >> d.kind
+      >> pages >> d.hasTags >> tagCount;
+    if (s.status() != QDataStream::Ok)
+        return false;
+
+    d.uuid       = uuid;
+    d.parentUuid = Uuid::fromString(parent);
+    d.pages      = pages;
+    // niente reserve(tagCount): un conteggio corrotto non deve allocare GB
+    for (quint32 i = 0; i < tagCount; ++i) {
+        QString name, pageId;
+        qint32 pageNumber = -1;
+        s >> name >> pageId >> pageNumber;
+        if (s.status() != QDataStream::Ok)
+            return false;
+
+        TagRef t;
+        t.nameId     = tagNames().intern(name);
+        t.pageId     = Uuid::fromString(pageId);
+        t.pageNumber = pageNumber;
+        d.tags.append(t);
+    }
+    return true;
+}
+
+// -------------------------
+//  ScanCache
+// -------------------------
+ScanCache::ScanCache(const QString &path)
+    : m_path(path)
+{
+}
+
+bool ScanCache::load()
+{
+    m_entries.clear();
+    m_dirty   = true; // finché non carichiamo un indice valido va riscritto
+    m_corrupt = false;
+
+    QFile f(m_path);
+    if (!f.open(QIODevice::ReadOnly))
+        return false; // prima esecuzione: nessuna cache
+
+    QDataStream in(&f);
+    in.setVersion(QDataStream::Qt_6_0);
+
+    quint32 magic = 0, version = 0;
+    QByteArray payload, digest;
+    in >> magic >> version;
+    if (in.status() != QDataStream::Ok || magic != kCacheMagic || version != kCacheVersion) {
+        // formato vecchio o file estraneo: si ricostruisce
+        m_corrupt = (magic != kCacheMagic);
+        return false;
+    }
+
+    in >> payload >> digest;
+    if (in.status() != QDataStream::Ok ||
+        digest != QCryptographicHash::hash(payload, QCryptographicHash::Md5)) {
+        m_corrupt = true;
+        return false;
+    }
+
+    QDataStream ps(payload);
+    ps.setVersion(QDataStream::Qt_6_0);
+
+    quint32 count = 0;
+    ps >> count;
+    for (quint32 i = 0; i < count; ++i) {
+        QString uuid;
+        Entry e;
+        if (!readEntry(ps, uuid, e)) {
+            m_entries.clear();
+            m_corrupt = true;
+            return false;
+        }
+        m_entries.insert(uuid, e);
+    }
+
+    if (ps.status() != QDataStream::Ok || !ps.atEnd()) {
+        m_entries.clear();
+        m_corrupt = true;
+        return false;
+    }
+
+    m_dirty = false;
+    return true;
+}
+
+bool ScanCache::save()
+{
+    if (!m_dirty)
+        return true;
+
+    const QFileInfo fi(m_path);
+    if (!QDir().mkpath(fi.absolutePath()))
+        return false;
+
+    QByteArray payload;
+    {
+        QDataStream ps(&payload, QIODevice::WriteOnly);
+        ps.setVersion(QDataStream::Qt_6_0);
+        ps << quint32(m_entries.size());
+        for (auto it = m_entries.cbegin(); it != m_entries.cend(); ++it)
+            writeEntry(ps, it.key(), it.value());
+    }
+
+    // QSaveFile: scrive su file temporaneo e poi rename → mai un indice a metà
+    QSaveFile f(m_path);
+    if (!f.open(QIODevice::WriteOnly))
+        return false;
+
+    QDataStream out(&f);
+    out.setVersion(QDataStream::Qt_6_0);
+    out << kCacheMagic << kCacheVersion << payload
+        << QCryptographicHash::hash(payload, QCryptographicHash::Md5);
+
+    if (out.status() != QDataStream::Ok || !f.commit())
+        return false;
+
+    m_dirty = false;
+    return true;
+}
+
+const ScanCache::Entry *ScanCache::lookup(const QString &uuid,
+                                          const FileStamp &meta,
+                                          const FileStamp &content) const
+{
+    const auto it = m_entries.constFind(uuid);
+    if (it == m_entries.cend())
+        return nullptr;
+
+    if (it->meta != meta || it->content != content)
+        return nullptr;
+
+    return &it.value();
+}
+
+void ScanCache::insert(const QString &uuid, const Entry &e)
+{
+    m_entries.insert(uuid, e);
+    m_dirty = true;
+}
+
+void ScanCache::retainOnly(const QStringList &uuids)
+{
+    const QSet<QString> keep(uuids.cbegin(), uuids.cend());
+    for (auto it = m_entries.begin(); it != m_entries.end(); ) {
+        if (!keep.contains(it.key())) {
+            it = m_entries.erase(it);
+            m_dirty = true;
+        } else {
+            ++it;
+        }
+    }
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include "model.h"
+
+// Impronta di un file sul FS: se cambia, il file va riletto
+struct FileStamp {
+    qint64  mtimeNs = 0;  // mtime in nanosecondi
+    qint64  size    = -1; // -1 = file assente
+    quint64 inode   = 0;
+
+    bool operator==(const FileStamp &o) const
+    {
+        return mtimeNs == o.mtimeNs && size == o.size && inode == o.inode;
+    }
+    bool operator!=(const FileStamp &o) const { return !(*this == o); }
+};
+
+// Legge mtime/size/inode con un solo stat(); size = -1 se il file non esiste
+FileStamp stampFile(const QString &path);
+
+// Indice binario persistente dei risultati di scansione per UUID.
+// Ogni voce è valida solo finché .metadata e .content hanno la stessa impronta.
+class ScanCache
+{
+public:
+    struct Entry {
+        FileStamp meta;
+        FileStamp content;
+        DocScan   scan;
+    };
+
+    explicit ScanCache(const QString &path);
+
+    // Carica l'indice da disco. Se manca, ha versione diversa o è corrotto
+    // la cache resta vuota (verrà ricostruita al salvataggio).
+    bool load();
+
+    // Scrive l'indice in modo atomico (solo se qualcosa è cambiato)
+    bool save();
+
+    // Voce valida per uuid se le impronte coincidono, altrimenti nullptr
+    const Entry *lookup(const QString &uuid,
+                        const FileStamp &meta,
+                        const FileStamp &content) const;
+
+    // Registra il risultato della scansione corrente
+    void insert(const QString &uuid, const Entry &e);
+
+    // Elimina le voci dei documenti non più presenti (non viste in questo giro)
+    void retainOnly(const QStringList &uuids);
+
+    const QString &path() const { return m_path; }
+    bool wasCorrupt() const { return m_corrupt; }
+
+private:
+    QString m_path;
+    QHash<QString, Entry> m_entries;
+    bool m_dirty   = false;
+    bool m_corrupt = false;
+};
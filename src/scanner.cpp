@@ -1,145 +1,608 @@
 #include "scanner.h"
 
+#include "arena.h"
 #include "json_utils.h"
+#include "logging.h"
+#include "parallel.h"
+#include "paths.h"
+#include "prefetch.h"
+#include "profile.h"
+#include "scan_cache.h"
 
 #include <QDir>
 #include <QFileInfo>
 #include <QStringList>
 #include <QJsonObject>
-#include <QJsonArray>
 #include <QJsonValue>
+#include <QSet>
+#include <QtGlobal>
 
-// Directory base dei documenti reMarkable
-static const QString kBase =
-    QStringLiteral("/home/root/.local/share/remarkable/xochitl");
+#include <memory>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// --max-memory: quota del budget per le arene dei worker (il resto va alle
+// liste, alla scan cache e al runtime Qt) e limiti di una singola arena
+static const qint64 kArenaShare = 4; // 1/4 del budget
+static const qint64 kMinArena   = 64 * 1024;
+static const qint64 kMaxArena   = 8 * 1024 * 1024;
+
+// Fallback di emergenza: deduci il tipo dal file presente sul FS.
+// `sources` (nomi dei .pdf/.epub dal listing della directory) evita due
+// stat() per documento durante la scansione completa.
+static QString probeFileType(const QString& root, const QString& uuid,
+                             const QSet<QString>* sources = nullptr)
+{
+    if (sources) {
+        if (sources->contains(uuid + ".pdf"))
+            return QStringLiteral("pdf");
+        if (sources->contains(uuid + ".epub"))
+            return QStringLiteral("epub");
+        return QStringLiteral("notebook");
+    }
+
+    const QString pdfPath  = root + "/" + uuid + ".pdf";
+    const QString epubPath = root + "/" + uuid + ".epub";
+    if (QFileInfo::exists(pdfPath))
+        return QStringLiteral("pdf");
+    if (QFileInfo::exists(epubPath))
+        return QStringLiteral("epub");
+    return QStringLiteral("notebook");
+}
+
+// Tag, page map e pageCount dal .content (la parte costosa della scansione)
+static void fillDetails(DocEntry& e, const ContentInfo& content)
+{
+    // Mappa pageId → numero pagina
+    QHash<QString,int> pageMap;
+    {
+        ProfileScope prof(ProfilePhase::PageMap);
+        pageMap = buildPageMap(content);
+    }
+
+    ProfileScope prof(ProfilePhase::TagDedup);
+
+    // Page tags (name + pageId + pageNumber); name/pageId già trimmed e non vuoti
+    QList<TagRef> tags;
+    const QList<ContentTag> pageTags = readPageTags(content);
+    tags.reserve(pageTags.size());
+    QSet<std::pair<quint32, Uuid>> seenPairs; // dedup per (tag, pagina)
+    seenPairs.reserve(pageTags.size());
+
+    for (const ContentTag& t : pageTags) {
+        TagRef tr;
+        tr.nameId = tagNames().intern(t.name);
+        tr.pageId = Uuid::fromString(t.pageId);
+
+        const std::pair<quint32, Uuid> key(tr.nameId, tr.pageId);
+        if (seenPairs.contains(key))
+            continue;
+        seenPairs.insert(key);
+
+        tr.pageNumber = pageMap.value(t.pageId, -1); // -1 se non trovato
+        tags.append(tr);
+    }
+
+    e.tags          = tags;
+    e.hasTags       = !e.tags.isEmpty();
+    // Numero di pagine dal .content (se presente)
+    e.pages         = content.pageCount;
+    e.detailsLoaded = true;
+}
+
+// Variante di --max-memory: page map e deduplica nell'arena del documento,
+// nomi e pageId internati direttamente dagli span (niente QString se già noti)
+struct TagKeyHash {
+    size_t operator()(const std::pair<quint32, Uuid>& k) const { return qHash(k.second, k.first); }
+};
+
+static void fillDetails(DocEntry& e, const ContentSpans& content)
+{
+    std::pmr::memory_resource* mr = content.resource();
+
+    // Mappa pageId → numero pagina, con le regole di buildPageMap
+    std::pmr::unordered_map<std::string_view, int> pageMap(mr);
+    {
+        ProfileScope prof(ProfilePhase::PageMap);
+        const auto& pages = content.cPages.empty() ? content.rootPages : content.cPages;
+        pageMap.reserve(pages.size());
+        for (const ContentSpans::Page& p : pages)
+            pageMap[p.id] = p.page; // come QHash::insert: vince l'ultimo
+    }
+
+    ProfileScope prof(ProfilePhase::TagDedup);
+
+    // Regole di readPageTags
+    const auto& pageTags = content.extraTagsSize > 0 ? content.extraTags : content.rootTags;
+    QList<TagRef> tags;
+    tags.reserve(qsizetype(pageTags.size()));
+    std::pmr::unordered_set<std::pair<quint32, Uuid>, TagKeyHash> seenPairs(mr);
+    seenPairs.reserve(pageTags.size());
+
+    for (const ContentSpans::Tag& t : pageTags) {
+        TagRef tr;
+        tr.nameId = tagNames().internUtf8(t.name.data(), qsizetype(t.name.size()));
+        tr.pageId = Uuid::fromUtf8(t.pageId.data(), qsizetype(t.pageId.size()));
+        if (!seenPairs.emplace(tr.nameId, tr.pageId).second)
+            continue;
+
+        const auto it = pageMap.find(t.pageId);
+        tr.pageNumber = it == pageMap.end() ? -1 : it->second;
+        tags.append(tr);
+    }
+
+    e.tags          = tags;
+    e.hasTags       = !e.tags.isEmpty();
+    e.pages         = content.pageCount;
+    e.detailsLoaded = true;
+}
+
+// I tipi noti condividono la stessa QString (implicit sharing)
+static QString kindString(std::string_view type)
+{
+    static const QString pdf = QStringLiteral("pdf"), epub = QStringLiteral("epub"),
+                         notebook = QStringLiteral("notebook");
+    if (type == "pdf")      return pdf;
+    if (type == "epub")     return epub;
+    if (type == "notebook") return notebook;
+    return QString::fromUtf8(type.data(), qsizetype(type.size()));
+}
+
+// Campi del .metadata che decidono l'esito di un UUID
+struct MetaFields {
+    bool    deleted = false;
+    bool    trash   = false;
+    bool    folder  = false; // CollectionType
+    QString parent;          // UUID della cartella, vuoto = root
+    QString visibleName;
+};
+
+// .metadata con il DOM di QJsonObject (scansione normale)
+static bool readMetaFields(const QString& path, const QString& uuid, MetaFields& m)
+{
+    QJsonObject meta;
+    {
+        ProfileScope prof(ProfilePhase::MetadataJson);
+        if (!loadJsonObject(path, meta))
+            return false;
+    }
+
+    m.deleted = meta.value("deleted").toBool(false);
+
+    // parent può essere stringa ("trash"/UUID) o bool(false) → root/My Files
+    const QJsonValue parentV = meta.value("parent");
+    if (parentV.isString()) {
+        const QString p = parentV.toString();
+        if (p == "trash")
+            m.trash = true;
+        else
+            m.parent = p; // UUID cartella
+    }
+
+    m.visibleName = meta.value("visibleName").toString(uuid).trimmed();
+    m.folder      = meta.value("type").toString() == QLatin1String("CollectionType");
+    return true;
+}
+
+// .metadata mappato e letto sugli span (--max-memory): stesso risultato
+static bool readMetaFields(const QString& path, const QString& uuid, MetaFields& m,
+                           ScanArena* arena)
+{
+    ProfileScope prof(ProfilePhase::MetadataJson);
+    MappedFile file;
+    MetadataSpans s;
+    if (!file.open(path))
+        return false;
+    profileAddBytes(ProfileBytes::Metadata, file.size());
+    if (!parseMetadataSpans(file.data(), file.size(), s, arena))
+        return false;
+
+    m.deleted = s.deleted;
+    if (s.parentIsString) {
+        if (s.parent == "trash")
+            m.trash = true;
+        else
+            m.parent = QString::fromUtf8(s.parent.data(), qsizetype(s.parent.size()));
+    }
+    m.visibleName = (s.hasVisibleName ? s.visibleName : uuid).trimmed();
+    m.folder      = s.type == "CollectionType";
+    return true;
+}
+
+// Scansiona un singolo UUID: legge .metadata e .content e costruisce la entry.
+// Con lazy = true il .content viene solo sondato per il fileType: tag e
+// pagine restano da caricare (loadDocumentDetails / DetailsCache).
+// Con un'arena (--max-memory) i temporanei vengono da lì e un .content più
+// grande di maxContent byte (0 = nessun limite) non viene letto: scanOne
+// restituisce false e il documento va riscansionato più tardi, da solo.
+static bool scanOne(const QString& root, const QString& uuid, DocScan& r, bool lazy,
+                    const QSet<QString>* sources = nullptr,
+                    ScanArena* arena = nullptr, qint64 maxContent = 0)
+{
+    const QString metaPath    = root + "/" + uuid + ".metadata";
+    const QString contentPath = root + "/" + uuid + ".content";
+
+    // 1) Leggi metadata (visibleName + parent/deleted)
+    MetaFields meta;
+    if (!(arena ? readMetaFields(metaPath, uuid, meta, arena)
+                : readMetaFields(metaPath, uuid, meta))) {
+        qCDebug(lcScan, "unreadable %s.metadata", qPrintable(uuid));
+        r.outcome = DocOutcome::Unreadable;
+        return true;
+    }
+
+    if (meta.deleted) {
+        r.outcome = DocOutcome::Deleted;
+        return true;
+    }
+    if (meta.trash) {
+        r.outcome = DocOutcome::Trash;
+        return true;
+    }
+
+    DocEntry& e = r.entry;
+    e.uuid         = uuid;
+    e.visibleName  = meta.visibleName;
+    e.parentUuid   = Uuid::fromString(meta.parent);
+    e.hasParent    = !e.parentUuid.isNull();
+
+    // Cartella: il .content non serve (niente tipo, tag o pagine)
+    if (meta.folder) {
+        e.kind = QStringLiteral("folder");
+        r.outcome = DocOutcome::Ok;
+        return true;
+    }
+
+    // 2) Leggi content (tipo + tag + page map) in streaming, senza DOM
+    const unsigned fields = lazy ? unsigned(CF_FileType | CF_Probe) : unsigned(CF_All);
+    QString fileType;
+    if (!arena) {
+        ContentInfo content;
+        bool contentOk;
+        {
+            ProfileScope prof(ProfilePhase::ContentJson);
+            contentOk = loadContentInfo(contentPath, content, fields);
+        }
+        if (!contentOk) {
+            r.outcome = DocOutcome::ContentMissing;
+            return true;
+        }
+        fileType = readFileType(content);
+        if (!lazy)
+            fillDetails(e, content);
+    } else {
+        MappedFile file;
+        ContentSpans content(arena);
+        bool contentOk;
+        {
+            ProfileScope prof(ProfilePhase::ContentJson);
+            contentOk = file.open(contentPath);
+            if (contentOk && maxContent > 0 && file.size() > maxContent) {
+                e = DocEntry();
+                return false; // troppo grande per l'arena: più tardi, da solo
+            }
+            if (contentOk) {
+                profileAddBytes(ProfileBytes::Content, file.size());
+                contentOk = parseContentSpans(file.data(), file.size(), content, fields);
+            }
+        }
+        if (!contentOk) {
+            r.outcome = DocOutcome::ContentMissing;
+            return true;
+        }
+        fileType = kindString(content.extraFileType.empty() ? content.rootFileType
+                                                            : content.extraFileType);
+        if (!lazy)
+            fillDetails(e, content);
+    }
+
+    if (fileType.isEmpty()) {
+        fileType = probeFileType(root, uuid, sources);
+        r.forcedType = true;
+    }
+
+    // 3) Tipo della entry
+    e.kind         = fileType;      // "pdf" | "epub" | "notebook"
+
+    // 4) Tag e pagine (subito, oppure on-demand in modalità lazy)
+    if (lazy)
+        e.detailsLoaded = false;
+
+    r.outcome = DocOutcome::Ok;
+    return true;
+}
+
+bool loadDocumentDetails(DocEntry& e)
+{
+    ContentInfo content;
+    if (!loadContentInfo(xochitlBase() + "/" + e.uuid + ".content", content)) {
+        // .content sparito o non valido dopo la fase 1: entry senza tag
+        e.tags.clear();
+        e.hasTags = false;
+        e.pages = 0;
+        e.detailsLoaded = true;
+        return false;
+    }
+
+    fillDetails(e, content);
+    return true;
+}
+
+void scanDocument(const QString& uuid, DocScan& out)
+{
+    out = DocScan();
+    scanOne(xochitlBase(), uuid, out, false);
+}
+
+bool docLessByName(const DocEntry& a, const DocEntry& b)
+{
+    return QString::localeAwareCompare(a.visibleName, b.visibleName) < 0;
+}
+
+// -------------------------
+//  DetailsCache
+// -------------------------
+DetailsCache::DetailsCache(int maxCost)
+    : m_lru(maxCost)
+{
+}
+
+DocEntry DetailsCache::resolve(const DocEntry& e)
+{
+    if (e.detailsLoaded)
+        return e;
+
+    if (const DocEntry* hit = m_lru.object(e.uuid))
+        return *hit; // object() aggiorna anche l'ordine LRU
+
+    DocEntry* full = new DocEntry(e);
+    if (!loadDocumentDetails(*full))
+        qCWarning(lcScan, "cannot read %s.content", qPrintable(e.uuid));
+
+    const DocEntry result = *full;
+    // costo = numero di tag (+1): il limite è sulla memoria, non sui documenti
+    m_lru.insert(e.uuid, full, full->tags.size() + 1);
+    return result;
+}
+
+// Aggiunge il contributo di un UUID alle statistiche e smista la entry
+static void collect(const DocScan& r,
+                    QList<DocEntry>& pdfs,
+                    QList<DocEntry>& epubs,
+                    QList<DocEntry>& notebooks,
+                    QList<DocEntry>* folders,
+                    ScanStats& stats)
+{
+    ++stats.metaCount;
+    if (r.forcedType)
+        ++stats.forcedType;
+
+    switch (r.outcome) {
+    case DocOutcome::Unreadable:     return;
+    case DocOutcome::Deleted:        ++stats.deleted;        return;
+    case DocOutcome::Trash:          ++stats.trash;          return;
+    case DocOutcome::ContentMissing: ++stats.contentMissing; return;
+    case DocOutcome::Ok:             break;
+    }
+
+    if (!r.entry.detailsLoaded)
+        ++stats.deferred;
+
+    const QString& fileType = r.entry.kind;
+    if (fileType == "pdf")            pdfs.append(r.entry);
+    else if (fileType == "epub")      epubs.append(r.entry);
+    else if (fileType == "notebook")  notebooks.append(r.entry);
+    else if (fileType == "folder")    { ++stats.folders; if (folders) folders->append(r.entry); }
+    else /* ignora altri tipi */      (void)0;
+}
 
 bool scanDocuments(QList<DocEntry>& pdfs,
                    QList<DocEntry>& epubs,
                    QList<DocEntry>& notebooks,
-                   ScanStats& stats)
+                   ScanStats& stats,
+                   const ScanOptions& opts,
+                   QList<DocEntry>* folders)
 {
-    QDir d(kBase);
+    ProfileScope profTotal(ProfilePhase::ScanTotal);
+
+    const QString root = opts.root.isEmpty() ? xochitlBase() : opts.root;
+    QDir d(root);
     if (!d.exists()) {
         return false;
     }
 
-    QStringList metas = d.entryList(QStringList() << "*.metadata",
-                                    QDir::Files, QDir::Name);
+    // Un solo listing: i .metadata da scansionare e i .pdf/.epub presenti
+    // (per probeFileType, senza stat() per documento)
+    QStringList metas;
+    QSet<QString> sources;
+    {
+        ProfileScope prof(ProfilePhase::ListDir);
+        const QStringList files = d.entryList(QStringList() << "*.metadata" << "*.pdf" << "*.epub",
+                                              QDir::Files, QDir::Name);
+        metas.reserve(files.size() / 2);
+        for (const QString& f : files) {
+            if (f.endsWith(QLatin1String(".metadata")))
+                metas.append(f);
+            else
+                sources.insert(f);
+        }
+    }
+
+    // Indice incrementale: se presente, i documenti con .metadata/.content
+    // invariati (mtime, size, inode) non vengono riletti.
+    const bool useCache = !opts.cachePath.isEmpty();
+    ScanCache cache(opts.cachePath);
+    if (useCache) {
+        ProfileScope prof(ProfilePhase::CacheLoad);
+        cache.load();
+    }
 
+    QStringList uuids;
+    uuids.reserve(metas.size());
     for (const QString& metaFile : metas) {
         // UUID = nome file senza estensione
         QString uuid = metaFile;
         uuid.chop(QStringLiteral(".metadata").size());
+        uuids.append(uuid);
+    }
 
-        const QString metaPath    = kBase + "/" + uuid + ".metadata";
-        const QString contentPath = kBase + "/" + uuid + ".content";
-
-        ++stats.metaCount;
-
-        // 1) Leggi metadata (visibleName + parent/deleted)
-        QJsonObject meta;
-        if (!loadJsonObject(metaPath, meta))
-            continue;
-
-        const bool isDeleted = meta.value("deleted").toBool(false);
-        if (isDeleted) {
-            ++stats.deleted;
-            continue;
-        }
+    // 1) Lavoro per-UUID sul pool di worker, in due passate:
+    //    a) impronte + lookup in cache (solo stat());
+    //    b) parsing dei documenti mancati, con prefetch dei file in anticipo.
+    //    Ogni worker scrive solo nel proprio slot; la cache è in sola lettura.
+    struct Slot {
+        DocScan   scan;
+        FileStamp meta, content;
+        bool      fromCache = false;
+        bool      oversized = false; // .content oltre l'arena (--max-memory)
+    };
+    std::vector<Slot> results(uuids.size());
 
-        // parent può essere stringa ("trash"/UUID) o bool(false)
-        const QJsonValue parentV = meta.value("parent");
-        QString parentStr;
-        bool inTrash = false;
-
-        if (parentV.isBool()) {
-            // parent:false → root/My Files (nessuna cartella)
-            parentStr.clear();
-        } else if (parentV.isString()) {
-            const QString p = parentV.toString();
-            if (p == "trash") {
-                inTrash = true;
-            } else {
-                parentStr = p; // UUID cartella
+    if (useCache) {
+        parallelFor(int(uuids.size()), opts.jobs, [&](int i) {
+            const QString& uuid = uuids.at(i);
+            Slot& s = results[i];
+            {
+                ProfileScope prof(ProfilePhase::Stat);
+                s.meta    = stampFile(root + "/" + uuid + ".metadata");
+                s.content = stampFile(root + "/" + uuid + ".content");
             }
-        } else {
-            parentStr.clear();
-        }
 
-        if (inTrash) {
-            ++stats.trash;
-            continue;
-        }
+            if (const ScanCache::Entry* hit = cache.lookup(uuid, s.meta, s.content)) {
+                s.scan = hit->scan;
+                // il fallback dipende da .pdf/.epub, non coperti dall'impronta
+                if (s.scan.forcedType && s.scan.outcome == DocOutcome::Ok)
+                    s.scan.entry.kind = probeFileType(root, uuid, &sources);
+                s.fromCache = true;
+            }
+        });
+    }
 
-        // 2) Leggi content (tipo + tag + page map)
-        QJsonObject content;
-        if (!loadJsonObject(contentPath, content)) {
-            ++stats.contentMissing;
-            continue;
+    QList<int> misses;
+    QStringList missUuids;
+    for (int i = 0; i < uuids.size(); ++i) {
+        if (!results[i].fromCache) {
+            misses.append(i);
+            missUuids.append(uuids.at(i));
         }
+    }
 
-        QString fileType = readFileType(content);
-        if (fileType.isEmpty()) {
-            // Fallback di emergenza: deduci dal file presente sul FS
-            const QString pdfPath  = kBase + "/" + uuid + ".pdf";
-            const QString epubPath = kBase + "/" + uuid + ".epub";
-            if (QFileInfo::exists(pdfPath))
-                fileType = "pdf";
-            else if (QFileInfo::exists(epubPath))
-                fileType = "epub";
-            else
-                fileType = "notebook";
+    // --max-memory: un'arena per worker con kArenaShare del budget. Se le
+    // arene sarebbero troppo piccole si usano meno worker.
+    int jobs = opts.jobs;
+    std::unique_ptr<ArenaPool> arenas;
+    if (opts.maxMemory > 0) {
+        const qint64 share = opts.maxMemory / kArenaShare;
+        int workers = effectiveJobs(opts.jobs, int(misses.size()));
+        workers = int(qBound<qint64>(1, share / kMinArena, workers));
+        const qint64 capacity = qBound(kMinArena, share / workers, kMaxArena);
+        arenas = std::make_unique<ArenaPool>(workers, size_t(capacity));
+        jobs = workers;
+    }
+    // Un .content oltre metà arena viene rimandato: span, page map e hash
+    // non ci starebbero, e N file grandi mappati insieme sforerebbero il tetto
+    const qint64 maxContent = arenas ? qint64(arenas->capacity()) / 2 : 0;
 
-            ++stats.forcedType;
+    auto scanMiss = [&](int i, qint64 limit) {
+        Slot& s = results[i];
+        if (!arenas) {
+            scanOne(root, uuids.at(i), s.scan, opts.lazy, &sources);
+            return;
         }
+        ArenaPool::Lease arena = arenas->acquire();
+        s.oversized = !scanOne(root, uuids.at(i), s.scan, opts.lazy, &sources, &*arena, limit);
+    };
 
-        // 3) Mappa pageId → numero pagina
-        const QHash<QString,int> pageMap = buildPageMap(content);
+    {
+        // Il kernel carica i file dei prossimi documenti mentre i worker
+        // analizzano quelli correnti (vedi prefetch.h)
+        const int workers = effectiveJobs(jobs, int(misses.size()));
+        Prefetcher prefetch(root, missUuids,
+                            QStringList() << ".metadata" << ".content",
+                            qMax(32, workers * 8));
 
-        // 4) Page tags (name + pageId + pageNumber)
-        QList<TagRef> tags;
-        const QJsonArray pageTags = readPageTags(content);
-        tags.reserve(pageTags.size());
-        QSet<QString> seenPairs; // dedup per (name|pageId)
+        parallelFor(int(misses.size()), jobs, [&](int m) {
+            const int i = misses.at(m);
 
-        for (const auto& v : pageTags) {
-            const QJsonObject t = v.toObject();
-            const QString name = t.value("name").toString().trimmed();
-            const QString pid  = t.value("pageId").toString().trimmed();
-            if (name.isEmpty() || pid.isEmpty())
-                continue;
+            if (!profileEnabled()) {
+                scanMiss(i, maxContent);
+            } else {
+                const qint64 t0 = profileNow();
+                scanMiss(i, maxContent);
+                profileDocument(uuids.at(i), profileNow() - t0);
+            }
+            prefetch.completed();
+        });
+    }
 
-            const QString key = name + "|" + pid;
-            if (seenPairs.contains(key))
+    // .content rimandati: uno alla volta, stesso parser in streaming e
+    // stessa arena (oltre la capacità si ripiega sull'heap)
+    if (arenas) {
+        for (int i : std::as_const(misses)) {
+            if (!results[i].oversized)
                 continue;
-            seenPairs.insert(key);
+            results[i].scan = DocScan();
+            scanMiss(i, 0);
+            ++stats.oversized;
+        }
+        stats.arenas         = arenas->arenas();
+        stats.arenaCapacity  = qint64(arenas->capacity());
+        stats.arenaHighWater = qint64(arenas->highWater());
+        stats.arenaSpilled   = qint64(arenas->spilled());
+        arenas.reset();
+    }
 
-            TagRef r;
-            r.name = name;
-            r.pageId = pid;
-            r.pageNumber = pageMap.value(pid, -1); // -1 se non trovato
-            tags.append(r);
+    // 2) Merge seriale nell'ordine di metas: output identico alla scansione seriale
+    {
+        ProfileScope prof(ProfilePhase::Merge);
+        for (int i = 0; i < uuids.size(); ++i) {
+            const Slot& s = results[i];
+            if (s.fromCache)
+                ++stats.cached;
+            else if (useCache && s.scan.entry.detailsLoaded) // le entry lazy non vanno in cache
+                cache.insert(uuids.at(i), ScanCache::Entry{s.meta, s.content, s.scan});
+
+            collect(s.scan, pdfs, epubs, notebooks, folders, stats);
         }
+    }
+    results.clear();
 
-        // 5) Costruisci entry
-        DocEntry e;
-        e.uuid         = uuid;
-        e.visibleName  = meta.value("visibleName").toString(uuid).trimmed();
-        e.parentUuid   = parentStr;
-        e.hasParent    = !e.parentUuid.isEmpty();
-        e.kind         = fileType;      // "pdf" | "epub" | "notebook"
-        e.tags         = tags;
-        e.hasTags      = !e.tags.isEmpty();
-       // Numero di pagine dal .content (se presente)
-        int pageCount = content.value("pageCount").toInt(0);
-        e.pages = pageCount;
-
-        // 6) Smista
-        if (fileType == "pdf")            pdfs.append(e);
-        else if (fileType == "epub")      epubs.append(e);
-        else if (fileType == "notebook")  notebooks.append(e);
-        else /* ignora altri tipi */      (void)0;
+    if (useCache) {
+        ProfileScope prof(ProfilePhase::CacheSave);
+        cache.retainOnly(uuids);
+        if (!cache.save())
+            qCWarning(lcScan, "cannot write scan cache: %s", qPrintable(cache.path()));
     }
 
     return true;
-}
\ No newline at end of file
+}
+
+void scanLibraries(std::vector<LibraryScan>& libs)
+{
+    if (libs.empty())
+        return;
+
+    const int share = qMax(1, QThread::idealThreadCount() / int(libs.size()));
+    const qint64 count = qint64(libs.size());
+    auto run = [share, count](LibraryScan& lib) {
+        ScanOptions opts = lib.opts;
+        if (opts.jobs <= 0)
+            opts.jobs = share;
+        // il tetto di memoria vale per il processo, non per libreria
+        opts.maxMemory /= count;
+        lib.ok = scanDocuments(lib.pdfs, lib.epubs, lib.notebooks, lib.stats, opts, &lib.folders);
+    };
+
+    // tagNames() è condivisa e thread-safe: i nameId restano confrontabili
+    // fra le librerie
+    std::vector<std::thread> threads;
+    threads.reserve(libs.size() - 1);
+    for (size_t i = 1; i < libs.size(); ++i)
+        threads.emplace_back(run, std::ref(libs[i]));
+    run(libs[0]);
+    for (std::thread& t : threads)
+        t.join();
+}
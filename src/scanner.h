@@ -1,12 +1,81 @@
 #pragma once
 
+#include <QCache>
 #include <QList>
+#include <QString>
 #include "model.h"
 
-// Scansiona la libreria reMarkable in kBase e riempie le liste PDF/EPUB/notebook.
-// Aggiorna anche le statistiche di scansione.
+#include <vector>
+
+// Opzioni di scansione
+struct ScanOptions {
+    // Directory della libreria; vuota = xochitlBase(). Permette di
+    // scansionare copie della libreria (backup, altri dispositivi: --diff)
+    QString root;
+
+    // Indice incrementale su disco (vedi scan_cache.h); vuoto = nessuna cache
+    QString cachePath;
+
+    // Worker per la scansione parallela: 1 = seriale, 0 = tutti i core.
+    // Il risultato è identico (stesso ordine) per qualunque valore.
+    int jobs = 1;
+
+    // Scansione in due fasi: solo .metadata + tipo dal .content; tag e page
+    // map vengono caricati quando servono (DetailsCache)
+    bool lazy = false;
+
+    // Tetto di memoria in byte (--max-memory); 0 = nessuno. I temporanei
+    // di ogni documento vengono da un'arena per worker, riusata fra i
+    // documenti; i .content che non ci stanno sono letti dopo, uno alla volta.
+    qint64 maxMemory = 0;
+};
+
+// Scansiona la libreria reMarkable in opts.root e riempie le liste PDF/EPUB/notebook
+// (e, se richiesto, quella delle cartelle: entry con kind "folder", senza
+// tag né pagine; vedi FolderIndex). Aggiorna anche le statistiche di scansione.
 // Restituisce false solo se la directory base non esiste.
 bool scanDocuments(QList<DocEntry>& pdfs,
                    QList<DocEntry>& epubs,
                    QList<DocEntry>& notebooks,
-                   ScanStats& stats);
\ No newline at end of file
+                   ScanStats& stats,
+                   const ScanOptions& opts = ScanOptions(),
+                   QList<DocEntry>* folders = nullptr);
+
+// Una libreria da scansionare con scanLibraries(): opzioni in ingresso
+// (root, cache, jobs), liste e statistiche in uscita
+struct LibraryScan {
+    ScanOptions     opts;
+    QList<DocEntry> pdfs, epubs, notebooks, folders;
+    ScanStats       stats;
+    bool            ok = false; // false = root inesistente
+};
+
+// Scansiona più librerie contemporaneamente, una per thread. Con
+// opts.jobs = 0 i core vengono ripartiti fra le librerie.
+void scanLibraries(std::vector<LibraryScan>& libs);
+
+// Scansione completa (senza cache) di un solo documento: usata da --watch
+// per aggiornare la entry di un UUID modificato
+void scanDocument(const QString& uuid, DocScan& out);
+
+// Ordinamento delle liste: alfabetico per visibleName
+bool docLessByName(const DocEntry& a, const DocEntry& b);
+
+// Carica tag, page map e pageCount di una entry della scansione lazy.
+// Restituisce false se il .content non è più leggibile (entry senza tag).
+bool loadDocumentDetails(DocEntry& e);
+
+// LRU limitata dei dettagli caricati on-demand in modalità lazy
+class DetailsCache
+{
+public:
+    // maxCost = numero massimo di tag tenuti in memoria
+    explicit DetailsCache(int maxCost = 50000);
+
+    // Entry completa per e: se già caricata la restituisce com'è,
+    // altrimenti la prende dalla LRU o legge il .content
+    DocEntry resolve(const DocEntry& e);
+
+private:
+    QCache<QString, DocEntry> m_lru;
+};
\ No newline at end of file
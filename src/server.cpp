@@ -0,0 +1,682 @@
+#include "server.h"
+#include "batch_export.h"
+#include "excerpts.h"
+#include "export.h"
+#include "highlights.h"
+#include "ink.h"
+#include "output.h"
+#include "paths.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMetaObject>
+#include <QTextStream>
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Oltre questi limiti la connessione viene chiusa: un client lento o
+// malevolo non può far crescere la memoria del server
+static const int       kMaxClients    = 64;
+static const qsizetype kMaxRequest    = 4096;
+static const int       kBacklog       = 16;
+static const int       kClientTimeout = 10; // secondi, lato --client
+static const int       kSummaryThreads = 2; // caricamento dei summary in testo
+
+namespace {
+
+bool fillAddress(const QString &path, sockaddr_un &addr)
+{
+    const QByteArray native = QFile::encodeName(path);
+    if (native.isEmpty() || size_t(native.size()) >= sizeof(addr.sun_path))
+        return false;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, native.constData(), size_t(native.size()));
+    return true;
+}
+
+// Scrive tutto il buffer (fd bloccante); false su errore
+bool writeAll(int fd, const char *p, qsizetype left)
+{
+    while (left > 0) {
+        const ssize_t n = ::send(fd, p, size_t(left), MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        p += n;
+        left -= n;
+    }
+    return true;
+}
+
+bool writeAllFd(int fd, const char *p, qsizetype left)
+{
+    while (left > 0) {
+        const ssize_t n = ::write(fd, p, size_t(left));
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        p += n;
+        left -= n;
+    }
+    return true;
+}
+
+void appendError(QByteArray &out, const QString &message)
+{
+    QString m = message;
+    m.replace(QLatin1Char('\n'), QLatin1Char(' '));
+    out.append("ERR ");
+    out.append(m.toUtf8());
+    out.append('\n');
+}
+
+void appendReply(QByteArray &out, const QByteArray &payload)
+{
+    out.append("OK ");
+    out.append(QByteArray::number(payload.size()));
+    out.append('\n');
+    out.append(payload);
+}
+
+} // namespace
+
+QString defaultSocketPath()
+{
+    return mirtilloShareBase() + "/mirtillo.sock";
+}
+
+// -------------------------
+//  QueryServer
+// -------------------------
+QueryServer::QueryServer(const QList<DocEntry>& pdfs,
+                         const QList<DocEntry>& epubs,
+                         const QList<DocEntry>& notebooks,
+                         const QList<DocEntry>& folders)
+    : m_pdfs(pdfs)
+    , m_epubs(epubs)
+    , m_notebooks(notebooks)
+    , m_folders(folders)
+    , m_context(std::make_unique<QObject>())
+{
+    m_pool.setMaxThreadCount(kSummaryThreads);
+}
+
+QueryServer::~QueryServer()
+{
+    // Prima i caricamenti in corso, poi il contesto: le risposte già
+    // accodate non raggiungono un server distrutto
+    m_pool.waitForDone();
+    m_context.reset();
+
+    while (!m_clients.empty())
+        dropClient(m_clients.back().get());
+
+    m_notifier.reset();
+    if (m_fd >= 0) {
+        ::close(m_fd);
+        ::unlink(QFile::encodeName(m_path).constData());
+    }
+}
+
+bool QueryServer::listen(const QString& path, QString& error)
+{
+    sockaddr_un addr;
+    if (!fillAddress(path, addr)) {
+        error = "socket path too long: " + path;
+        return false;
+    }
+
+    // Un socket già presente è di un altro server (attivo) oppure orfano
+    // di un server terminato male: si distingue provando a connettersi
+    struct stat st;
+    if (::lstat(addr.sun_path, &st) == 0) {
+        if (!S_ISSOCK(st.st_mode)) {
+            error = path + " exists and is not a socket";
+            return false;
+        }
+        const int probe = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        const bool alive = probe >= 0 &&
+            ::connect(probe, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0;
+        if (probe >= 0)
+            ::close(probe);
+        if (alive) {
+            error = "another mirtillo server is running on " + path;
+            return false;
+        }
+        ::unlink(addr.sun_path);
+    }
+
+    QDir().mkpath(QFileInfo(path).absolutePath());
+
+    m_fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (m_fd < 0 ||
+        ::bind(m_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 ||
+        ::chmod(addr.sun_path, 0600) < 0 ||
+        ::listen(m_fd, kBacklog) < 0) {
+        error = "cannot listen on " + path + ": " + QString::fromLocal8Bit(std::strerror(errno));
+        if (m_fd >= 0)
+            ::close(m_fd);
+        m_fd = -1;
+        return false;
+    }
+
+    m_path = path;
+    m_notifier = std::make_unique<QSocketNotifier>(m_fd, QSocketNotifier::Read);
+    QObject::connect(m_notifier.get(), &QSocketNotifier::activated,
+                     [this]() { acceptClients(); });
+    return true;
+}
+
+void QueryServer::acceptClients()
+{
+    for (;;) {
+        const int fd = ::accept4(m_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR)
+                continue;
+            return; // EAGAIN (nessuno in coda) o EMFILE: si riprova al prossimo evento
+        }
+        if (int(m_clients.size()) >= kMaxClients) {
+            ::close(fd);
+            continue;
+        }
+
+        auto c = std::make_unique<Client>();
+        Client* raw = c.get();
+        c->id = m_nextClientId++;
+        c->fd = fd;
+        c->readable = std::make_unique<QSocketNotifier>(fd, QSocketNotifier::Read);
+        c->writable = std::make_unique<QSocketNotifier>(fd, QSocketNotifier::Write);
+        c->writable->setEnabled(false);
+        QObject::connect(c->readable.get(), &QSocketNotifier::activated,
+                         [this, raw]() { readClient(raw); });
+        QObject::connect(c->writable.get(), &QSocketNotifier::activated,
+                         [this, raw]() { writeClient(raw); });
+        m_clients.push_back(std::move(c));
+    }
+}
+
+void QueryServer::readClient(Client* c)
+{
+    char buf[4096];
+    for (;;) {
+        const ssize_t n = ::recv(c->fd, buf, sizeof(buf), 0);
+        if (n == 0) {
+            dropClient(c); // il client ha chiuso
+            return;
+        }
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            dropClient(c);
+            return;
+        }
+        c->in.append(buf, n);
+        if (c->in.size() > kMaxRequest && !c->in.contains('\n')) {
+            dropClient(c);
+            return;
+        }
+        if (c->in.contains('\n'))
+            break; // prima si risponde, poi si legge il resto
+    }
+
+    processRequests(c);
+}
+
+void QueryServer::processRequests(Client* c)
+{
+    qsizetype nl;
+    while (!c->busy && (nl = c->in.indexOf('\n')) >= 0) {
+        const QString line = QString::fromUtf8(c->in.constData(), nl);
+        c->in.remove(0, nl + 1);
+        handle(c, line.split(QLatin1Char('\t')));
+    }
+    writeClient(c);
+}
+
+void QueryServer::writeClient(Client* c)
+{
+    while (c->outPos < c->out.size()) {
+        const ssize_t n = ::send(c->fd, c->out.constData() + c->outPos,
+                                 size_t(c->out.size() - c->outPos), MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            dropClient(c);
+            return;
+        }
+        c->outPos += n;
+    }
+
+    // Finché la risposta non è stata consumata non si leggono altre richieste:
+    // un client che non legge non fa accumulare output nel server
+    const bool pending = c->outPos < c->out.size();
+    if (!pending) {
+        c->out.clear();
+        c->outPos = 0;
+    }
+    c->writable->setEnabled(pending);
+    c->readable->setEnabled(!pending && !c->busy);
+}
+
+void QueryServer::dropClient(Client* c)
+{
+    const auto it = std::find_if(m_clients.begin(), m_clients.end(),
+                                 [c](const std::unique_ptr<Client>& p) { return p.get() == c; });
+    if (it == m_clients.end())
+        return;
+
+    // Il notifier può essere quello che sta emettendo il segnale corrente:
+    // lo distrugge il loop di eventi
+    c->readable->setEnabled(false);
+    c->writable->setEnabled(false);
+    c->readable.release()->deleteLater();
+    c->writable.release()->deleteLater();
+    ::close(c->fd);
+    m_clients.erase(it);
+}
+
+QueryServer::Client* QueryServer::findClient(quint64 id) const
+{
+    for (const std::unique_ptr<Client>& c : m_clients)
+        if (c->id == id)
+            return c.get();
+    return nullptr;
+}
+
+void QueryServer::startSummary(Client* c, const DocEntry& e)
+{
+    c->busy = true;
+    c->readable->setEnabled(false);
+
+    const quint64 id = c->id;
+    QObject* context = m_context.get();
+    // La copia della entry non risente del watcher che modifica le liste
+    m_pool.start([this, id, context, full = e]() mutable {
+        loadDocumentHighlights(full);
+        loadDocumentInk(full);
+        loadDocumentExcerpts(full);
+        QString text;
+        {
+            QTextStream ts(&text);
+            printDocumentSummary(full, ts);
+        }
+        const QByteArray payload = text.toUtf8();
+        QMetaObject::invokeMethod(context, [this, id, payload]() {
+            finishSummary(id, payload);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void QueryServer::finishSummary(quint64 clientId, const QByteArray& payload)
+{
+    Client* c = findClient(clientId);
+    if (!c)
+        return; // il client se n'è andato nel frattempo
+    c->busy = false;
+    appendReply(c->out, payload);
+    processRequests(c);
+}
+
+const DocEntry* QueryServer::findDocument(const QString& uuid)
+{
+    auto valid = [&]() -> const DocEntry* {
+        const auto it = m_byUuid.constFind(uuid);
+        if (it == m_byUuid.cend())
+            return nullptr;
+        const QList<DocEntry>* list = it->first;
+        const int pos = it->second;
+        if (pos < list->size() && list->at(pos).uuid == uuid)
+            return &list->at(pos);
+        return nullptr;
+    };
+
+    if (const DocEntry* e = valid())
+        return e;
+
+    // Mancante o spostato (il watcher inserisce e rimuove entry): si
+    // ricostruisce la mappa e si riprova una volta
+    m_byUuid.clear();
+    for (const QList<DocEntry>* list : {&m_pdfs, &m_epubs, &m_notebooks})
+        for (int i = 0; i < list->size(); ++i)
+            m_byUuid.insert(list->at(i).uuid, qMakePair(list, i));
+    return valid();
+}
+
+void QueryServer::invalidate()
+{
+    m_byUuid.clear();
+    m_folderIndexValid = false;
+}
+
+const FolderIndex& QueryServer::folderIndex()
+{
+    if (!m_folderIndexValid) {
+        m_folderIndex.build(m_folders, m_pdfs, m_epubs, m_notebooks);
+        m_folderIndexValid = true;
+    }
+    return m_folderIndex;
+}
+
+const TagIndex* QueryServer::tagIndex()
+{
+    // Un stat() per query: il watcher riscrive l'indice con un rename, quindi
+    // un'impronta diversa vuol dire un file nuovo da rimappare
+    const QString path = mirtilloShareBase() + "/tag_index.bin";
+    const FileStamp stamp = stampFile(path);
+    if (m_index && stamp == m_indexStamp)
+        return m_index.get();
+
+    auto index = std::make_unique<TagIndex>();
+    if (!index->open(path)) {
+        m_index.reset();
+        return nullptr;
+    }
+    m_index = std::move(index);
+    m_indexStamp = stamp;
+    return m_index.get();
+}
+
+void QueryServer::handle(Client* c, const QStringList& args)
+{
+    QByteArray& out = c->out;
+    const QString cmd = args.value(0).trimmed().toLower();
+
+    // Opzioni comuni (stessa sintassi della riga di comando) e argomenti
+    OutputFormat format = OutputFormat::Text;
+    ExportFilter filter;
+    int folderNode = FolderIndex::kRoot;
+    QStringList positional;
+    for (int i = 1; i < args.size(); ++i) {
+        const QString& a = args.at(i);
+        if (a == "--format") {
+            if (!parseOutputFormat(args.value(++i), format)) {
+                appendError(out, "--format expects text, json, jsonl or csv");
+                return;
+            }
+        } else if (a == "--kind") {
+            for (const QString& k : args.value(++i).split(',', Qt::SkipEmptyParts)) {
+                const QString kind = k.trimmed().toLower();
+                if (kind != "pdf" && kind != "epub" && kind != "notebook") {
+                    appendError(out, "--kind expects pdf, epub or notebook");
+                    return;
+                }
+                filter.kinds.insert(kind);
+            }
+        } else if (a == "--folder") {
+            QString error;
+            folderNode = folderIndex().resolve(args.value(++i), error);
+            if (folderNode < 0) {
+                appendError(out, error);
+                return;
+            }
+            filter.byFolder = true;
+        } else if (a == "--has-tags") {
+            filter.taggedOnly = true;
+        } else {
+            positional << a;
+        }
+    }
+
+    QByteArray payload;
+
+    if (cmd == "ping") {
+        payload = "pong\n";
+    } else if (cmd == "stats") {
+        const TagIndex* index = tagIndex();
+        QTextStream ts(&payload);
+        ts << "documents " << (m_pdfs.size() + m_epubs.size() + m_notebooks.size()) << "\n"
+           << "pdf " << m_pdfs.size() << "\n"
+           << "epub " << m_epubs.size() << "\n"
+           << "notebook " << m_notebooks.size() << "\n"
+           << "folders " << m_folders.size() << "\n"
+           << "tags " << (index ? index->tagCount() : 0) << "\n"
+           << "clients " << m_clients.size() << "\n";
+    } else if (cmd == "list") {
+        OutputSink sink(payload, 16 * 1024);
+        RecordWriter w(sink, format, RecordWriter::Kind::Documents);
+        auto row = [&](const DocEntry& e) {
+            if (!filter.matches(e))
+                return;
+            if (format != OutputFormat::Text) {
+                w.document(e);
+                return;
+            }
+            // Una riga per documento: uuid, tipo, nome
+            sink.appendUtf8(e.uuid);
+            sink.append('\t');
+            sink.appendUtf8(e.kind);
+            sink.append('\t');
+            sink.appendUtf8(e.visibleName);
+            sink.append('\n');
+        };
+
+        if (format != OutputFormat::Text)
+            w.begin();
+        if (filter.byFolder) {
+            // Solo il sottoalbero della cartella: O(sottoalbero)
+            folderIndex().forEachDocument(folderNode, row);
+        } else {
+            for (const QList<DocEntry>* list : {&m_pdfs, &m_epubs, &m_notebooks})
+                for (const DocEntry& e : *list)
+                    row(e);
+        }
+        if (format != OutputFormat::Text)
+            w.end();
+        sink.flush();
+    } else if (cmd == "folders") {
+        const FolderIndex& index = folderIndex();
+        if (format == OutputFormat::Text) {
+            QString text;
+            {
+                QTextStream ts(&text);
+                printFolderTree(index, folderNode, ts);
+            }
+            payload = text.toUtf8();
+        } else {
+            OutputSink sink(payload, 16 * 1024);
+            RecordWriter w(sink, format, RecordWriter::Kind::Folders);
+            w.begin();
+            for (int n : index.subtreeNodes(folderNode))
+                w.folder(index, n);
+            w.end();
+        }
+    } else if (cmd == "summary") {
+        if (positional.size() != 1) {
+            appendError(out, "usage: summary <uuid>");
+            return;
+        }
+        const DocEntry* e = findDocument(positional.first().trimmed());
+        if (!e) {
+            appendError(out, "document not found: " + positional.first());
+            return;
+        }
+        if (format == OutputFormat::Text) {
+            startSummary(c, *e); // risposta da finishSummary()
+            return;
+        } else {
+            OutputSink sink(payload, 16 * 1024);
+            RecordWriter w(sink, format, RecordWriter::Kind::Documents);
+            w.begin();
+            w.document(*e);
+            w.end();
+        }
+    } else if (cmd == "tag" || cmd == "tag-prefix") {
+        if (positional.size() != 1) {
+            appendError(out, "usage: " + cmd + " <name>");
+            return;
+        }
+        const TagIndex* index = tagIndex();
+        if (!index) {
+            appendError(out, "tag index not available");
+            return;
+        }
+        const QList<TagHit> hits = index->find(positional.first().trimmed(), cmd == "tag-prefix");
+        if (format == OutputFormat::Text) {
+            QString text;
+            {
+                QTextStream ts(&text);
+                printTagHits(hits, ts);
+            }
+            payload = text.toUtf8();
+        } else {
+            OutputSink sink(payload, 16 * 1024);
+            RecordWriter w(sink, format, RecordWriter::Kind::TagHits);
+            w.begin();
+            for (const TagHit& h : hits)
+                w.tagHit(h);
+            w.end();
+        }
+    } else {
+        appendError(out, "unknown command: " + cmd);
+        return;
+    }
+
+    appendReply(out, payload);
+}
+
+// -------------------------
+//  --client
+// -------------------------
+int runClient(const QString& socketPath, const QStringList& args)
+{
+    QTextStream err(stderr);
+
+    if (args.isEmpty()) {
+        err << "Error: --client requires a query (e.g. list, summary <uuid>, tag <name>)\n";
+        return 1;
+    }
+    for (const QString& a : args) {
+        if (a.contains(QLatin1Char('\t')) || a.contains(QLatin1Char('\n'))) {
+            err << "Error: query arguments cannot contain tabs or newlines\n";
+            return 1;
+        }
+    }
+
+    sockaddr_un addr;
+    if (!fillAddress(socketPath, addr)) {
+        err << "Error: socket path too long: " << socketPath << "\n";
+        return 1;
+    }
+
+    const int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+        err << "Error: no mirtillo server on " << socketPath
+            << " (start one with mirtillo --serve)\n";
+        if (fd >= 0)
+            ::close(fd);
+        return 1;
+    }
+
+    // Un server bloccato non deve bloccare anche il client
+    timeval tv{kClientTimeout, 0};
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    const QByteArray request = args.join(QLatin1Char('\t')).toUtf8() + '\n';
+    if (!writeAll(fd, request.constData(), request.size())) {
+        err << "Error: cannot send query to " << socketPath << "\n";
+        ::close(fd);
+        return 1;
+    }
+
+    // Intestazione "OK <n>\n" o "ERR ...\n", poi il payload copiato su stdout
+    // a blocchi (niente buffer dell'intera risposta)
+    QByteArray head;
+    char buf[16 * 1024];
+    qsizetype nl = -1;
+    while (nl < 0) {
+        const ssize_t n = ::recv(fd, buf, sizeof(buf), 0);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0 || head.size() > kMaxRequest) {
+            err << "Error: no reply from " << socketPath << "\n";
+            ::close(fd);
+            return 1;
+        }
+        head.append(buf, n);
+        nl = head.indexOf('\n');
+    }
+
+    const QByteArray status = head.left(nl);
+    if (status.startsWith("ERR ")) {
+        err << "Error: " << QString::fromUtf8(status.mid(4)) << "\n";
+        ::close(fd);
+        return 1;
+    }
+
+    bool ok = status.startsWith("OK ");
+    qint64 left = ok ? status.mid(3).toLongLong(&ok) : 0;
+    if (!ok || left < 0) {
+        err << "Error: malformed reply from " << socketPath << "\n";
+        ::close(fd);
+        return 1;
+    }
+
+    const qsizetype already = std::min<qint64>(head.size() - nl - 1, left);
+    bool written = writeAllFd(STDOUT_FILENO, head.constData() + nl + 1, already);
+    left -= already;
+    while (written && left > 0) {
+        const ssize_t n = ::recv(fd, buf, size_t(std::min<qint64>(left, qint64(sizeof(buf)))), 0);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        written = writeAllFd(STDOUT_FILENO, buf, n);
+        left -= n;
+    }
+    ::close(fd);
+
+    if (left > 0) {
+        err << "Error: truncated reply from " << socketPath << "\n";
+        return 1;
+    }
+    return written ? 0 : 1;
+}
+
+bool quitOnTerminationSignals()
+{
+    // Segnali bloccati e letti da un signalfd nel loop: il gestore gira nel
+    // thread principale come qualsiasi altro evento (nessun vincolo
+    // async-signal-safe)
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    if (::pthread_sigmask(SIG_BLOCK, &mask, nullptr) != 0)
+        return false;
+
+    const int fd = ::signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (fd < 0)
+        return false;
+
+    // Figlio dell'applicazione: vive quanto il loop di eventi
+    auto* notifier = new QSocketNotifier(fd, QSocketNotifier::Read,
+                                         QCoreApplication::instance());
+    QObject::connect(notifier, &QSocketNotifier::activated, [fd]() {
+        signalfd_siginfo info;
+        while (::read(fd, &info, sizeof(info)) == ssize_t(sizeof(info))) {
+        }
+        QCoreApplication::quit();
+    });
+    return true;
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QSocketNotifier>
+#include <QString>
+#include <QStringList>
+#include <QThreadPool>
+
+#include <memory>
+#include <vector>
+
+#include "folder_index.h"
+#include "model.h"
+#include "scan_cache.h"
+#include "tag_index.h"
+
+// Modalità --serve: la libreria scansionata resta in memoria e risponde alle
+// query di `mirtillo --client` su un socket UNIX locale, senza riscansione
+// né avvio di un nuovo processo per ogni richiesta.
+//
+// Protocollo (una connessione può portare più richieste in sequenza):
+//
+//   richiesta:  argomenti separati da TAB, terminati da '\n' (UTF-8)
+//               es. "list\t--format\tjson\t--kind\tpdf\n"
+//   risposta:   "OK <byte>\n" seguito da esattamente <byte> byte di payload,
+//               oppure "ERR <messaggio>\n"
+//
+// Comandi: ping | stats | list [--format F] [--kind k,..]
+// [--folder uuid|root|/percorso] [--has-tags] | folders [--folder ...]
+// [--format F] | summary <uuid> | tag <nome> [--format F] |
+// tag-prefix <prefisso> [--format F]
+//
+// Tutto gira nel loop di eventi Qt (un solo thread, socket non bloccanti):
+// ogni richiesta costa pochi microsecondi e i client vengono serviti in
+// modo interleaved. Le liste sono le stesse aggiornate da LibraryWatcher,
+// quindi --serve --watch risponde sempre con lo stato corrente.
+//
+// Unica eccezione, `summary` in testo: highlight, inchiostro ed estratti EPUB
+// vanno letti da disco e su un documento grande costano decine di ms.
+// Vengono caricati su una copia della entry in un piccolo pool di thread;
+// il loop intanto serve gli altri client, e la risposta viene accodata
+// quando è pronta. Le richieste successive dello stesso client aspettano,
+// così le risposte restano nell'ordine delle richieste.
+class QueryServer
+{
+public:
+    QueryServer(const QList<DocEntry>& pdfs,
+                const QList<DocEntry>& epubs,
+                const QList<DocEntry>& notebooks,
+                const QList<DocEntry>& folders);
+    ~QueryServer();
+
+    QueryServer(const QueryServer&) = delete;
+    QueryServer& operator=(const QueryServer&) = delete;
+
+    // Crea il socket in `path` (rimuove un socket orfano di un server morto).
+    // false con `error` se il percorso è occupato da un server attivo.
+    bool listen(const QString& path, QString& error);
+
+    // Le liste sono cambiate (LibraryWatcher): gli indici derivati vanno
+    // ricostruiti alla prossima query
+    void invalidate();
+
+private:
+    struct Client {
+        quint64    id = 0; // per ritrovarlo alla fine di un summary
+        int        fd = -1;
+        bool       busy = false; // summary in caricamento nel pool
+        QByteArray in;   // richiesta parziale
+        QByteArray out;  // risposte non ancora scritte...
+        qsizetype  outPos = 0; // ...a partire da qui
+        std::unique_ptr<QSocketNotifier> readable;
+        std::unique_ptr<QSocketNotifier> writable;
+    };
+
+    void acceptClients();
+    void readClient(Client* c);
+    void writeClient(Client* c);
+    void dropClient(Client* c);
+    Client* findClient(quint64 id) const;
+
+    // Esegue le richieste complete in c->in, fino a una che resta in attesa
+    void processRequests(Client* c);
+
+    // Esegue una richiesta e accoda la risposta in c->out (o la rimanda:
+    // summary in testo, vedi startSummary)
+    void handle(Client* c, const QStringList& args);
+    void startSummary(Client* c, const DocEntry& e);
+    void finishSummary(quint64 clientId, const QByteArray& payload);
+    const DocEntry* findDocument(const QString& uuid);
+    const TagIndex* tagIndex();
+    const FolderIndex& folderIndex();
+
+    const QList<DocEntry>& m_pdfs;
+    const QList<DocEntry>& m_epubs;
+    const QList<DocEntry>& m_notebooks;
+    const QList<DocEntry>& m_folders;
+
+    QString m_path;
+    int     m_fd = -1;
+    std::unique_ptr<QSocketNotifier> m_notifier;
+    std::vector<std::unique_ptr<Client>> m_clients;
+    quint64 m_nextClientId = 1;
+
+    // Caricamento dei summary fuori dal loop. I risultati tornano al loop
+    // come chiamate accodate su m_context: distrutto il server, quelle non
+    // ancora eseguite vengono scartate da Qt.
+    QThreadPool              m_pool;
+    std::unique_ptr<QObject> m_context;
+
+    // uuid → (lista, posizione); verificato a ogni uso e ricostruito se le
+    // liste sono cambiate sotto (watcher)
+    QHash<QString, QPair<const QList<DocEntry>*, int>> m_byUuid;
+
+    // Albero delle cartelle: punta alle entry delle liste, quindi va
+    // ricostruito a ogni invalidate()
+    FolderIndex m_folderIndex;
+    bool        m_folderIndexValid = false;
+
+    // Indice dei tag mappato; riaperto quando il file su disco cambia
+    std::unique_ptr<TagIndex> m_index;
+    FileStamp                 m_indexStamp;
+};
+
+// Percorso di default del socket (--socket per cambiarlo)
+QString defaultSocketPath();
+
+// Modalità --client: invia `args` al server e copia la risposta su stdout.
+// Ritorna il codice di uscita del processo.
+int runClient(const QString& socketPath, const QStringList& args);
+
+// SIGINT/SIGTERM chiudono il loop di eventi in modo ordinato (i distruttori
+// rimuovono il socket) invece di terminare il processo
+bool quitOnTerminationSignals();
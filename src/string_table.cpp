@@ -0,0 +1,67 @@
+#include "string_table.h"
+
+quint32 StringTable::intern(const QString &s)
+{
+    {
+        QReadLocker r(&m_lock);
+        const auto it = m_ids.constFind(s);
+        if (it != m_ids.cend())
+            return it.value();
+    }
+
+    QWriteLocker w(&m_lock);
+    // un altro worker può averla aggiunta tra i due lock
+    const auto it = m_ids.constFind(s);
+    if (it != m_ids.cend())
+        return it.value();
+
+    const quint32 id = quint32(m_strings.size());
+    m_strings.append(s);
+    m_ids.insert(s, id);
+    return id;
+}
+
+quint32 StringTable::internUtf8(const char *data, qsizetype size)
+{
+    // fromRawData: chiave di ricerca senza copia
+    const QByteArray key = QByteArray::fromRawData(data, size);
+    {
+        QReadLocker r(&m_lock);
+        const auto it = m_utf8Ids.constFind(key);
+        if (it != m_utf8Ids.cend())
+            return it.value();
+    }
+
+    const quint32 id = intern(QString::fromUtf8(data, size));
+    QWriteLocker w(&m_lock);
+    m_utf8Ids.insert(QByteArray(data, size), id);
+    return id;
+}
+
+bool StringTable::find(const QString &s, quint32 &id) const
+{
+    QReadLocker r(&m_lock);
+    const auto it = m_ids.constFind(s);
+    if (it == m_ids.cend())
+        return false;
+    id = it.value();
+    return true;
+}
+
+QString StringTable::at(quint32 id) const
+{
+    QReadLocker r(&m_lock);
+    return id < quint32(m_strings.size()) ? m_strings.at(id) : QString();
+}
+
+qsizetype StringTable::size() const
+{
+    QReadLocker r(&m_lock);
+    return m_strings.size();
+}
+
+StringTable &tagNames()
+{
+    static StringTable table;
+    return table;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QReadWriteLock>
+#include <QString>
+
+// Tabella di stringhe internate: ogni stringa distinta è memorizzata una
+// sola volta e identificata da un indice a 32 bit, stabile per tutta la
+// vita del processo. Thread-safe (la scansione parallela interna da più
+// worker). Gli indici non sono persistenti: su disco vanno le stringhe.
+class StringTable
+{
+public:
+    // Indice di s, aggiungendola se non presente
+    quint32 intern(const QString &s);
+    // Come intern(), da UTF-8: se la stringa è già nota non alloca nulla
+    // (scansione con --max-memory, span del file mappato)
+    quint32 internUtf8(const char *data, qsizetype size);
+    // Solo ricerca: false (e tabella invariata) se s non è mai stata internata.
+    // Per l'input degli utenti (--folder, richieste di --serve)
+    bool find(const QString &s, quint32 &id) const;
+    // Stringa con indice id ("" se id non valido)
+    QString at(quint32 id) const;
+
+    qsizetype size() const;
+
+private:
+    mutable QReadWriteLock   m_lock;
+    QList<QString>           m_strings;
+    QHash<QString, quint32>  m_ids;
+    QHash<QByteArray, quint32> m_utf8Ids; // solo le stringhe viste da internUtf8
+
+};
+
+// Nomi dei tag di tutta la libreria (TagRef::nameId)
+StringTable &tagNames();
@@ -0,0 +1,284 @@
+#include "tag_index.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QHash>
+#include <QSaveFile>
+#include <QtEndian>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+// Formato del file (cambiare kIndexVersion a ogni modifica del layout)
+static const char    kIndexMagic[4] = {'M', 'R', 'T', 'I'};
+static const quint32 kIndexVersion  = 1;
+static const quint32 kHeaderSize    = 40; // magic + 9 × u32
+static const quint32 kDocRecSize    = 24; // uuid, title, kind: (off, len) ×3
+static const quint32 kTagRecSize    = 16; // nameOff, nameLen, firstPosting, count
+static const quint32 kPostingSize   = 16; // docId, pageNumber, pageIdOff, pageIdLen
+
+// -------------------------
+//  Scrittura
+// -------------------------
+namespace {
+
+void put32(QByteArray &b, quint32 v)
+{
+    char tmp[4];
+    qToLittleEndian<quint32>(v, tmp);
+    b.append(tmp, 4);
+}
+
+// Pool di stringhe UTF-8 internate: ogni stringa distinta compare una volta
+class StringPool
+{
+public:
+    quint32 add(const QByteArray &s)
+    {
+        const auto it = m_offsets.constFind(s);
+        if (it != m_offsets.cend())
+            return it.value();
+        const quint32 off = quint32(m_data.size());
+        m_data.append(s);
+        m_offsets.insert(s, off);
+        return off;
+    }
+
+    // Aggiunge (off, len) di s al buffer b
+    void ref(QByteArray &b, const QByteArray &s)
+    {
+        put32(b, add(s));
+        put32(b, quint32(s.size()));
+    }
+
+    const QByteArray &data() const { return m_data; }
+
+private:
+    QByteArray m_data;
+    QHash<QByteArray, quint32> m_offsets;
+};
+
+struct Posting {
+    quint32    docId;
+    qint32     pageNumber;
+    QByteArray pageId;
+};
+
+} // namespace
+
+bool writeTagIndex(const QString &path,
+                   const QList<DocEntry> &pdfs,
+                   const QList<DocEntry> &epubs,
+                   const QList<DocEntry> &notebooks)
+{
+    // 1) Documenti (docId = posizione) e posting raggruppate per tag
+    std::vector<const DocEntry *> docs;
+    QHash<quint32, std::vector<Posting>> byTag; // per TagRef::nameId
+
+    for (const QList<DocEntry> *list : {&pdfs, &epubs, &notebooks}) {
+        for (const DocEntry &d : *list) {
+            const quint32 docId = quint32(docs.size());
+            docs.push_back(&d);
+            for (const TagRef &t : d.tags)
+                byTag[t.nameId].push_back(Posting{docId, t.pageNumber, t.pageId.toString().toUtf8()});
+        }
+    }
+
+    // 2) Tag ordinati per nome UTF-8 (stesso ordine usato dalla binary search)
+    std::vector<std::pair<QByteArray, std::vector<Posting> *>> tags;
+    tags.reserve(size_t(byTag.size()));
+    for (auto it = byTag.begin(); it != byTag.end(); ++it)
+        tags.emplace_back(tagNames().at(it.key()).toUtf8(), &it.value());
+    std::sort(tags.begin(), tags.end(),
+              [](const auto &a, const auto &b) { return a.first < b.first; });
+
+    // 3) Tabelle
+    StringPool pool;
+    QByteArray docRecs, tagRecs, postings;
+    docRecs.reserve(qsizetype(docs.size() * kDocRecSize));
+
+    for (const DocEntry *d : docs) {
+        pool.ref(docRecs, d->uuid.toUtf8());
+        pool.ref(docRecs, d->visibleName.toUtf8());
+        pool.ref(docRecs, d->kind.toUtf8());
+    }
+
+    quint32 postingCount = 0;
+    for (auto &tag : tags) {
+        std::vector<Posting> &list = *tag.second;
+        std::sort(list.begin(), list.end(), [](const Posting &a, const Posting &b) {
+            if (a.docId != b.docId)           return a.docId < b.docId;
+            if (a.pageNumber != b.pageNumber) return a.pageNumber < b.pageNumber;
+            return a.pageId < b.pageId;
+        });
+
+        pool.ref(tagRecs, tag.first);
+        put32(tagRecs, postingCount);
+        put32(tagRecs, quint32(list.size()));
+
+        for (const Posting &p : list) {
+            put32(postings, p.docId);
+            put32(postings, quint32(p.pageNumber));
+            pool.ref(postings, p.pageId);
+        }
+        postingCount += quint32(list.size());
+    }
+
+    // 4) Header + sezioni contigue
+    const quint32 docsOff     = kHeaderSize;
+    const quint32 tagsOff     = docsOff + quint32(docRecs.size());
+    const quint32 postingsOff = tagsOff + quint32(tagRecs.size());
+    const quint32 stringsOff  = postingsOff + quint32(postings.size());
+
+    QByteArray out;
+    out.reserve(qsizetype(stringsOff) + pool.data().size());
+    out.append(kIndexMagic, 4);
+    put32(out, kIndexVersion);
+    put32(out, quint32(docs.size()));
+    put32(out, quint32(tags.size()));
+    put32(out, postingCount);
+    put32(out, docsOff);
+    put32(out, tagsOff);
+    put32(out, postingsOff);
+    put32(out, stringsOff);
+    put32(out, quint32(pool.data().size()));
+    out.append(docRecs);
+    out.append(tagRecs);
+    out.append(postings);
+    out.append(pool.data());
+
+    if (!QDir().mkpath(QFileInfo(path).absolutePath()))
+        return false;
+
+    QSaveFile f(path);
+    if (!f.open(QIODevice::WriteOnly))
+        return false;
+    if (f.write(out) != out.size()) {
+        f.cancelWriting();
+        return false;
+    }
+    return f.commit();
+}
+
+// -------------------------
+//  Lettura (mmap)
+// -------------------------
+quint32 TagIndex::u32(quint32 off) const
+{
+    return qFromLittleEndian<quint32>(m_data + off);
+}
+
+QByteArrayView TagIndex::str(quint32 off, quint32 len) const
+{
+    if (quint64(off) + len > m_stringsSize)
+        return QByteArrayView(); // riferimento fuori dal pool: indice corrotto
+    return QByteArrayView(reinterpret_cast<const char *>(m_data) + m_stringsOff + off, len);
+}
+
+QByteArrayView TagIndex::tagName(quint32 tag) const
+{
+    const quint32 rec = m_tagsOff + tag * kTagRecSize;
+    return str(u32(rec), u32(rec + 4));
+}
+
+bool TagIndex::open(const QString &path)
+{
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::ReadOnly))
+        return false;
+
+    const qint64 size = m_file.size();
+    if (size < kHeaderSize || size > qint64(0xFFFFFFFFu))
+        return false;
+
+    m_data = m_file.map(0, size);
+    if (!m_data)
+        return false;
+    m_size = quint32(size);
+
+    if (std::memcmp(m_data, kIndexMagic, 4) != 0 || u32(4) != kIndexVersion) {
+        m_data = nullptr;
+        return false;
+    }
+
+    m_docCount     = u32(8);
+    m_tagCount     = u32(12);
+    m_postingCount = u32(16);
+    m_docsOff      = u32(20);
+    m_tagsOff      = u32(24);
+    m_postingsOff  = u32(28);
+    m_stringsOff   = u32(32);
+    m_stringsSize  = u32(36);
+
+    // Ogni tabella deve stare nel file (aritmetica a 64 bit: niente overflow)
+    const bool valid =
+        quint64(m_docsOff) + quint64(m_docCount) * kDocRecSize <= m_size &&
+        quint64(m_tagsOff) + quint64(m_tagCount) * kTagRecSize <= m_size &&
+        quint64(m_postingsOff) + quint64(m_postingCount) * kPostingSize <= m_size &&
+        quint64(m_stringsOff) + m_stringsSize <= m_size;
+    if (!valid) {
+        m_data = nullptr;
+        return false;
+    }
+    return true;
+}
+
+QList<TagHit> TagIndex::find(const QString &name, bool prefix) const
+{
+    QList<TagHit> hits;
+    if (!m_data)
+        return hits;
+
+    const QByteArray key = name.toUtf8();
+    const QByteArrayView keyView(key);
+
+    // Primo tag con nome >= key (binary search sui TagRecord ordinati)
+    quint32 lo = 0, hi = m_tagCount;
+    while (lo < hi) {
+        const quint32 mid = lo + (hi - lo) / 2;
+        const QByteArrayView n = tagName(mid);
+        const size_t common = size_t(std::min(n.size(), key.size()));
+        const int c = common ? std::memcmp(n.data(), key.constData(), common) : 0;
+        if (c < 0 || (c == 0 && n.size() < key.size()))
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    for (quint32 tag = lo; tag < m_tagCount; ++tag) {
+        const QByteArrayView n = tagName(tag);
+        const bool match = prefix ? n.startsWith(keyView)
+                                  : (n.size() == key.size() && n.startsWith(keyView));
+        if (!match)
+            break;
+
+        const quint32 rec   = m_tagsOff + tag * kTagRecSize;
+        const quint32 first = u32(rec + 8);
+        const quint32 count = u32(rec + 12);
+        if (quint64(first) + count > m_postingCount)
+            break; // indice corrotto
+
+        const QString tagStr = QString::fromUtf8(n);
+        for (quint32 i = 0; i < count; ++i) {
+            const quint32 p = m_postingsOff + (first + i) * kPostingSize;
+            const quint32 docId = u32(p);
+            if (docId >= m_docCount)
+                continue;
+            const quint32 d = m_docsOff + docId * kDocRecSize;
+
+            TagHit h;
+            h.tag        = tagStr;
+            h.docUuid    = QString::fromUtf8(str(u32(d), u32(d + 4)));
+            h.docTitle   = QString::fromUtf8(str(u32(d + 8), u32(d + 12)));
+            h.docKind    = QString::fromUtf8(str(u32(d + 16), u32(d + 20)));
+            h.pageNumber = qint32(u32(p + 4));
+            h.pageId     = QString::fromUtf8(str(u32(p + 8), u32(p + 12)));
+            hits.append(h);
+        }
+
+        if (!prefix)
+            break; // i nomi sono unici
+    }
+    return hits;
+}
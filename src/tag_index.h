@@ -0,0 +1,63 @@
+#pragma once
+
+#include <QByteArray>
+#include <QFile>
+#include <QList>
+#include <QString>
+#include "model.h"
+
+// Indice globale tag → pagine della libreria, scritto come file binario
+// piatto (little-endian) pensato per essere letto direttamente via mmap:
+//
+//   Header | DocRecord[docs] | TagRecord[tags] | Posting[postings] | stringhe UTF-8
+//
+// I TagRecord sono ordinati per nome (byte UTF-8): ricerca esatta e per
+// prefisso sono una binary search. Le posting di ogni tag sono ordinate per
+// (docId, pageNumber, pageId). Le stringhe sono internate una sola volta.
+
+// Costruisce e scrive (in modo atomico) l'indice dei tag delle tre liste
+bool writeTagIndex(const QString &path,
+                   const QList<DocEntry> &pdfs,
+                   const QList<DocEntry> &epubs,
+                   const QList<DocEntry> &notebooks);
+
+// Una pagina che porta un tag
+struct TagHit {
+    QString tag;
+    QString docUuid;
+    QString docTitle;
+    QString docKind;
+    int     pageNumber = -1; // 0-based; -1 se sconosciuto
+    QString pageId;
+};
+
+// Lettore dell'indice: mappa il file e risponde senza rileggere la libreria
+class TagIndex
+{
+public:
+    TagIndex() = default;
+    TagIndex(const TagIndex &) = delete;
+    TagIndex &operator=(const TagIndex &) = delete;
+
+    // Mappa il file e ne valida header e tabelle
+    bool open(const QString &path);
+
+    quint32 tagCount() const { return m_tagCount; }
+    quint32 docCount() const { return m_docCount; }
+
+    // Pagine con il tag esatto `name`, oppure con tutti i tag che iniziano
+    // con `name` se prefix = true. Ordine: tag, documento, pagina.
+    QList<TagHit> find(const QString &name, bool prefix) const;
+
+private:
+    QByteArrayView str(quint32 off, quint32 len) const;
+    quint32 u32(quint32 off) const;
+    QByteArrayView tagName(quint32 tag) const;
+
+    QFile         m_file;
+    const uchar  *m_data = nullptr;
+    quint32       m_size = 0;
+    quint32       m_docCount = 0, m_tagCount = 0, m_postingCount = 0;
+    quint32       m_docsOff = 0, m_tagsOff = 0, m_postingsOff = 0;
+    quint32       m_stringsOff = 0, m_stringsSize = 0;
+};
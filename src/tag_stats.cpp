@@ -0,0 +1,435 @@
+#include "tag_stats.h"
+
+#include "parallel.h"
+#include "string_table.h"
+
+#include <QHash>
+#include <QtAlgorithms>
+
+#include <algorithm>
+#include <utility>
+
+// -------------------------
+//  PageSet
+// -------------------------
+PageSet PageSet::fromSorted(const std::vector<quint32> &pages)
+{
+    PageSet s;
+    s.m_count = int(pages.size());
+
+    for (size_t i = 0; i < pages.size();) {
+        Container c;
+        c.key = quint16(pages[i] >> 16);
+        size_t end = i;
+        while (end < pages.size() && quint16(pages[end] >> 16) == c.key)
+            ++end;
+        c.count = int(end - i);
+
+        // Bitmap solo se più piccola dell'array (come i container di roaring)
+        const size_t words = size_t(pages[end - 1] & 0xFFFF) / 64 + 1;
+        if (words * sizeof(quint64) < size_t(c.count) * sizeof(quint16)) {
+            c.bits.assign(words, 0);
+            for (size_t k = i; k < end; ++k)
+                c.bits[(pages[k] & 0xFFFF) / 64] |= quint64(1) << (pages[k] % 64);
+        } else {
+            c.array.reserve(size_t(c.count));
+            for (size_t k = i; k < end; ++k)
+                c.array.push_back(quint16(pages[k]));
+        }
+        s.m_containers.push_back(std::move(c));
+        i = end;
+    }
+    return s;
+}
+
+bool PageSet::contains(quint32 page) const
+{
+    const quint16 key = quint16(page >> 16);
+    for (const Container &c : m_containers) {
+        if (c.key == key)
+            return c.contains(quint16(page));
+    }
+    return false;
+}
+
+int PageSet::intersectCount(const PageSet &other) const
+{
+    // Merge sulle key: solo i container dello stesso blocco si toccano
+    int n = 0;
+    auto a = m_containers.begin(), b = other.m_containers.begin();
+    while (a != m_containers.end() && b != other.m_containers.end()) {
+        if (a->key < b->key) {
+            ++a;
+        } else if (b->key < a->key) {
+            ++b;
+        } else {
+            n += a->intersectCount(*b);
+            ++a;
+            ++b;
+        }
+    }
+    return n;
+}
+
+int PageSet::unionCount(const std::vector<const PageSet *> &sets)
+{
+    std::vector<quint16> keys;
+    for (const PageSet *s : sets)
+        for (const Container &c : s->m_containers)
+            keys.push_back(c.key);
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+    int n = 0;
+    std::vector<quint64> words;
+    for (quint16 key : keys) {
+        words.clear();
+        for (const PageSet *s : sets)
+            for (const Container &c : s->m_containers)
+                if (c.key == key)
+                    c.unite(words);
+        for (quint64 w : words)
+            n += int(qPopulationCount(w));
+    }
+    return n;
+}
+
+bool PageSet::Container::contains(quint16 low) const
+{
+    if (isBitmap()) {
+        const size_t w = low / 64;
+        return w < bits.size() && (bits[w] >> (low % 64)) & 1;
+    }
+    return std::binary_search(array.begin(), array.end(), low);
+}
+
+int PageSet::Container::intersectCount(const Container &other) const
+{
+    if (isBitmap() && other.isBitmap()) {
+        const size_t n = std::min(bits.size(), other.bits.size());
+        int c = 0;
+        for (size_t i = 0; i < n; ++i)
+            c += int(qPopulationCount(bits[i] & other.bits[i]));
+        return c;
+    }
+    if (isBitmap() || other.isBitmap()) {
+        const Container &sparse = isBitmap() ? other : *this;
+        const Container &dense  = isBitmap() ? *this : other;
+        int c = 0;
+        for (quint16 p : sparse.array)
+            c += dense.contains(p);
+        return c;
+    }
+
+    // Due array ordinati: merge
+    int c = 0;
+    auto a = array.begin(), b = other.array.begin();
+    while (a != array.end() && b != other.array.end()) {
+        if (*a < *b) {
+            ++a;
+        } else if (*b < *a) {
+            ++b;
+        } else {
+            ++c;
+            ++a;
+            ++b;
+        }
+    }
+    return c;
+}
+
+void PageSet::Container::unite(std::vector<quint64> &words) const
+{
+    if (isBitmap()) {
+        if (words.size() < bits.size())
+            words.resize(bits.size(), 0);
+        for (size_t i = 0; i < bits.size(); ++i)
+            words[i] |= bits[i];
+        return;
+    }
+    if (!array.empty() && words.size() <= size_t(array.back()) / 64)
+        words.resize(size_t(array.back()) / 64 + 1, 0);
+    for (quint16 p : array)
+        words[p / 64] |= quint64(1) << (p % 64);
+}
+
+// -------------------------
+//  TagStats
+// -------------------------
+namespace {
+
+// Risultato di un documento, calcolato da un worker
+struct DocSlot {
+    struct Group {
+        quint32 nameId;
+        PageSet pages;
+        int     unknown; // occorrenze con pagina sconosciuta
+    };
+    std::vector<Group>   groups;
+    std::vector<TagPair> pairs; // a < b per nameId
+    int                  taggedPages = 0;
+};
+
+} // namespace
+
+static void analyzeDocument(const DocEntry &doc, DocSlot &slot)
+{
+    // (nameId, pagina) ordinati: i gruppi per tag sono contigui
+    std::vector<std::pair<quint32, int>> refs;
+    refs.reserve(size_t(doc.tags.size()));
+    for (const TagRef &t : doc.tags)
+        refs.emplace_back(t.nameId, t.pageNumber);
+    std::sort(refs.begin(), refs.end());
+
+    std::vector<quint32> pages;
+    for (size_t i = 0; i < refs.size();) {
+        const quint32 id = refs[i].first;
+        int unknown = 0;
+        pages.clear();
+        for (; i < refs.size() && refs[i].first == id; ++i) {
+            const int p = refs[i].second;
+            if (p < 0)
+                ++unknown;
+            else if (pages.empty() || pages.back() != quint32(p))
+                pages.push_back(quint32(p));
+        }
+        slot.groups.push_back(DocSlot::Group{id, PageSet::fromSorted(pages), unknown});
+    }
+
+    std::vector<const PageSet *> sets;
+    sets.reserve(slot.groups.size());
+    for (const DocSlot::Group &g : slot.groups)
+        sets.push_back(&g.pages);
+    slot.taggedPages = PageSet::unionCount(sets);
+
+    // Coppie di tag del documento: k² intersezioni per k tag distinti,
+    // ognuna lineare nelle parole (o negli elementi) dei due insiemi
+    for (size_t i = 0; i < slot.groups.size(); ++i) {
+        if (slot.groups[i].pages.count() == 0)
+            continue;
+        for (size_t j = i + 1; j < slot.groups.size(); ++j) {
+            const int c = slot.groups[i].pages.intersectCount(slot.groups[j].pages);
+            if (c > 0)
+                slot.pairs.push_back(TagPair{slot.groups[i].nameId, slot.groups[j].nameId, c});
+        }
+    }
+}
+
+void TagStats::build(const std::vector<const DocEntry *> &docs, int jobs)
+{
+    m_documents = int(docs.size());
+    m_taggedPages = 0;
+    m_tags.clear();
+    m_docs.clear();
+    m_pairs.clear();
+
+    std::vector<const DocEntry *> tagged;
+    for (const DocEntry *d : docs)
+        if (!d->tags.isEmpty())
+            tagged.push_back(d);
+
+    std::vector<DocSlot> results(tagged.size());
+    parallelFor(int(tagged.size()), jobs, [&](int i) {
+        analyzeDocument(*tagged[size_t(i)], results[size_t(i)]);
+    });
+
+    // Merge seriale: tabelle indicizzate per nameId, coppie in una hash
+    // sparsa (la matrice densa con decine di migliaia di tag non ci sta)
+    const size_t names = size_t(tagNames().size());
+    std::vector<TagFrequency> byId(names);
+    QHash<quint64, int> pairs;
+    for (size_t i = 0; i < results.size(); ++i) {
+        const DocSlot &s = results[i];
+        const DocEntry *doc = tagged[i];
+        for (const DocSlot::Group &g : s.groups) {
+            TagFrequency &f = byId[g.nameId];
+            f.nameId = g.nameId;
+            f.pages += g.pages.count();
+            f.unknownPages += g.unknown;
+            ++f.documents;
+            if (g.pages.count() > f.heaviestPages) {
+                f.heaviest = doc;
+                f.heaviestPages = g.pages.count();
+            }
+        }
+        for (const TagPair &p : s.pairs)
+            pairs[(quint64(p.a) << 32) | p.b] += p.pages;
+
+        DocDensity d;
+        d.doc = doc;
+        d.taggedPages = s.taggedPages;
+        d.tags = int(s.groups.size());
+        d.density = doc->pages > 0 ? qMin(1.0, double(s.taggedPages) / doc->pages) : 0.0;
+        m_docs.push_back(d);
+        m_taggedPages += s.taggedPages;
+    }
+
+    // Rango alfabetico dei tag usati: un solo ordinamento di stringhe,
+    // poi tutti i confronti sono fra interi
+    std::vector<quint32> used;
+    std::vector<QString> name(names);
+    for (const TagFrequency &f : byId) {
+        if (f.documents > 0) {
+            used.push_back(f.nameId);
+            name[f.nameId] = tagNames().at(f.nameId);
+        }
+    }
+    std::sort(used.begin(), used.end(), [&](quint32 x, quint32 y) { return name[x] < name[y]; });
+    std::vector<int> rank(names, 0);
+    for (size_t r = 0; r < used.size(); ++r)
+        rank[used[r]] = int(r);
+
+    m_tags.reserve(used.size());
+    for (quint32 id : used)
+        m_tags.push_back(byId[id]);
+    std::stable_sort(m_tags.begin(), m_tags.end(), [](const TagFrequency &x, const TagFrequency &y) {
+        return x.pages > y.pages;
+    });
+
+    std::stable_sort(m_docs.begin(), m_docs.end(), [](const DocDensity &x, const DocDensity &y) {
+        if (x.density != y.density)
+            return x.density > y.density;
+        return x.taggedPages > y.taggedPages;
+    });
+
+    m_pairs.reserve(size_t(pairs.size()));
+    for (auto it = pairs.cbegin(); it != pairs.cend(); ++it) {
+        quint32 a = quint32(it.key() >> 32), b = quint32(it.key());
+        if (rank[b] < rank[a])
+            std::swap(a, b);
+        m_pairs.push_back(TagPair{a, b, it.value()});
+    }
+    std::sort(m_pairs.begin(), m_pairs.end(), [&](const TagPair &x, const TagPair &y) {
+        if (x.pages != y.pages)
+            return x.pages > y.pages;
+        if (rank[x.a] != rank[y.a])
+            return rank[x.a] < rank[y.a];
+        return rank[x.b] < rank[y.b];
+    });
+}
+
+// -------------------------
+//  Output
+// -------------------------
+static QString percent(double v)
+{
+    return QString::number(v * 100.0, 'f', 0) + "%";
+}
+
+void printTagStats(const TagStats &stats, int top, QTextStream &out)
+{
+    out << "=== Tag statistics =======================================\n";
+    out << "Documents : " << stats.documents() << " (" << stats.densities().size()
+        << " with tags)\n";
+    out << "Tags      : " << stats.tags().size() << "\n";
+    out << "Tagged    : " << stats.taggedPages() << " page(s)\n";
+
+    out << "Tags by pages:\n";
+    if (stats.tags().empty())
+        out << "  (none)\n";
+    for (size_t i = 0; i < stats.tags().size() && int(i) < top; ++i) {
+        const TagFrequency &f = stats.tags()[i];
+        out << "  - \"" << tagNames().at(f.nameId) << "\": " << f.pages << " page(s) in "
+            << f.documents << " document(s)";
+        if (f.unknownPages > 0)
+            out << ", " << f.unknownPages << " on unknown pages";
+        if (f.heaviest)
+            out << "\n      • Heaviest: \"" << f.heaviest->visibleName << "\" ("
+                << f.heaviestPages << " page(s))";
+        out << "\n";
+    }
+
+    out << "Densest documents:\n";
+    if (stats.densities().empty())
+        out << "  (none)\n";
+    for (size_t i = 0; i < stats.densities().size() && int(i) < top; ++i) {
+        const DocDensity &d = stats.densities()[i];
+        out << "  - \"" << d.doc->visibleName << "\" (" << d.doc->kind << "): "
+            << d.taggedPages << " of ";
+        if (d.doc->pages > 0)
+            out << d.doc->pages << " page(s) tagged (" << percent(d.density) << ")";
+        else
+            out << "? page(s) tagged";
+        out << ", " << d.tags << " tag(s)\n";
+    }
+
+    out << "Tags on the same pages:\n";
+    if (stats.pairs().empty())
+        out << "  (none)\n";
+    for (size_t i = 0; i < stats.pairs().size() && int(i) < top; ++i) {
+        const TagPair &p = stats.pairs()[i];
+        out << "  - \"" << tagNames().at(p.a) << "\" + \"" << tagNames().at(p.b) << "\": "
+            << p.pages << " page(s)\n";
+    }
+    out.flush();
+}
+
+void writeTagStatsJson(const TagStats &stats, OutputSink &sink)
+{
+    sink.append("{\"documents\":");
+    sink.appendNumber(stats.documents());
+    sink.append(",\"taggedPages\":");
+    sink.appendNumber(stats.taggedPages());
+
+    sink.append(",\"tags\":[");
+    bool first = true;
+    for (const TagFrequency &f : stats.tags()) {
+        sink.append(first ? "\n  {\"tag\":" : ",\n  {\"tag\":");
+        first = false;
+        sink.appendJsonString(tagNames().at(f.nameId));
+        sink.append(",\"pages\":");
+        sink.appendNumber(f.pages);
+        sink.append(",\"documents\":");
+        sink.appendNumber(f.documents);
+        sink.append(",\"unknownPages\":");
+        sink.appendNumber(f.unknownPages);
+        sink.append(",\"heaviest\":");
+        if (f.heaviest) {
+            sink.append("{\"uuid\":");
+            sink.appendJsonString(f.heaviest->uuid);
+            sink.append(",\"pages\":");
+            sink.appendNumber(f.heaviestPages);
+            sink.append("}");
+        } else {
+            sink.append("null");
+        }
+        sink.append("}");
+    }
+
+    sink.append("],\"documentsByDensity\":[");
+    first = true;
+    for (const DocDensity &d : stats.densities()) {
+        sink.append(first ? "\n  {\"uuid\":" : ",\n  {\"uuid\":");
+        first = false;
+        sink.appendJsonString(d.doc->uuid);
+        sink.append(",\"name\":");
+        sink.appendJsonString(d.doc->visibleName);
+        sink.append(",\"kind\":");
+        sink.appendJsonString(d.doc->kind);
+        sink.append(",\"pages\":");
+        sink.appendNumber(d.doc->pages);
+        sink.append(",\"taggedPages\":");
+        sink.appendNumber(d.taggedPages);
+        sink.append(",\"tags\":");
+        sink.appendNumber(d.tags);
+        sink.append(",\"density\":");
+        const QByteArray density = QByteArray::number(d.density, 'f', 3);
+        sink.append(density.constData(), density.size());
+        sink.append("}");
+    }
+
+    sink.append("],\"cooccurrence\":[");
+    first = true;
+    for (const TagPair &p : stats.pairs()) {
+        sink.append(first ? "\n  {\"a\":" : ",\n  {\"a\":");
+        first = false;
+        sink.appendJsonString(tagNames().at(p.a));
+        sink.append(",\"b\":");
+        sink.appendJsonString(tagNames().at(p.b));
+        sink.append(",\"pages\":");
+        sink.appendNumber(p.pages);
+        sink.append("}");
+    }
+    sink.append("]}\n");
+    sink.flush();
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <QList>
+#include <QString>
+#include <QTextStream>
+#include <QtGlobal>
+
+#include <vector>
+
+#include "model.h"
+#include "output.h"
+
+// Insieme delle pagine (0-based) di un documento che portano un tag, come
+// una roaring bitmap: i 16 bit alti del numero di pagina scelgono un
+// container, che per i 16 bassi è un array ordinato di quint16 finché è
+// piccolo e una bitmap a parole di 64 bit quando l'array occuperebbe di più.
+// Quasi sempre c'è un solo container; le intersezioni contano i bit comuni
+// (popcount) senza costruire insiemi.
+class PageSet
+{
+public:
+    // `pages` ordinate e senza duplicati
+    static PageSet fromSorted(const std::vector<quint32> &pages);
+
+    int  count() const { return m_count; }
+    bool contains(quint32 page) const;
+
+    // |this ∩ other|
+    int intersectCount(const PageSet &other) const;
+
+    // Pagine distinte nell'unione di più insiemi
+    static int unionCount(const std::vector<const PageSet *> &sets);
+
+private:
+    // Pagine da key << 16 a key << 16 | 0xFFFF
+    struct Container {
+        quint16              key = 0;
+        std::vector<quint16> array; // container sparso
+        std::vector<quint64> bits;  // container denso
+        int                  count = 0;
+
+        bool isBitmap() const { return !bits.empty(); }
+        bool contains(quint16 low) const;
+        int  intersectCount(const Container &other) const;
+        // OR nella bitmap `words` (allargata se serve)
+        void unite(std::vector<quint64> &words) const;
+    };
+
+    std::vector<Container> m_containers; // ordinati per key
+    int                    m_count = 0;
+};
+
+// Un tag con le sue frequenze nella libreria
+struct TagFrequency {
+    quint32 nameId = 0;
+    int     pages = 0;        // pagine taggate (somma sui documenti)
+    int     documents = 0;
+    int     unknownPages = 0; // occorrenze con pagina sconosciuta
+    const DocEntry *heaviest = nullptr; // documento con più pagine del tag
+    int     heaviestPages = 0;
+};
+
+// Densità dei tag di un documento
+struct DocDensity {
+    const DocEntry *doc = nullptr;
+    int    taggedPages = 0; // pagine con almeno un tag
+    int    tags = 0;        // tag distinti
+    double density = 0;     // taggedPages / pagine (0 se sconosciute)
+};
+
+// Due tag sulle stesse pagine: quante, su tutta la libreria
+struct TagPair {
+    quint32 a = 0, b = 0; // nameId, con nome(a) < nome(b)
+    int     pages = 0;
+};
+
+// Statistiche dei tag (--tag-stats): frequenze, densità per documento e
+// matrice di co-occorrenza sparsa. Tutto lavora sui nameId di tagNames():
+// i nomi servono solo per ordinare e stampare il risultato.
+class TagStats
+{
+public:
+    // Documenti con tag: gruppi per tag come PageSet, coppie per documento
+    // sul pool di worker (0 = tutti i core), poi merge seriale
+    void build(const std::vector<const DocEntry *> &docs, int jobs);
+
+    int documents() const { return m_documents; }
+    int taggedPages() const { return m_taggedPages; }
+
+    // Ordinati per pagine decrescenti, poi per nome
+    const std::vector<TagFrequency> &tags() const { return m_tags; }
+    // Ordinati per densità decrescente, poi per pagine taggate
+    const std::vector<DocDensity> &densities() const { return m_docs; }
+    // Ordinate per pagine decrescenti, poi per nomi
+    const std::vector<TagPair> &pairs() const { return m_pairs; }
+
+private:
+    int m_documents = 0;
+    int m_taggedPages = 0;
+    std::vector<TagFrequency> m_tags;
+    std::vector<DocDensity>   m_docs;
+    std::vector<TagPair>      m_pairs;
+};
+
+// Layout dei summary: intestazione "===", campi "Nome : valore", elenchi
+// "  - ..." con le prime `top` righe di ogni sezione
+void printTagStats(const TagStats &stats, int top, QTextStream &out);
+
+// Un solo oggetto JSON con tags, documents e cooccurrence completi
+void writeTagStatsJson(const TagStats &stats, OutputSink &sink);
@@ -0,0 +1,212 @@
+#include "title_search.h"
+#include "scanner.h"
+
+#include <QStringList>
+
+#include <algorithm>
+#include <utility>
+
+// Quota minima di trigrammi della query che un titolo "simile" deve avere
+static const int kFuzzyPercent = 50;
+
+QString foldTitle(const QString &s)
+{
+    const QString nfkd = s.normalized(QString::NormalizationForm_KD);
+    QString out;
+    out.reserve(nfkd.size());
+    bool space = true; // niente spazi iniziali o doppi
+    for (QChar c : nfkd) {
+        if (c.category() == QChar::Mark_NonSpacing)
+            continue; // accento separato dalla lettera dalla NFKD
+        if (c.isLetterOrNumber()) {
+            out.append(c.toCaseFolded());
+            space = false;
+        } else if (!space) {
+            out.append(QLatin1Char(' '));
+            space = true;
+        }
+    }
+    if (out.endsWith(QLatin1Char(' ')))
+        out.chop(1);
+    return out;
+}
+
+namespace {
+
+quint64 trigram(QChar a, QChar b, QChar c)
+{
+    return (quint64(a.unicode()) << 32) | (quint64(b.unicode()) << 16) | quint64(c.unicode());
+}
+
+// `w` compare in `key` all'inizio di una parola (senza allocazioni: la
+// scansione lineare delle query corte lo chiama per ogni titolo)
+bool hasWordPrefix(const QString &key, const QString &w)
+{
+    for (qsizetype pos = key.indexOf(w); pos >= 0; pos = key.indexOf(w, pos + 1))
+        if (pos == 0 || key.at(pos - 1) == QLatin1Char(' '))
+            return true;
+    return false;
+}
+
+// Trigrammi di " " + key: lo spazio iniziale marca l'inizio di parola
+void trigramsOf(const QString &key, std::vector<quint64> &out)
+{
+    const QString padded = QLatin1Char(' ') + key;
+    for (qsizetype i = 0; i + 2 < padded.size(); ++i)
+        out.push_back(trigram(padded.at(i), padded.at(i + 1), padded.at(i + 2)));
+}
+
+} // namespace
+
+void TitleSearch::build(const QList<const QList<DocEntry> *> &lists)
+{
+    m_docs.clear();
+    m_keys.clear();
+    for (const QList<DocEntry> *list : lists) {
+        for (const DocEntry &e : *list) {
+            m_docs.push_back(&e);
+            m_keys.push_back(foldTitle(e.visibleName));
+        }
+    }
+
+    // (trigramma, documento) ordinati e senza doppioni → array compatti
+    std::vector<std::pair<quint64, quint32>> pairs;
+    std::vector<quint64> grams;
+    for (size_t d = 0; d < m_keys.size(); ++d) {
+        grams.clear();
+        trigramsOf(m_keys[d], grams);
+        for (quint64 g : grams)
+            pairs.emplace_back(g, quint32(d));
+    }
+    std::sort(pairs.begin(), pairs.end());
+    pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+
+    m_trigrams.clear();
+    m_offsets.clear();
+    m_postings.clear();
+    m_postings.reserve(pairs.size());
+    for (const auto &p : pairs) {
+        if (m_trigrams.empty() || m_trigrams.back() != p.first) {
+            m_trigrams.push_back(p.first);
+            m_offsets.push_back(quint32(m_postings.size()));
+        }
+        m_postings.push_back(p.second);
+    }
+    m_offsets.push_back(quint32(m_postings.size()));
+    m_built = true;
+}
+
+int TitleSearch::score(int doc, const QString &q, const QStringList &words,
+                       int common, int total) const
+{
+    const QString &key = m_keys[size_t(doc)];
+    if (key == q)
+        return 1000;
+    if (key.startsWith(q))
+        return 900;
+
+    if (hasWordPrefix(key, q))
+        return 800;
+
+    if (words.size() > 1 &&
+        std::all_of(words.begin(), words.end(),
+                    [&key](const QString &w) { return hasWordPrefix(key, w); }))
+        return 700;
+
+    if (key.contains(q))
+        return 600;
+
+    // Simile: proporzionale ai trigrammi in comune (sempre sotto 600)
+    if (total > 0 && common * 100 >= total * kFuzzyPercent)
+        return 100 + 400 * common / total;
+    return 0;
+}
+
+QList<TitleHit> TitleSearch::find(const QString &query, int limit, const QString &kind) const
+{
+    QList<TitleHit> hits;
+    const QString q = foldTitle(query);
+    if (q.isEmpty() || limit <= 0)
+        return hits;
+    const QStringList words = q.split(QLatin1Char(' '), Qt::SkipEmptyParts);
+
+    std::vector<TitleHit> found;
+    auto consider = [&](int d, int common, int total) {
+        if (!kind.isEmpty() && m_docs[size_t(d)]->kind != kind)
+            return;
+        const int s = score(d, q, words, common, total);
+        if (s > 0)
+            found.push_back(TitleHit{m_docs[size_t(d)], s});
+    };
+
+    // Trigramma d'inizio parola (" " + prime due lettere) di ogni parola della
+    // query: un titolo con tutte le parole come prefissi (fascia 700) li ha
+    // tutti, anche quando i trigrammi in comune restano sotto la soglia
+    std::vector<quint64> starts;
+    if (words.size() > 1) {
+        for (const QString &w : words)
+            if (w.size() >= 2)
+                starts.push_back(trigram(QLatin1Char(' '), w.at(0), w.at(1)));
+        std::sort(starts.begin(), starts.end());
+        starts.erase(std::unique(starts.begin(), starts.end()), starts.end());
+    }
+
+    if (q.size() < 3 || (words.size() > 1 && starts.empty())) {
+        // Troppo corta per i trigrammi, o fatta solo di parole di una lettera
+        // (nessun trigramma d'inizio parola): scansione lineare con titolo
+        // esatto, prefissi di parola e sottostringhe (niente somiglianza)
+        for (size_t d = 0; d < m_keys.size(); ++d)
+            consider(int(d), 0, 0);
+    } else {
+        // Conta per documento i trigrammi della query presenti nel titolo e,
+        // a parte, quelli d'inizio parola
+        std::vector<quint64> grams;
+        trigramsOf(q, grams);
+        std::sort(grams.begin(), grams.end());
+        grams.erase(std::unique(grams.begin(), grams.end()), grams.end());
+        const int total = int(grams.size());
+
+        std::vector<quint16> counts(m_docs.size(), 0);
+        std::vector<quint16> startHits(starts.empty() ? 0 : m_docs.size(), 0);
+        std::vector<quint32> touched;
+        for (quint64 g : grams) {
+            const auto it = std::lower_bound(m_trigrams.begin(), m_trigrams.end(), g);
+            if (it == m_trigrams.end() || *it != g)
+                continue;
+            const bool start = std::binary_search(starts.begin(), starts.end(), g);
+            const size_t t = size_t(it - m_trigrams.begin());
+            for (quint32 i = m_offsets[t]; i < m_offsets[t + 1]; ++i) {
+                const quint32 d = m_postings[i];
+                if (counts[d]++ == 0)
+                    touched.push_back(d);
+                if (start)
+                    ++startHits[d];
+            }
+        }
+
+        // Un titolo che contiene la query ha tutti i suoi trigrammi tranne,
+        // al più, quello con lo spazio iniziale: la soglia non perde le
+        // sottostringhe. Le parole come prefissi sparse nel titolo passano
+        // per i trigrammi d'inizio parola; score() decide il resto.
+        const size_t nStarts = starts.size();
+        for (quint32 d : touched)
+            if (counts[d] * 100 >= total * kFuzzyPercent ||
+                (nStarts > 0 && startHits[d] == nStarts))
+                consider(int(d), counts[d], total);
+    }
+
+    auto better = [](const TitleHit &a, const TitleHit &b) {
+        if (a.score != b.score)
+            return a.score > b.score;
+        if (a.doc->visibleName.size() != b.doc->visibleName.size())
+            return a.doc->visibleName.size() < b.doc->visibleName.size();
+        return docLessByName(*a.doc, *b.doc);
+    };
+    const size_t n = std::min(found.size(), size_t(limit));
+    std::partial_sort(found.begin(), found.begin() + std::ptrdiff_t(n), found.end(), better);
+
+    hits.reserve(qsizetype(n));
+    for (size_t i = 0; i < n; ++i)
+        hits.append(found[i]);
+    return hits;
+}
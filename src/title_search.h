@@ -0,0 +1,54 @@
+#pragma once
+
+#include <QList>
+#include <QString>
+
+#include <vector>
+
+#include "model.h"
+
+// Un risultato della ricerca per titolo
+struct TitleHit {
+    const DocEntry *doc = nullptr;
+    int             score = 0; // più alto = più rilevante
+};
+
+// Ricerca per titolo del menu interattivo (/testo).
+//
+// Le chiavi sono i visibleName piegati (foldTitle: senza accenti né
+// maiuscole, punteggiatura ridotta a spazi). Per query di almeno 3
+// caratteri un indice a trigrammi (array ordinato trigramma → documenti,
+// come le posting di tag_index) trova i candidati senza scorrere i titoli:
+// almeno metà dei trigrammi della query, oppure (più parole) i trigrammi
+// d'inizio di tutte le parole. Le query più corte, o di sole parole di una
+// lettera, scorrono le chiavi (confronti senza allocazioni).
+//
+// Ranking: titolo identico > inizio del titolo > inizio di una parola >
+// tutte le parole della query come prefissi > sottostringa > simile
+// (almeno metà dei trigrammi in comune). A parità vince il titolo più corto.
+//
+// I puntatori restano validi finché le liste passate a build() non cambiano.
+class TitleSearch
+{
+public:
+    void build(const QList<const QList<DocEntry> *> &lists);
+    bool isBuilt() const { return m_built; }
+
+    // Al più `limit` risultati, ordinati per rilevanza. `kind` vuoto = tutti
+    QList<TitleHit> find(const QString &query, int limit, const QString &kind = QString()) const;
+
+private:
+    int score(int doc, const QString &q, const QStringList &words,
+              int common, int total) const;
+
+    std::vector<const DocEntry *> m_docs;
+    std::vector<QString>          m_keys;     // titoli piegati
+    std::vector<quint64>          m_trigrams; // chiavi distinte, ordinate
+    std::vector<quint32>          m_offsets;  // posting di m_trigrams[i]: [off[i], off[i+1])
+    std::vector<quint32>          m_postings; // id documento, crescenti
+    bool                          m_built = false;
+};
+
+// Titolo → chiave di ricerca: NFKD senza segni diacritici, case folding,
+// tutto ciò che non è lettera o cifra diventa un solo spazio
+QString foldTitle(const QString &s);
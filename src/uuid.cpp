@@ -0,0 +1,122 @@
+#include "uuid.h"
+#include "string_table.h"
+
+// m_hi = kEscape → m_lo è l'indice della stringa in rawIds()
+static const quint64 kEscape = ~quint64(0);
+
+// Stringhe non canoniche usate come UUID
+static StringTable &rawIds()
+{
+    static StringTable table;
+    return table;
+}
+
+static int hexValue(char16_t u)
+{
+    if (u >= '0' && u <= '9') return u - '0';
+    if (u >= 'a' && u <= 'f') return u - 'a' + 10;
+    return -1; // maiuscole incluse: non round-trip, vanno in escape
+}
+
+// Forma canonica minuscola 8-4-4-4-12 → due parole; false se non lo è.
+// `at(i)` restituisce l'unità i-esima (QChar o byte UTF-8)
+template <typename At>
+static bool parseCanonical(qsizetype size, At at, quint64 (&words)[2])
+{
+    if (size != 36)
+        return false;
+    int nibbles = 0;
+    for (int i = 0; i < 36; ++i) {
+        if (i == 8 || i == 13 || i == 18 || i == 23) {
+            if (at(i) != '-')
+                return false;
+            continue;
+        }
+        const int v = hexValue(at(i));
+        if (v < 0)
+            return false;
+        quint64 &w = words[nibbles / 16];
+        w = (w << 4) | quint64(v);
+        ++nibbles;
+    }
+    // Il nil UUID e i valori con m_hi = kEscape collidono con le codifiche
+    // riservate: passano anche loro dalla tabella
+    return !(words[0] == 0 && words[1] == 0) && words[0] != kEscape;
+}
+
+Uuid Uuid::fromString(const QString &s)
+{
+    Uuid u;
+    if (s.isEmpty())
+        return u;
+
+    quint64 words[2] = {0, 0};
+    if (parseCanonical(s.size(), [&s](int i) { return s.at(i).unicode(); }, words)) {
+        u.m_hi = words[0];
+        u.m_lo = words[1];
+        return u;
+    }
+
+    u.m_hi = kEscape;
+    u.m_lo = rawIds().intern(s);
+    return u;
+}
+
+Uuid Uuid::fromUtf8(const char *data, qsizetype size)
+{
+    Uuid u;
+    if (size <= 0)
+        return u;
+
+    quint64 words[2] = {0, 0};
+    if (parseCanonical(size, [data](int i) { return char16_t(uchar(data[i])); }, words)) {
+        u.m_hi = words[0];
+        u.m_lo = words[1];
+        return u;
+    }
+
+    u.m_hi = kEscape;
+    u.m_lo = rawIds().internUtf8(data, size);
+    return u;
+}
+
+bool Uuid::lookup(const QString &s, Uuid &out)
+{
+    out = Uuid();
+    if (s.isEmpty())
+        return true;
+
+    quint64 words[2] = {0, 0};
+    if (parseCanonical(s.size(), [&s](int i) { return s.at(i).unicode(); }, words)) {
+        out.m_hi = words[0];
+        out.m_lo = words[1];
+        return true;
+    }
+
+    quint32 id;
+    if (!rawIds().find(s, id))
+        return false;
+    out.m_hi = kEscape;
+    out.m_lo = id;
+    return true;
+}
+
+QString Uuid::toString() const
+{
+    if (isNull())
+        return QString();
+    if (m_hi == kEscape)
+        return rawIds().at(quint32(m_lo));
+
+    static const char digits[] = "0123456789abcdef";
+    QChar buf[36];
+    int pos = 0;
+    for (int n = 0; n < 32; ++n) {
+        if (n == 8 || n == 12 || n == 16 || n == 20)
+            buf[pos++] = QLatin1Char('-');
+        const quint64 w = n < 16 ? m_hi : m_lo;
+        const int shift = (15 - n % 16) * 4;
+        buf[pos++] = QLatin1Char(digits[(w >> shift) & 0xF]);
+    }
+    return QString(buf, 36);
+}
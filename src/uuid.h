@@ -0,0 +1,37 @@
+#pragma once
+
+#include <QHashFunctions>
+#include <QString>
+
+// UUID in 16 byte al posto di una QString da 36 caratteri UTF-16.
+// Solo la forma canonica minuscola (8-4-4-4-12) è codificata in binario;
+// qualunque altra stringa (maiuscole, id non standard) viene internata e
+// salvata come escape, così toString() restituisce sempre l'originale.
+class Uuid
+{
+public:
+    Uuid() = default; // nullo = stringa vuota
+
+    static Uuid fromString(const QString &s);
+    // Stesso risultato di fromString(QString::fromUtf8(data, size)), senza
+    // allocare per la forma canonica
+    static Uuid fromUtf8(const char *data, qsizetype size);
+    // Come fromString(), ma non interna nulla: false se s non è canonica e
+    // non è mai stata vista, cioè nessun Uuid esistente può valere s.
+    // Per le stringhe degli utenti, che non devono far crescere la tabella
+    static bool lookup(const QString &s, Uuid &out);
+    QString toString() const;
+
+    bool isNull() const { return m_hi == 0 && m_lo == 0; }
+
+    friend bool operator==(const Uuid &a, const Uuid &b)
+    { return a.m_hi == b.m_hi && a.m_lo == b.m_lo; }
+    friend bool operator!=(const Uuid &a, const Uuid &b) { return !(a == b); }
+
+    friend size_t qHash(const Uuid &u, size_t seed = 0)
+    { return qHashMulti(seed, u.m_hi, u.m_lo); }
+
+private:
+    quint64 m_hi = 0;
+    quint64 m_lo = 0;
+};
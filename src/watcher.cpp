@@ -0,0 +1,240 @@
+#include "watcher.h"
+#include "excerpts.h"
+#include "export.h"
+#include "highlights.h"
+#include "ink.h"
+#include "logging.h"
+#include "pdf_summary.h"
+#include "paths.h"
+#include "tag_index.h"
+
+#include <QFile>
+
+#include <algorithm>
+#include <cerrno>
+
+#include <sys/inotify.h>
+#include <unistd.h>
+
+// xochitl riscrive più file per ogni salvataggio: si aspetta una pausa di
+// kDebounceMs, ma mai oltre kMaxLatencyMs dal primo evento del burst
+static const int kDebounceMs   = 750;
+static const int kMaxLatencyMs = 5000;
+
+// Oltre questo numero di UUID in attesa si fa una scansione completa
+static const int kMaxPending   = 1024;
+
+static const uint32_t kWatchMask =
+    IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE;
+
+LibraryWatcher::LibraryWatcher(QList<DocEntry>& pdfs,
+                               QList<DocEntry>& epubs,
+                               QList<DocEntry>& notebooks,
+                               QList<DocEntry>& folders,
+                               const ScanOptions& opts,
+                               QTextStream& log)
+    : m_pdfs(pdfs)
+    , m_epubs(epubs)
+    , m_notebooks(notebooks)
+    , m_folders(folders)
+    , m_opts(opts)
+    , m_log(log)
+{
+    // Le entry devono restare complete: tag index e summary ne dipendono
+    m_opts.lazy = false;
+
+    m_debounce.setSingleShot(true);
+    QObject::connect(&m_debounce, &QTimer::timeout, [this]() { flush(); });
+}
+
+LibraryWatcher::~LibraryWatcher()
+{
+    m_notifier.reset();
+    if (m_fd >= 0)
+        ::close(m_fd);
+}
+
+bool LibraryWatcher::start()
+{
+    m_fd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_fd < 0)
+        return false;
+
+    if (::inotify_add_watch(m_fd, xochitlBase().toLocal8Bit().constData(), kWatchMask) < 0) {
+        ::close(m_fd);
+        m_fd = -1;
+        return false;
+    }
+
+    m_notifier = std::make_unique<QSocketNotifier>(m_fd, QSocketNotifier::Read);
+    QObject::connect(m_notifier.get(), &QSocketNotifier::activated,
+                     [this]() { readEvents(); });
+    return true;
+}
+
+void LibraryWatcher::readEvents()
+{
+    // Buffer fisso: gli eventi non letti restano nella coda del kernel
+    alignas(struct inotify_event) char buf[16 * 1024];
+
+    for (;;) {
+        const ssize_t n = ::read(m_fd, buf, sizeof(buf));
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR)
+                continue;
+            return; // EAGAIN: coda vuota
+        }
+
+        for (ssize_t off = 0; off < n; ) {
+            const auto* ev = reinterpret_cast<const struct inotify_event*>(buf + off);
+            off += ssize_t(sizeof(struct inotify_event) + ev->len);
+
+            if (ev->mask & IN_Q_OVERFLOW) {
+                // Il kernel ha perso eventi: non si sa cosa è cambiato
+                m_overflow = true;
+                queue(QString());
+                continue;
+            }
+            if (ev->mask & IN_IGNORED) {
+                m_log << "[watch] " << xochitlBase() << " is no longer watched\n";
+                m_log.flush();
+                continue;
+            }
+            if (ev->len == 0)
+                continue;
+
+            // Solo <uuid>.metadata e <uuid>.content; il resto (.pdf, .rm, ...) non
+            // cambia le entry
+            const QString name = QString::fromLocal8Bit(ev->name);
+            QString uuid;
+            if (name.endsWith(QLatin1String(".metadata")))
+                uuid = name.chopped(9);
+            else if (name.endsWith(QLatin1String(".content")))
+                uuid = name.chopped(8);
+            if (!uuid.isEmpty())
+                queue(uuid);
+        }
+    }
+}
+
+void LibraryWatcher::queue(const QString& uuid)
+{
+    if (!m_overflow) {
+        if (m_pending.size() >= kMaxPending) {
+            m_overflow = true;
+        } else {
+            m_pending.insert(uuid);
+        }
+    }
+    if (m_overflow && !m_pending.isEmpty()) {
+        m_pending.clear();
+        m_pending.squeeze();
+    }
+
+    // Debounce: ogni evento rimanda il flush, entro kMaxLatencyMs dal primo
+    if (!m_debounce.isActive())
+        m_firstEvent.start();
+    const int remaining = kMaxLatencyMs - int(m_firstEvent.elapsed());
+    m_debounce.start(std::max(0, std::min(kDebounceMs, remaining)));
+}
+
+void LibraryWatcher::flush()
+{
+    const int count = m_pending.size();
+
+    if (m_overflow) {
+        rescanAll();
+        m_log << "[watch] full rescan: "
+              << (m_pdfs.size() + m_epubs.size() + m_notebooks.size())
+              << " document(s)\n";
+    } else {
+        for (const QString& uuid : std::as_const(m_pending))
+            rescanOne(uuid);
+        m_log << "[watch] updated " << count << " document(s)\n";
+    }
+    m_log.flush();
+
+    m_pending.clear();
+    m_pending.squeeze();
+    m_overflow = false;
+
+    if (!writeTagIndex(mirtilloShareBase() + "/tag_index.bin", m_pdfs, m_epubs, m_notebooks))
+        qCWarning(lcWatch, "cannot write tag index");
+
+    if (m_onChange)
+        m_onChange();
+}
+
+void LibraryWatcher::rescanAll()
+{
+    QList<DocEntry> pdfs, epubs, notebooks, folders;
+    ScanStats stats;
+    if (!scanDocuments(pdfs, epubs, notebooks, stats, m_opts, &folders))
+        return; // directory sparita: si tengono le liste precedenti
+
+    std::sort(pdfs.begin(),      pdfs.end(),      docLessByName);
+    std::sort(epubs.begin(),     epubs.end(),     docLessByName);
+    std::sort(notebooks.begin(), notebooks.end(), docLessByName);
+    std::sort(folders.begin(),   folders.end(),   docLessByName);
+
+    m_pdfs = pdfs;
+    m_epubs = epubs;
+    m_notebooks = notebooks;
+    m_folders = folders;
+
+    for (const QList<DocEntry>* list : {&m_pdfs, &m_epubs, &m_notebooks})
+        for (const DocEntry& e : *list)
+            refreshSummary(e);
+}
+
+void LibraryWatcher::rescanOne(const QString& uuid)
+{
+    // Il documento può aver cambiato tipo, nome o essere finito nel cestino:
+    // si toglie da tutte le liste e si reinserisce se ancora valido
+    auto sameUuid = [&uuid](const DocEntry& e) { return e.uuid == uuid; };
+    m_pdfs.removeIf(sameUuid);
+    m_epubs.removeIf(sameUuid);
+    m_notebooks.removeIf(sameUuid);
+    m_folders.removeIf(sameUuid);
+
+    DocScan r;
+    scanDocument(uuid, r);
+    if (r.outcome != DocOutcome::Ok)
+        return;
+
+    QList<DocEntry>* list = nullptr;
+    if (r.entry.kind == "pdf")           list = &m_pdfs;
+    else if (r.entry.kind == "epub")     list = &m_epubs;
+    else if (r.entry.kind == "notebook") list = &m_notebooks;
+    else if (r.entry.kind == "folder")   list = &m_folders;
+    else                                 return; // ignora altri tipi
+
+    // Inserimento ordinato: stesso ordine del sort dopo la scansione iniziale
+    const auto pos = std::upper_bound(list->begin(), list->end(), r.entry, docLessByName);
+    list->insert(pos, r.entry);
+
+    if (list != &m_folders)
+        refreshSummary(r.entry);
+}
+
+void LibraryWatcher::refreshSummary(const DocEntry& e)
+{
+    // Solo i summary che l'utente ha già esportato vengono riscritti
+    const bool text = QFile::exists(summaryPath(e.uuid));
+    const bool pdf  = QFile::exists(summaryPdfPath(e.uuid));
+    if (!text && !pdf)
+        return;
+
+    // Highlight, inchiostro ed estratti si leggono su una copia: le liste
+    // restano leggere
+    DocEntry full = e;
+    loadDocumentHighlights(full);
+    loadDocumentInk(full);
+    loadDocumentExcerpts(full);
+
+    QString error;
+    if (text && !writeSummaryFile(full, error))
+        qCWarning(lcWatch, "%s", qPrintable(error));
+    if (pdf && !writeSummaryPdf(full, error))
+        qCWarning(lcWatch, "%s", qPrintable(error));
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QList>
+#include <QSet>
+#include <QSocketNotifier>
+#include <QString>
+#include <QTextStream>
+#include <QTimer>
+
+#include <functional>
+#include <memory>
+
+#include "model.h"
+#include "scanner.h"
+
+// Modalità --watch: dopo la scansione iniziale resta residente e segue la
+// directory xochitl via inotify. Gli eventi su .metadata/.content vengono
+// raccolti per UUID e, dopo una pausa (debounce), solo quei documenti sono
+// riscansionati; poi si aggiornano l'indice dei tag e i summary già esportati.
+// Anche le cartelle (lista `folders`) seguono le modifiche.
+//
+// Memoria limitata: il buffer di lettura è fisso e l'insieme dei UUID in
+// attesa ha un tetto oltre il quale si ripiega su una scansione completa
+// (lo stesso accade con IN_Q_OVERFLOW del kernel).
+class LibraryWatcher
+{
+public:
+    LibraryWatcher(QList<DocEntry>& pdfs,
+                   QList<DocEntry>& epubs,
+                   QList<DocEntry>& notebooks,
+                   QList<DocEntry>& folders,
+                   const ScanOptions& opts,
+                   QTextStream& log);
+    ~LibraryWatcher();
+
+    LibraryWatcher(const LibraryWatcher&) = delete;
+    LibraryWatcher& operator=(const LibraryWatcher&) = delete;
+
+    // Apre inotify sulla directory xochitl; false se non disponibile
+    bool start();
+
+    // Chiamata dopo ogni aggiornamento delle liste (es. per invalidare
+    // indici costruiti sopra di esse, come quelli di QueryServer)
+    void setChangeHandler(std::function<void()> fn) { m_onChange = std::move(fn); }
+
+private:
+    void readEvents();
+    void queue(const QString& uuid);
+    void flush();
+    void rescanAll();
+    void rescanOne(const QString& uuid);
+    void refreshSummary(const DocEntry& e);
+
+    QList<DocEntry>& m_pdfs;
+    QList<DocEntry>& m_epubs;
+    QList<DocEntry>& m_notebooks;
+    QList<DocEntry>& m_folders;
+    ScanOptions      m_opts;
+    QTextStream&     m_log;
+
+    int m_fd = -1;
+    std::unique_ptr<QSocketNotifier> m_notifier;
+    QTimer        m_debounce;
+    QElapsedTimer m_firstEvent; // primo evento del burst corrente
+    QSet<QString> m_pending;    // UUID da riscansionare
+    bool          m_overflow = false;
+    std::function<void()> m_onChange;
+};
@@ -0,0 +1,150 @@
+#include "zip_reader.h"
+
+#include <QtEndian>
+
+#include <zlib.h>
+
+static const quint32 kEndOfCentralDir = 0x06054b50;
+static const quint32 kCentralHeader   = 0x02014b50;
+static const quint32 kLocalHeader     = 0x04034b50;
+
+// Blocco di output dell'inflate
+static const qsizetype kChunk = 16 * 1024;
+
+static quint16 le16(const uchar *p) { return qFromLittleEndian<quint16>(p); }
+static quint32 le32(const uchar *p) { return qFromLittleEndian<quint32>(p); }
+
+ZipReader::~ZipReader()
+{
+    if (m_data)
+        m_file.unmap(const_cast<uchar *>(m_data));
+}
+
+bool ZipReader::open(const QString &path)
+{
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::ReadOnly))
+        return false;
+    m_size = m_file.size();
+    if (m_size < 22 || m_size > qint64(0xFFFFFFFF))
+        return false;
+    m_data = m_file.map(0, m_size);
+    if (!m_data)
+        return false;
+
+    // End of central directory: ultimi 22 byte + commento (max 64 KiB)
+    const qint64 lowest = qMax<qint64>(0, m_size - 22 - 0xFFFF);
+    qint64 eocd = -1;
+    for (qint64 i = m_size - 22; i >= lowest; --i) {
+        if (le32(m_data + i) == kEndOfCentralDir) {
+            eocd = i;
+            break;
+        }
+    }
+    if (eocd < 0)
+        return false;
+
+    const quint16 count  = le16(m_data + eocd + 10);
+    const quint32 cdSize = le32(m_data + eocd + 12);
+    const quint32 cdOff  = le32(m_data + eocd + 16);
+    if (qint64(cdOff) + cdSize > eocd)
+        return false;
+
+    m_entries.reserve(count);
+    qint64 p = cdOff;
+    const qint64 end = qint64(cdOff) + cdSize;
+    for (quint16 i = 0; i < count; ++i) {
+        if (p + 46 > end || le32(m_data + p) != kCentralHeader)
+            return false;
+        const quint16 nameLen    = le16(m_data + p + 28);
+        const quint16 extraLen   = le16(m_data + p + 30);
+        const quint16 commentLen = le16(m_data + p + 32);
+        if (p + 46 + nameLen > end)
+            return false;
+
+        ZipEntry e;
+        e.method         = le16(m_data + p + 10);
+        e.compressedSize = le32(m_data + p + 20);
+        e.size           = le32(m_data + p + 24);
+        e.localOffset    = le32(m_data + p + 42);
+        m_entries.insert(QByteArray(reinterpret_cast<const char *>(m_data + p + 46), nameLen), e);
+        p += 46 + nameLen + extraLen + commentLen;
+    }
+    return true;
+}
+
+const ZipEntry *ZipReader::find(const QByteArray &name) const
+{
+    const auto it = m_entries.constFind(name);
+    return it == m_entries.cend() ? nullptr : &*it;
+}
+
+bool ZipReader::read(const ZipEntry &entry,
+                     const std::function<bool(const char *, qsizetype)> &fn) const
+{
+    // I dati iniziano dopo l'header locale, i cui campi variabili possono
+    // differire da quelli della central directory
+    const qint64 h = entry.localOffset;
+    if (!m_data || h + 30 > m_size || le32(m_data + h) != kLocalHeader)
+        return false;
+    const qint64 data = h + 30 + le16(m_data + h + 26) + le16(m_data + h + 28);
+    if (data + entry.compressedSize > m_size)
+        return false;
+    const uchar *in = m_data + data;
+
+    if (entry.method == 0) {
+        for (qint64 off = 0; off < entry.compressedSize; off += kChunk) {
+            const qsizetype n = qsizetype(qMin<qint64>(kChunk, entry.compressedSize - off));
+            if (!fn(reinterpret_cast<const char *>(in + off), n))
+                return true;
+        }
+        return true;
+    }
+    if (entry.method != 8)
+        return false;
+
+    z_stream zs = {};
+    if (inflateInit2(&zs, -MAX_WBITS) != Z_OK) // deflate raw, senza header zlib
+        return false;
+    zs.next_in  = const_cast<Bytef *>(in);
+    zs.avail_in = uInt(entry.compressedSize);
+
+    char out[kChunk];
+    bool ok = true;
+    for (;;) {
+        zs.next_out  = reinterpret_cast<Bytef *>(out);
+        zs.avail_out = uInt(sizeof out);
+        const int rc = inflate(&zs, Z_NO_FLUSH);
+        if (rc != Z_OK && rc != Z_STREAM_END) {
+            ok = false;
+            break;
+        }
+        const qsizetype n = qsizetype(sizeof out - zs.avail_out);
+        if (n > 0 && !fn(out, n))
+            break;
+        if (rc == Z_STREAM_END)
+            break;
+        if (n == 0 && zs.avail_in == 0) { // stream troncato
+            ok = false;
+            break;
+        }
+    }
+    inflateEnd(&zs);
+    return ok;
+}
+
+bool ZipReader::readAll(const ZipEntry &entry, qsizetype limit, QByteArray &out) const
+{
+    out.clear();
+    out.reserve(qsizetype(qMin<qint64>(entry.size, limit)));
+    bool tooBig = false;
+    const bool ok = read(entry, [&](const char *p, qsizetype n) {
+        if (out.size() + n > limit) {
+            tooBig = true;
+            return false;
+        }
+        out.append(p, n);
+        return true;
+    });
+    return ok && !tooBig;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <QByteArray>
+#include <QFile>
+#include <QHash>
+#include <QString>
+
+#include <functional>
+
+// Lettore minimo di archivi ZIP (i .epub): il file è mappato, la central
+// directory letta una volta all'apertura, e ogni voce viene inflata in
+// streaming a blocchi (zlib, deflate raw) solo quando serve. Chi legge può
+// fermarsi a metà: il resto della voce non viene decompresso.
+// Supportati solo i metodi 0 (stored) e 8 (deflate); niente ZIP64 né
+// cifratura (gli EPUB non li usano).
+
+struct ZipEntry {
+    quint16 method = 0;
+    quint32 compressedSize = 0;
+    quint32 size = 0;           // dimensione decompressa dichiarata
+    quint32 localOffset = 0;    // header locale
+};
+
+class ZipReader
+{
+public:
+    ZipReader() = default;
+    ZipReader(const ZipReader &) = delete;
+    ZipReader &operator=(const ZipReader &) = delete;
+    ~ZipReader();
+
+    // Mappa il file e legge la central directory. false se non è uno ZIP valido
+    bool open(const QString &path);
+
+    const ZipEntry *find(const QByteArray &name) const;
+
+    // Blocchi decompressi della voce, in ordine. fn restituisce false per
+    // fermarsi (non è un errore). false = voce corrotta o metodo non supportato
+    bool read(const ZipEntry &entry,
+              const std::function<bool(const char *, qsizetype)> &fn) const;
+
+    // Voce intera, al massimo `limit` byte (file piccoli: container, OPF)
+    bool readAll(const ZipEntry &entry, qsizetype limit, QByteArray &out) const;
+
+private:
+    QFile        m_file;
+    const uchar *m_data = nullptr;
+    qint64       m_size = 0;
+    QHash<QByteArray, ZipEntry> m_entries;
+};
@@ -0,0 +1,67 @@
+#include "alloc_count.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+
+static std::atomic<bool>    g_enabled{false};
+static std::atomic<quint64> g_calls{0};
+static std::atomic<quint64> g_bytes{0};
+
+static inline void count(std::size_t n)
+{
+    if (!g_enabled.load(std::memory_order_relaxed))
+        return;
+    g_calls.fetch_add(1, std::memory_order_relaxed);
+    g_bytes.fetch_add(n, std::memory_order_relaxed);
+}
+
+#if defined(__GLIBC__)
+
+// Punti d'ingresso interni di glibc, esportati: ridefinire malloc
+// nell'eseguibile sostituisce quello usato da Qt e da libstdc++, free
+// compreso, e la memoria continua a venire dallo stesso allocatore.
+extern "C" {
+void *__libc_malloc(std::size_t size);
+void *__libc_calloc(std::size_t n, std::size_t size);
+void *__libc_realloc(void *p, std::size_t size);
+
+void *malloc(std::size_t size)
+{
+    count(size);
+    return __libc_malloc(size);
+}
+
+void *calloc(std::size_t n, std::size_t size)
+{
+    count(n * size);
+    return __libc_calloc(n, size);
+}
+
+void *realloc(void *p, std::size_t size)
+{
+    count(size);
+    return __libc_realloc(p, size);
+}
+}
+
+bool allocCountAvailable() { return true; }
+
+#else
+
+bool allocCountAvailable() { return false; }
+
+#endif
+
+void enableAllocCount()
+{
+    g_enabled.store(true, std::memory_order_relaxed);
+}
+
+AllocCount allocCount()
+{
+    AllocCount c;
+    c.calls = g_calls.load(std::memory_order_relaxed);
+    c.bytes = g_bytes.load(std::memory_order_relaxed);
+    return c;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <QtGlobal>
+
+// Conteggio delle allocazioni di tutto il processo (mirtillo_bench --check).
+// malloc/calloc/realloc sono ridefiniti nell'eseguibile e inoltrati
+// all'allocatore di glibc: così si contano anche QString, QHash & co., che
+// non passano da operator new. Su libc diverse da glibc il conteggio non
+// è disponibile e allocCountAvailable() è false.
+
+struct AllocCount {
+    quint64 calls = 0; // malloc + calloc + realloc
+    quint64 bytes = 0; // byte richiesti
+};
+
+bool allocCountAvailable();
+
+// Il conteggio parte spento: i tempi del benchmark normale non pagano
+// gli incrementi atomici condivisi fra i worker
+void enableAllocCount();
+
+// Totali dall'avvio; i budget usano la differenza fra due letture
+AllocCount allocCount();
@@ -0,0 +1,480 @@
+#include "corpus.h"
+
+#include <QDir>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QRandomGenerator>
+#include <QStringList>
+#include <QtEndian>
+
+#include <cstring>
+
+#include <zlib.h>
+
+// UUID v4 deterministico (dipende solo dal seed)
+static QString makeUuid(QRandomGenerator &rng)
+{
+    quint64 hi = rng.generate64();
+    quint64 lo = rng.generate64();
+    hi = (hi & ~quint64(0xF000)) | quint64(0x4000);       // versione 4
+    lo = (lo & ~(quint64(3) << 62)) | (quint64(2) << 62); // variante RFC 4122
+    return QString::asprintf("%08llx-%04llx-%04llx-%04llx-%012llx",
+                             (unsigned long long)(hi >> 32),
+                             (unsigned long long)((hi >> 16) & 0xFFFF),
+                             (unsigned long long)(hi & 0xFFFF),
+                             (unsigned long long)(lo >> 48),
+                             (unsigned long long)(lo & 0xFFFFFFFFFFFFULL));
+}
+
+static bool writeFile(const QString &path, const QByteArray &data,
+                      CorpusResult &result, QString &error)
+{
+    QFile f(path);
+    if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate) || f.write(data) != data.size()) {
+        error = "cannot write " + path;
+        return false;
+    }
+    result.bytes += data.size();
+    return true;
+}
+
+static QByteArray metadataJson(const QString &name, const QString &parent,
+                               const QString &type, bool deleted, qint64 mtime)
+{
+    QJsonObject m;
+    m["createdTime"]      = QString::number(mtime - 86400000);
+    m["deleted"]          = deleted;
+    m["lastModified"]     = QString::number(mtime);
+    m["lastOpened"]       = QString::number(mtime);
+    m["lastOpenedPage"]   = 0;
+    m["parent"]           = parent;
+    m["pinned"]           = false;
+    m["type"]             = type;
+    m["visibleName"]      = name;
+    return QJsonDocument(m).toJson(QJsonDocument::Indented);
+}
+
+// .content come lo scrive xochitl (formatVersion 2): cPages con redir per
+// PDF/EPUB, solo idx per i notebook; pageTags riferiti agli id di pagina.
+// Con rootPages le pagine stanno in "pages" alla radice (formato vecchio).
+// distinctTags = tag meno i duplicati esatti.
+static QByteArray contentJson(QRandomGenerator &rng, const CorpusSpec &spec,
+                              const QString &fileType, bool withFileType, bool rootPages,
+                              int pageCount, qint64 &tagCount, qint64 &distinctTags,
+                              QStringList &pageIds)
+{
+    QJsonArray pages;
+    pageIds.clear();
+    pageIds.reserve(pageCount);
+    for (int i = 0; i < pageCount; ++i) {
+        const QString pid = makeUuid(rng);
+        pageIds.append(pid);
+
+        QJsonObject page;
+        page["id"]  = pid;
+        page["idx"] = QJsonObject{{"timestamp", "1:2"},
+                                  {"value", "b" + QString::number(i, 36)}};
+        if (fileType != "notebook")
+            page["redir"] = QJsonObject{{"timestamp", "1:2"}, {"value", i}};
+        page["template"] = QJsonObject{{"timestamp", "1:1"}, {"value", "Blank"}};
+        pages.append(page);
+    }
+
+    QJsonArray pageTags;
+    for (int i = 0; i < pageCount; ++i) {
+        if (rng.generateDouble() >= spec.tagsPerPage)
+            continue;
+        QJsonObject t;
+        t["name"]      = QString("Topic %1").arg(rng.bounded(qMax(1, spec.tagVocabulary)));
+        t["pageId"]    = pageIds.at(i);
+        t["timestamp"] = qint64(1700000000000LL + i);
+        pageTags.append(t);
+        ++tagCount;
+        ++distinctTags;
+        // ~10% di duplicati esatti: esercitano la deduplica dello scanner
+        if (rng.bounded(10) == 0) {
+            pageTags.append(t);
+            ++tagCount;
+        }
+    }
+
+    QJsonObject cPages;
+    cPages["lastOpened"] = QJsonObject{{"timestamp", "1:1"},
+                                       {"value", pageIds.isEmpty() ? QString() : pageIds.first()}};
+    cPages["original"]   = QJsonObject{{"timestamp", "1:1"}, {"value", pageCount}};
+    if (!rootPages)
+        cPages["pages"]  = pages;
+    cPages["uuids"]      = QJsonArray{QJsonObject{{"first", makeUuid(rng)}, {"second", 1}}};
+
+    QJsonObject c;
+    c["cPages"]           = cPages;
+    c["coverPageNumber"]  = 0;
+    c["documentMetadata"] = QJsonObject();
+    c["extraMetaData"]    = QJsonObject{{"LastTool", "Highlighter"}, {"LastPen", "Ballpointv2"}};
+    if (withFileType)
+        c["fileType"]     = fileType;
+    c["fontName"]         = "";
+    c["formatVersion"]    = 2;
+    c["lineHeight"]       = -1;
+    c["orientation"]      = "portrait";
+    c["pageCount"]        = pageCount;
+    c["pageTags"]         = pageTags;
+    if (rootPages)
+        c["pages"]        = pages;
+    c["sizeInBytes"]      = QString::number(qint64(pageCount) * 48213);
+    c["tags"]             = QJsonArray();
+    c["textAlignment"]    = "justify";
+    c["textScale"]        = 1;
+    c["zoomMode"]         = "bestFit";
+    return QJsonDocument(c).toJson(QJsonDocument::Indented);
+}
+
+// Pagina .rm v6 come la scrive xochitl: intestazione, un blocco AuthorIds
+// e un SceneLineItem (0x05) per tratto, punti da 14 byte (versione 2)
+static QByteArray rmPage(QRandomGenerator &rng, const CorpusSpec &spec)
+{
+    QByteArray out("reMarkable .lines file, version=6");
+    out.append(43 - out.size(), ' ');
+
+    auto u8 = [](QByteArray &b, quint8 v) { b.append(char(v)); };
+    auto u32 = [](QByteArray &b, quint32 v) {
+        char tmp[4];
+        qToLittleEndian<quint32>(v, tmp);
+        b.append(tmp, 4);
+    };
+    auto f32 = [&u32](QByteArray &b, float v) {
+        quint32 bits;
+        std::memcpy(&bits, &v, 4);
+        u32(b, bits);
+    };
+    auto varuint = [](QByteArray &b, quint32 v) {
+        do {
+            const quint8 byte = quint8(v & 0x7F);
+            v >>= 7;
+            b.append(char(v ? byte | 0x80 : byte));
+        } while (v);
+    };
+    auto tag = [&](QByteArray &b, quint32 index, quint8 type) { varuint(b, index << 4 | type); };
+    auto crdt = [&](QByteArray &b, quint32 index, quint8 part1, quint32 part2) {
+        tag(b, index, 0xF);
+        u8(b, part1);
+        varuint(b, part2);
+    };
+    auto block = [&](quint8 type, const QByteArray &payload) {
+        u32(out, quint32(payload.size()));
+        u8(out, 0);
+        u8(out, 1); // versione minima
+        u8(out, 2); // versione
+        u8(out, type);
+        out.append(payload);
+    };
+
+    QByteArray authors;
+    tag(authors, 1, 0xC);
+    u32(authors, 0);
+    block(0x09, authors);
+
+    for (int s = 0; s < spec.strokesPerPage; ++s) {
+        QByteArray points;
+        float x = float(rng.bounded(1400)), y = float(rng.bounded(1800));
+        for (int i = 0; i < spec.pointsPerStroke; ++i) {
+            x += float(rng.bounded(9)) - 4;
+            y += float(rng.bounded(9)) - 4;
+            f32(points, x);
+            f32(points, y);
+            points.append(QByteArray(6, '\x10')); // speed, width, direction, pressure
+        }
+
+        QByteArray value;
+        u8(value, 3); // elemento "line"
+        tag(value, 1, 0x4);
+        u32(value, 15); // Ballpoint v2
+        tag(value, 2, 0x4);
+        u32(value, 0);
+        tag(value, 3, 0x8);
+        value.append(QByteArray(8, '\0'));
+        tag(value, 4, 0x4);
+        u32(value, 0);
+        tag(value, 5, 0xC);
+        u32(value, quint32(points.size()));
+        value.append(points);
+        crdt(value, 6, 1, quint32(s + 1));
+
+        QByteArray item;
+        crdt(item, 1, 0, 11);
+        crdt(item, 2, 1, quint32(100 + s));
+        crdt(item, 3, 0, 0);
+        crdt(item, 4, 0, 0);
+        tag(item, 5, 0x4);
+        u32(item, 0);
+        tag(item, 6, 0xC);
+        u32(item, quint32(value.size()));
+        item.append(value);
+        block(0x05, item);
+    }
+    return out;
+}
+
+// EPUB minimo ma reale (ZIP): mimetype, container.xml, OPF e capitoli XHTML
+// in deflate con testo pseudo-casuale, ~spec.epubBytesPerPage byte per pagina
+static QByteArray epubBook(QRandomGenerator &rng, const CorpusSpec &spec, int pageCount)
+{
+    static const char *const kWords[] = {
+        "mirtillo", "pagina", "libro", "nota", "tempo", "mare", "luce", "parola",
+        "storia", "capitolo", "sera", "vento", "casa", "strada", "città", "voce",
+    };
+    const int chapters = qBound(1, pageCount / 20, 40);
+    const qint64 chapterBytes = qint64(pageCount) * spec.epubBytesPerPage / chapters;
+
+    QByteArray out, central;
+    quint16 members = 0;
+    auto u16 = [](QByteArray &b, quint16 v) {
+        char tmp[2];
+        qToLittleEndian<quint16>(v, tmp);
+        b.append(tmp, 2);
+    };
+    auto u32 = [](QByteArray &b, quint32 v) {
+        char tmp[4];
+        qToLittleEndian<quint32>(v, tmp);
+        b.append(tmp, 4);
+    };
+    auto add = [&](const QByteArray &name, const QByteArray &data, bool deflated) {
+        QByteArray packed = data;
+        if (deflated) {
+            z_stream zs = {};
+            deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+            packed.resize(qsizetype(deflateBound(&zs, uLong(data.size()))));
+            zs.next_in   = reinterpret_cast<Bytef *>(const_cast<char *>(data.constData()));
+            zs.avail_in  = uInt(data.size());
+            zs.next_out  = reinterpret_cast<Bytef *>(packed.data());
+            zs.avail_out = uInt(packed.size());
+            deflate(&zs, Z_FINISH);
+            packed.resize(qsizetype(zs.total_out));
+            deflateEnd(&zs);
+        }
+        const quint32 crc = quint32(crc32(0, reinterpret_cast<const Bytef *>(data.constData()),
+                                          uInt(data.size())));
+        const quint32 offset = quint32(out.size());
+        auto header = [&](QByteArray &b) {
+            u16(b, 20);               // versione necessaria
+            u16(b, 0);                // flag
+            u16(b, deflated ? 8 : 0); // metodo
+            u32(b, 0);                // ora/data DOS
+            u32(b, crc);
+            u32(b, quint32(packed.size()));
+            u32(b, quint32(data.size()));
+            u16(b, quint16(name.size()));
+            u16(b, 0);                // extra
+        };
+        u32(out, 0x04034b50);
+        header(out);
+        out.append(name);
+        out.append(packed);
+
+        u32(central, 0x02014b50);
+        u16(central, 20);             // versione di chi ha scritto
+        header(central);
+        u16(central, 0);              // commento
+        u16(central, 0);              // disco
+        u16(central, 0);              // attributi interni
+        u32(central, 0);              // attributi esterni
+        u32(central, offset);
+        central.append(name);
+        ++members;
+    };
+
+    add("mimetype", "application/epub+zip", false);
+    add("META-INF/container.xml",
+        "<?xml version=\"1.0\"?>\n"
+        "<container version=\"1.0\" xmlns=\"urn:oasis:names:tc:opendocument:xmlns:container\">\n"
+        "  <rootfiles><rootfile full-path=\"OEBPS/content.opf\" "
+        "media-type=\"application/oebps-package+xml\"/></rootfiles>\n"
+        "</container>\n", true);
+
+    QByteArray manifest, spine;
+    for (int c = 0; c < chapters; ++c) {
+        const QByteArray id = "ch" + QByteArray::number(c + 1);
+        manifest += "    <item id=\"" + id + "\" href=\"text/" + id +
+                    ".xhtml\" media-type=\"application/xhtml+xml\"/>\n";
+        spine += "    <itemref idref=\"" + id + "\"/>\n";
+    }
+    add("OEBPS/content.opf",
+        "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+        "<package xmlns=\"http://www.idpf.org/2007/opf\" version=\"3.0\">\n"
+        "  <manifest>\n" + manifest + "  </manifest>\n"
+        "  <spine>\n" + spine + "  </spine>\n</package>\n", true);
+
+    for (int c = 0; c < chapters; ++c) {
+        QByteArray x = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                       "<html xmlns=\"http://www.w3.org/1999/xhtml\"><head><title>Capitolo " +
+                       QByteArray::number(c + 1) + "</title><style>p { margin: 0 }</style></head>\n"
+                       "<body><h1>Capitolo " + QByteArray::number(c + 1) + "</h1>\n<p>";
+        x.reserve(qsizetype(chapterBytes) + 4096);
+        const qsizetype start = x.size();
+        while (x.size() - start < chapterBytes) {
+            x += kWords[rng.bounded(int(sizeof kWords / sizeof *kWords))];
+            const quint32 r = rng.bounded(40);
+            x += r == 0 ? "</p>\n<p>" : r == 1 ? ", " : r == 2 ? " &amp; " : " ";
+        }
+        x += "</p></body></html>\n";
+        add("OEBPS/text/ch" + QByteArray::number(c + 1) + ".xhtml", x, true);
+    }
+
+    const quint32 centralOffset = quint32(out.size());
+    out.append(central);
+    u32(out, 0x06054b50);
+    u16(out, 0);
+    u16(out, 0);
+    u16(out, members);
+    u16(out, members);
+    u32(out, quint32(central.size()));
+    u32(out, centralOffset);
+    u16(out, 0);
+    return out;
+}
+
+bool generateCorpus(const QString &dir, const CorpusSpec &spec,
+                    CorpusResult &result, QString &error)
+{
+    result = CorpusResult();
+
+    QDir d(dir);
+    if (d.exists() && !d.isEmpty()) {
+        error = "directory is not empty: " + dir;
+        return false;
+    }
+    if (!d.mkpath(".")) {
+        error = "cannot create directory: " + dir;
+        return false;
+    }
+
+    QRandomGenerator rng(spec.seed);
+    // Generatore a parte per l'inchiostro: a parità di seed metadati e
+    // .content restano identici a quelli dei corpus senza .rm
+    QRandomGenerator inkRng(spec.seed ^ 0x696E6B00u);
+    // Idem per il testo degli EPUB
+    QRandomGenerator epubRng(spec.seed ^ 0x65707562u);
+    const qint64 baseTime = 1700000000000LL;
+
+    CorpusExpect &expect = result.expect;
+
+    // 1) Cartelle (CollectionType, .content minimale come su device)
+    QStringList folderIds;
+    for (int i = 0; i < spec.folders; ++i) {
+        const QString id = makeUuid(rng);
+        folderIds.append(id);
+        if (!writeFile(d.filePath(id + ".metadata"),
+                       metadataJson(QString("Folder %1").arg(i + 1), QString(),
+                                    "CollectionType", false, baseTime + i),
+                       result, error) ||
+            !writeFile(d.filePath(id + ".content"), "{\n    \"tags\": [\n    ]\n}\n",
+                       result, error))
+            return false;
+        ++result.metadataFiles;
+        ++result.contentFiles;
+        ++expect.folders;
+    }
+
+    // 2) Documenti
+    const int totalWeight = qMax(1, spec.pdfWeight + spec.epubWeight + spec.notebookWeight);
+    const int minPages = qMax(0, spec.minPages);
+    const int maxPages = qMax(minPages, spec.maxPages);
+
+    for (int i = 0; i < spec.docs; ++i) {
+        const QString uuid = makeUuid(rng);
+
+        const int w = int(rng.bounded(totalWeight));
+        const QString type = w < spec.pdfWeight ? "pdf"
+                           : w < spec.pdfWeight + spec.epubWeight ? "epub"
+                           : "notebook";
+
+        const double r = rng.generateDouble();
+        const bool deleted = r < spec.deletedRatio;
+        const bool trash   = !deleted && r < spec.deletedRatio + spec.trashRatio;
+
+        QString parent;
+        if (trash)
+            parent = "trash";
+        else if (!folderIds.isEmpty() && rng.bounded(2) == 0)
+            parent = folderIds.at(int(rng.bounded(int(folderIds.size()))));
+
+        const QString title = QString("%1 %2 — synthetic").arg(type.toUpper()).arg(i + 1);
+        if (!writeFile(d.filePath(uuid + ".metadata"),
+                       metadataJson(title, parent, "DocumentType", deleted, baseTime + i),
+                       result, error))
+            return false;
+        ++result.metadataFiles;
+
+        // File sorgente vuoto: basta per probeFileType
+        if (type != "notebook" &&
+            !writeFile(d.filePath(uuid + "." + type), QByteArray(), result, error))
+            return false;
+
+        const bool missing = rng.generateDouble() < spec.missingContentRatio;
+        // deleted e trash si fermano al .metadata
+        if (deleted)
+            ++expect.deleted;
+        else if (trash)
+            ++expect.trash;
+        else if (missing)
+            ++expect.contentMissing;
+        if (missing)
+            continue;
+
+        const bool withFileType = rng.generateDouble() >= spec.noFileTypeRatio;
+        const int pageCount = minPages + int(rng.bounded(maxPages - minPages + 1));
+        // Estratto solo se richiesto: a ratio 0 i corpus restano identici
+        const bool rootPages = spec.rootPagesRatio > 0 &&
+                               rng.generateDouble() < spec.rootPagesRatio;
+        QStringList pageIds;
+        qint64 distinctTags = 0;
+        if (!writeFile(d.filePath(uuid + ".content"),
+                       contentJson(rng, spec, type, withFileType, rootPages, pageCount,
+                                   result.tags, distinctTags, pageIds),
+                       result, error))
+            return false;
+        ++result.contentFiles;
+
+        if (!deleted && !trash) {
+            // Senza fileType il tipo viene dal .pdf/.epub scritto sopra
+            if (type == "pdf")
+                ++expect.pdfs;
+            else if (type == "epub")
+                ++expect.epubs;
+            else
+                ++expect.notebooks;
+            if (!withFileType)
+                ++expect.forcedType;
+            expect.pages += pageCount;
+            expect.tags  += distinctTags;
+            if (type == "notebook")
+                expect.unnumbered += distinctTags;
+        }
+
+        // Solo gli EPUB con .content hanno pagine a cui dare un testo
+        if (type == "epub" && spec.epubBytesPerPage > 0) {
+            if (!writeFile(d.filePath(uuid + ".epub"), epubBook(epubRng, spec, pageCount),
+                           result, error))
+                return false;
+            ++result.epubFiles;
+        }
+
+        bool pageDir = false;
+        for (const QString &pid : std::as_const(pageIds)) {
+            if (inkRng.generateDouble() >= spec.inkPagesRatio)
+                continue;
+            if (!pageDir && !d.mkpath(uuid)) {
+                error = "cannot create directory: " + d.filePath(uuid);
+                return false;
+            }
+            pageDir = true;
+            if (!writeFile(d.filePath(uuid + "/" + pid + ".rm"), rmPage(inkRng, spec),
+                           result, error))
+                return false;
+            ++result.rmFiles;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <QString>
+#include <QtGlobal>
+
+// Generatore di librerie xochitl sintetiche (usato da mirtillo_gen e
+// mirtillo_bench). Scrive <uuid>.metadata / <uuid>.content con la stessa
+// struttura dei file reali del Paper Pro, più un <uuid>.pdf / .epub vuoto
+// per i documenti che ne hanno uno (serve al fallback del fileType),
+// qualche pagina d'inchiostro <uuid>/<pageId>.rm in formato v6 e, per gli
+// EPUB con .content, un .epub vero (capitoli XHTML in deflate).
+struct CorpusSpec {
+    int     docs = 1000;
+
+    // Mix dei tipi (pesi relativi)
+    int     pdfWeight      = 40;
+    int     epubWeight     = 20;
+    int     notebookWeight = 40;
+
+    // Pagine per documento (uniforme in [minPages, maxPages])
+    int     minPages = 1;
+    int     maxPages = 300;
+
+    // Tag medi per pagina (0.05 = un tag ogni 20 pagine) e nomi distinti
+    double  tagsPerPage  = 0.05;
+    int     tagVocabulary = 200;
+
+    // Frazioni di documenti cancellati / nel cestino / senza .content
+    double  deletedRatio        = 0.02;
+    double  trashRatio          = 0.03;
+    double  missingContentRatio = 0.01;
+    // Frazione di .content senza fileType (tipo dedotto dal filesystem)
+    double  noFileTypeRatio     = 0.02;
+    // Frazione di .content con le pagine in "pages" alla radice invece che
+    // in cPages.pages (formato vecchio, fallback di buildPageMap)
+    double  rootPagesRatio      = 0.0;
+
+    // Frazione di pagine con inchiostro, tratti per pagina, punti per tratto
+    double  inkPagesRatio   = 0.01;
+    int     strokesPerPage  = 16;
+    int     pointsPerStroke = 32;
+
+    // Byte di testo per pagina negli EPUB (0 = .epub vuoto)
+    int     epubBytesPerPage = 1024;
+
+    // Cartelle (parent dei documenti); 0 = tutto in root
+    int     folders = 50;
+
+    quint32 seed = 1;
+};
+
+// Quello che la scansione della libreria deve restituire, ricavato da
+// quanto è stato scritto (mirtillo_bench --check)
+struct CorpusExpect {
+    int    pdfs = 0, epubs = 0, notebooks = 0; // entry valide per tipo
+    int    folders        = 0;
+    int    deleted        = 0;
+    int    trash          = 0;
+    int    contentMissing = 0;
+    int    forcedType     = 0;
+    qint64 pages          = 0; // somma dei pageCount delle entry valide
+    qint64 tags           = 0; // coppie (tag, pagina) distinte
+    qint64 unnumbered     = 0; // tag senza numero di pagina (notebook: niente redir)
+};
+
+// Riepilogo di quanto è stato scritto
+struct CorpusResult {
+    int    metadataFiles = 0;
+    int    contentFiles  = 0;
+    qint64 tags          = 0;
+    int    rmFiles       = 0;
+    int    epubFiles     = 0;
+    qint64 bytes         = 0;
+    CorpusExpect expect;
+};
+
+// Crea (o svuota) dir e vi scrive la libreria. false + error in caso di errore.
+bool generateCorpus(const QString &dir, const CorpusSpec &spec,
+                    CorpusResult &result, QString &error);
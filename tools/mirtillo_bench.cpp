@@ -0,0 +1,477 @@
+// ========================
+//  mirtillo_bench — benchmark della scansione su librerie sintetiche
+// ========================
+//
+// Per ogni dimensione richiesta genera (una volta) una libreria sintetica e
+// rilancia se stesso con --run in un processo separato, così il picco di RSS
+// misurato è quello del solo corpus. Il risultato è un JSON su stdout (o su
+// --out) da confrontare tra una release e l'altra.
+//
+// Con --check esegue invece i casi di tools/perf_budgets.json (vedi
+// perf_check.h) e termina con errore se un caso è sbagliato o fuori budget.
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QProcess>
+#include <QTextStream>
+
+#include <algorithm>
+#include <vector>
+
+#include <sys/resource.h>
+
+#include "corpus.h"
+#include "diff.h"
+#include "excerpts.h"
+#include "export.h"
+#include "ink.h"
+#include "json_stream.h"
+#include "json_utils.h"
+#include "paths.h"
+#include "pdf_summary.h"
+#include "perf_check.h"
+#include "scanner.h"
+#include "tag_stats.h"
+#include "title_search.h"
+
+static long peakRssKiB()
+{
+    struct rusage ru;
+    return ::getrusage(RUSAGE_SELF, &ru) == 0 ? ru.ru_maxrss : -1;
+}
+
+// Percentile (0..1) di una serie di latenze in ns; riordina la serie
+static qint64 percentile(std::vector<qint64> &v, double p)
+{
+    if (v.empty())
+        return 0;
+    const size_t k = std::min(v.size() - 1, size_t(p * double(v.size() - 1) + 0.5));
+    std::nth_element(v.begin(), v.begin() + qptrdiff(k), v.end());
+    return v[k];
+}
+
+// Fase con tempo totale e (opzionale) latenze per documento
+static QJsonObject phaseJson(const QString &name, qint64 totalNs, int docs,
+                             std::vector<qint64> latencies = {})
+{
+    QJsonObject o;
+    o["phase"]      = name;
+    o["docs"]       = docs;
+    o["total_ms"]   = double(totalNs) / 1e6;
+    o["docs_per_s"] = totalNs > 0 ? double(docs) * 1e9 / double(totalNs) : 0.0;
+    if (!latencies.empty()) {
+        o["p50_us"] = double(percentile(latencies, 0.50)) / 1e3;
+        o["p99_us"] = double(percentile(latencies, 0.99)) / 1e3;
+    }
+    return o;
+}
+
+// -------------------------
+//  Processo figlio: misura un corpus
+// -------------------------
+static int runCorpus(int jobs, QTextStream &out)
+{
+    // xochitlBase()/mirtilloShareBase() arrivano dalle variabili d'ambiente
+    // impostate dal processo padre
+    const QString share = mirtilloShareBase();
+    QDir().mkpath(share);
+
+    QJsonArray phases;
+    QElapsedTimer t;
+
+    ScanOptions opts;
+    opts.cachePath = share + "/scan_cache.bin";
+    opts.jobs = jobs;
+
+    // 1) Scansione completa: a freddo (scrive la cache) e a caldo
+    QList<DocEntry> pdfs, epubs, notebooks;
+    ScanStats stats;
+    t.start();
+    if (!scanDocuments(pdfs, epubs, notebooks, stats, opts)) {
+        out << "{\"error\": \"directory not found\"}\n";
+        return 1;
+    }
+    phases.append(phaseJson("scan_cold", t.nsecsElapsed(), stats.metaCount));
+
+    {
+        QList<DocEntry> p2, e2, n2;
+        ScanStats s2;
+        t.start();
+        scanDocuments(p2, e2, n2, s2, opts);
+        phases.append(phaseJson("scan_warm", t.nsecsElapsed(), s2.metaCount));
+    }
+
+    {
+        // --max-memory 32: senza cache, temporanei nelle arene dei worker
+        ScanOptions budget = opts;
+        budget.cachePath.clear();
+        budget.maxMemory = 32 * 1024 * 1024;
+        QList<DocEntry> p2, e2, n2;
+        ScanStats s2;
+        t.start();
+        scanDocuments(p2, e2, n2, s2, budget);
+        QJsonObject o = phaseJson("scan_max_memory", t.nsecsElapsed(), s2.metaCount);
+        o["arenas"]           = s2.arenas;
+        o["arena_kib"]        = s2.arenaCapacity / 1024;
+        o["arena_high_water"] = s2.arenaHighWater / 1024;
+        o["arena_spilled"]    = s2.arenaSpilled / 1024;
+        o["oversized"]        = s2.oversized;
+        phases.append(o);
+    }
+
+    QList<DocEntry> all = pdfs + epubs + notebooks;
+    const int docs = int(all.size());
+
+    // 2) Latenza per documento della scansione (seriale, senza cache)
+    {
+        std::vector<qint64> lat;
+        lat.reserve(size_t(docs));
+        qint64 total = 0;
+        for (const DocEntry &e : std::as_const(all)) {
+            DocScan r;
+            t.start();
+            scanDocument(e.uuid, r);
+            lat.push_back(t.nsecsElapsed());
+            total += lat.back();
+        }
+        phases.append(phaseJson("scan_document", total, docs, lat));
+    }
+
+    // 3) buildPageMap (il parsing del .content non è conteggiato)
+    {
+        std::vector<qint64> lat;
+        lat.reserve(size_t(docs));
+        qint64 total = 0;
+        for (const DocEntry &e : std::as_const(all)) {
+            ContentInfo content;
+            if (!loadContentInfo(xochitlBase() + "/" + e.uuid + ".content", content))
+                continue;
+            t.start();
+            const QHash<QString,int> map = buildPageMap(content);
+            lat.push_back(t.nsecsElapsed());
+            total += lat.back();
+            Q_UNUSED(map);
+        }
+        phases.append(phaseJson("build_page_map", total, int(lat.size()), lat));
+    }
+
+    // 4) Summary a video (su stringa) ed export su file
+    {
+        std::vector<qint64> lat;
+        lat.reserve(size_t(docs));
+        qint64 total = 0;
+        QString sink;
+        for (const DocEntry &e : std::as_const(all)) {
+            sink.clear();
+            QTextStream s(&sink);
+            t.start();
+            printDocumentSummary(e, s);
+            s.flush();
+            lat.push_back(t.nsecsElapsed());
+            total += lat.back();
+        }
+        phases.append(phaseJson("render_summary", total, docs, lat));
+    }
+    {
+        std::vector<qint64> lat;
+        lat.reserve(size_t(docs));
+        qint64 total = 0;
+        QString error;
+        for (const DocEntry &e : std::as_const(all)) {
+            t.start();
+            if (!writeSummaryFile(e, error)) {
+                qWarning("mirtillo_bench: %s", qPrintable(error));
+                return 1;
+            }
+            lat.push_back(t.nsecsElapsed());
+            total += lat.back();
+        }
+        phases.append(phaseJson("export_summary", total, docs, lat));
+    }
+    {
+        std::vector<qint64> lat;
+        lat.reserve(size_t(docs));
+        qint64 total = 0;
+        QString error;
+        for (const DocEntry &e : std::as_const(all)) {
+            t.start();
+            if (!writeSummaryPdf(e, error)) {
+                qWarning("mirtillo_bench: %s", qPrintable(error));
+                return 1;
+            }
+            lat.push_back(t.nsecsElapsed());
+            total += lat.back();
+        }
+        phases.append(phaseJson("export_pdf", total, docs, lat));
+    }
+
+    // 5) Ricerca per titolo del menu: costruzione dell'indice e query miste
+    //    (prefisso, titolo esatto, sottostringa, refuso, molto frequente)
+    {
+        TitleSearch search;
+        t.start();
+        search.build({&pdfs, &epubs, &notebooks});
+        phases.append(phaseJson("build_title_index", t.nsecsElapsed(), docs));
+
+        QStringList queries;
+        for (int i = 0; i < docs && queries.size() < 200; i += qMax(1, docs / 40)) {
+            const QString &name = all.at(i).visibleName;
+            queries << name.left(2) << name << name.mid(2, 6)
+                    << name.left(name.size() / 2) + "x" << "synth";
+        }
+
+        std::vector<qint64> lat;
+        lat.reserve(size_t(queries.size()));
+        qint64 total = 0;
+        for (const QString &q : std::as_const(queries)) {
+            t.start();
+            const QList<TitleHit> hits = search.find(q, 20);
+            lat.push_back(t.nsecsElapsed());
+            total += lat.back();
+            Q_UNUSED(hits);
+        }
+        phases.append(phaseJson("title_search", total, int(queries.size()), lat));
+    }
+
+    // 6) Statistiche dell'inchiostro di tutta la libreria (.rm v6, in parallelo)
+    {
+        QList<DocEntry> p2 = pdfs, e2 = epubs, n2 = notebooks;
+        t.start();
+        const int inkPages = loadInk(p2, e2, n2, jobs);
+        QJsonObject o = phaseJson("ink_stats", t.nsecsElapsed(), docs);
+        o["pages"] = inkPages;
+        phases.append(o);
+    }
+
+    // 6b) Estratti EPUB: a freddo calcola e salva il layout dei capitoli,
+    //     a caldo infla solo i capitoli con pagine taggate
+    for (const char *name : {"excerpts_cold", "excerpts_warm"}) {
+        QList<DocEntry> e2 = epubs;
+        t.start();
+        const int excerpts = loadExcerpts(e2, jobs);
+        QJsonObject o = phaseJson(name, t.nsecsElapsed(), int(e2.size()));
+        o["excerpts"] = excerpts;
+        phases.append(o);
+    }
+
+    // 7) --tag-stats: page set per tag e co-occorrenza su tutta la libreria
+    {
+        std::vector<const DocEntry *> docPtrs;
+        for (const DocEntry &e : std::as_const(all))
+            docPtrs.push_back(&e);
+        TagStats tagStats;
+        t.start();
+        tagStats.build(docPtrs, jobs);
+        QJsonObject o = phaseJson("tag_stats", t.nsecsElapsed(), docs);
+        o["tags"]  = int(tagStats.tags().size());
+        o["pairs"] = int(tagStats.pairs().size());
+        phases.append(o);
+    }
+
+    // 8) --diff della libreria con se stessa: le due scansioni in parallelo,
+    //    a freddo (cache di diff vuote) e a caldo
+    for (const char *name : {"diff_cold", "diff_warm"}) {
+        QByteArray report;
+        OutputSink sink(report);
+        DiffStats ds;
+        QString error;
+        t.start();
+        if (!diffLibraries(xochitlBase(), xochitlBase(), opts, OutputFormat::JsonLines,
+                           sink, ds, error)) {
+            qWarning("mirtillo_bench: %s", qPrintable(error));
+            break;
+        }
+        phases.append(phaseJson(name, t.nsecsElapsed(), 2 * stats.metaCount));
+    }
+
+    QJsonObject result;
+    result["documents"]    = docs;
+    result["metadata"]     = stats.metaCount;
+    result["phases"]       = phases;
+    result["peak_rss_kib"] = double(peakRssKiB());
+    out << QJsonDocument(result).toJson(QJsonDocument::Compact) << "\n";
+    return 0;
+}
+
+// -------------------------
+//  Processo padre
+// -------------------------
+static void usage(QTextStream &out)
+{
+    out << "Usage: mirtillo_bench [options]\n"
+           "  --sizes N,N,...   corpus sizes in documents (default 1000,10000,100000)\n"
+           "  --work DIR        corpora and scratch files (default <tmp>/mirtillo_bench)\n"
+           "  --jobs N          scan workers, 0 = all cores (default 0)\n"
+           "  --seed N          generator seed (default 1)\n"
+           "  --out FILE        write the JSON report to FILE instead of stdout\n"
+           "\n"
+           "Regression check:\n"
+           "  --check           run the cases in the budgets file instead of the benchmark;\n"
+           "                    exits with 1 if a result is wrong or over budget\n"
+           "  --budgets FILE    cases, margin and measured values (default " MIRTILLO_BUDGETS ")\n"
+           "  --time-scale F    multiply the time budgets by F (slow machines, VMs)\n"
+           "  --record FILE     write the budgets file with the values just measured\n"
+           "                    (budgets are not checked, results still are)\n";
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QTextStream out(stdout), err(stderr);
+
+    QList<int> sizes = {1000, 10000, 100000};
+    QString work = QDir::tempPath() + "/mirtillo_bench";
+    QString outPath;
+    int jobs = 0;
+    quint32 seed = 1;
+    bool child = false;
+    bool check = false;
+    CheckOptions checkOpts;
+    checkOpts.budgetsPath = QStringLiteral(MIRTILLO_BUDGETS);
+
+    const QStringList args = app.arguments();
+    for (int i = 1; i < args.size(); ++i) {
+        const QString arg = args.at(i);
+        if (arg == "--help" || arg == "-h") {
+            usage(out);
+            return 0;
+        }
+        if (arg == "--run") {
+            child = true;
+            continue;
+        }
+        if (arg == "--check") {
+            check = true;
+            continue;
+        }
+        if (i + 1 >= args.size()) {
+            err << "Error: " << arg << " requires a value\n";
+            return 1;
+        }
+
+        const QString v = args.at(++i);
+        bool ok = true;
+        if (arg == "--sizes") {
+            sizes.clear();
+            for (const QString &s : v.split(',')) {
+                const int n = s.toInt(&ok);
+                ok = ok && n > 0;
+                if (!ok)
+                    break;
+                sizes.append(n);
+            }
+        } else if (arg == "--work") {
+            work = v;
+        } else if (arg == "--jobs") {
+            jobs = v.toInt(&ok);
+            ok = ok && jobs >= 0;
+        } else if (arg == "--seed") {
+            seed = v.toUInt(&ok);
+        } else if (arg == "--out") {
+            outPath = v;
+        } else if (arg == "--budgets") {
+            checkOpts.budgetsPath = v;
+        } else if (arg == "--time-scale") {
+            checkOpts.timeScale = v.toDouble(&ok);
+            ok = ok && checkOpts.timeScale > 0;
+        } else if (arg == "--record") {
+            checkOpts.recordPath = v;
+        } else {
+            err << "Unknown option: " << arg << "\n";
+            usage(err);
+            return 1;
+        }
+        if (!ok) {
+            err << "Error: invalid value for " << arg << ": " << v << "\n";
+            return 1;
+        }
+    }
+
+    if (child)
+        return runCorpus(jobs, out);
+
+    if (check) {
+        checkOpts.work    = work;
+        checkOpts.outPath = outPath;
+        checkOpts.jobs    = jobs;
+        return runPerfCheck(checkOpts, err);
+    }
+
+    QJsonArray corpora;
+    for (int size : std::as_const(sizes)) {
+        // Corpus riusato tra un'esecuzione e l'altra (marker = generazione completa);
+        // il suffisso cambia con il contenuto generato (v2: pagine .rm, v3: EPUB veri)
+        const QString corpus = QString("%1/corpus_%2_seed%3_v3").arg(work).arg(size).arg(seed);
+        const QString marker = corpus + "/.mirtillo_bench_complete";
+        if (!QFile::exists(marker)) {
+            if (QDir(corpus).exists() && !QDir(corpus).isEmpty()) {
+                err << "Error: incomplete corpus, remove it first: " << corpus << "\n";
+                return 1;
+            }
+            err << "Generating " << size << " documents in " << corpus << "...\n";
+            err.flush();
+
+            CorpusSpec spec;
+            spec.docs = size;
+            spec.seed = seed;
+            CorpusResult gen;
+            QString error;
+            if (!generateCorpus(corpus, spec, gen, error)) {
+                err << "Error: " << error << "\n";
+                return 1;
+            }
+            QFile m(marker);
+            m.open(QIODevice::WriteOnly);
+        }
+
+        // Directory share pulita a ogni esecuzione: scan cache e summary
+        // del benchmark non devono sopravvivere
+        const QString share = QString("%1/share_%2").arg(work).arg(size);
+        QDir(share).removeRecursively();
+
+        QProcessEnvironment env = QProcessEnvironment::systemEnvironment();
+        env.insert("MIRTILLO_XOCHITL_DIR", corpus);
+        env.insert("MIRTILLO_SHARE_DIR", share);
+
+        QProcess p;
+        p.setProcessEnvironment(env);
+        p.setProcessChannelMode(QProcess::ForwardedErrorChannel);
+        p.start(app.applicationFilePath(),
+                QStringList() << "--run" << "--jobs" << QString::number(jobs));
+        if (!p.waitForFinished(-1) || p.exitCode() != 0) {
+            err << "Error: benchmark run failed for " << corpus << "\n"
+                << p.readAllStandardOutput();
+            return 1;
+        }
+
+        QJsonObject r = QJsonDocument::fromJson(p.readAllStandardOutput()).object();
+        r["corpus_size"] = size;
+        corpora.append(r);
+        err << "  " << size << " documents done\n";
+        err.flush();
+    }
+
+    QJsonObject report;
+    report["mirtillo_version"] = QStringLiteral(MIRTILLO_VERSION);
+    report["jobs"]             = jobs;
+    report["seed"]             = double(seed);
+    report["corpora"]          = corpora;
+    const QByteArray json = QJsonDocument(report).toJson(QJsonDocument::Indented);
+
+    if (outPath.isEmpty()) {
+        out << json;
+        return 0;
+    }
+
+    QFile f(outPath);
+    if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate) || f.write(json) != json.size()) {
+        err << "Error: cannot write " << outPath << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,132 @@
+// ========================
+//  mirtillo_gen — libreria xochitl sintetica per test e benchmark
+// ========================
+
+#include <QCoreApplication>
+#include <QTextStream>
+
+#include "corpus.h"
+
+static void usage(QTextStream &out)
+{
+    out << "Usage: mirtillo_gen --out DIR [options]\n"
+           "  --docs N             documents (default 1000)\n"
+           "  --mix P:E:N          pdf:epub:notebook weights (default 40:20:40)\n"
+           "  --pages MIN-MAX      pages per document (default 1-300)\n"
+           "  --tags-per-page F    average tags per page (default 0.05)\n"
+           "  --tag-vocabulary N   distinct tag names (default 200)\n"
+           "  --deleted F          deleted ratio (default 0.02)\n"
+           "  --trash F            trash ratio (default 0.03)\n"
+           "  --missing-content F  ratio without .content (default 0.01)\n"
+           "  --no-filetype F      ratio without fileType (default 0.02)\n"
+           "  --root-pages F       ratio with pages in the root-level \"pages\" (default 0)\n"
+           "  --ink-pages F        ratio of pages with a .rm file (default 0.01)\n"
+           "  --strokes N          strokes per .rm page (default 16)\n"
+           "  --points N           points per stroke (default 32)\n"
+           "  --epub-text N        text bytes per EPUB page, 0 = empty .epub (default 1024)\n"
+           "  --folders N          folders (default 50)\n"
+           "  --seed N             random seed (default 1)\n";
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QTextStream out(stdout), err(stderr);
+
+    CorpusSpec spec;
+    QString dir;
+
+    const QStringList args = app.arguments();
+    for (int i = 1; i < args.size(); ++i) {
+        const QString arg = args.at(i);
+        if (arg == "--help" || arg == "-h") {
+            usage(out);
+            return 0;
+        }
+        if (i + 1 >= args.size()) {
+            err << "Error: " << arg << " requires a value\n";
+            return 1;
+        }
+
+        const QString v = args.at(++i);
+        bool ok = true;
+        if (arg == "--out") {
+            dir = v;
+        } else if (arg == "--docs") {
+            spec.docs = v.toInt(&ok);
+        } else if (arg == "--mix") {
+            const QStringList w = v.split(':');
+            ok = w.size() == 3;
+            if (ok) {
+                bool a = false, b = false, c = false;
+                spec.pdfWeight      = w.at(0).toInt(&a);
+                spec.epubWeight     = w.at(1).toInt(&b);
+                spec.notebookWeight = w.at(2).toInt(&c);
+                ok = a && b && c;
+            }
+        } else if (arg == "--pages") {
+            const QStringList r = v.split('-');
+            ok = r.size() == 2;
+            if (ok) {
+                bool a = false, b = false;
+                spec.minPages = r.at(0).toInt(&a);
+                spec.maxPages = r.at(1).toInt(&b);
+                ok = a && b && spec.minPages <= spec.maxPages;
+            }
+        } else if (arg == "--tags-per-page") {
+            spec.tagsPerPage = v.toDouble(&ok);
+        } else if (arg == "--tag-vocabulary") {
+            spec.tagVocabulary = v.toInt(&ok);
+        } else if (arg == "--deleted") {
+            spec.deletedRatio = v.toDouble(&ok);
+        } else if (arg == "--trash") {
+            spec.trashRatio = v.toDouble(&ok);
+        } else if (arg == "--missing-content") {
+            spec.missingContentRatio = v.toDouble(&ok);
+        } else if (arg == "--no-filetype") {
+            spec.noFileTypeRatio = v.toDouble(&ok);
+        } else if (arg == "--root-pages") {
+            spec.rootPagesRatio = v.toDouble(&ok);
+        } else if (arg == "--ink-pages") {
+            spec.inkPagesRatio = v.toDouble(&ok);
+        } else if (arg == "--strokes") {
+            spec.strokesPerPage = v.toInt(&ok);
+        } else if (arg == "--points") {
+            spec.pointsPerStroke = v.toInt(&ok);
+        } else if (arg == "--epub-text") {
+            spec.epubBytesPerPage = v.toInt(&ok);
+        } else if (arg == "--folders") {
+            spec.folders = v.toInt(&ok);
+        } else if (arg == "--seed") {
+            spec.seed = v.toUInt(&ok);
+        } else {
+            err << "Unknown option: " << arg << "\n";
+            usage(err);
+            return 1;
+        }
+        if (!ok) {
+            err << "Error: invalid value for " << arg << ": " << v << "\n";
+            return 1;
+        }
+    }
+
+    if (dir.isEmpty()) {
+        usage(err);
+        return 1;
+    }
+
+    CorpusResult result;
+    QString error;
+    if (!generateCorpus(dir, spec, result, error)) {
+        err << "Error: " << error << "\n";
+        return 1;
+    }
+
+    out << "Wrote " << result.metadataFiles << " .metadata, "
+        << result.contentFiles << " .content, "
+        << result.tags << " page tags, "
+        << result.rmFiles << " .rm pages, "
+        << result.epubFiles << " .epub ("
+        << (result.bytes / 1024) << " KiB) to " << dir << "\n";
+    return 0;
+}
@@ -0,0 +1,625 @@
+#include "perf_check.h"
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMap>
+#include <QSaveFile>
+#include <QStringList>
+#include <QSysInfo>
+
+#include <functional>
+
+#include "alloc_count.h"
+#include "corpus.h"
+#include "export.h"
+#include "json_utils.h"
+#include "paths.h"
+#include "scanner.h"
+
+// Tetto di --max-memory nella fase scan_max_memory: abbastanza basso da
+// mandare nel percorso dei .content fuori misura i casi con documenti grandi
+static const qint64 kCheckMaxMemory = 16 * 1024 * 1024;
+
+// Budget di tempo minimo di una fase (vedi checkBudget)
+static const double kMinTimeBudgetMs = 5.0;
+
+// Margine dei budget sui valori misurati ("margin" nel file dei budget)
+struct Margin {
+    double time   = 0;
+    double allocs = 0;
+};
+
+// -------------------------
+//  Casi
+// -------------------------
+
+// Campi di CorpusSpec impostabili dal JSON (chiavi sconosciute = errore,
+// così un refuso non fa passare un caso con i valori di default)
+static bool corpusSpecFromJson(const QJsonObject &o, CorpusSpec &spec, QString &error)
+{
+    const struct { const char *key; int *field; } ints[] = {
+        {"docs", &spec.docs},
+        {"pdfWeight", &spec.pdfWeight},
+        {"epubWeight", &spec.epubWeight},
+        {"notebookWeight", &spec.notebookWeight},
+        {"minPages", &spec.minPages},
+        {"maxPages", &spec.maxPages},
+        {"tagVocabulary", &spec.tagVocabulary},
+        {"strokesPerPage", &spec.strokesPerPage},
+        {"pointsPerStroke", &spec.pointsPerStroke},
+        {"epubBytesPerPage", &spec.epubBytesPerPage},
+        {"folders", &spec.folders},
+    };
+    const struct { const char *key; double *field; } doubles[] = {
+        {"tagsPerPage", &spec.tagsPerPage},
+        {"deletedRatio", &spec.deletedRatio},
+        {"trashRatio", &spec.trashRatio},
+        {"missingContentRatio", &spec.missingContentRatio},
+        {"noFileTypeRatio", &spec.noFileTypeRatio},
+        {"rootPagesRatio", &spec.rootPagesRatio},
+        {"inkPagesRatio", &spec.inkPagesRatio},
+    };
+
+    for (auto it = o.begin(); it != o.end(); ++it) {
+        const QString key = it.key();
+        bool known = false;
+        if (key == "seed") {
+            spec.seed = quint32(it.value().toDouble());
+            known = true;
+        }
+        for (const auto &f : ints) {
+            if (key == QLatin1String(f.key)) {
+                *f.field = it.value().toInt();
+                known = true;
+            }
+        }
+        for (const auto &f : doubles) {
+            if (key == QLatin1String(f.key)) {
+                *f.field = it.value().toDouble();
+                known = true;
+            }
+        }
+        if (!known) {
+            error = "unknown corpus field: " + key;
+            return false;
+        }
+    }
+    return true;
+}
+
+// -------------------------
+//  Misure
+// -------------------------
+struct PhaseRun {
+    QString name;
+    int     docs   = 0;
+    qint64  ns     = 0;
+    quint64 allocs = 0;
+};
+
+static PhaseRun measure(const QString &name, const std::function<int()> &fn)
+{
+    PhaseRun p;
+    p.name = name;
+    QElapsedTimer t;
+    const AllocCount before = allocCount();
+    t.start();
+    p.docs = fn();
+    p.ns = t.nsecsElapsed();
+    p.allocs = allocCount().calls - before.calls;
+    return p;
+}
+
+static double allocsPerDoc(const PhaseRun &p)
+{
+    return p.docs > 0 ? double(p.allocs) / double(p.docs) : 0.0;
+}
+
+// -------------------------
+//  Correttezza
+// -------------------------
+struct ScanResult {
+    QList<DocEntry> pdfs, epubs, notebooks;
+    ScanStats       stats;
+};
+
+// Impronta delle liste: tipo, nome, pagine e tag di ogni entry, in ordine
+static QByteArray fingerprint(const ScanResult &r)
+{
+    QCryptographicHash h(QCryptographicHash::Sha1);
+    for (const QList<DocEntry> *list : {&r.pdfs, &r.epubs, &r.notebooks}) {
+        for (const DocEntry &e : *list) {
+            h.addData((e.uuid + '\n' + e.kind + '\n' + e.visibleName + '\n' +
+                       QString::number(e.pages) + '\n').toUtf8());
+            for (const TagRef &t : e.tags)
+                h.addData((t.name() + '\t' + QString::number(t.pageNumber) + '\t' +
+                           t.pageId.toString() + '\n').toUtf8());
+        }
+    }
+    return h.result().toHex();
+}
+
+static void expectEqual(const char *what, qint64 got, qint64 expected, QStringList &failures)
+{
+    if (got != expected)
+        failures << QString("%1: %2, expected %3").arg(QLatin1String(what)).arg(got).arg(expected);
+}
+
+static void checkScan(const ScanResult &r, const CorpusExpect &x, QStringList &failures)
+{
+    expectEqual("pdfs", r.pdfs.size(), x.pdfs, failures);
+    expectEqual("epubs", r.epubs.size(), x.epubs, failures);
+    expectEqual("notebooks", r.notebooks.size(), x.notebooks, failures);
+    expectEqual("folders", r.stats.folders, x.folders, failures);
+    expectEqual("deleted", r.stats.deleted, x.deleted, failures);
+    expectEqual("trash", r.stats.trash, x.trash, failures);
+    expectEqual("contentMissing", r.stats.contentMissing, x.contentMissing, failures);
+    expectEqual("forcedType", r.stats.forcedType, x.forcedType, failures);
+
+    qint64 pages = 0, tags = 0, unnumbered = 0;
+    for (const QList<DocEntry> *list : {&r.pdfs, &r.epubs, &r.notebooks}) {
+        for (const DocEntry &e : *list) {
+            pages += e.pages;
+            tags  += e.tags.size();
+            for (const TagRef &t : e.tags)
+                unnumbered += t.pageNumber < 0;
+        }
+    }
+    expectEqual("pages", pages, x.pages, failures);
+    expectEqual("tags", tags, x.tags, failures);
+    expectEqual("unnumbered tags", unnumbered, x.unnumbered, failures);
+}
+
+// Rilegge i summary esportati: titolo e righe "• Page" di ogni documento
+static void checkExport(const ScanResult &r, const CorpusExpect &x, QStringList &failures)
+{
+    static const QString kTitle = QStringLiteral("Title     : ");
+    static const QString kPage  = QStringLiteral("      • Page ");
+
+    qint64 tags = 0, unnumbered = 0;
+    int badTitles = 0, missing = 0;
+    for (const QList<DocEntry> *list : {&r.pdfs, &r.epubs, &r.notebooks}) {
+        for (const DocEntry &e : *list) {
+            QFile f(summaryPath(e.uuid));
+            if (!f.open(QIODevice::ReadOnly)) {
+                ++missing;
+                continue;
+            }
+            const QStringList lines = QString::fromUtf8(f.readAll()).split('\n');
+            if (!lines.contains(kTitle + e.visibleName))
+                ++badTitles;
+            for (const QString &line : lines) {
+                if (!line.startsWith(kPage))
+                    continue;
+                ++tags;
+                unnumbered += line.at(kPage.size()) == QLatin1Char('?');
+            }
+        }
+    }
+    expectEqual("summaries missing", missing, 0, failures);
+    expectEqual("summaries with a wrong title", badTitles, 0, failures);
+    expectEqual("summary tag lines", tags, x.tags, failures);
+    expectEqual("summary tag lines without page", unnumbered, x.unnumbered, failures);
+}
+
+// Estrattore in streaming e a span contro il DOM di QJsonDocument su ogni
+// .content del corpus (verifyContentExtractor); elenca i primi file diversi
+static void checkExtractor(const QString &corpus, QStringList &failures)
+{
+    const QDir d(corpus);
+    const QStringList contents = d.entryList(QStringList() << "*.content", QDir::Files, QDir::Name);
+    int mismatches = 0;
+    for (const QString &name : contents) {
+        QString diff;
+        if (verifyContentExtractor(d.filePath(name), diff))
+            continue;
+        if (++mismatches <= 5)
+            failures << "content extractor: " + name + ": " + diff;
+    }
+    if (mismatches > 5)
+        failures << QString("content extractor: %1 more mismatching file(s)").arg(mismatches - 5);
+}
+
+// -------------------------
+//  Corpora golden
+// -------------------------
+
+// Una entry nella forma di expected.json
+static QJsonObject docJson(const DocEntry &e)
+{
+    QJsonArray tags;
+    for (const TagRef &t : e.tags) {
+        QJsonObject tag;
+        tag["name"]       = t.name();
+        tag["pageNumber"] = t.pageNumber;
+        tag["pageId"]     = t.pageId.toString();
+        tags.append(tag);
+    }
+
+    QJsonObject o;
+    o["uuid"]        = e.uuid;
+    o["kind"]        = e.kind;
+    o["visibleName"] = e.visibleName;
+    o["parent"]      = e.hasParent ? e.parentUuid.toString() : QString();
+    o["pages"]       = e.pages;
+    o["tags"]        = tags;
+    return o;
+}
+
+// Contatori attesi di expected.json, per checkScan e checkExport
+static CorpusExpect expectFromGolden(const QJsonObject &expected)
+{
+    const QJsonObject stats = expected.value("stats").toObject();
+    CorpusExpect x;
+    x.pdfs           = stats.value("pdfs").toInt();
+    x.epubs          = stats.value("epubs").toInt();
+    x.notebooks      = stats.value("notebooks").toInt();
+    x.folders        = stats.value("folders").toInt();
+    x.deleted        = stats.value("deleted").toInt();
+    x.trash          = stats.value("trash").toInt();
+    x.contentMissing = stats.value("contentMissing").toInt();
+    x.forcedType     = stats.value("forcedType").toInt();
+
+    for (const QJsonValue &d : expected.value("documents").toArray()) {
+        const QJsonArray tags = d.toObject().value("tags").toArray();
+        x.pages += d.toObject().value("pages").toInt();
+        x.tags  += tags.size();
+        for (const QJsonValue &t : tags)
+            x.unnumbered += t.toObject().value("pageNumber").toInt() < 0;
+    }
+    return x;
+}
+
+// Ogni documento esattamente come in expected.json (per UUID; i tag in ordine)
+static void checkGolden(const ScanResult &r, const QJsonObject &expected, QStringList &failures)
+{
+    expectEqual("metadata", r.stats.metaCount,
+                expected.value("stats").toObject().value("metadata").toInt(), failures);
+
+    QMap<QString, QJsonObject> got, want;
+    for (const QList<DocEntry> *list : {&r.pdfs, &r.epubs, &r.notebooks}) {
+        for (const DocEntry &e : *list)
+            got.insert(e.uuid, docJson(e));
+    }
+    for (const QJsonValue &d : expected.value("documents").toArray())
+        want.insert(d.toObject().value("uuid").toString(), d.toObject());
+
+    const auto compact = [](const QJsonObject &o) {
+        return QString::fromUtf8(QJsonDocument(o).toJson(QJsonDocument::Compact));
+    };
+    for (auto it = want.cbegin(); it != want.cend(); ++it) {
+        if (!got.contains(it.key()))
+            failures << "missing document " + it.key();
+        else if (got.value(it.key()) != it.value())
+            failures << "document " + it.key() + ": " + compact(got.value(it.key())) +
+                            ", expected " + compact(it.value());
+    }
+    for (auto it = got.cbegin(); it != got.cend(); ++it) {
+        if (!want.contains(it.key()))
+            failures << "unexpected document " + it.key();
+    }
+}
+
+// -------------------------
+//  Budget
+// -------------------------
+// Limite = valore misurato × margine (× timeScale per il tempo), mai sotto
+// kMinTimeBudgetMs: le fasi dei casi golden durano frazioni di millisecondo
+// e il solo rumore dello scheduler supererebbe il margine.
+// Una fase senza misura (caso mai registrato con --record) non fallisce:
+// finisce in `unmeasured` e il report lo dice.
+static void checkBudget(const QJsonObject &measured, const Margin &margin, const PhaseRun &p,
+                        double timeScale, QStringList &failures, QStringList &unmeasured)
+{
+    const QJsonObject m = measured.value(p.name).toObject();
+    if (!m.contains("ms") || (allocCountAvailable() && !m.contains("allocs_per_doc"))) {
+        unmeasured << p.name;
+        return;
+    }
+    const double ms      = double(p.ns) / 1e6;
+    const double limitMs = qMax(m.value("ms").toDouble() * margin.time, kMinTimeBudgetMs) * timeScale;
+    if (ms > limitMs)
+        failures << QString("%1: %2 ms, budget %3 ms (measured %4 ms)")
+                        .arg(p.name).arg(ms, 0, 'f', 1).arg(limitMs, 0, 'f', 1)
+                        .arg(m.value("ms").toDouble(), 0, 'f', 1);
+
+    if (!allocCountAvailable())
+        return;
+    const double limitAllocs = m.value("allocs_per_doc").toDouble() * margin.allocs;
+    if (allocsPerDoc(p) > limitAllocs)
+        failures << QString("%1: %2 allocations per document, budget %3 (measured %4)")
+                        .arg(p.name).arg(allocsPerDoc(p), 0, 'f', 1).arg(limitAllocs, 0, 'f', 1)
+                        .arg(m.value("allocs_per_doc").toDouble(), 0, 'f', 1);
+}
+
+static QJsonObject phaseJson(const PhaseRun &p)
+{
+    QJsonObject o;
+    o["phase"]    = p.name;
+    o["docs"]     = p.docs;
+    o["total_ms"] = double(p.ns) / 1e6;
+    if (allocCountAvailable()) {
+        o["allocs"]         = double(p.allocs);
+        o["allocs_per_doc"] = allocsPerDoc(p);
+    }
+    return o;
+}
+
+// Valori grezzi per --record: il margine resta quello del file
+static QJsonObject measuredJson(const PhaseRun &p)
+{
+    QJsonObject m;
+    m["ms"] = qRound(double(p.ns) / 1e5) / 10.0;
+    if (allocCountAvailable())
+        m["allocs_per_doc"] = qRound(allocsPerDoc(p) * 10) / 10.0;
+    return m;
+}
+
+// -------------------------
+//  Un caso
+// -------------------------
+// Un caso è generato ("corpus": CorpusSpec) oppure golden ("golden":
+// directory accanto al file dei budget con la libreria e expected.json, che
+// non si tocca). Per entrambi i budget stanno in "measured".
+static bool runCase(const QJsonObject &c, const CheckOptions &opts, const Margin &margin,
+                    QJsonObject &report, QJsonObject &recorded, QString &error)
+{
+    const QString name = c.value("name").toString();
+    if (name.isEmpty()) {
+        error = "case without a name";
+        return false;
+    }
+    const bool golden = c.contains("golden");
+
+    // Share sempre rigenerata, come il corpus dei casi generati: il
+    // risultato non dipende da esecuzioni precedenti
+    QString corpus;
+    const QString share = opts.work + "/check_" + name + "_share";
+    QDir(share).removeRecursively();
+    CorpusExpect expect;
+    QJsonObject expected;
+    if (golden) {
+        corpus = QFileInfo(opts.budgetsPath).absolutePath() + "/" + c.value("golden").toString();
+        QFile f(corpus + "/expected.json");
+        if (!f.open(QIODevice::ReadOnly)) {
+            error = name + ": cannot read " + f.fileName();
+            return false;
+        }
+        expected = QJsonDocument::fromJson(f.readAll()).object();
+        if (!expected.contains("documents")) {
+            error = name + ": invalid " + f.fileName();
+            return false;
+        }
+        expect = expectFromGolden(expected);
+    } else {
+        CorpusSpec spec;
+        if (!corpusSpecFromJson(c.value("corpus").toObject(), spec, error)) {
+            error = name + ": " + error;
+            return false;
+        }
+        corpus = opts.work + "/check_" + name;
+        QDir(corpus).removeRecursively();
+        CorpusResult gen;
+        if (!generateCorpus(corpus, spec, gen, error)) {
+            error = name + ": " + error;
+            return false;
+        }
+        expect = gen.expect;
+    }
+    if (!QDir().mkpath(share)) {
+        error = "cannot create directory: " + share;
+        return false;
+    }
+    setXochitlBase(corpus);
+    setMirtilloShareBase(share);
+
+    ScanOptions scanOpts;
+    scanOpts.jobs = opts.jobs;
+
+    QStringList failures;
+    QList<PhaseRun> phases;
+
+    // 1) Scansione senza cache: il riferimento per le altre
+    ScanResult cold;
+    phases << measure("scan_cold", [&] {
+        scanDocuments(cold.pdfs, cold.epubs, cold.notebooks, cold.stats, scanOpts);
+        return cold.stats.metaCount;
+    });
+    checkScan(cold, expect, failures);
+    if (golden)
+        checkGolden(cold, expected, failures);
+    checkExtractor(corpus, failures);
+    const QByteArray reference = fingerprint(cold);
+
+    // 2) Cache incrementale: la prima scansione la scrive, la seconda la usa
+    {
+        ScanOptions cached = scanOpts;
+        cached.cachePath = share + "/scan_cache.bin";
+        ScanResult fill, warm;
+        scanDocuments(fill.pdfs, fill.epubs, fill.notebooks, fill.stats, cached);
+        phases << measure("scan_warm", [&] {
+            scanDocuments(warm.pdfs, warm.epubs, warm.notebooks, warm.stats, cached);
+            return warm.stats.metaCount;
+        });
+        if (fingerprint(warm) != reference)
+            failures << "scan_warm: result differs from the uncached scan";
+    }
+
+    // 3) --max-memory: arene per worker e .content fuori misura
+    {
+        ScanOptions budget = scanOpts;
+        budget.maxMemory = kCheckMaxMemory;
+        ScanResult arena;
+        phases << measure("scan_max_memory", [&] {
+            scanDocuments(arena.pdfs, arena.epubs, arena.notebooks, arena.stats, budget);
+            return arena.stats.metaCount;
+        });
+        if (fingerprint(arena) != reference)
+            failures << "scan_max_memory: result differs from the uncached scan";
+    }
+
+    // 4) Export dei summary di testo
+    {
+        QString exportError;
+        phases << measure("export_summary", [&] {
+            int written = 0;
+            for (const QList<DocEntry> *list : {&cold.pdfs, &cold.epubs, &cold.notebooks}) {
+                for (const DocEntry &e : *list) {
+                    if (!writeSummaryFile(e, exportError))
+                        return written;
+                    ++written;
+                }
+            }
+            return written;
+        });
+        if (!exportError.isEmpty())
+            failures << "export_summary: " + exportError;
+        else
+            checkExport(cold, expect, failures);
+    }
+
+    // Con --record si stanno misurando: niente budget
+    const bool budgeted = opts.recordPath.isEmpty();
+    const QJsonObject measured = c.value("measured").toObject();
+    QStringList unmeasured;
+    QJsonArray phaseArray;
+    QJsonObject newMeasured;
+    for (const PhaseRun &p : std::as_const(phases)) {
+        if (budgeted)
+            checkBudget(measured, margin, p, opts.timeScale, failures, unmeasured);
+        phaseArray.append(phaseJson(p));
+        newMeasured[p.name] = measuredJson(p);
+    }
+
+    report = QJsonObject();
+    report["case"]       = name;
+    report["documents"]  = cold.stats.metaCount;
+    report["phases"]     = phaseArray;
+    report["failures"]   = QJsonArray::fromStringList(failures);
+    report["unmeasured"] = QJsonArray::fromStringList(unmeasured);
+
+    recorded = c;
+    recorded["measured"] = newMeasured;
+
+    if (!golden)
+        QDir(corpus).removeRecursively();
+    QDir(share).removeRecursively();
+    return true;
+}
+
+static bool writeJson(const QString &path, const QByteArray &json, QString &error)
+{
+    QSaveFile f(path);
+    if (!f.open(QIODevice::WriteOnly) || f.write(json) != json.size() || !f.commit()) {
+        error = "cannot write " + path;
+        return false;
+    }
+    return true;
+}
+
+int runPerfCheck(const CheckOptions &opts, QTextStream &err)
+{
+    QFile f(opts.budgetsPath);
+    if (!f.open(QIODevice::ReadOnly)) {
+        err << "Error: cannot read " << opts.budgetsPath << "\n";
+        return 1;
+    }
+    const QJsonObject root  = QJsonDocument::fromJson(f.readAll()).object();
+    const QJsonArray  cases = root.value("cases").toArray();
+    if (cases.isEmpty()) {
+        err << "Error: no cases in " << opts.budgetsPath << "\n";
+        return 1;
+    }
+    Margin margin;
+    margin.time   = root.value("margin").toObject().value("time").toDouble();
+    margin.allocs = root.value("margin").toObject().value("allocs").toDouble();
+    if (margin.time < 1 || margin.allocs < 1) {
+        err << "Error: " << opts.budgetsPath << ": \"margin\" needs \"time\" and \"allocs\" >= 1\n";
+        return 1;
+    }
+    if (allocCountAvailable())
+        enableAllocCount();
+    else
+        err << "Warning: allocation counting is not available, allocation budgets are skipped\n";
+
+    QJsonArray reports, recordedCases;
+    int failed = 0, unmeasured = 0;
+    for (const QJsonValue &v : cases) {
+        QJsonObject report, recorded;
+        QString error;
+        if (!runCase(v.toObject(), opts, margin, report, recorded, error)) {
+            err << "Error: " << error << "\n";
+            return 1;
+        }
+
+        const QJsonArray failures = report.value("failures").toArray();
+        QStringList skipped;
+        for (const QJsonValue &phase : report.value("unmeasured").toArray())
+            skipped << phase.toString();
+        unmeasured += skipped.size();
+        err << "  " << report.value("case").toString() << ": ";
+        if (failures.isEmpty()) {
+            err << "ok (" << report.value("documents").toInt() << " documents";
+            if (!skipped.isEmpty())
+                err << "; no budget, not measured yet: " << skipped.join(", ");
+            err << ")\n";
+        } else {
+            ++failed;
+            err << "FAILED\n";
+            for (const QJsonValue &msg : failures)
+                err << "      " << msg.toString() << "\n";
+        }
+        err.flush();
+        reports.append(report);
+        recordedCases.append(recorded);
+    }
+
+    QJsonObject result;
+    result["mirtillo_version"] = QStringLiteral(MIRTILLO_VERSION);
+    result["jobs"]             = opts.jobs;
+    result["time_scale"]       = opts.timeScale;
+    result["cases"]            = reports;
+    result["failed"]           = failed;
+    result["unmeasured"]       = unmeasured;
+    const QByteArray json = QJsonDocument(result).toJson(QJsonDocument::Indented);
+
+    QString error;
+    if (opts.outPath.isEmpty()) {
+        QTextStream(stdout) << json;
+    } else if (!writeJson(opts.outPath, json, error)) {
+        err << "Error: " << error << "\n";
+        return 1;
+    }
+
+    if (!opts.recordPath.isEmpty() && failed) {
+        err << "Measured values not written: fix the failing cases first\n";
+    } else if (!opts.recordPath.isEmpty()) {
+        // Margine e casi golden restano quelli del file; "reference" dice
+        // dove sono state prese le misure
+        QJsonObject budgets = root;
+        budgets["reference"] = QString("%1, %2, jobs %3")
+                                   .arg(QSysInfo::prettyProductName(),
+                                        QSysInfo::currentCpuArchitecture())
+                                   .arg(opts.jobs);
+        budgets["cases"] = recordedCases;
+        if (!writeJson(opts.recordPath, QJsonDocument(budgets).toJson(QJsonDocument::Indented),
+                       error)) {
+            err << "Error: " << error << "\n";
+            return 1;
+        }
+        err << "Measured values written to " << opts.recordPath << "\n";
+    }
+
+    err << (failed ? "Performance check FAILED: " : "Performance check passed: ")
+        << (cases.size() - failed) << "/" << cases.size() << " case(s) ok\n";
+    if (unmeasured > 0 && opts.recordPath.isEmpty())
+        err << "Warning: " << unmeasured << " phase(s) have no measured value and were not "
+               "budgeted; record them on the reference machine (target perf_record)\n";
+    return failed ? 1 : 0;
+}
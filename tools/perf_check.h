@@ -0,0 +1,44 @@
+#pragma once
+
+#include <QString>
+#include <QTextStream>
+
+// Controllo di regressione di mirtillo_bench (--check, test "perf_check").
+//
+// I casi stanno in un file JSON (tools/perf_budgets.json) e sono di due tipi:
+// - golden: piccole librerie scritte a mano in tools/golden/<nome>, con il
+//   risultato atteso della scansione in expected.json (contatori e, per
+//   ogni documento, tipo, nome, cartella, pagine e tag con il numero di
+//   pagina). Coprono i casi limite del formato: .content mancante o non
+//   valido, "pages" alla radice, cestino, cancellati e cartelle;
+// - generati: una CorpusSpec rigenerata a ogni esecuzione (deterministica
+//   per seed), confrontata con quanto ha scritto il generatore
+//   (CorpusExpect).
+// Ogni caso tiene in "measured" i tempi e le allocazioni misurati sulla
+// macchina di riferimento.
+//
+// La libreria viene scansionata ed esportata in questo processo, con
+// xochitlBase()/mirtilloShareBase() puntate sul corpus, e per ogni caso si
+// controlla che la scansione con cache e con --max-memory sia identica a
+// quella senza cache, che i summary esportati abbiano titoli e tag attesi e
+// che su ogni .content l'estrattore in streaming (e quello a span) dia lo
+// stesso risultato del DOM di QJsonDocument (verifyContentExtractor).
+// Il limite di una fase è il valore misurato per il "margin" del file (il
+// tempo anche per timeScale, mai sotto pochi millisecondi). Una fase senza
+// misura non ha budget: non fallisce, ma il report la elenca.
+//
+// Con recordPath il file viene riscritto con i valori appena misurati
+// (margine e casi golden invariati) e i budget non si controllano.
+//
+// Restituisce 0 se tutti i casi rispettano correttezza e budget.
+
+struct CheckOptions {
+    QString budgetsPath;     // casi, margine e valori misurati
+    QString work;            // corpus generati e directory share dei casi
+    QString outPath;         // report JSON; vuoto = stdout
+    QString recordPath;      // se impostato, scrive qui i valori misurati
+    int     jobs = 0;        // worker della scansione (0 = tutti i core)
+    double  timeScale = 1.0; // budget di tempo più larghi su macchine lente (VM)
+};
+
+int runPerfCheck(const CheckOptions &opts, QTextStream &err);